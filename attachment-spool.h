@@ -0,0 +1,327 @@
+#ifndef ASPOOL
+#define ASPOOL
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "env.h"
+
+/*
+* Attachment spool
+* Every uploaded file is one file of the spool directory, named by its id, with an attachment header
+* before the content. Uploads append to it and downloads are written to the sockets with sendfile
+* from its descriptor, so the content is read from the page cache for every recipient and never
+* copied by the server. The files outlive the server: one started later (or taking over) opens an
+* attachment the first time it is asked for, and files older than attachment_ttl are removed.
+*/
+#define SPOOL_MAGIC 0x4f534341
+
+typedef struct attachment_header {
+    uint32_t magic;
+    uint32_t complete;
+    uint64_t size;
+    int64_t created;
+    int32_t broadcast;
+    char name[ATTACHMENT_NAME_LENGTH];
+    char sender[MAX_USERNAME_LENGTH];
+    char recipient[MAX_USERNAME_LENGTH];
+} AttachmentHeader;
+
+// An open spool file, shared by the upload and every download of it, the last release closes it
+typedef struct attachment {
+    uint64_t id;
+    int fd;
+    int refs;
+    AttachmentHeader header;
+    struct attachment *next;
+} Attachment;
+
+typedef struct spool {
+    pthread_mutex_t lock;
+    char dir[SPOOL_DIR_LENGTH];
+    // Open attachments, the list holds a reference to each until the file is removed
+    Attachment *open;
+    uint64_t next_id;
+    // Bytes of content in the spool
+    size_t bytes;
+    unsigned long uploads;
+    unsigned long downloads;
+    unsigned long expired;
+    size_t uploaded;
+    size_t downloaded;
+} Spool;
+
+Spool spool = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+/*
+* Spool path function
+* @param path: where the path is written, SPOOL_DIR_LENGTH + 32 bytes
+* @param id: the attachment id
+* @return: void
+*/
+void spool_path(char *path, uint64_t id) {
+    snprintf(path, SPOOL_DIR_LENGTH + 32, "%s/%016llx", spool.dir, (unsigned long long) id);
+}
+
+/*
+* Spool init function
+* @param dir: the spool directory, created if missing
+* @return: 0 if successful, -1 if the directory can not be used
+* This function will be used at startup to count the attachments left by an earlier server
+*/
+int spool_init(const char *dir) {
+    if (mkdir(dir, 0700) == -1 && errno != EEXIST) {
+        return -1;
+    }
+    DIR *listing = opendir(dir);
+    if (listing == NULL) {
+        return -1;
+    }
+    snprintf(spool.dir, sizeof(spool.dir), "%s", dir);
+    spool.bytes = 0;
+    struct dirent *entry;
+    while ((entry = readdir(listing)) != NULL) {
+        struct stat info;
+        if (entry->d_name[0] != '.' && fstatat(dirfd(listing), entry->d_name, &info, 0) == 0 && info.st_size > (off_t) sizeof(AttachmentHeader)) {
+            spool.bytes += info.st_size - sizeof(AttachmentHeader);
+        }
+    }
+    closedir(listing);
+    // Ids start from the time, so they do not repeat the ones of an earlier server
+    spool.next_id = (uint64_t) time(NULL) << 20;
+    return 0;
+}
+
+/*
+* Attachment retain function
+* @param attachment: the attachment
+* @return: the same attachment
+*/
+Attachment *attachment_retain(Attachment *attachment) {
+    __atomic_add_fetch(&attachment->refs, 1, __ATOMIC_RELAXED);
+    return attachment;
+}
+
+/*
+* Attachment release function
+* @param attachment: the attachment, NULL is ignored
+* @return: void
+* This function will be used to drop a reference, the last one closes the file
+*/
+void attachment_release(Attachment *attachment) {
+    if (attachment && __atomic_sub_fetch(&attachment->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        close(attachment->fd);
+        free(attachment);
+    }
+}
+
+/*
+* Attachment create function
+* @param name: the file name given by the sender
+* @param sender: the username of the sender
+* @param recipient: the username of the recipient, empty for everyone
+* @return: the attachment with a reference for the caller, NULL if the file could not be created
+*/
+Attachment *attachment_create(const char *name, const char *sender, const char *recipient) {
+    Attachment *attachment = (Attachment *) calloc(1, sizeof(Attachment));
+    if (attachment == NULL) {
+        return NULL;
+    }
+    char path[SPOOL_DIR_LENGTH + 32];
+    pthread_mutex_lock(&spool.lock);
+    do {
+        attachment->id = spool.next_id++;
+        spool_path(path, attachment->id);
+        attachment->fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    } while (attachment->fd == -1 && errno == EEXIST);
+    pthread_mutex_unlock(&spool.lock);
+    if (attachment->fd == -1) {
+        free(attachment);
+        return NULL;
+    }
+    AttachmentHeader *header = &attachment->header;
+    header->magic = SPOOL_MAGIC;
+    header->created = time(NULL);
+    header->broadcast = recipient[0] == '\0';
+    snprintf(header->name, sizeof(header->name), "%s", name);
+    snprintf(header->sender, sizeof(header->sender), "%s", sender);
+    snprintf(header->recipient, sizeof(header->recipient), "%s", recipient);
+    if (pwrite(attachment->fd, header, sizeof(AttachmentHeader), 0) != sizeof(AttachmentHeader)) {
+        close(attachment->fd);
+        unlink(path);
+        free(attachment);
+        return NULL;
+    }
+    attachment->refs = 2;
+    pthread_mutex_lock(&spool.lock);
+    attachment->next = spool.open;
+    spool.open = attachment;
+    pthread_mutex_unlock(&spool.lock);
+    return attachment;
+}
+
+/*
+* Attachment append function
+* @param attachment: an attachment being uploaded
+* @param data: the bytes
+* @param len: the number of bytes
+* @return: 0 if successful, -1 if the write failed
+*/
+int attachment_append(Attachment *attachment, const void *data, size_t len) {
+    off_t offset = sizeof(AttachmentHeader) + attachment->header.size;
+    size_t written = 0;
+    while (written < len) {
+        ssize_t bytes = pwrite(attachment->fd, (const char *) data + written, len - written, offset + written);
+        if (bytes <= 0) {
+            return -1;
+        }
+        written += bytes;
+    }
+    attachment->header.size += len;
+    __atomic_add_fetch(&spool.bytes, len, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/*
+* Attachment finish function
+* @param attachment: an attachment being uploaded
+* @return: 0 if successful, -1 if the header could not be written
+* This function will be used when the last chunk arrived, only then the attachment can be downloaded
+*/
+int attachment_finish(Attachment *attachment) {
+    attachment->header.complete = 1;
+    if (pwrite(attachment->fd, &attachment->header, sizeof(AttachmentHeader), 0) != sizeof(AttachmentHeader)) {
+        return -1;
+    }
+    __atomic_add_fetch(&spool.uploads, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&spool.uploaded, attachment->header.size, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/*
+* Spool forget function
+* @param id: the attachment id
+* @return: void
+* This function will be used when the file of an attachment was removed, the list drops its reference
+*/
+void spool_forget(uint64_t id) {
+    Attachment *found = NULL;
+    pthread_mutex_lock(&spool.lock);
+    for (Attachment **link = &spool.open; *link; link = &(*link)->next) {
+        if ((*link)->id == id) {
+            found = *link;
+            *link = found->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&spool.lock);
+    attachment_release(found);
+}
+
+/*
+* Attachment remove function
+* @param attachment: the attachment, the caller keeps its reference
+* @return: void
+* This function will be used for aborted uploads, the downloads already started keep the descriptor
+*/
+void attachment_remove(Attachment *attachment) {
+    char path[SPOOL_DIR_LENGTH + 32];
+    spool_path(path, attachment->id);
+    if (unlink(path) == 0) {
+        __atomic_sub_fetch(&spool.bytes, attachment->header.size, __ATOMIC_RELAXED);
+    }
+    spool_forget(attachment->id);
+}
+
+/*
+* Attachment find function
+* @param id: the attachment id
+* @return: the attachment with a reference for the caller, NULL if there is no such file
+* This function will be used by downloads, an attachment of an earlier server is opened from the spool
+*/
+Attachment *attachment_find(uint64_t id) {
+    pthread_mutex_lock(&spool.lock);
+    Attachment *attachment = spool.open;
+    while (attachment && attachment->id != id) {
+        attachment = attachment->next;
+    }
+    if (attachment) {
+        attachment_retain(attachment);
+        pthread_mutex_unlock(&spool.lock);
+        return attachment;
+    }
+    char path[SPOOL_DIR_LENGTH + 32];
+    spool_path(path, id);
+    int fd = open(path, O_RDWR);
+    if (fd == -1) {
+        pthread_mutex_unlock(&spool.lock);
+        return NULL;
+    }
+    attachment = (Attachment *) calloc(1, sizeof(Attachment));
+    if (attachment == NULL || pread(fd, &attachment->header, sizeof(AttachmentHeader), 0) != sizeof(AttachmentHeader) ||
+        attachment->header.magic != SPOOL_MAGIC) {
+        pthread_mutex_unlock(&spool.lock);
+        close(fd);
+        free(attachment);
+        return NULL;
+    }
+    // The size in the header is only written at the end of an upload, one still going on is as long as its file
+    struct stat info;
+    if (!attachment->header.complete && fstat(fd, &info) == 0 && info.st_size >= (off_t) sizeof(AttachmentHeader)) {
+        attachment->header.size = info.st_size - sizeof(AttachmentHeader);
+    }
+    attachment->header.name[ATTACHMENT_NAME_LENGTH - 1] = '\0';
+    attachment->header.sender[MAX_USERNAME_LENGTH - 1] = '\0';
+    attachment->header.recipient[MAX_USERNAME_LENGTH - 1] = '\0';
+    attachment->id = id;
+    attachment->fd = fd;
+    attachment->refs = 2;
+    attachment->next = spool.open;
+    spool.open = attachment;
+    pthread_mutex_unlock(&spool.lock);
+    return attachment;
+}
+
+/*
+* Spool expire function
+* @param ttl: seconds an attachment is kept
+* @return: the number of attachments removed
+* This function will be used by the main thread to remove the old files, a download in progress keeps its descriptor
+*/
+int spool_expire(int ttl) {
+    DIR *listing = opendir(spool.dir);
+    if (listing == NULL) {
+        return 0;
+    }
+    int removed = 0;
+    time_t now = time(NULL);
+    struct dirent *entry;
+    while ((entry = readdir(listing)) != NULL) {
+        struct stat info;
+        char *end;
+        uint64_t id = strtoull(entry->d_name, &end, 16);
+        if (entry->d_name[0] == '.' || *end != '\0' || fstatat(dirfd(listing), entry->d_name, &info, 0) == -1 || now - info.st_mtime < ttl) {
+            continue;
+        }
+        if (unlinkat(dirfd(listing), entry->d_name, 0) == 0) {
+            if (info.st_size > (off_t) sizeof(AttachmentHeader)) {
+                __atomic_sub_fetch(&spool.bytes, info.st_size - sizeof(AttachmentHeader), __ATOMIC_RELAXED);
+            }
+            spool_forget(id);
+            removed++;
+        }
+    }
+    closedir(listing);
+    spool.expired += removed;
+    return removed;
+}
+
+#endif
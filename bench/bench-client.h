@@ -0,0 +1,353 @@
+#ifndef BCLIENT
+#define BCLIENT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "../chat.pb-c.h"
+
+/*
+* Bench client
+* What the benchmarks need to talk to the server without the chat client: a connection with its
+* receive buffer cut into framed responses, the requests they send, and the numbers they print.
+* The requests are written with blocking sends, the responses are read as they are needed.
+*/
+typedef struct bench_conn {
+    int fd;
+    unsigned char *rx;
+    size_t rx_len;
+    size_t rx_cap;
+} BenchConn;
+
+/*
+* Now ns function
+* @return: the monotonic time in nanoseconds
+*/
+long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+* Bench connect function
+* @param conn: the connection to open
+* @param port: the port of the server on this machine
+* @param source: the local address to connect from, NULL for any
+* @return: 0 if successful, -1 if failed
+*/
+int bench_connect(BenchConn *conn, int port, const char *source) {
+    conn->fd = socket(AF_INET, SOCK_STREAM, 0);
+    conn->rx_len = 0;
+    conn->rx_cap = 8192;
+    conn->rx = (unsigned char *) malloc(conn->rx_cap);
+    if (conn->fd == -1 || conn->rx == NULL) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    if (source) {
+        // Every local address has its own ports, so more than one gives more than 28k connections
+        address.sin_addr.s_addr = inet_addr(source);
+        if (bind(conn->fd, (struct sockaddr *) &address, sizeof(address)) == -1) {
+            return -1;
+        }
+    }
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = inet_addr("127.0.0.1");
+    return connect(conn->fd, (struct sockaddr *) &address, sizeof(address));
+}
+
+/*
+* Bench close function
+* @param conn: the connection
+* @return: void
+*/
+void bench_close(BenchConn *conn) {
+    close(conn->fd);
+    free(conn->rx);
+    conn->fd = -1;
+    conn->rx = NULL;
+}
+
+/*
+* Bench send function
+* @param conn: the connection
+* @param request: the request, sent with its length in front
+* @return: 0 if successful, -1 if the connection failed
+*/
+int bench_send(BenchConn *conn, Chat__Request *request) {
+    size_t len = chat__request__get_packed_size(request);
+    unsigned char *buffer = (unsigned char *) malloc(len + 4);
+    if (buffer == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t header = htonl((uint32_t) len);
+    memcpy(buffer, &header, 4);
+    chat__request__pack(request, buffer + 4);
+    size_t sent = 0;
+    while (sent < len + 4) {
+        ssize_t bytes = send(conn->fd, buffer + sent, len + 4 - sent, MSG_NOSIGNAL);
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd waiting = {conn->fd, POLLOUT, 0};
+            poll(&waiting, 1, 100);
+            continue;
+        }
+        if (bytes <= 0) {
+            free(buffer);
+            return -1;
+        }
+        sent += bytes;
+    }
+    free(buffer);
+    return 0;
+}
+
+/*
+* Bench read function
+* @param conn: the connection
+* @return: the bytes read, 0 if the server closed it, -1 if nothing was there
+* This function will be used when the socket is readable, the bytes wait in the buffer until they are a response
+*/
+ssize_t bench_read(BenchConn *conn) {
+    if (conn->rx_cap - conn->rx_len < 4096) {
+        conn->rx_cap *= 2;
+        conn->rx = (unsigned char *) realloc(conn->rx, conn->rx_cap);
+        if (conn->rx == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    ssize_t bytes = recv(conn->fd, conn->rx + conn->rx_len, conn->rx_cap - conn->rx_len, MSG_DONTWAIT);
+    if (bytes > 0) {
+        conn->rx_len += bytes;
+    }
+    return bytes;
+}
+
+/*
+* Bench next function
+* @param conn: the connection
+* @return: the next response in the buffer, NULL if it is not complete yet
+*/
+Chat__Response *bench_next(BenchConn *conn) {
+    if (conn->rx_len < 4) {
+        return NULL;
+    }
+    uint32_t header;
+    memcpy(&header, conn->rx, 4);
+    size_t len = ntohl(header);
+    if (conn->rx_len < 4 + len) {
+        return NULL;
+    }
+    Chat__Response *response = chat__response__unpack(NULL, len, conn->rx + 4);
+    if (response == NULL) {
+        printf("The server sent a response that could not be unpacked!\n");
+        exit(EXIT_FAILURE);
+    }
+    memmove(conn->rx, conn->rx + 4 + len, conn->rx_len - 4 - len);
+    conn->rx_len -= 4 + len;
+    return response;
+}
+
+/*
+* Bench recv function
+* @param conn: the connection
+* @param timeout_ms: how long to wait for it
+* @return: the next response, NULL if none came in time or the server closed the connection
+*/
+Chat__Response *bench_recv(BenchConn *conn, int timeout_ms) {
+    long long deadline = now_ns() + timeout_ms * 1000000LL;
+    while (1) {
+        Chat__Response *response = bench_next(conn);
+        if (response) {
+            return response;
+        }
+        long long left = (deadline - now_ns()) / 1000000;
+        struct pollfd waiting = {conn->fd, POLLIN, 0};
+        if (left <= 0 || poll(&waiting, 1, (int) left) <= 0) {
+            return NULL;
+        }
+        if (bench_read(conn) == 0) {
+            return NULL;
+        }
+    }
+}
+
+/*
+* Bench recv op function
+* @param conn: the connection
+* @param operation: the operation of the response looked for, the others are dropped
+* @param timeout_ms: how long to wait for it
+* @return: the response, NULL if none came in time
+*/
+Chat__Response *bench_recv_op(BenchConn *conn, Chat__Operation operation, int timeout_ms) {
+    long long deadline = now_ns() + timeout_ms * 1000000LL;
+    while (now_ns() < deadline) {
+        Chat__Response *response = bench_recv(conn, (int) ((deadline - now_ns()) / 1000000) + 1);
+        if (response == NULL || response->operation == operation) {
+            return response;
+        }
+        chat__response__free_unpacked(response, NULL);
+    }
+    return NULL;
+}
+
+/*
+* Bench register function
+* @param conn: the connection
+* @param name: the username
+* @return: 0 if sent, -1 if the connection failed
+*/
+int bench_register(BenchConn *conn, char *name) {
+    Chat__NewUserRequest user = CHAT__NEW_USER_REQUEST__INIT;
+    user.username = name;
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__REGISTER_USER;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_REGISTER_USER;
+    request.register_user = &user;
+    return bench_send(conn, &request);
+}
+
+/*
+* Bench message function
+* @param conn: the connection
+* @param recipient: the username of the recipient, empty for a broadcast
+* @param content: the message
+* @return: 0 if sent, -1 if the connection failed
+*/
+int bench_message(BenchConn *conn, char *recipient, char *content) {
+    Chat__SendMessageRequest message = CHAT__SEND_MESSAGE_REQUEST__INIT;
+    message.recipient = recipient;
+    message.content = content;
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__SEND_MESSAGE;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_SEND_MESSAGE;
+    request.send_message = &message;
+    return bench_send(conn, &request);
+}
+
+/*
+* Bench status function
+* @param conn: the connection
+* @param name: the username of the connection
+* @param status: the new status
+* @return: 0 if sent, -1 if the connection failed
+*/
+int bench_status(BenchConn *conn, char *name, Chat__UserStatus status) {
+    Chat__UpdateStatusRequest update = CHAT__UPDATE_STATUS_REQUEST__INIT;
+    update.username = name;
+    update.new_status = status;
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__UPDATE_STATUS;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_UPDATE_STATUS;
+    request.update_status = &update;
+    return bench_send(conn, &request);
+}
+
+/*
+* Bench users function
+* @param conn: the connection
+* @param name: the user to look up, empty for the list of every user
+* @return: 0 if sent, -1 if the connection failed
+*/
+int bench_users(BenchConn *conn, char *name) {
+    Chat__UserListRequest list = CHAT__USER_LIST_REQUEST__INIT;
+    list.username = name;
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__GET_USERS;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_GET_USERS;
+    request.get_users = &list;
+    return bench_send(conn, &request);
+}
+
+/*
+* Compare samples function
+* @param a: a sample
+* @param b: another sample
+* @return: the order of the samples for qsort
+*/
+int compare_samples(const void *a, const void *b) {
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+/*
+* Bench percentiles function
+* @param label: what was measured
+* @param samples: the latencies in nanoseconds, they are sorted
+* @param count: the number of samples
+* @return: the p99 in nanoseconds
+*/
+long long bench_percentiles(const char *label, long long *samples, int count) {
+    if (count == 0) {
+        printf("%s: no samples\n", label);
+        return 0;
+    }
+    qsort(samples, count, sizeof(long long), compare_samples);
+    long long p99 = samples[(int) (count * 0.99)];
+    printf("%s: %d samples, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n", label, count,
+        samples[count / 2] / 1e6, samples[(int) (count * 0.9)] / 1e6, p99 / 1e6, samples[(int) (count * 0.999)] / 1e6, samples[count - 1] / 1e6);
+    return p99;
+}
+
+/*
+* Process stat function
+* @param pid: the process
+* @param key: a line of /proc/<pid>/status, like "VmRSS:"
+* @return: its value, in kB for the sizes, -1 if it could not be read
+*/
+long process_stat(int pid, const char *key) {
+    char path[64], line[256];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    long value = -1;
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, key, strlen(key)) == 0) {
+            value = atol(line + strlen(key));
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+/*
+* Process cpu function
+* @param pid: the process
+* @return: the user and system CPU time it used in seconds, -1 if it could not be read
+*/
+double process_cpu(int pid) {
+    char path[64], text[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    size_t len = fread(text, 1, sizeof(text) - 1, file);
+    fclose(file);
+    text[len] = '\0';
+    // The name may have spaces, the fields are counted after its closing parenthesis
+    char *fields = strrchr(text, ')');
+    unsigned long user = 0, system = 0;
+    if (fields == NULL || sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &user, &system) != 2) {
+        return -1;
+    }
+    return (double) (user + system) / sysconf(_SC_CLK_TCK);
+}
+
+#endif
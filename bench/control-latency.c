@@ -0,0 +1,114 @@
+#include "bench-client.h"
+
+/*
+* Control latency benchmark
+* A receiver with a small socket buffer stops reading while a sender floods broadcasts, so the frames
+* pile up in its queue on the server. Then the receiver changes its status and reads until the answer
+* comes. It prints how many broadcasts came before the answer and how long it took. The answer only
+* waits for what the kernel already holds when control frames go ahead of the chat traffic:
+*   ./server.o 8080 -o broadcast_rate=0
+*   ./bench/control-latency.o 8080 [broadcasts]
+*/
+
+#define CONTROL_RCVBUF 65536
+#define CONTROL_PAYLOAD 100
+
+/*
+* Connect user function
+* @param conn: the connection
+* @param port: the port of the server
+* @param name: the username to register
+* @return: void
+* This function will be used to set every client up, the benchmark stops if one cannot register
+*/
+void connect_user(BenchConn *conn, int port, char *name) {
+    if (bench_connect(conn, port, NULL) == -1 || bench_register(conn, name) == -1) {
+        printf("Could not connect %s!\n", name);
+        exit(EXIT_FAILURE);
+    }
+    Chat__Response *response = bench_recv_op(conn, CHAT__OPERATION__REGISTER_USER, 5000);
+    if (response == NULL || response->status_code != CHAT__STATUS_CODE__OK) {
+        printf("Could not register %s: %s\n", name, response ? response->message : "no answer");
+        exit(EXIT_FAILURE);
+    }
+    chat__response__free_unpacked(response, NULL);
+}
+
+/*
+* Main function
+* @param argc: number of arguments
+* @param argv: arguments
+* @return: 0 if successful, 1 if failed
+*/
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <port> [broadcasts]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int broadcasts = argc > 2 ? atoi(argv[2]) : 60000;
+
+    BenchConn receiver, sender;
+    connect_user(&receiver, port, "receiver");
+    // New users are not ONLINE until they say so, only then do broadcasts reach them
+    bench_status(&receiver, "receiver", CHAT__USER_STATUS__ONLINE);
+    Chat__Response *online = bench_recv(&receiver, 5000);
+    if (online == NULL) {
+        printf("The receiver could not go online!\n");
+        return 1;
+    }
+    chat__response__free_unpacked(online, NULL);
+    int size = CONTROL_RCVBUF;
+    setsockopt(receiver.fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    connect_user(&sender, port, "sender");
+
+    // Every broadcast is answered to the sender, once they all are the frames wait for the receiver
+    int answered = 0, shed = 0;
+    char content[CONTROL_PAYLOAD + 16];
+    for (int i = 0; answered < broadcasts; ) {
+        Chat__Response *response;
+        if (i < broadcasts) {
+            snprintf(content, sizeof(content), "%d %0*d", i++, CONTROL_PAYLOAD, 0);
+            bench_message(&sender, "", content);
+            // The answers are taken as they come so neither side blocks
+            bench_read(&sender);
+            response = bench_next(&sender);
+        } else if ((response = bench_recv(&sender, 5000)) == NULL) {
+            printf("The sender got %d of %d answers!\n", answered, broadcasts);
+            return 1;
+        }
+        for (; response; response = bench_next(&sender)) {
+            if (response->operation == CHAT__OPERATION__SEND_MESSAGE) {
+                answered++;
+                shed += response->status_code != CHAT__STATUS_CODE__OK;
+            }
+            chat__response__free_unpacked(response, NULL);
+        }
+    }
+    if (shed) {
+        printf("\033[0;33mWARNING!\033[0m %d broadcasts were refused by the server\n", shed);
+    }
+
+    long long start = now_ns();
+    bench_status(&receiver, "receiver", CHAT__USER_STATUS__BUSY);
+    int before = 0;
+    while (1) {
+        Chat__Response *response = bench_recv(&receiver, 10000);
+        if (response == NULL) {
+            printf("The receiver got no answer to its status change!\n");
+            return 1;
+        }
+        // The answer to a status change goes out without an operation, anything but a broadcast is it
+        Chat__Operation operation = response->operation;
+        chat__response__free_unpacked(response, NULL);
+        if (operation != CHAT__OPERATION__INCOMING_MESSAGE) {
+            break;
+        }
+        before++;
+    }
+    double elapsed = (now_ns() - start) / 1e6;
+    printf("Status change answered after %d of %d broadcasts, in %.1f ms\n", before, broadcasts - shed, elapsed);
+    bench_close(&receiver);
+    bench_close(&sender);
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "../mpsc-queue.h"
+
+/*
+* Mailbox contention benchmark
+* Many producer threads post to one consumer thread, through the lock-free MPSC queue the connections
+* use as their mailbox and through a queue behind a mutex, the consumer taking one item per lock like
+* the outbound queues did. Every item carries the time it was posted, so the consumer measures how long
+* it waited, and every producer measures how long its posts took. It prints the items per second and
+* the percentiles of both for each queue:
+*   ./bench/mailbox-contention.o [producers] [items per producer]
+*/
+
+typedef struct item {
+    MpscNode link;
+    struct item *next;
+    long long posted;
+} Item;
+
+typedef struct mutex_queue {
+    pthread_mutex_t lock;
+    Item *head;
+    Item *tail;
+} MutexQueue;
+
+typedef struct producer {
+    pthread_t thread;
+    int lock_free;
+    int count;
+    Item *items;
+    long long *post_ns;
+} Producer;
+
+MpscQueue mailbox;
+MutexQueue locked = {PTHREAD_MUTEX_INITIALIZER, NULL, NULL};
+pthread_barrier_t start_barrier;
+
+/*
+* Now ns function
+* @return: the monotonic time in nanoseconds
+*/
+long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+* Mutex push function
+* @param queue: the queue
+* @param item: the item to append
+* @return: void
+*/
+void mutex_push(MutexQueue *queue, Item *item) {
+    item->next = NULL;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail) {
+        queue->tail->next = item;
+    } else {
+        queue->head = item;
+    }
+    queue->tail = item;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/*
+* Mutex pop function
+* @param queue: the queue
+* @return: the oldest item, NULL if the queue is empty
+*/
+Item *mutex_pop(MutexQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    Item *item = queue->head;
+    if (item) {
+        queue->head = item->next;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return item;
+}
+
+/*
+* Producer thread function
+* @param arg: the producer
+* @return: NULL
+*/
+void *producer_thread(void *arg) {
+    Producer *producer = (Producer *) arg;
+    pthread_barrier_wait(&start_barrier);
+    for (int i = 0; i < producer->count; i++) {
+        Item *item = &producer->items[i];
+        long long start = now_ns();
+        item->posted = start;
+        if (producer->lock_free) {
+            mpsc_push(&mailbox, &item->link);
+        } else {
+            mutex_push(&locked, item);
+        }
+        producer->post_ns[i] = now_ns() - start;
+    }
+    return NULL;
+}
+
+/*
+* Compare samples function
+* @param a: a sample
+* @param b: another sample
+* @return: the order of the samples for qsort
+*/
+int compare_samples(const void *a, const void *b) {
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+/*
+* Print percentiles function
+* @param label: what was measured
+* @param samples: the times in nanoseconds, they are sorted
+* @param count: the number of samples
+* @return: void
+*/
+void print_percentiles(const char *label, long long *samples, long count) {
+    qsort(samples, count, sizeof(long long), compare_samples);
+    printf("  %s: p50 %.2f us, p99 %.2f us, p99.9 %.2f us, max %.2f us\n", label, samples[count / 2] / 1e3,
+        samples[(long) (count * 0.99)] / 1e3, samples[(long) (count * 0.999)] / 1e3, samples[count - 1] / 1e3);
+}
+
+/*
+* Run function
+* @param lock_free: 1 for the MPSC queue, 0 for the mutex queue
+* @param producer_count: the number of producer threads
+* @param per_producer: the items every producer posts
+* @return: void
+* This function will be used as the consumer, it takes every item and measures how long it waited
+*/
+void run(int lock_free, int producer_count, int per_producer) {
+    long total = (long) producer_count * per_producer;
+    Producer *producers = (Producer *) calloc(producer_count, sizeof(Producer));
+    long long *waited = (long long *) malloc(sizeof(long long) * total);
+    long long *posts = (long long *) malloc(sizeof(long long) * total);
+    if (producers == NULL || waited == NULL || posts == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    mpsc_init(&mailbox);
+    pthread_barrier_init(&start_barrier, NULL, producer_count + 1);
+    for (int p = 0; p < producer_count; p++) {
+        producers[p].lock_free = lock_free;
+        producers[p].count = per_producer;
+        producers[p].items = (Item *) calloc(per_producer, sizeof(Item));
+        producers[p].post_ns = posts + (long) p * per_producer;
+        if (producers[p].items == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        pthread_create(&producers[p].thread, NULL, producer_thread, &producers[p]);
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    long long start = now_ns();
+    long taken = 0;
+    while (taken < total) {
+        Item *item = NULL;
+        if (lock_free) {
+            MpscNode *node = mpsc_pop(&mailbox);
+            item = node ? mpsc_entry(node, Item, link) : NULL;
+        } else {
+            item = mutex_pop(&locked);
+        }
+        if (item == NULL) {
+            sched_yield();
+            continue;
+        }
+        waited[taken++] = now_ns() - item->posted;
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    for (int p = 0; p < producer_count; p++) {
+        pthread_join(producers[p].thread, NULL);
+        free(producers[p].items);
+    }
+    pthread_barrier_destroy(&start_barrier);
+    printf("%s: %d producers, %.2f M items per second\n", lock_free ? "MPSC queue" : "Mutex queue", producer_count, total / seconds / 1e6);
+    print_percentiles("post", posts, total);
+    print_percentiles("wait until taken", waited, total);
+    free(producers);
+    free(waited);
+    free(posts);
+}
+
+/*
+* Main function
+* @param argc: number of arguments
+* @param argv: arguments
+* @return: 0 if successful
+*/
+int main(int argc, char *argv[]) {
+    int producer_count = argc > 1 ? atoi(argv[1]) : 64;
+    int per_producer = argc > 2 ? atoi(argv[2]) : 20000;
+    run(0, producer_count, per_producer);
+    run(1, producer_count, per_producer);
+    return 0;
+}
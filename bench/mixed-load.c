@@ -0,0 +1,201 @@
+#include <pthread.h>
+#include "bench-client.h"
+
+/*
+* Mixed load benchmark
+* Chatters send each other direct messages every CHAT_INTERVAL_MS and the receiver takes the time
+* from the content, first alone and then while listers ask for the whole user list as fast as the
+* server answers. Idle users are registered first so every list is long. It prints the delivery
+* latency of the chat messages in both phases and the lists served per second. Without worker threads
+* a list delays the chat of every client on its thread, with them only the lister waits:
+*   ./server.o 8080 -o max_per_ip=0 -o direct_rate=0 -o users_rate=0
+*   ./bench/mixed-load.o 8080 [chatters] [listers] [idle users] [seconds]
+*/
+
+#define CHAT_INTERVAL_MS 10
+
+typedef struct lister_state {
+    int port;
+    int index;
+    volatile int *running;
+    unsigned long lists;
+} ListerState;
+
+typedef struct samples {
+    long long *values;
+    int count;
+    int capacity;
+} Samples;
+
+/*
+* Add sample function
+* @param samples: the samples
+* @param value: a latency in nanoseconds
+* @return: void
+*/
+void add_sample(Samples *samples, long long value) {
+    if (samples->count == samples->capacity) {
+        samples->capacity = samples->capacity ? samples->capacity * 2 : 4096;
+        samples->values = (long long *) realloc(samples->values, sizeof(long long) * samples->capacity);
+        if (samples->values == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    samples->values[samples->count++] = value;
+}
+
+/*
+* Connect user function
+* @param conn: the connection
+* @param port: the port of the server
+* @param name: the username to register
+* @return: void
+* This function will be used to set every client up, the benchmark stops if one cannot register
+*/
+void connect_user(BenchConn *conn, int port, char *name) {
+    if (bench_connect(conn, port, NULL) == -1 || bench_register(conn, name) == -1) {
+        printf("Could not connect %s!\n", name);
+        exit(EXIT_FAILURE);
+    }
+    Chat__Response *response = bench_recv_op(conn, CHAT__OPERATION__REGISTER_USER, 5000);
+    if (response == NULL || response->status_code != CHAT__STATUS_CODE__OK) {
+        printf("Could not register %s: %s\n", name, response ? response->message : "no answer");
+        exit(EXIT_FAILURE);
+    }
+    chat__response__free_unpacked(response, NULL);
+}
+
+/*
+* Lister thread function
+* @param arg: the lister
+* @return: NULL
+* This function will be used to ask for the user list again as soon as the last one came
+*/
+void *lister_thread(void *arg) {
+    ListerState *state = (ListerState *) arg;
+    BenchConn conn;
+    char name[32];
+    snprintf(name, sizeof(name), "lister%d", state->index);
+    connect_user(&conn, state->port, name);
+    while (*state->running) {
+        bench_users(&conn, "");
+        Chat__Response *response = bench_recv_op(&conn, CHAT__OPERATION__GET_USERS, 5000);
+        if (response == NULL) {
+            printf("%s got no user list!\n", name);
+            break;
+        }
+        chat__response__free_unpacked(response, NULL);
+        state->lists++;
+    }
+    bench_close(&conn);
+    return NULL;
+}
+
+/*
+* Chat phase function
+* @param chatters: the connections of the chatters, each one writes to the next
+* @param count: the number of chatters
+* @param seconds: how long the phase lasts
+* @param samples: where the delivery latencies go
+* @return: void
+*/
+void chat_phase(BenchConn *chatters, int count, int seconds, Samples *samples) {
+    struct pollfd *waiting = (struct pollfd *) calloc(count, sizeof(struct pollfd));
+    long long *next_send = (long long *) calloc(count, sizeof(long long));
+    char recipient[32], content[32];
+    long long end = now_ns() + seconds * 1000000000LL;
+    while (now_ns() < end) {
+        long long now = now_ns();
+        for (int i = 0; i < count; i++) {
+            if (now >= next_send[i]) {
+                snprintf(recipient, sizeof(recipient), "chatter%d", (i + 1) % count);
+                snprintf(content, sizeof(content), "%lld", now);
+                bench_message(&chatters[i], recipient, content);
+                next_send[i] = now + CHAT_INTERVAL_MS * 1000000LL;
+            }
+            waiting[i].fd = chatters[i].fd;
+            waiting[i].events = POLLIN;
+        }
+        if (poll(waiting, count, 1) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            if (!(waiting[i].revents & POLLIN)) {
+                continue;
+            }
+            bench_read(&chatters[i]);
+            Chat__Response *response;
+            while ((response = bench_next(&chatters[i]))) {
+                if (response->operation == CHAT__OPERATION__INCOMING_MESSAGE && response->incoming_message) {
+                    add_sample(samples, now_ns() - atoll(response->incoming_message->content));
+                }
+                chat__response__free_unpacked(response, NULL);
+            }
+        }
+    }
+    free(waiting);
+    free(next_send);
+}
+
+/*
+* Main function
+* @param argc: number of arguments
+* @param argv: arguments
+* @return: 0 if successful, 1 if failed
+*/
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <port> [chatters] [listers] [idle users] [seconds]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int chatter_count = argc > 2 ? atoi(argv[2]) : 16;
+    int lister_count = argc > 3 ? atoi(argv[3]) : 4;
+    int idle_count = argc > 4 ? atoi(argv[4]) : 2000;
+    int seconds = argc > 5 ? atoi(argv[5]) : 5;
+
+    char name[32];
+    BenchConn *idle = (BenchConn *) calloc(idle_count, sizeof(BenchConn));
+    for (int i = 0; i < idle_count; i++) {
+        snprintf(name, sizeof(name), "idle%d", i);
+        connect_user(&idle[i], port, name);
+    }
+    BenchConn *chatters = (BenchConn *) calloc(chatter_count, sizeof(BenchConn));
+    for (int i = 0; i < chatter_count; i++) {
+        snprintf(name, sizeof(name), "chatter%d", i);
+        connect_user(&chatters[i], port, name);
+    }
+
+    Samples alone = {0}, mixed = {0};
+    chat_phase(chatters, chatter_count, seconds, &alone);
+
+    volatile int running = 1;
+    pthread_t *threads = (pthread_t *) calloc(lister_count, sizeof(pthread_t));
+    ListerState *listers = (ListerState *) calloc(lister_count, sizeof(ListerState));
+    for (int i = 0; i < lister_count; i++) {
+        listers[i].port = port;
+        listers[i].index = i;
+        listers[i].running = &running;
+        pthread_create(&threads[i], NULL, lister_thread, &listers[i]);
+    }
+    chat_phase(chatters, chatter_count, seconds, &mixed);
+    running = 0;
+    unsigned long lists = 0;
+    for (int i = 0; i < lister_count; i++) {
+        pthread_join(threads[i], NULL);
+        lists += listers[i].lists;
+    }
+
+    printf("%d chatters, %d idle users\n", chatter_count, idle_count);
+    bench_percentiles("Chat alone", alone.values, alone.count);
+    bench_percentiles("Chat with listers", mixed.values, mixed.count);
+    printf("%d listers: %.0f lists of %d users per second\n", lister_count, (double) lists / seconds, idle_count + chatter_count + lister_count);
+    for (int i = 0; i < chatter_count; i++) {
+        bench_close(&chatters[i]);
+    }
+    for (int i = 0; i < idle_count; i++) {
+        bench_close(&idle[i]);
+    }
+    return 0;
+}
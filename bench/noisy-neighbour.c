@@ -0,0 +1,185 @@
+#include <pthread.h>
+#include "bench-client.h"
+
+/*
+* Noisy neighbour benchmark
+* A quiet client asks for itself every QUIET_INTERVAL_MS and times every answer, first alone and then
+* while a noisy client pipelines thousands of the same request without waiting and throws the answers
+* away. It prints the percentiles of the quiet client in both phases and the requests the noisy one got
+* answered. With a read budget per connection the quiet latency stays bounded:
+*   ./server.o 8080 -o users_rate=0
+*   ./bench/noisy-neighbour.o 8080 [seconds] [pipelined requests]
+*/
+
+#define QUIET_INTERVAL_MS 10
+
+typedef struct noisy_state {
+    BenchConn conn;
+    int pipelined;
+    volatile int *running;
+    unsigned long answered;
+} NoisyState;
+
+/*
+* Connect user function
+* @param conn: the connection
+* @param port: the port of the server
+* @param name: the username to register
+* @return: void
+* This function will be used to set every client up, the benchmark stops if one cannot register
+*/
+void connect_user(BenchConn *conn, int port, char *name) {
+    if (bench_connect(conn, port, NULL) == -1 || bench_register(conn, name) == -1) {
+        printf("Could not connect %s!\n", name);
+        exit(EXIT_FAILURE);
+    }
+    Chat__Response *response = bench_recv_op(conn, CHAT__OPERATION__REGISTER_USER, 5000);
+    if (response == NULL || response->status_code != CHAT__STATUS_CODE__OK) {
+        printf("Could not register %s: %s\n", name, response ? response->message : "no answer");
+        exit(EXIT_FAILURE);
+    }
+    chat__response__free_unpacked(response, NULL);
+}
+
+/*
+* Noisy send thread function
+* @param arg: the noisy client
+* @return: NULL
+* This function will be used to write the same batch of requests again and again, packed only once
+*/
+void *noisy_send_thread(void *arg) {
+    NoisyState *state = (NoisyState *) arg;
+    Chat__UserListRequest list = CHAT__USER_LIST_REQUEST__INIT;
+    list.username = "noisy";
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__GET_USERS;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_GET_USERS;
+    request.get_users = &list;
+    size_t len = chat__request__get_packed_size(&request);
+    size_t total = (len + 4) * state->pipelined;
+    unsigned char *batch = (unsigned char *) malloc(total);
+    if (batch == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t header = htonl((uint32_t) len);
+    for (int i = 0; i < state->pipelined; i++) {
+        memcpy(batch + i * (len + 4), &header, 4);
+        chat__request__pack(&request, batch + i * (len + 4) + 4);
+    }
+    while (*state->running) {
+        for (size_t sent = 0; sent < total; ) {
+            ssize_t bytes = send(state->conn.fd, batch + sent, total - sent, MSG_NOSIGNAL);
+            if (bytes <= 0) {
+                free(batch);
+                return NULL;
+            }
+            sent += bytes;
+        }
+    }
+    free(batch);
+    return NULL;
+}
+
+/*
+* Noisy drain thread function
+* @param arg: the noisy client
+* @return: NULL
+* This function will be used to read the answers of the noisy client so the server never waits on it
+*/
+void *noisy_drain_thread(void *arg) {
+    NoisyState *state = (NoisyState *) arg;
+    while (*state->running) {
+        struct pollfd waiting = {state->conn.fd, POLLIN, 0};
+        if (poll(&waiting, 1, 100) <= 0) {
+            continue;
+        }
+        if (bench_read(&state->conn) == 0) {
+            break;
+        }
+        Chat__Response *response;
+        while ((response = bench_next(&state->conn))) {
+            state->answered += response->operation == CHAT__OPERATION__GET_USERS;
+            chat__response__free_unpacked(response, NULL);
+        }
+    }
+    return NULL;
+}
+
+/*
+* Quiet phase function
+* @param quiet: the connection of the quiet client
+* @param seconds: how long the phase lasts
+* @param samples: where the round trips go, room for one every QUIET_INTERVAL_MS
+* @return: the number of samples
+*/
+int quiet_phase(BenchConn *quiet, int seconds, long long *samples) {
+    int count = 0;
+    long long end = now_ns() + seconds * 1000000000LL;
+    while (now_ns() < end) {
+        long long start = now_ns();
+        bench_users(quiet, "quiet");
+        Chat__Response *response = bench_recv_op(quiet, CHAT__OPERATION__GET_USERS, 10000);
+        if (response == NULL) {
+            printf("The quiet client got no answer!\n");
+            exit(EXIT_FAILURE);
+        }
+        samples[count++] = now_ns() - start;
+        chat__response__free_unpacked(response, NULL);
+        usleep(QUIET_INTERVAL_MS * 1000);
+    }
+    return count;
+}
+
+/*
+* Main function
+* @param argc: number of arguments
+* @param argv: arguments
+* @return: 0 if successful, 1 if failed
+*/
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <port> [seconds] [pipelined requests]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    int pipelined = argc > 3 ? atoi(argv[3]) : 2000;
+
+    BenchConn quiet;
+    connect_user(&quiet, port, "quiet");
+    int capacity = seconds * 1000 / QUIET_INTERVAL_MS + 1;
+    long long *alone = (long long *) malloc(sizeof(long long) * capacity);
+    long long *noisy = (long long *) malloc(sizeof(long long) * capacity);
+    if (alone == NULL || noisy == NULL) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    int alone_count = quiet_phase(&quiet, seconds, alone);
+
+    volatile int running = 1;
+    NoisyState state = {{0}, pipelined, &running, 0};
+    connect_user(&state.conn, port, "noisy");
+    pthread_t sender, drainer;
+    pthread_create(&drainer, NULL, noisy_drain_thread, &state);
+    pthread_create(&sender, NULL, noisy_send_thread, &state);
+    // Let the noisy client fill its queues first
+    usleep(300 * 1000);
+    unsigned long answered_before = state.answered;
+    int noisy_count = quiet_phase(&quiet, seconds, noisy);
+    unsigned long answered = state.answered - answered_before;
+    running = 0;
+    // The sender may be blocked in a send, shutting the socket down wakes it
+    shutdown(state.conn.fd, SHUT_RDWR);
+    pthread_join(sender, NULL);
+    pthread_join(drainer, NULL);
+
+    bench_percentiles("Quiet alone", alone, alone_count);
+    bench_percentiles("Quiet with a noisy neighbour", noisy, noisy_count);
+    printf("Noisy client: %.0f requests answered per second\n", (double) answered / seconds);
+    bench_close(&state.conn);
+    bench_close(&quiet);
+    free(alone);
+    free(noisy);
+    return 0;
+}
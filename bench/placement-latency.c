@@ -0,0 +1,146 @@
+#include <pthread.h>
+#include "bench-client.h"
+
+/*
+* Placement latency benchmark
+* Background clients send each other direct messages as fast as the server delivers them while a probe
+* client asks for one user at a time and times every answer. It prints the percentiles of the probe,
+* run it once against a server with its threads free to move and once with them pinned, the p99 of
+* the two runs is the difference the placement makes:
+*   ./server.o 8080 -o max_per_ip=0 -o direct_rate=0 -o users_rate=0
+*   ./server.o 8080 -o max_per_ip=0 -o direct_rate=0 -o users_rate=0 -o io_cpus=0-1 -o worker_cpus=2-3
+*   ./bench/placement-latency.o 8080 [background clients] [seconds]
+*/
+
+#define PROBE_INTERVAL_US 500
+
+typedef struct background_state {
+    int port;
+    int count;
+    volatile int *running;
+    unsigned long delivered;
+} BackgroundState;
+
+/*
+* Connect user function
+* @param conn: the connection
+* @param port: the port of the server
+* @param name: the username to register
+* @return: void
+* This function will be used to set every client up, the benchmark stops if one cannot register
+*/
+void connect_user(BenchConn *conn, int port, char *name) {
+    if (bench_connect(conn, port, NULL) == -1 || bench_register(conn, name) == -1) {
+        printf("Could not connect %s!\n", name);
+        exit(EXIT_FAILURE);
+    }
+    Chat__Response *response = bench_recv_op(conn, CHAT__OPERATION__REGISTER_USER, 5000);
+    if (response == NULL || response->status_code != CHAT__STATUS_CODE__OK) {
+        printf("Could not register %s: %s\n", name, response ? response->message : "no answer");
+        exit(EXIT_FAILURE);
+    }
+    chat__response__free_unpacked(response, NULL);
+}
+
+/*
+* Background thread function
+* @param arg: the background clients
+* @return: NULL
+* This function will be used to keep the I/O threads and workers busy, every client sends the next
+* message once its last one was delivered
+*/
+void *background_thread(void *arg) {
+    BackgroundState *state = (BackgroundState *) arg;
+    BenchConn *conns = (BenchConn *) calloc(state->count, sizeof(BenchConn));
+    struct pollfd *waiting = (struct pollfd *) calloc(state->count, sizeof(struct pollfd));
+    char name[32], recipient[32];
+    for (int i = 0; i < state->count; i++) {
+        snprintf(name, sizeof(name), "load%d", i);
+        connect_user(&conns[i], state->port, name);
+        waiting[i].fd = conns[i].fd;
+        waiting[i].events = POLLIN;
+    }
+    for (int i = 0; i < state->count; i++) {
+        snprintf(recipient, sizeof(recipient), "load%d", (i + 1) % state->count);
+        bench_message(&conns[i], recipient, "load");
+    }
+    while (*state->running) {
+        if (poll(waiting, state->count, 100) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < state->count; i++) {
+            if (!(waiting[i].revents & POLLIN) || bench_read(&conns[i]) == 0) {
+                continue;
+            }
+            Chat__Response *response;
+            while ((response = bench_next(&conns[i]))) {
+                if (response->operation == CHAT__OPERATION__INCOMING_MESSAGE) {
+                    // The message came from the previous client, it sends again
+                    int sender = (i + state->count - 1) % state->count;
+                    snprintf(recipient, sizeof(recipient), "load%d", i);
+                    bench_message(&conns[sender], recipient, "load");
+                    state->delivered++;
+                }
+                chat__response__free_unpacked(response, NULL);
+            }
+        }
+    }
+    for (int i = 0; i < state->count; i++) {
+        bench_close(&conns[i]);
+    }
+    free(conns);
+    free(waiting);
+    return NULL;
+}
+
+/*
+* Main function
+* @param argc: number of arguments
+* @param argv: arguments
+* @return: 0 if successful, 1 if failed
+*/
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <port> [background clients] [seconds]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int background_count = argc > 2 ? atoi(argv[2]) : 64;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+
+    volatile int running = 1;
+    BackgroundState background = {port, background_count, &running, 0};
+    pthread_t thread;
+    pthread_create(&thread, NULL, background_thread, &background);
+
+    BenchConn probe;
+    connect_user(&probe, port, "probe");
+    // Let the background clients register and get going
+    sleep(1);
+    int capacity = seconds * (1000000 / PROBE_INTERVAL_US) + 1;
+    long long *samples = (long long *) malloc(sizeof(long long) * capacity);
+    int count = 0;
+    unsigned long delivered_before = background.delivered;
+    long long end = now_ns() + seconds * 1000000000LL;
+    while (now_ns() < end && count < capacity) {
+        long long start = now_ns();
+        bench_users(&probe, "probe");
+        Chat__Response *response = bench_recv_op(&probe, CHAT__OPERATION__GET_USERS, 5000);
+        if (response == NULL) {
+            printf("The probe got no answer!\n");
+            return 1;
+        }
+        samples[count++] = now_ns() - start;
+        chat__response__free_unpacked(response, NULL);
+        usleep(PROBE_INTERVAL_US);
+    }
+    unsigned long delivered = background.delivered - delivered_before;
+    running = 0;
+    pthread_join(thread, NULL);
+
+    printf("%d background clients, %.0f messages delivered per second\n", background_count, (double) delivered / seconds);
+    bench_percentiles("Probe round trip", samples, count);
+    bench_close(&probe);
+    free(samples);
+    return 0;
+}
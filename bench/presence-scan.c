@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../presence-table.h"
+#include "../client-node.h"
+
+/*
+* Presence scan benchmark
+* Finds the recipients of a broadcast the way the server did before the presence table, walking the
+* list of connections and comparing names, and the way it does now, scanning the eligibility bitmap.
+* Every run has one node per user allocated one by one like the server does, one user in ten OFFLINE
+* and a sender that changes every broadcast. It prints the time of one broadcast for each way.
+*   ./bench/presence-scan.o [broadcasts]
+*/
+
+#define USER_COUNTS 3
+
+/*
+* Now ns function
+* @return: the monotonic time in nanoseconds
+*/
+long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+* List recipients function
+* @param root: the first node of the list, the server
+* @param sender: the node of the sender
+* @return: the sum of the sockets of the recipients, so the walk cannot be left out
+*/
+long list_recipients(CNode *root, CNode *sender) {
+    long sum = 0;
+    for (CNode *current = root; current; current = current->linked_to) {
+        if (strcmp(current->name, "Server") == 0 || strcmp(current->name, sender->name) == 0 || current->status == CHAT__USER_STATUS__OFFLINE) {
+            continue;
+        }
+        sum += current->data;
+    }
+    return sum;
+}
+
+/*
+* Table recipients function
+* @param table: the presence table
+* @param sender: the slot of the sender
+* @return: the sum of the sockets of the recipients, so the scan cannot be left out
+*/
+long table_recipients(PresenceTable *table, int sender) {
+    long sum = 0;
+    for (int slot = presence_next(table, 0, sender); slot >= 0; slot = presence_next(table, slot + 1, sender)) {
+        sum += ((CNode *) table->owners[slot])->data;
+    }
+    return sum;
+}
+
+/*
+* Run function
+* @param users: the number of registered users
+* @param broadcasts: how many broadcasts are timed
+* @return: void
+*/
+void run(int users, int broadcasts) {
+    PresenceTable table;
+    if (presence_init(&table, users) == -1) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    CNode *root = create_node(0, "127.0.0.1", "Server");
+    CNode **nodes = (CNode **) malloc(sizeof(CNode *) * users);
+    CNode *last = root;
+    for (int i = 0; i < users; i++) {
+        char name[MAX_USERNAME_LENGTH];
+        snprintf(name, sizeof(name), "user%d", i);
+        nodes[i] = create_node(i + 10, "127.0.0.1", name);
+        nodes[i]->status = i % 10 == 0 ? CHAT__USER_STATUS__OFFLINE : CHAT__USER_STATUS__ONLINE;
+        nodes[i]->slot = presence_acquire(&table, nodes[i]);
+        presence_set_status(&table, nodes[i]->slot, nodes[i]->status);
+        last->linked_to = nodes[i];
+        last = nodes[i];
+    }
+
+    // The same senders for both, and the sums have to agree
+    long list_sum = 0, table_sum = 0;
+    long long start = now_ns();
+    for (int b = 0; b < broadcasts; b++) {
+        list_sum += list_recipients(root, nodes[(b * 7919) % users]);
+    }
+    long long list_ns = now_ns() - start;
+    start = now_ns();
+    for (int b = 0; b < broadcasts; b++) {
+        table_sum += table_recipients(&table, nodes[(b * 7919) % users]->slot);
+    }
+    long long table_ns = now_ns() - start;
+    if (list_sum != table_sum) {
+        printf("The list and the table found different recipients!\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("%7d users: list %10.1f us, table %10.1f us per broadcast, %.1fx\n", users, list_ns / 1e3 / broadcasts,
+        table_ns / 1e3 / broadcasts, table_ns ? (double) list_ns / table_ns : 0.0);
+
+    for (int i = 0; i < users; i++) {
+        free(nodes[i]);
+    }
+    free(nodes);
+    free(root);
+}
+
+/*
+* Main function
+* @param argc: number of arguments
+* @param argv: arguments
+* @return: 0 if successful
+*/
+int main(int argc, char *argv[]) {
+    int broadcasts = argc > 1 ? atoi(argv[1]) : 1000;
+    int user_counts[USER_COUNTS] = {100, 10000, 100000};
+    for (int i = 0; i < USER_COUNTS; i++) {
+        // Fewer rounds for the big tables, about the same time for each
+        int rounds = broadcasts * 100 / user_counts[i];
+        run(user_counts[i], rounds > 10 ? rounds : 10);
+    }
+    return 0;
+}
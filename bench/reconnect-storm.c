@@ -0,0 +1,271 @@
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "bench-client.h"
+
+/*
+* Reconnect storm benchmark
+* Every wave, a crowd of clients connects and registers at the same moment, like after a network blip,
+* while users that are already in keep asking for themselves. A refused connection or registration
+* waits the retry_after_ms of its answer and tries again. For every wave it prints the registrations of
+* every 100 ms until the whole crowd is in, and at the end the latency the users already in saw. With
+* admission control the registrations per bucket stay flat instead of collapsing:
+*   ./server.o 8080 -o max_per_ip=0
+*   ./bench/reconnect-storm.o 8080 [clients per wave] [waves] [users already in]
+*/
+
+#define STORM_BUCKET_MS 100
+#define STORM_BUCKETS 600
+#define STORM_PROBE_INTERVAL_MS 10
+#define STORM_BATCH 64
+// The wait when a connection closed without saying how long
+#define STORM_DEFAULT_RETRY_MS 100
+
+typedef struct storm_client {
+    BenchConn conn;
+    int connected;
+    int registered;
+    long long retry_at;
+} StormClient;
+
+typedef struct probe_user {
+    BenchConn conn;
+    char name[32];
+    long long sent_at;
+} ProbeUser;
+
+typedef struct samples {
+    long long *values;
+    int count;
+    int capacity;
+} Samples;
+
+/*
+* Add sample function
+* @param samples: the samples
+* @param value: a latency in nanoseconds
+* @return: void
+*/
+void add_sample(Samples *samples, long long value) {
+    if (samples->count == samples->capacity) {
+        samples->capacity = samples->capacity ? samples->capacity * 2 : 4096;
+        samples->values = (long long *) realloc(samples->values, sizeof(long long) * samples->capacity);
+        if (samples->values == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    samples->values[samples->count++] = value;
+}
+
+/*
+* Watch function
+* @param epoll_descript: the epoll instance
+* @param descript: the socket
+* @param tag: what is reported for it, the client index or minus one minus the probe index
+* @return: void
+*/
+void watch(int epoll_descript, int descript, int tag) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = (uint64_t) (int64_t) tag;
+    if (epoll_ctl(epoll_descript, EPOLL_CTL_ADD, descript, &event) == -1) {
+        printf("Could not watch a connection: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+* Start client function
+* @param client: the storm client
+* @param tag: its index
+* @param name: its username
+* @param port: the port of the server
+* @param epoll_descript: where its answers are waited for
+* @return: void
+* This function will be used for the first try and the retries, a client that is still connected only sends the registration again
+*/
+void start_client(StormClient *client, int tag, char *name, int port, int epoll_descript) {
+    if (!client->connected) {
+        if (bench_connect(&client->conn, port, NULL) == -1) {
+            printf("Client %d could not connect: %s\n", tag, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        client->connected = 1;
+        watch(epoll_descript, client->conn.fd, tag);
+    }
+    client->retry_at = 0;
+    // A connection closed before the registration was written is seen closed on the next read
+    bench_register(&client->conn, name);
+}
+
+/*
+* Drop client function
+* @param client: the storm client
+* @param epoll_descript: the epoll instance
+* @return: void
+*/
+void drop_client(StormClient *client, int epoll_descript) {
+    epoll_ctl(epoll_descript, EPOLL_CTL_DEL, client->conn.fd, NULL);
+    bench_close(&client->conn);
+    client->connected = 0;
+}
+
+/*
+* Main function
+* @param argc: number of arguments
+* @param argv: arguments
+* @return: 0 if successful, 1 if failed
+*/
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <port> [clients per wave] [waves] [users already in]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int clients = argc > 2 ? atoi(argv[2]) : 2000;
+    int waves = argc > 3 ? atoi(argv[3]) : 3;
+    int probe_count = argc > 4 ? atoi(argv[4]) : 8;
+
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < (rlim_t) (clients + probe_count) + 64) {
+        clients = (int) limit.rlim_cur - probe_count - 64;
+        printf("\033[0;33mWARNING!\033[0m The file descriptor limit only allows %d clients per wave\n", clients);
+    }
+
+    int epoll_descript = epoll_create1(0);
+    StormClient *storm = (StormClient *) calloc(clients, sizeof(StormClient));
+    ProbeUser *probes = (ProbeUser *) calloc(probe_count, sizeof(ProbeUser));
+    if (epoll_descript == -1 || storm == NULL || probes == NULL) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    for (int p = 0; p < probe_count; p++) {
+        snprintf(probes[p].name, sizeof(probes[p].name), "probe%d", p);
+        if (bench_connect(&probes[p].conn, port, NULL) == -1 || bench_register(&probes[p].conn, probes[p].name) == -1) {
+            printf("Could not connect %s!\n", probes[p].name);
+            return 1;
+        }
+        Chat__Response *response = bench_recv_op(&probes[p].conn, CHAT__OPERATION__REGISTER_USER, 5000);
+        if (response == NULL || response->status_code != CHAT__STATUS_CODE__OK) {
+            printf("Could not register %s: %s\n", probes[p].name, response ? response->message : "no answer");
+            return 1;
+        }
+        chat__response__free_unpacked(response, NULL);
+        watch(epoll_descript, probes[p].conn.fd, -1 - p);
+    }
+
+    Samples latency = {0};
+    int buckets[STORM_BUCKETS];
+    char name[32];
+    struct epoll_event events[256];
+    long long next_probe = now_ns();
+    for (int wave = 0; wave < waves; wave++) {
+        // The blip, every client of the last wave is gone at once and the new crowd comes in together
+        for (int i = 0; i < clients; i++) {
+            if (storm[i].connected) {
+                drop_client(&storm[i], epoll_descript);
+            }
+            storm[i].registered = 0;
+            storm[i].retry_at = 0;
+        }
+        memset(buckets, 0, sizeof(buckets));
+        long long start = now_ns();
+        int registered = 0, refused = 0, last_bucket = 0, next = 0;
+        while (registered < clients) {
+            long long now = now_ns();
+            int bucket = (int) ((now - start) / (STORM_BUCKET_MS * 1000000LL));
+            if (bucket >= STORM_BUCKETS) {
+                printf("Wave %d did not get in after %d s, %d of %d registered!\n", wave + 1, STORM_BUCKETS * STORM_BUCKET_MS / 1000, registered, clients);
+                return 1;
+            }
+            // The crowd connects as fast as this process can, the answers are read in between
+            for (int started = 0; started < STORM_BATCH && next < clients; started++, next++) {
+                snprintf(name, sizeof(name), "storm%d_%d", wave, next);
+                start_client(&storm[next], next, name, port, epoll_descript);
+            }
+            for (int i = 0; i < next; i++) {
+                if (storm[i].retry_at && storm[i].retry_at <= now) {
+                    snprintf(name, sizeof(name), "storm%d_%d", wave, i);
+                    start_client(&storm[i], i, name, port, epoll_descript);
+                }
+            }
+            // A probe that was answered asks again, the ones still waiting are counted when they are answered
+            if (now >= next_probe) {
+                for (int p = 0; p < probe_count; p++) {
+                    if (probes[p].sent_at == 0) {
+                        probes[p].sent_at = now;
+                        bench_users(&probes[p].conn, probes[p].name);
+                    }
+                }
+                next_probe = now + STORM_PROBE_INTERVAL_MS * 1000000LL;
+            }
+
+            int ready = epoll_wait(epoll_descript, events, 256, 1);
+            for (int e = 0; e < ready; e++) {
+                int tag = (int) (int64_t) events[e].data.u64;
+                if (tag < 0) {
+                    ProbeUser *probe = &probes[-1 - tag];
+                    if (bench_read(&probe->conn) == 0) {
+                        printf("%s was disconnected!\n", probe->name);
+                        return 1;
+                    }
+                    Chat__Response *response;
+                    while ((response = bench_next(&probe->conn))) {
+                        if (response->operation == CHAT__OPERATION__GET_USERS && probe->sent_at) {
+                            add_sample(&latency, now_ns() - probe->sent_at);
+                            probe->sent_at = 0;
+                        }
+                        chat__response__free_unpacked(response, NULL);
+                    }
+                    continue;
+                }
+                StormClient *client = &storm[tag];
+                ssize_t bytes = bench_read(&client->conn);
+                int closed = bytes == 0 || (bytes == -1 && errno != EAGAIN && errno != EWOULDBLOCK);
+                Chat__Response *response;
+                while ((response = bench_next(&client->conn))) {
+                    if (response->operation == CHAT__OPERATION__REGISTER_USER && !client->registered) {
+                        if (response->status_code == CHAT__STATUS_CODE__OK) {
+                            client->registered = 1;
+                            registered++;
+                            last_bucket = (int) ((now_ns() - start) / (STORM_BUCKET_MS * 1000000LL));
+                            buckets[last_bucket < STORM_BUCKETS ? last_bucket : STORM_BUCKETS - 1]++;
+                        } else {
+                            refused++;
+                            client->retry_at = now_ns() + (response->retry_after_ms ? response->retry_after_ms : STORM_DEFAULT_RETRY_MS) * 1000000LL;
+                        }
+                    }
+                    chat__response__free_unpacked(response, NULL);
+                }
+                if (closed && !client->registered) {
+                    // Refused at accept, the next try is a new connection
+                    drop_client(client, epoll_descript);
+                    if (client->retry_at == 0) {
+                        client->retry_at = now_ns() + STORM_DEFAULT_RETRY_MS * 1000000LL;
+                    }
+                }
+            }
+        }
+        double seconds = (now_ns() - start) / 1e9;
+        printf("Wave %d: %d clients registered in %.2f s, %d refused and tried again\n  per %d ms:", wave + 1, clients, seconds, refused, STORM_BUCKET_MS);
+        for (int b = 0; b <= last_bucket && b < STORM_BUCKETS; b++) {
+            printf(" %d", buckets[b]);
+        }
+        printf("\n");
+    }
+
+    bench_percentiles("Users already in", latency.values, latency.count);
+    for (int i = 0; i < clients; i++) {
+        if (storm[i].connected) {
+            bench_close(&storm[i].conn);
+        }
+    }
+    for (int p = 0; p < probe_count; p++) {
+        bench_close(&probes[p].conn);
+    }
+    free(latency.values);
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "bench-client.h"
+
+/*
+* Scale benchmark
+* Connects and registers many clients to a server on this machine, at most a window of them waiting
+* for their answer at a time, and reports how fast they registered and the memory the server took per
+* connection. A refused registration is tried again on a new connection. Each local address only has
+* about 28k ports, so the clients connect from SOURCE_CLIENTS of them per address, 127.0.0.1, .2 and on.
+* The server needs room for them and no per-address limit, and pings have to be off since the clients
+* never answer them:
+*   ./server.o 8080 -o max_per_ip=0 -o ping_interval=0
+*   ./bench/scale.o 8080 <server pid> [clients] [window]
+*/
+
+#define SOURCE_CLIENTS 20000
+#define DEFAULT_SCALE_CLIENTS 100000
+#define DEFAULT_SCALE_WINDOW 512
+
+/*
+* Start client function
+* @param conns: the connections
+* @param index: the client to connect
+* @param port: the port of the server
+* @param epoll_descript: where its answer is waited for
+* @return: 0 if successful, -1 if failed
+*/
+int start_client(BenchConn *conns, int index, int port, int epoll_descript) {
+    char source[32], name[32];
+    snprintf(source, sizeof(source), "127.0.0.%d", 1 + index / SOURCE_CLIENTS);
+    snprintf(name, sizeof(name), "scale%d", index);
+    if (bench_connect(&conns[index], port, source) == -1 || bench_register(&conns[index], name) == -1) {
+        printf("Client %d could not connect: %s\n", index, strerror(errno));
+        return -1;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = index;
+    return epoll_ctl(epoll_descript, EPOLL_CTL_ADD, conns[index].fd, &event);
+}
+
+/*
+* Main function
+* @param argc: number of arguments
+* @param argv: arguments
+* @return: 0 if successful, 1 if failed
+*/
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("Usage: %s <port> <server pid> [clients] [window]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int server = atoi(argv[2]);
+    int clients = argc > 3 ? atoi(argv[3]) : DEFAULT_SCALE_CLIENTS;
+    int window = argc > 4 ? atoi(argv[4]) : DEFAULT_SCALE_WINDOW;
+
+    // Every client is a descriptor of this process too
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < (rlim_t) clients + 64) {
+        clients = (int) limit.rlim_cur - 64;
+        printf("\033[0;33mWARNING!\033[0m The file descriptor limit only allows %d clients\n", clients);
+    }
+
+    BenchConn *conns = (BenchConn *) calloc(clients, sizeof(BenchConn));
+    int epoll_descript = epoll_create1(0);
+    if (conns == NULL || epoll_descript == -1) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    long rss_before = process_stat(server, "VmRSS:");
+    long long start = now_ns();
+    int next = 0, waiting = 0, registered = 0, refused = 0;
+    // Refused clients are started again before the new ones
+    int *retry = (int *) malloc(sizeof(int) * clients);
+    int retries = 0;
+    struct epoll_event events[256];
+    while (registered < clients) {
+        while (waiting < window && (retries > 0 || next < clients)) {
+            int index = retries > 0 ? retry[--retries] : next++;
+            if (start_client(conns, index, port, epoll_descript) == -1) {
+                return 1;
+            }
+            waiting++;
+        }
+        int ready = epoll_wait(epoll_descript, events, 256, 5000);
+        if (ready == 0) {
+            printf("No answer for 5 s with %d clients registered!\n", registered);
+            return 1;
+        }
+        for (int i = 0; i < ready; i++) {
+            int index = events[i].data.u32;
+            int closed = bench_read(&conns[index]) == 0;
+            Chat__Response *response;
+            while ((response = bench_next(&conns[index])) && response->operation != CHAT__OPERATION__REGISTER_USER) {
+                chat__response__free_unpacked(response, NULL);
+            }
+            if (response == NULL && !closed) {
+                continue;
+            }
+            epoll_ctl(epoll_descript, EPOLL_CTL_DEL, conns[index].fd, NULL);
+            waiting--;
+            if (response && response->status_code == CHAT__STATUS_CODE__OK) {
+                registered++;
+                if (registered % 10000 == 0) {
+                    printf("%d registered after %.1f s\n", registered, (now_ns() - start) / 1e9);
+                }
+            } else {
+                // Refused at accept or shed while the server catches up, a new connection tries again
+                refused++;
+                bench_close(&conns[index]);
+                retry[retries++] = index;
+            }
+            if (response) {
+                chat__response__free_unpacked(response, NULL);
+            }
+        }
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    // Let the server settle before its memory is read
+    sleep(1);
+    long rss_after = process_stat(server, "VmRSS:");
+    printf("%d clients registered in %.2f s (%.0f per second), %d registrations refused and tried again\n", registered, seconds, registered / seconds, refused);
+    if (rss_before >= 0 && rss_after >= 0) {
+        printf("Server RSS: %ld kB before, %ld kB after, %.0f bytes per connection\n", rss_before, rss_after, (rss_after - rss_before) * 1024.0 / registered);
+    } else {
+        printf("Could not read the memory of process %d\n", server);
+    }
+    for (int i = 0; i < clients; i++) {
+        bench_close(&conns[i]);
+    }
+    return 0;
+}
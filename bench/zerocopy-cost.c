@@ -0,0 +1,133 @@
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "bench-client.h"
+
+/*
+* Zerocopy cost benchmark
+* Many receivers on this machine go online, then one sender broadcasts large messages to them, and the
+* receivers count the bytes until every one of them has the whole broadcasts. It prints the CPU time
+* the server took per GB delivered. Run it once with zerocopy off and once with the frames above the
+* threshold, the server needs room for the large messages and the receivers:
+*   ./server.o 8080 -o max_per_ip=0 -o broadcast_rate=0 -o message_length=65536 -o buffer_size=131072 -o queue_limit=67108864 -o zerocopy_threshold=65536
+*   ./bench/zerocopy-cost.o 8080 <server pid> [receivers] [broadcasts] [message size]
+*/
+
+#define ZEROCOPY_READ_CHUNK (1 << 20)
+
+/*
+* Main function
+* @param argc: number of arguments
+* @param argv: arguments
+* @return: 0 if successful, 1 if failed
+*/
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("Usage: %s <port> <server pid> [receivers] [broadcasts] [message size]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int server = atoi(argv[2]);
+    int receiver_count = argc > 3 ? atoi(argv[3]) : 1000;
+    int broadcasts = argc > 4 ? atoi(argv[4]) : 20;
+    int size = argc > 5 ? atoi(argv[5]) : 65536;
+
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    // Every receiver registers and goes online, the answers are read before the broadcasts start
+    BenchConn *receivers = (BenchConn *) calloc(receiver_count, sizeof(BenchConn));
+    long long *received = (long long *) calloc(receiver_count, sizeof(long long));
+    char *scratch = (char *) malloc(ZEROCOPY_READ_CHUNK);
+    char *content = (char *) malloc(size + 1);
+    int epoll_descript = epoll_create1(0);
+    if (receivers == NULL || received == NULL || scratch == NULL || content == NULL || epoll_descript == -1) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    char name[32];
+    for (int i = 0; i < receiver_count; i++) {
+        snprintf(name, sizeof(name), "receiver%d", i);
+        if (bench_connect(&receivers[i], port, NULL) == -1 || bench_register(&receivers[i], name) == -1 ||
+            bench_status(&receivers[i], name, CHAT__USER_STATUS__ONLINE) == -1) {
+            printf("Could not connect %s!\n", name);
+            return 1;
+        }
+    }
+    for (int i = 0; i < receiver_count; i++) {
+        for (int answers = 0; answers < 2; answers++) {
+            Chat__Response *response = bench_recv(&receivers[i], 5000);
+            if (response == NULL || response->status_code != CHAT__STATUS_CODE__OK) {
+                printf("Receiver %d could not go online: %s\n", i, response ? response->message : "no answer");
+                return 1;
+            }
+            chat__response__free_unpacked(response, NULL);
+        }
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(epoll_descript, EPOLL_CTL_ADD, receivers[i].fd, &event);
+    }
+    BenchConn sender;
+    if (bench_connect(&sender, port, NULL) == -1 || bench_register(&sender, "sender") == -1) {
+        printf("Could not connect the sender!\n");
+        return 1;
+    }
+    Chat__Response *response = bench_recv_op(&sender, CHAT__OPERATION__REGISTER_USER, 5000);
+    if (response == NULL || response->status_code != CHAT__STATUS_CODE__OK) {
+        printf("Could not register the sender: %s\n", response ? response->message : "no answer");
+        return 1;
+    }
+    chat__response__free_unpacked(response, NULL);
+
+    memset(content, 'x', size);
+    content[size] = '\0';
+    double cpu_before = process_cpu(server);
+    long long start = now_ns();
+    int sent = 0, done = 0;
+    long long whole = (long long) broadcasts * size;
+    struct epoll_event events[256];
+    while (done < receiver_count) {
+        // One broadcast at a time between the reads, the server answers every one to the sender
+        if (sent < broadcasts) {
+            bench_message(&sender, "", content);
+            sent++;
+        }
+        int ready = epoll_wait(epoll_descript, events, 256, sent < broadcasts ? 0 : 5000);
+        if (ready == 0 && sent == broadcasts) {
+            printf("No data for 5 s, %d of %d receivers got everything!\n", done, receiver_count);
+            return 1;
+        }
+        for (int e = 0; e < ready; e++) {
+            int i = events[e].data.u32;
+            ssize_t bytes = recv(receivers[i].fd, scratch, ZEROCOPY_READ_CHUNK, MSG_DONTWAIT);
+            if (bytes == 0) {
+                printf("Receiver %d was disconnected!\n", i);
+                return 1;
+            }
+            if (bytes < 0) {
+                continue;
+            }
+            // The frames are a little longer than the messages, the bytes are enough to know they came
+            if (received[i] < whole && received[i] + bytes >= whole) {
+                done++;
+            }
+            received[i] += bytes;
+        }
+    }
+    double seconds = (now_ns() - start) / 1e9;
+    double cpu = process_cpu(server) - cpu_before;
+    double gigabytes = (double) receiver_count * whole / 1e9;
+    printf("%d receivers, %d broadcasts of %d bytes: %.2f GB in %.2f s, server CPU %.2f s, %.2f CPU-s/GB\n",
+        receiver_count, broadcasts, size, gigabytes, seconds, cpu, cpu / gigabytes);
+
+    bench_close(&sender);
+    for (int i = 0; i < receiver_count; i++) {
+        bench_close(&receivers[i]);
+    }
+    free(received);
+    free(scratch);
+    free(content);
+    return 0;
+}
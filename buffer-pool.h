@@ -0,0 +1,256 @@
+#ifndef BPOOL
+#define BPOOL
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include "mem-budget.h"
+#include "attachment-spool.h"
+
+/*
+* Buffer pool
+* Receive buffers are only borrowed while a socket has data to read, so an idle
+* connection does not own one. Returned buffers are cached up to max_cached.
+* Every buffer remembers its size, so the pool can be resized while buffers are borrowed.
+* Cached buffers still count against the memory budget, nothing is cached while it is exceeded.
+*/
+typedef struct pooled_buffer {
+    struct pooled_buffer *next;
+    size_t size;
+} PooledBuffer;
+
+typedef struct buffer_pool {
+    pthread_mutex_t lock;
+    PooledBuffer *free_list;
+    size_t buffer_size;
+    int cached;
+    int max_cached;
+    int in_use;
+} BufferPool;
+
+// Outbound lanes of a connection, a queued frame is written before the frames of later lanes ahead of it
+typedef enum lane {
+    LANE_CONTROL,
+    LANE_BULK,
+    LANE_FILE,
+    LANES
+} Lane;
+
+/*
+* Frame
+* A packed response shared by every connection it is queued on, it is freed when the last one releases it.
+* The first head bytes are in data, the rest of the len bytes (if any) are sent from file at file_offset,
+* or are the data of body, a frame shared by every recipient of the same message.
+* Every frame written to a client is one in the numbering it acknowledges, unless numbered is unset
+*/
+typedef struct frame {
+    int refs;
+    int lane;
+    int numbered;
+    size_t len;
+    size_t head;
+    Attachment *file;
+    off_t file_offset;
+    struct frame *body;
+    unsigned char data[];
+} Frame;
+
+/*
+* Pool init function
+* @param pool: the buffer pool
+* @param buffer_size: the size of every buffer
+* @param max_cached: how many free buffers are kept around
+* @return: void
+*/
+void pool_init(BufferPool *pool, size_t buffer_size, int max_cached) {
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->free_list = NULL;
+    pool->buffer_size = buffer_size;
+    pool->cached = 0;
+    pool->max_cached = max_cached;
+    pool->in_use = 0;
+}
+
+/*
+* Pool take function
+* @param pool: the buffer pool
+* @return: a buffer of buffer_size bytes, NULL if the allocation failed
+* This function will be used to borrow a receive buffer when a socket is readable
+*/
+char *pool_take(BufferPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    PooledBuffer *buffer = pool->free_list;
+    if (buffer) {
+        pool->free_list = buffer->next;
+        pool->cached--;
+    }
+    pool->in_use++;
+    pthread_mutex_unlock(&pool->lock);
+    if (buffer == NULL) {
+        size_t size = pool->buffer_size;
+        buffer = (PooledBuffer *) malloc(sizeof(PooledBuffer) + size);
+        if (buffer == NULL) {
+            pthread_mutex_lock(&pool->lock);
+            pool->in_use--;
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        buffer->size = size;
+        mem_charge(MEM_RECEIVE, sizeof(PooledBuffer) + size);
+    }
+    return (char *) (buffer + 1);
+}
+
+/*
+* Pool give function
+* @param pool: the buffer pool
+* @param data: the buffer to return
+* @return: void
+* This function will be used to give the buffer back once the payload was parsed
+*/
+void pool_give(BufferPool *pool, char *data) {
+    PooledBuffer *buffer = (PooledBuffer *) data - 1;
+    pthread_mutex_lock(&pool->lock);
+    pool->in_use--;
+    // Buffers of an old size are not cached after a resize
+    if (pool->cached < pool->max_cached && buffer->size == pool->buffer_size && !mem_over()) {
+        buffer->next = pool->free_list;
+        pool->free_list = buffer;
+        pool->cached++;
+        buffer = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (buffer) {
+        mem_release(MEM_RECEIVE, sizeof(PooledBuffer) + buffer->size);
+        free(buffer);
+    }
+}
+
+/*
+* Pool buffer size function
+* @param data: a buffer taken from the pool
+* @return: the number of bytes the buffer can hold
+*/
+size_t pool_buffer_size(char *data) {
+    return ((PooledBuffer *) data - 1)->size;
+}
+
+/*
+* Pool resize function
+* @param pool: the buffer pool
+* @param buffer_size: the new size of every buffer
+* @param max_cached: how many free buffers are kept around
+* @return: void
+* This function will be used on a config reload, cached buffers that no longer fit are freed
+*/
+void pool_resize(BufferPool *pool, size_t buffer_size, int max_cached) {
+    pthread_mutex_lock(&pool->lock);
+    PooledBuffer *keep = NULL;
+    int kept = 0;
+    while (pool->free_list) {
+        PooledBuffer *buffer = pool->free_list;
+        pool->free_list = buffer->next;
+        if (buffer->size == buffer_size && kept < max_cached) {
+            buffer->next = keep;
+            keep = buffer;
+            kept++;
+        } else {
+            mem_release(MEM_RECEIVE, sizeof(PooledBuffer) + buffer->size);
+            free(buffer);
+        }
+    }
+    pool->free_list = keep;
+    pool->cached = kept;
+    pool->buffer_size = buffer_size;
+    pool->max_cached = max_cached;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+* Frame create function
+* @param len: the size of the packed response
+* @return: a frame with one reference, NULL if the allocation failed
+*/
+Frame *frame_create(size_t len) {
+    Frame *frame = (Frame *) malloc(sizeof(Frame) + len);
+    if (frame) {
+        frame->refs = 1;
+        frame->lane = LANE_CONTROL;
+        frame->numbered = 1;
+        frame->len = len;
+        frame->head = len;
+        frame->file = NULL;
+        frame->file_offset = 0;
+        frame->body = NULL;
+        mem_charge(MEM_FRAMES, sizeof(Frame) + len);
+    }
+    return frame;
+}
+
+/*
+* Frame retain function
+* @param frame: the frame
+* @return: the same frame
+*/
+Frame *frame_retain(Frame *frame) {
+    __atomic_add_fetch(&frame->refs, 1, __ATOMIC_RELAXED);
+    return frame;
+}
+
+/*
+* Frame release function
+* @param frame: the frame
+* @return: void
+* This function will be used to drop a reference, the last one frees the frame
+*/
+void frame_release(Frame *frame) {
+    if (frame && __atomic_sub_fetch(&frame->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        mem_release(MEM_FRAMES, sizeof(Frame) + frame->head);
+        attachment_release(frame->file);
+        frame_release(frame->body);
+        free(frame);
+    }
+}
+
+/*
+* Frame create split function
+* @param head: the bytes of the frame that are its own
+* @param body: the frame whose data follows them, a reference is taken
+* @return: the frame with its head to fill, NULL if the allocation failed
+* This function will be used when a message is the same for several recipients but for a few bytes
+* of each, only those are allocated for every one of them
+*/
+Frame *frame_create_split(size_t head, Frame *body) {
+    Frame *frame = frame_create(head);
+    if (frame) {
+        frame->len = head + body->len;
+        frame->body = frame_retain(body);
+    }
+    return frame;
+}
+
+/*
+* Frame parts function
+* @param frame: a frame that is not sent from a file
+* @param offset: the bytes of the frame that were already sent
+* @param parts: where the rest of the frame is described, room for two
+* @return: the number of parts
+*/
+int frame_parts(Frame *frame, size_t offset, struct iovec *parts) {
+    int count = 0;
+    if (offset < frame->head) {
+        parts[count].iov_base = frame->data + offset;
+        parts[count].iov_len = frame->head - offset;
+        count++;
+        offset = frame->head;
+    }
+    if (frame->body && offset < frame->len) {
+        parts[count].iov_base = frame->body->data + (offset - frame->head);
+        parts[count].iov_len = frame->len - offset;
+        count++;
+    }
+    return count;
+}
+
+#endif
@@ -97,6 +97,51 @@ void   chat__new_user_request__free_unpacked
   assert(message->base.descriptor == &chat__new_user_request__descriptor);
   protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
 }
+void   chat__ack__init
+                     (Chat__Ack         *message)
+{
+  static const Chat__Ack init_value = CHAT__ACK__INIT;
+  *message = init_value;
+}
+size_t chat__ack__get_packed_size
+                     (const Chat__Ack *message)
+{
+  assert(message->base.descriptor == &chat__ack__descriptor);
+  return protobuf_c_message_get_packed_size ((const ProtobufCMessage*)(message));
+}
+size_t chat__ack__pack
+                     (const Chat__Ack *message,
+                      uint8_t       *out)
+{
+  assert(message->base.descriptor == &chat__ack__descriptor);
+  return protobuf_c_message_pack ((const ProtobufCMessage*)message, out);
+}
+size_t chat__ack__pack_to_buffer
+                     (const Chat__Ack *message,
+                      ProtobufCBuffer *buffer)
+{
+  assert(message->base.descriptor == &chat__ack__descriptor);
+  return protobuf_c_message_pack_to_buffer ((const ProtobufCMessage*)message, buffer);
+}
+Chat__Ack *
+       chat__ack__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data)
+{
+  return (Chat__Ack *)
+     protobuf_c_message_unpack (&chat__ack__descriptor,
+                                allocator, len, data);
+}
+void   chat__ack__free_unpacked
+                     (Chat__Ack *message,
+                      ProtobufCAllocator *allocator)
+{
+  if(!message)
+    return;
+  assert(message->base.descriptor == &chat__ack__descriptor);
+  protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
+}
 void   chat__send_message_request__init
                      (Chat__SendMessageRequest         *message)
 {
@@ -142,6 +187,51 @@ void   chat__send_message_request__free_unpacked
   assert(message->base.descriptor == &chat__send_message_request__descriptor);
   protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
 }
+void   chat__delivery__init
+                     (Chat__Delivery         *message)
+{
+  static const Chat__Delivery init_value = CHAT__DELIVERY__INIT;
+  *message = init_value;
+}
+size_t chat__delivery__get_packed_size
+                     (const Chat__Delivery *message)
+{
+  assert(message->base.descriptor == &chat__delivery__descriptor);
+  return protobuf_c_message_get_packed_size ((const ProtobufCMessage*)(message));
+}
+size_t chat__delivery__pack
+                     (const Chat__Delivery *message,
+                      uint8_t       *out)
+{
+  assert(message->base.descriptor == &chat__delivery__descriptor);
+  return protobuf_c_message_pack ((const ProtobufCMessage*)message, out);
+}
+size_t chat__delivery__pack_to_buffer
+                     (const Chat__Delivery *message,
+                      ProtobufCBuffer *buffer)
+{
+  assert(message->base.descriptor == &chat__delivery__descriptor);
+  return protobuf_c_message_pack_to_buffer ((const ProtobufCMessage*)message, buffer);
+}
+Chat__Delivery *
+       chat__delivery__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data)
+{
+  return (Chat__Delivery *)
+     protobuf_c_message_unpack (&chat__delivery__descriptor,
+                                allocator, len, data);
+}
+void   chat__delivery__free_unpacked
+                     (Chat__Delivery *message,
+                      ProtobufCAllocator *allocator)
+{
+  if(!message)
+    return;
+  assert(message->base.descriptor == &chat__delivery__descriptor);
+  protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
+}
 void   chat__incoming_message_response__init
                      (Chat__IncomingMessageResponse         *message)
 {
@@ -277,6 +367,51 @@ void   chat__user_list_response__free_unpacked
   assert(message->base.descriptor == &chat__user_list_response__descriptor);
   protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
 }
+void   chat__presence_request__init
+                     (Chat__PresenceRequest         *message)
+{
+  static const Chat__PresenceRequest init_value = CHAT__PRESENCE_REQUEST__INIT;
+  *message = init_value;
+}
+size_t chat__presence_request__get_packed_size
+                     (const Chat__PresenceRequest *message)
+{
+  assert(message->base.descriptor == &chat__presence_request__descriptor);
+  return protobuf_c_message_get_packed_size ((const ProtobufCMessage*)(message));
+}
+size_t chat__presence_request__pack
+                     (const Chat__PresenceRequest *message,
+                      uint8_t       *out)
+{
+  assert(message->base.descriptor == &chat__presence_request__descriptor);
+  return protobuf_c_message_pack ((const ProtobufCMessage*)message, out);
+}
+size_t chat__presence_request__pack_to_buffer
+                     (const Chat__PresenceRequest *message,
+                      ProtobufCBuffer *buffer)
+{
+  assert(message->base.descriptor == &chat__presence_request__descriptor);
+  return protobuf_c_message_pack_to_buffer ((const ProtobufCMessage*)message, buffer);
+}
+Chat__PresenceRequest *
+       chat__presence_request__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data)
+{
+  return (Chat__PresenceRequest *)
+     protobuf_c_message_unpack (&chat__presence_request__descriptor,
+                                allocator, len, data);
+}
+void   chat__presence_request__free_unpacked
+                     (Chat__PresenceRequest *message,
+                      ProtobufCAllocator *allocator)
+{
+  if(!message)
+    return;
+  assert(message->base.descriptor == &chat__presence_request__descriptor);
+  protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
+}
 void   chat__update_status_request__init
                      (Chat__UpdateStatusRequest         *message)
 {
@@ -322,6 +457,141 @@ void   chat__update_status_request__free_unpacked
   assert(message->base.descriptor == &chat__update_status_request__descriptor);
   protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
 }
+void   chat__attachment__init
+                     (Chat__Attachment         *message)
+{
+  static const Chat__Attachment init_value = CHAT__ATTACHMENT__INIT;
+  *message = init_value;
+}
+size_t chat__attachment__get_packed_size
+                     (const Chat__Attachment *message)
+{
+  assert(message->base.descriptor == &chat__attachment__descriptor);
+  return protobuf_c_message_get_packed_size ((const ProtobufCMessage*)(message));
+}
+size_t chat__attachment__pack
+                     (const Chat__Attachment *message,
+                      uint8_t       *out)
+{
+  assert(message->base.descriptor == &chat__attachment__descriptor);
+  return protobuf_c_message_pack ((const ProtobufCMessage*)message, out);
+}
+size_t chat__attachment__pack_to_buffer
+                     (const Chat__Attachment *message,
+                      ProtobufCBuffer *buffer)
+{
+  assert(message->base.descriptor == &chat__attachment__descriptor);
+  return protobuf_c_message_pack_to_buffer ((const ProtobufCMessage*)message, buffer);
+}
+Chat__Attachment *
+       chat__attachment__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data)
+{
+  return (Chat__Attachment *)
+     protobuf_c_message_unpack (&chat__attachment__descriptor,
+                                allocator, len, data);
+}
+void   chat__attachment__free_unpacked
+                     (Chat__Attachment *message,
+                      ProtobufCAllocator *allocator)
+{
+  if(!message)
+    return;
+  assert(message->base.descriptor == &chat__attachment__descriptor);
+  protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
+}
+void   chat__download_request__init
+                     (Chat__DownloadRequest         *message)
+{
+  static const Chat__DownloadRequest init_value = CHAT__DOWNLOAD_REQUEST__INIT;
+  *message = init_value;
+}
+size_t chat__download_request__get_packed_size
+                     (const Chat__DownloadRequest *message)
+{
+  assert(message->base.descriptor == &chat__download_request__descriptor);
+  return protobuf_c_message_get_packed_size ((const ProtobufCMessage*)(message));
+}
+size_t chat__download_request__pack
+                     (const Chat__DownloadRequest *message,
+                      uint8_t       *out)
+{
+  assert(message->base.descriptor == &chat__download_request__descriptor);
+  return protobuf_c_message_pack ((const ProtobufCMessage*)message, out);
+}
+size_t chat__download_request__pack_to_buffer
+                     (const Chat__DownloadRequest *message,
+                      ProtobufCBuffer *buffer)
+{
+  assert(message->base.descriptor == &chat__download_request__descriptor);
+  return protobuf_c_message_pack_to_buffer ((const ProtobufCMessage*)message, buffer);
+}
+Chat__DownloadRequest *
+       chat__download_request__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data)
+{
+  return (Chat__DownloadRequest *)
+     protobuf_c_message_unpack (&chat__download_request__descriptor,
+                                allocator, len, data);
+}
+void   chat__download_request__free_unpacked
+                     (Chat__DownloadRequest *message,
+                      ProtobufCAllocator *allocator)
+{
+  if(!message)
+    return;
+  assert(message->base.descriptor == &chat__download_request__descriptor);
+  protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
+}
+void   chat__message_chunk__init
+                     (Chat__MessageChunk         *message)
+{
+  static const Chat__MessageChunk init_value = CHAT__MESSAGE_CHUNK__INIT;
+  *message = init_value;
+}
+size_t chat__message_chunk__get_packed_size
+                     (const Chat__MessageChunk *message)
+{
+  assert(message->base.descriptor == &chat__message_chunk__descriptor);
+  return protobuf_c_message_get_packed_size ((const ProtobufCMessage*)(message));
+}
+size_t chat__message_chunk__pack
+                     (const Chat__MessageChunk *message,
+                      uint8_t       *out)
+{
+  assert(message->base.descriptor == &chat__message_chunk__descriptor);
+  return protobuf_c_message_pack ((const ProtobufCMessage*)message, out);
+}
+size_t chat__message_chunk__pack_to_buffer
+                     (const Chat__MessageChunk *message,
+                      ProtobufCBuffer *buffer)
+{
+  assert(message->base.descriptor == &chat__message_chunk__descriptor);
+  return protobuf_c_message_pack_to_buffer ((const ProtobufCMessage*)message, buffer);
+}
+Chat__MessageChunk *
+       chat__message_chunk__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data)
+{
+  return (Chat__MessageChunk *)
+     protobuf_c_message_unpack (&chat__message_chunk__descriptor,
+                                allocator, len, data);
+}
+void   chat__message_chunk__free_unpacked
+                     (Chat__MessageChunk *message,
+                      ProtobufCAllocator *allocator)
+{
+  if(!message)
+    return;
+  assert(message->base.descriptor == &chat__message_chunk__descriptor);
+  protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
+}
 void   chat__request__init
                      (Chat__Request         *message)
 {
@@ -367,6 +637,51 @@ void   chat__request__free_unpacked
   assert(message->base.descriptor == &chat__request__descriptor);
   protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
 }
+void   chat__server_notice_response__init
+                     (Chat__ServerNoticeResponse         *message)
+{
+  static const Chat__ServerNoticeResponse init_value = CHAT__SERVER_NOTICE_RESPONSE__INIT;
+  *message = init_value;
+}
+size_t chat__server_notice_response__get_packed_size
+                     (const Chat__ServerNoticeResponse *message)
+{
+  assert(message->base.descriptor == &chat__server_notice_response__descriptor);
+  return protobuf_c_message_get_packed_size ((const ProtobufCMessage*)(message));
+}
+size_t chat__server_notice_response__pack
+                     (const Chat__ServerNoticeResponse *message,
+                      uint8_t       *out)
+{
+  assert(message->base.descriptor == &chat__server_notice_response__descriptor);
+  return protobuf_c_message_pack ((const ProtobufCMessage*)message, out);
+}
+size_t chat__server_notice_response__pack_to_buffer
+                     (const Chat__ServerNoticeResponse *message,
+                      ProtobufCBuffer *buffer)
+{
+  assert(message->base.descriptor == &chat__server_notice_response__descriptor);
+  return protobuf_c_message_pack_to_buffer ((const ProtobufCMessage*)message, buffer);
+}
+Chat__ServerNoticeResponse *
+       chat__server_notice_response__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data)
+{
+  return (Chat__ServerNoticeResponse *)
+     protobuf_c_message_unpack (&chat__server_notice_response__descriptor,
+                                allocator, len, data);
+}
+void   chat__server_notice_response__free_unpacked
+                     (Chat__ServerNoticeResponse *message,
+                      ProtobufCAllocator *allocator)
+{
+  if(!message)
+    return;
+  assert(message->base.descriptor == &chat__server_notice_response__descriptor);
+  protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
+}
 void   chat__response__init
                      (Chat__Response         *message)
 {
@@ -463,7 +778,7 @@ const ProtobufCMessageDescriptor chat__user__descriptor =
   (ProtobufCMessageInit) chat__user__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor chat__new_user_request__field_descriptors[1] =
+static const ProtobufCFieldDescriptor chat__new_user_request__field_descriptors[4] =
 {
   {
     "username",
@@ -477,14 +792,53 @@ static const ProtobufCFieldDescriptor chat__new_user_request__field_descriptors[
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "resume",
+    2,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_BOOL,
+    0,   /* quantifier_offset */
+    offsetof(Chat__NewUserRequest, resume),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "received",
+    3,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(Chat__NewUserRequest, received),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "session_token",
+    4,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_BYTES,
+    0,   /* quantifier_offset */
+    offsetof(Chat__NewUserRequest, session_token),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned chat__new_user_request__field_indices_by_name[] = {
+  2,   /* field[2] = received */
+  1,   /* field[1] = resume */
+  3,   /* field[3] = session_token */
   0,   /* field[0] = username */
 };
 static const ProtobufCIntRange chat__new_user_request__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 1 }
+  { 0, 4 }
 };
 const ProtobufCMessageDescriptor chat__new_user_request__descriptor =
 {
@@ -494,73 +848,60 @@ const ProtobufCMessageDescriptor chat__new_user_request__descriptor =
   "Chat__NewUserRequest",
   "chat",
   sizeof(Chat__NewUserRequest),
-  1,
+  4,
   chat__new_user_request__field_descriptors,
   chat__new_user_request__field_indices_by_name,
   1,  chat__new_user_request__number_ranges,
   (ProtobufCMessageInit) chat__new_user_request__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor chat__send_message_request__field_descriptors[2] =
+static const ProtobufCFieldDescriptor chat__ack__field_descriptors[1] =
 {
   {
-    "recipient",
+    "received",
     1,
     PROTOBUF_C_LABEL_NONE,
-    PROTOBUF_C_TYPE_STRING,
+    PROTOBUF_C_TYPE_UINT64,
     0,   /* quantifier_offset */
-    offsetof(Chat__SendMessageRequest, recipient),
+    offsetof(Chat__Ack, received),
     NULL,
-    &protobuf_c_empty_string,
-    0,             /* flags */
-    0,NULL,NULL    /* reserved1,reserved2, etc */
-  },
-  {
-    "content",
-    2,
-    PROTOBUF_C_LABEL_NONE,
-    PROTOBUF_C_TYPE_STRING,
-    0,   /* quantifier_offset */
-    offsetof(Chat__SendMessageRequest, content),
     NULL,
-    &protobuf_c_empty_string,
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
 };
-static const unsigned chat__send_message_request__field_indices_by_name[] = {
-  1,   /* field[1] = content */
-  0,   /* field[0] = recipient */
+static const unsigned chat__ack__field_indices_by_name[] = {
+  0,   /* field[0] = received */
 };
-static const ProtobufCIntRange chat__send_message_request__number_ranges[1 + 1] =
+static const ProtobufCIntRange chat__ack__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 2 }
+  { 0, 1 }
 };
-const ProtobufCMessageDescriptor chat__send_message_request__descriptor =
+const ProtobufCMessageDescriptor chat__ack__descriptor =
 {
   PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
-  "chat.SendMessageRequest",
-  "SendMessageRequest",
-  "Chat__SendMessageRequest",
+  "chat.Ack",
+  "Ack",
+  "Chat__Ack",
   "chat",
-  sizeof(Chat__SendMessageRequest),
-  2,
-  chat__send_message_request__field_descriptors,
-  chat__send_message_request__field_indices_by_name,
-  1,  chat__send_message_request__number_ranges,
-  (ProtobufCMessageInit) chat__send_message_request__init,
+  sizeof(Chat__Ack),
+  1,
+  chat__ack__field_descriptors,
+  chat__ack__field_indices_by_name,
+  1,  chat__ack__number_ranges,
+  (ProtobufCMessageInit) chat__ack__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor chat__incoming_message_response__field_descriptors[3] =
+static const ProtobufCFieldDescriptor chat__send_message_request__field_descriptors[4] =
 {
   {
-    "sender",
+    "recipient",
     1,
     PROTOBUF_C_LABEL_NONE,
     PROTOBUF_C_TYPE_STRING,
     0,   /* quantifier_offset */
-    offsetof(Chat__IncomingMessageResponse, sender),
+    offsetof(Chat__SendMessageRequest, recipient),
     NULL,
     &protobuf_c_empty_string,
     0,             /* flags */
@@ -572,34 +913,175 @@ static const ProtobufCFieldDescriptor chat__incoming_message_response__field_des
     PROTOBUF_C_LABEL_NONE,
     PROTOBUF_C_TYPE_STRING,
     0,   /* quantifier_offset */
-    offsetof(Chat__IncomingMessageResponse, content),
+    offsetof(Chat__SendMessageRequest, content),
     NULL,
     &protobuf_c_empty_string,
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
   {
-    "type",
+    "message_id",
     3,
     PROTOBUF_C_LABEL_NONE,
-    PROTOBUF_C_TYPE_ENUM,
+    PROTOBUF_C_TYPE_UINT64,
     0,   /* quantifier_offset */
-    offsetof(Chat__IncomingMessageResponse, type),
-    &chat__message_type__descriptor,
+    offsetof(Chat__SendMessageRequest, message_id),
+    NULL,
     NULL,
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
-};
+  {
+    "recipients",
+    4,
+    PROTOBUF_C_LABEL_REPEATED,
+    PROTOBUF_C_TYPE_STRING,
+    offsetof(Chat__SendMessageRequest, n_recipients),
+    offsetof(Chat__SendMessageRequest, recipients),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+};
+static const unsigned chat__send_message_request__field_indices_by_name[] = {
+  1,   /* field[1] = content */
+  2,   /* field[2] = message_id */
+  0,   /* field[0] = recipient */
+  3,   /* field[3] = recipients */
+};
+static const ProtobufCIntRange chat__send_message_request__number_ranges[1 + 1] =
+{
+  { 1, 0 },
+  { 0, 4 }
+};
+const ProtobufCMessageDescriptor chat__send_message_request__descriptor =
+{
+  PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
+  "chat.SendMessageRequest",
+  "SendMessageRequest",
+  "Chat__SendMessageRequest",
+  "chat",
+  sizeof(Chat__SendMessageRequest),
+  4,
+  chat__send_message_request__field_descriptors,
+  chat__send_message_request__field_indices_by_name,
+  1,  chat__send_message_request__number_ranges,
+  (ProtobufCMessageInit) chat__send_message_request__init,
+  NULL,NULL,NULL    /* reserved[123] */
+};
+static const ProtobufCFieldDescriptor chat__delivery__field_descriptors[2] =
+{
+  {
+    "username",
+    1,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Delivery, username),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "status",
+    2,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_ENUM,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Delivery, status),
+    &chat__delivery_status__descriptor,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+};
+static const unsigned chat__delivery__field_indices_by_name[] = {
+  1,   /* field[1] = status */
+  0,   /* field[0] = username */
+};
+static const ProtobufCIntRange chat__delivery__number_ranges[1 + 1] =
+{
+  { 1, 0 },
+  { 0, 2 }
+};
+const ProtobufCMessageDescriptor chat__delivery__descriptor =
+{
+  PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
+  "chat.Delivery",
+  "Delivery",
+  "Chat__Delivery",
+  "chat",
+  sizeof(Chat__Delivery),
+  2,
+  chat__delivery__field_descriptors,
+  chat__delivery__field_indices_by_name,
+  1,  chat__delivery__number_ranges,
+  (ProtobufCMessageInit) chat__delivery__init,
+  NULL,NULL,NULL    /* reserved[123] */
+};
+static const ProtobufCFieldDescriptor chat__incoming_message_response__field_descriptors[4] =
+{
+  {
+    "sender",
+    1,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(Chat__IncomingMessageResponse, sender),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "content",
+    2,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(Chat__IncomingMessageResponse, content),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "type",
+    3,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_ENUM,
+    0,   /* quantifier_offset */
+    offsetof(Chat__IncomingMessageResponse, type),
+    &chat__message_type__descriptor,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "sequence",
+    4,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(Chat__IncomingMessageResponse, sequence),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+};
 static const unsigned chat__incoming_message_response__field_indices_by_name[] = {
   1,   /* field[1] = content */
   0,   /* field[0] = sender */
+  3,   /* field[3] = sequence */
   2,   /* field[2] = type */
 };
 static const ProtobufCIntRange chat__incoming_message_response__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 3 }
+  { 0, 4 }
 };
 const ProtobufCMessageDescriptor chat__incoming_message_response__descriptor =
 {
@@ -609,14 +1091,14 @@ const ProtobufCMessageDescriptor chat__incoming_message_response__descriptor =
   "Chat__IncomingMessageResponse",
   "chat",
   sizeof(Chat__IncomingMessageResponse),
-  3,
+  4,
   chat__incoming_message_response__field_descriptors,
   chat__incoming_message_response__field_indices_by_name,
   1,  chat__incoming_message_response__number_ranges,
   (ProtobufCMessageInit) chat__incoming_message_response__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor chat__user_list_request__field_descriptors[1] =
+static const ProtobufCFieldDescriptor chat__user_list_request__field_descriptors[4] =
 {
   {
     "username",
@@ -630,14 +1112,53 @@ static const ProtobufCFieldDescriptor chat__user_list_request__field_descriptors
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "usernames",
+    2,
+    PROTOBUF_C_LABEL_REPEATED,
+    PROTOBUF_C_TYPE_STRING,
+    offsetof(Chat__UserListRequest, n_usernames),
+    offsetof(Chat__UserListRequest, usernames),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "prefix",
+    3,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(Chat__UserListRequest, prefix),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "limit",
+    4,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT32,
+    0,   /* quantifier_offset */
+    offsetof(Chat__UserListRequest, limit),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned chat__user_list_request__field_indices_by_name[] = {
+  3,   /* field[3] = limit */
+  2,   /* field[2] = prefix */
   0,   /* field[0] = username */
+  1,   /* field[1] = usernames */
 };
 static const ProtobufCIntRange chat__user_list_request__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 1 }
+  { 0, 4 }
 };
 const ProtobufCMessageDescriptor chat__user_list_request__descriptor =
 {
@@ -647,14 +1168,14 @@ const ProtobufCMessageDescriptor chat__user_list_request__descriptor =
   "Chat__UserListRequest",
   "chat",
   sizeof(Chat__UserListRequest),
-  1,
+  4,
   chat__user_list_request__field_descriptors,
   chat__user_list_request__field_indices_by_name,
   1,  chat__user_list_request__number_ranges,
   (ProtobufCMessageInit) chat__user_list_request__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor chat__user_list_response__field_descriptors[2] =
+static const ProtobufCFieldDescriptor chat__user_list_response__field_descriptors[3] =
 {
   {
     "users",
@@ -680,15 +1201,28 @@ static const ProtobufCFieldDescriptor chat__user_list_response__field_descriptor
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "more",
+    3,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_BOOL,
+    0,   /* quantifier_offset */
+    offsetof(Chat__UserListResponse, more),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned chat__user_list_response__field_indices_by_name[] = {
+  2,   /* field[2] = more */
   1,   /* field[1] = type */
   0,   /* field[0] = users */
 };
 static const ProtobufCIntRange chat__user_list_response__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 2 }
+  { 0, 3 }
 };
 const ProtobufCMessageDescriptor chat__user_list_response__descriptor =
 {
@@ -698,13 +1232,64 @@ const ProtobufCMessageDescriptor chat__user_list_response__descriptor =
   "Chat__UserListResponse",
   "chat",
   sizeof(Chat__UserListResponse),
-  2,
+  3,
   chat__user_list_response__field_descriptors,
   chat__user_list_response__field_indices_by_name,
   1,  chat__user_list_response__number_ranges,
   (ProtobufCMessageInit) chat__user_list_response__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
+static const ProtobufCFieldDescriptor chat__presence_request__field_descriptors[2] =
+{
+  {
+    "usernames",
+    1,
+    PROTOBUF_C_LABEL_REPEATED,
+    PROTOBUF_C_TYPE_STRING,
+    offsetof(Chat__PresenceRequest, n_usernames),
+    offsetof(Chat__PresenceRequest, usernames),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "unsubscribe",
+    2,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_BOOL,
+    0,   /* quantifier_offset */
+    offsetof(Chat__PresenceRequest, unsubscribe),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+};
+static const unsigned chat__presence_request__field_indices_by_name[] = {
+  1,   /* field[1] = unsubscribe */
+  0,   /* field[0] = usernames */
+};
+static const ProtobufCIntRange chat__presence_request__number_ranges[1 + 1] =
+{
+  { 1, 0 },
+  { 0, 2 }
+};
+const ProtobufCMessageDescriptor chat__presence_request__descriptor =
+{
+  PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
+  "chat.PresenceRequest",
+  "PresenceRequest",
+  "Chat__PresenceRequest",
+  "chat",
+  sizeof(Chat__PresenceRequest),
+  2,
+  chat__presence_request__field_descriptors,
+  chat__presence_request__field_indices_by_name,
+  1,  chat__presence_request__number_ranges,
+  (ProtobufCMessageInit) chat__presence_request__init,
+  NULL,NULL,NULL    /* reserved[123] */
+};
 static const ProtobufCFieldDescriptor chat__update_status_request__field_descriptors[2] =
 {
   {
@@ -723,40 +1308,310 @@ static const ProtobufCFieldDescriptor chat__update_status_request__field_descrip
     "new_status",
     2,
     PROTOBUF_C_LABEL_NONE,
-    PROTOBUF_C_TYPE_ENUM,
+    PROTOBUF_C_TYPE_ENUM,
+    0,   /* quantifier_offset */
+    offsetof(Chat__UpdateStatusRequest, new_status),
+    &chat__user_status__descriptor,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+};
+static const unsigned chat__update_status_request__field_indices_by_name[] = {
+  1,   /* field[1] = new_status */
+  0,   /* field[0] = username */
+};
+static const ProtobufCIntRange chat__update_status_request__number_ranges[1 + 1] =
+{
+  { 1, 0 },
+  { 0, 2 }
+};
+const ProtobufCMessageDescriptor chat__update_status_request__descriptor =
+{
+  PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
+  "chat.UpdateStatusRequest",
+  "UpdateStatusRequest",
+  "Chat__UpdateStatusRequest",
+  "chat",
+  sizeof(Chat__UpdateStatusRequest),
+  2,
+  chat__update_status_request__field_descriptors,
+  chat__update_status_request__field_indices_by_name,
+  1,  chat__update_status_request__number_ranges,
+  (ProtobufCMessageInit) chat__update_status_request__init,
+  NULL,NULL,NULL    /* reserved[123] */
+};
+static const ProtobufCFieldDescriptor chat__attachment__field_descriptors[5] =
+{
+  {
+    "id",
+    1,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Attachment, id),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "name",
+    2,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Attachment, name),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "size",
+    3,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Attachment, size),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "sender",
+    4,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Attachment, sender),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "type",
+    5,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_ENUM,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Attachment, type),
+    &chat__message_type__descriptor,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+};
+static const unsigned chat__attachment__field_indices_by_name[] = {
+  0,   /* field[0] = id */
+  1,   /* field[1] = name */
+  3,   /* field[3] = sender */
+  2,   /* field[2] = size */
+  4,   /* field[4] = type */
+};
+static const ProtobufCIntRange chat__attachment__number_ranges[1 + 1] =
+{
+  { 1, 0 },
+  { 0, 5 }
+};
+const ProtobufCMessageDescriptor chat__attachment__descriptor =
+{
+  PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
+  "chat.Attachment",
+  "Attachment",
+  "Chat__Attachment",
+  "chat",
+  sizeof(Chat__Attachment),
+  5,
+  chat__attachment__field_descriptors,
+  chat__attachment__field_indices_by_name,
+  1,  chat__attachment__number_ranges,
+  (ProtobufCMessageInit) chat__attachment__init,
+  NULL,NULL,NULL    /* reserved[123] */
+};
+static const ProtobufCFieldDescriptor chat__download_request__field_descriptors[2] =
+{
+  {
+    "attachment_id",
+    1,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(Chat__DownloadRequest, attachment_id),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "message_id",
+    2,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT32,
+    0,   /* quantifier_offset */
+    offsetof(Chat__DownloadRequest, message_id),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+};
+static const unsigned chat__download_request__field_indices_by_name[] = {
+  0,   /* field[0] = attachment_id */
+  1,   /* field[1] = message_id */
+};
+static const ProtobufCIntRange chat__download_request__number_ranges[1 + 1] =
+{
+  { 1, 0 },
+  { 0, 2 }
+};
+const ProtobufCMessageDescriptor chat__download_request__descriptor =
+{
+  PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
+  "chat.DownloadRequest",
+  "DownloadRequest",
+  "Chat__DownloadRequest",
+  "chat",
+  sizeof(Chat__DownloadRequest),
+  2,
+  chat__download_request__field_descriptors,
+  chat__download_request__field_indices_by_name,
+  1,  chat__download_request__number_ranges,
+  (ProtobufCMessageInit) chat__download_request__init,
+  NULL,NULL,NULL    /* reserved[123] */
+};
+static const ProtobufCFieldDescriptor chat__message_chunk__field_descriptors[8] =
+{
+  {
+    "message_id",
+    1,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT32,
+    0,   /* quantifier_offset */
+    offsetof(Chat__MessageChunk, message_id),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "type",
+    2,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_ENUM,
+    0,   /* quantifier_offset */
+    offsetof(Chat__MessageChunk, type),
+    &chat__chunk_type__descriptor,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "recipient",
+    3,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(Chat__MessageChunk, recipient),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "data",
+    4,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_BYTES,
+    0,   /* quantifier_offset */
+    offsetof(Chat__MessageChunk, data),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "sender",
+    5,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(Chat__MessageChunk, sender),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "message_type",
+    6,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_ENUM,
+    0,   /* quantifier_offset */
+    offsetof(Chat__MessageChunk, message_type),
+    &chat__message_type__descriptor,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "filename",
+    7,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(Chat__MessageChunk, filename),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "attachment",
+    8,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_MESSAGE,
     0,   /* quantifier_offset */
-    offsetof(Chat__UpdateStatusRequest, new_status),
-    &chat__user_status__descriptor,
+    offsetof(Chat__MessageChunk, attachment),
+    &chat__attachment__descriptor,
     NULL,
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
 };
-static const unsigned chat__update_status_request__field_indices_by_name[] = {
-  1,   /* field[1] = new_status */
-  0,   /* field[0] = username */
+static const unsigned chat__message_chunk__field_indices_by_name[] = {
+  7,   /* field[7] = attachment */
+  3,   /* field[3] = data */
+  6,   /* field[6] = filename */
+  0,   /* field[0] = message_id */
+  5,   /* field[5] = message_type */
+  2,   /* field[2] = recipient */
+  4,   /* field[4] = sender */
+  1,   /* field[1] = type */
 };
-static const ProtobufCIntRange chat__update_status_request__number_ranges[1 + 1] =
+static const ProtobufCIntRange chat__message_chunk__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 2 }
+  { 0, 8 }
 };
-const ProtobufCMessageDescriptor chat__update_status_request__descriptor =
+const ProtobufCMessageDescriptor chat__message_chunk__descriptor =
 {
   PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
-  "chat.UpdateStatusRequest",
-  "UpdateStatusRequest",
-  "Chat__UpdateStatusRequest",
+  "chat.MessageChunk",
+  "MessageChunk",
+  "Chat__MessageChunk",
   "chat",
-  sizeof(Chat__UpdateStatusRequest),
-  2,
-  chat__update_status_request__field_descriptors,
-  chat__update_status_request__field_indices_by_name,
-  1,  chat__update_status_request__number_ranges,
-  (ProtobufCMessageInit) chat__update_status_request__init,
+  sizeof(Chat__MessageChunk),
+  8,
+  chat__message_chunk__field_descriptors,
+  chat__message_chunk__field_indices_by_name,
+  1,  chat__message_chunk__number_ranges,
+  (ProtobufCMessageInit) chat__message_chunk__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor chat__request__field_descriptors[6] =
+static const ProtobufCFieldDescriptor chat__request__field_descriptors[10] =
 {
   {
     "operation",
@@ -830,19 +1685,71 @@ static const ProtobufCFieldDescriptor chat__request__field_descriptors[6] =
     0 | PROTOBUF_C_FIELD_FLAG_ONEOF,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "send_chunk",
+    7,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_MESSAGE,
+    offsetof(Chat__Request, payload_case),
+    offsetof(Chat__Request, send_chunk),
+    &chat__message_chunk__descriptor,
+    NULL,
+    0 | PROTOBUF_C_FIELD_FLAG_ONEOF,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "download_attachment",
+    8,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_MESSAGE,
+    offsetof(Chat__Request, payload_case),
+    offsetof(Chat__Request, download_attachment),
+    &chat__download_request__descriptor,
+    NULL,
+    0 | PROTOBUF_C_FIELD_FLAG_ONEOF,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "ack",
+    9,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_MESSAGE,
+    offsetof(Chat__Request, payload_case),
+    offsetof(Chat__Request, ack),
+    &chat__ack__descriptor,
+    NULL,
+    0 | PROTOBUF_C_FIELD_FLAG_ONEOF,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "subscribe_presence",
+    10,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_MESSAGE,
+    offsetof(Chat__Request, payload_case),
+    offsetof(Chat__Request, subscribe_presence),
+    &chat__presence_request__descriptor,
+    NULL,
+    0 | PROTOBUF_C_FIELD_FLAG_ONEOF,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned chat__request__field_indices_by_name[] = {
+  8,   /* field[8] = ack */
+  7,   /* field[7] = download_attachment */
   4,   /* field[4] = get_users */
   0,   /* field[0] = operation */
   1,   /* field[1] = register_user */
+  6,   /* field[6] = send_chunk */
   2,   /* field[2] = send_message */
+  9,   /* field[9] = subscribe_presence */
   5,   /* field[5] = unregister_user */
   3,   /* field[3] = update_status */
 };
 static const ProtobufCIntRange chat__request__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 6 }
+  { 0, 10 }
 };
 const ProtobufCMessageDescriptor chat__request__descriptor =
 {
@@ -852,14 +1759,78 @@ const ProtobufCMessageDescriptor chat__request__descriptor =
   "Chat__Request",
   "chat",
   sizeof(Chat__Request),
-  6,
+  10,
   chat__request__field_descriptors,
   chat__request__field_indices_by_name,
   1,  chat__request__number_ranges,
   (ProtobufCMessageInit) chat__request__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor chat__response__field_descriptors[5] =
+static const ProtobufCFieldDescriptor chat__server_notice_response__field_descriptors[3] =
+{
+  {
+    "type",
+    1,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_ENUM,
+    0,   /* quantifier_offset */
+    offsetof(Chat__ServerNoticeResponse, type),
+    &chat__notice_type__descriptor,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "redirect",
+    2,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(Chat__ServerNoticeResponse, redirect),
+    NULL,
+    &protobuf_c_empty_string,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "deadline_seconds",
+    3,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT32,
+    0,   /* quantifier_offset */
+    offsetof(Chat__ServerNoticeResponse, deadline_seconds),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+};
+static const unsigned chat__server_notice_response__field_indices_by_name[] = {
+  2,   /* field[2] = deadline_seconds */
+  1,   /* field[1] = redirect */
+  0,   /* field[0] = type */
+};
+static const ProtobufCIntRange chat__server_notice_response__number_ranges[1 + 1] =
+{
+  { 1, 0 },
+  { 0, 3 }
+};
+const ProtobufCMessageDescriptor chat__server_notice_response__descriptor =
+{
+  PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
+  "chat.ServerNoticeResponse",
+  "ServerNoticeResponse",
+  "Chat__ServerNoticeResponse",
+  "chat",
+  sizeof(Chat__ServerNoticeResponse),
+  3,
+  chat__server_notice_response__field_descriptors,
+  chat__server_notice_response__field_indices_by_name,
+  1,  chat__server_notice_response__number_ranges,
+  (ProtobufCMessageInit) chat__server_notice_response__init,
+  NULL,NULL,NULL    /* reserved[123] */
+};
+static const ProtobufCFieldDescriptor chat__response__field_descriptors[18] =
 {
   {
     "operation",
@@ -921,18 +1892,187 @@ static const ProtobufCFieldDescriptor chat__response__field_descriptors[5] =
     0 | PROTOBUF_C_FIELD_FLAG_ONEOF,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "server_notice",
+    6,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_MESSAGE,
+    offsetof(Chat__Response, result_case),
+    offsetof(Chat__Response, server_notice),
+    &chat__server_notice_response__descriptor,
+    NULL,
+    0 | PROTOBUF_C_FIELD_FLAG_ONEOF,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "retry_after_ms",
+    7,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT32,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Response, retry_after_ms),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "chunk",
+    8,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_MESSAGE,
+    offsetof(Chat__Response, result_case),
+    offsetof(Chat__Response, chunk),
+    &chat__message_chunk__descriptor,
+    NULL,
+    0 | PROTOBUF_C_FIELD_FLAG_ONEOF,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "attachment",
+    9,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_MESSAGE,
+    offsetof(Chat__Response, result_case),
+    offsetof(Chat__Response, attachment),
+    &chat__attachment__descriptor,
+    NULL,
+    0 | PROTOBUF_C_FIELD_FLAG_ONEOF,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "replayed",
+    10,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Response, replayed),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "lost",
+    11,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Response, lost),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "duplicate",
+    12,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_BOOL,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Response, duplicate),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "session_token",
+    13,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_BYTES,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Response, session_token),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "status",
+    14,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_ENUM,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Response, status),
+    &chat__user_status__descriptor,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "resumed",
+    15,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_BOOL,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Response, resumed),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "deliveries",
+    16,
+    PROTOBUF_C_LABEL_REPEATED,
+    PROTOBUF_C_TYPE_MESSAGE,
+    offsetof(Chat__Response, n_deliveries),
+    offsetof(Chat__Response, deliveries),
+    &chat__delivery__descriptor,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "presence",
+    17,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_MESSAGE,
+    offsetof(Chat__Response, result_case),
+    offsetof(Chat__Response, presence),
+    &chat__user__descriptor,
+    NULL,
+    0 | PROTOBUF_C_FIELD_FLAG_ONEOF,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "broadcast_sequence",
+    18,
+    PROTOBUF_C_LABEL_NONE,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(Chat__Response, broadcast_sequence),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned chat__response__field_indices_by_name[] = {
+  8,   /* field[8] = attachment */
+  17,   /* field[17] = broadcast_sequence */
+  7,   /* field[7] = chunk */
+  15,   /* field[15] = deliveries */
+  11,   /* field[11] = duplicate */
   4,   /* field[4] = incoming_message */
+  10,   /* field[10] = lost */
   2,   /* field[2] = message */
   0,   /* field[0] = operation */
+  16,   /* field[16] = presence */
+  9,   /* field[9] = replayed */
+  14,   /* field[14] = resumed */
+  6,   /* field[6] = retry_after_ms */
+  5,   /* field[5] = server_notice */
+  12,   /* field[12] = session_token */
+  13,   /* field[13] = status */
   1,   /* field[1] = status_code */
   3,   /* field[3] = user_list */
 };
 static const ProtobufCIntRange chat__response__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 5 }
+  { 0, 18 }
 };
 const ProtobufCMessageDescriptor chat__response__descriptor =
 {
@@ -942,7 +2082,7 @@ const ProtobufCMessageDescriptor chat__response__descriptor =
   "Chat__Response",
   "chat",
   sizeof(Chat__Response),
-  5,
+  18,
   chat__response__field_descriptors,
   chat__response__field_indices_by_name,
   1,  chat__response__number_ranges,
@@ -1007,17 +2147,53 @@ const ProtobufCEnumDescriptor chat__message_type__descriptor =
   chat__message_type__value_ranges,
   NULL,NULL,NULL,NULL   /* reserved[1234] */
 };
-static const ProtobufCEnumValue chat__user_list_type__enum_values_by_number[2] =
+static const ProtobufCEnumValue chat__delivery_status__enum_values_by_number[4] =
+{
+  { "DELIVERED", "CHAT__DELIVERY_STATUS__DELIVERED", 0 },
+  { "DELIVERED_BUSY", "CHAT__DELIVERY_STATUS__DELIVERED_BUSY", 1 },
+  { "RECIPIENT_OFFLINE", "CHAT__DELIVERY_STATUS__RECIPIENT_OFFLINE", 2 },
+  { "RECIPIENT_NOT_FOUND", "CHAT__DELIVERY_STATUS__RECIPIENT_NOT_FOUND", 3 },
+};
+static const ProtobufCIntRange chat__delivery_status__value_ranges[] = {
+{0, 0},{0, 4}
+};
+static const ProtobufCEnumValueIndex chat__delivery_status__enum_values_by_name[4] =
+{
+  { "DELIVERED", 0 },
+  { "DELIVERED_BUSY", 1 },
+  { "RECIPIENT_NOT_FOUND", 3 },
+  { "RECIPIENT_OFFLINE", 2 },
+};
+const ProtobufCEnumDescriptor chat__delivery_status__descriptor =
+{
+  PROTOBUF_C__ENUM_DESCRIPTOR_MAGIC,
+  "chat.DeliveryStatus",
+  "DeliveryStatus",
+  "Chat__DeliveryStatus",
+  "chat",
+  4,
+  chat__delivery_status__enum_values_by_number,
+  4,
+  chat__delivery_status__enum_values_by_name,
+  1,
+  chat__delivery_status__value_ranges,
+  NULL,NULL,NULL,NULL   /* reserved[1234] */
+};
+static const ProtobufCEnumValue chat__user_list_type__enum_values_by_number[4] =
 {
   { "ALL", "CHAT__USER_LIST_TYPE__ALL", 0 },
   { "SINGLE", "CHAT__USER_LIST_TYPE__SINGLE", 1 },
+  { "BATCH", "CHAT__USER_LIST_TYPE__BATCH", 2 },
+  { "PREFIX", "CHAT__USER_LIST_TYPE__PREFIX", 3 },
 };
 static const ProtobufCIntRange chat__user_list_type__value_ranges[] = {
-{0, 0},{0, 2}
+{0, 0},{0, 4}
 };
-static const ProtobufCEnumValueIndex chat__user_list_type__enum_values_by_name[2] =
+static const ProtobufCEnumValueIndex chat__user_list_type__enum_values_by_name[4] =
 {
   { "ALL", 0 },
+  { "BATCH", 2 },
+  { "PREFIX", 3 },
   { "SINGLE", 1 },
 };
 const ProtobufCEnumDescriptor chat__user_list_type__descriptor =
@@ -1027,15 +2203,47 @@ const ProtobufCEnumDescriptor chat__user_list_type__descriptor =
   "UserListType",
   "Chat__UserListType",
   "chat",
-  2,
+  4,
   chat__user_list_type__enum_values_by_number,
-  2,
+  4,
   chat__user_list_type__enum_values_by_name,
   1,
   chat__user_list_type__value_ranges,
   NULL,NULL,NULL,NULL   /* reserved[1234] */
 };
-static const ProtobufCEnumValue chat__operation__enum_values_by_number[6] =
+static const ProtobufCEnumValue chat__chunk_type__enum_values_by_number[4] =
+{
+  { "BEGIN", "CHAT__CHUNK_TYPE__BEGIN", 0 },
+  { "DATA", "CHAT__CHUNK_TYPE__DATA", 1 },
+  { "END", "CHAT__CHUNK_TYPE__END", 2 },
+  { "ABORT", "CHAT__CHUNK_TYPE__ABORT", 3 },
+};
+static const ProtobufCIntRange chat__chunk_type__value_ranges[] = {
+{0, 0},{0, 4}
+};
+static const ProtobufCEnumValueIndex chat__chunk_type__enum_values_by_name[4] =
+{
+  { "ABORT", 3 },
+  { "BEGIN", 0 },
+  { "DATA", 1 },
+  { "END", 2 },
+};
+const ProtobufCEnumDescriptor chat__chunk_type__descriptor =
+{
+  PROTOBUF_C__ENUM_DESCRIPTOR_MAGIC,
+  "chat.ChunkType",
+  "ChunkType",
+  "Chat__ChunkType",
+  "chat",
+  4,
+  chat__chunk_type__enum_values_by_number,
+  4,
+  chat__chunk_type__enum_values_by_name,
+  1,
+  chat__chunk_type__value_ranges,
+  NULL,NULL,NULL,NULL   /* reserved[1234] */
+};
+static const ProtobufCEnumValue chat__operation__enum_values_by_number[16] =
 {
   { "REGISTER_USER", "CHAT__OPERATION__REGISTER_USER", 0 },
   { "SEND_MESSAGE", "CHAT__OPERATION__SEND_MESSAGE", 1 },
@@ -1043,16 +2251,36 @@ static const ProtobufCEnumValue chat__operation__enum_values_by_number[6] =
   { "GET_USERS", "CHAT__OPERATION__GET_USERS", 3 },
   { "UNREGISTER_USER", "CHAT__OPERATION__UNREGISTER_USER", 4 },
   { "INCOMING_MESSAGE", "CHAT__OPERATION__INCOMING_MESSAGE", 5 },
+  { "SERVER_NOTICE", "CHAT__OPERATION__SERVER_NOTICE", 6 },
+  { "SEND_CHUNK", "CHAT__OPERATION__SEND_CHUNK", 7 },
+  { "INCOMING_CHUNK", "CHAT__OPERATION__INCOMING_CHUNK", 8 },
+  { "DOWNLOAD_ATTACHMENT", "CHAT__OPERATION__DOWNLOAD_ATTACHMENT", 9 },
+  { "INCOMING_ATTACHMENT", "CHAT__OPERATION__INCOMING_ATTACHMENT", 10 },
+  { "ACK", "CHAT__OPERATION__ACK", 11 },
+  { "PING", "CHAT__OPERATION__PING", 12 },
+  { "PONG", "CHAT__OPERATION__PONG", 13 },
+  { "SUBSCRIBE_PRESENCE", "CHAT__OPERATION__SUBSCRIBE_PRESENCE", 14 },
+  { "PRESENCE_EVENT", "CHAT__OPERATION__PRESENCE_EVENT", 15 },
 };
 static const ProtobufCIntRange chat__operation__value_ranges[] = {
-{0, 0},{0, 6}
+{0, 0},{0, 16}
 };
-static const ProtobufCEnumValueIndex chat__operation__enum_values_by_name[6] =
+static const ProtobufCEnumValueIndex chat__operation__enum_values_by_name[16] =
 {
+  { "ACK", 11 },
+  { "DOWNLOAD_ATTACHMENT", 9 },
   { "GET_USERS", 3 },
+  { "INCOMING_ATTACHMENT", 10 },
+  { "INCOMING_CHUNK", 8 },
   { "INCOMING_MESSAGE", 5 },
+  { "PING", 12 },
+  { "PONG", 13 },
+  { "PRESENCE_EVENT", 15 },
   { "REGISTER_USER", 0 },
+  { "SEND_CHUNK", 7 },
   { "SEND_MESSAGE", 1 },
+  { "SERVER_NOTICE", 6 },
+  { "SUBSCRIBE_PRESENCE", 14 },
   { "UNREGISTER_USER", 4 },
   { "UPDATE_STATUS", 2 },
 };
@@ -1063,29 +2291,33 @@ const ProtobufCEnumDescriptor chat__operation__descriptor =
   "Operation",
   "Chat__Operation",
   "chat",
-  6,
+  16,
   chat__operation__enum_values_by_number,
-  6,
+  16,
   chat__operation__enum_values_by_name,
   1,
   chat__operation__value_ranges,
   NULL,NULL,NULL,NULL   /* reserved[1234] */
 };
-static const ProtobufCEnumValue chat__status_code__enum_values_by_number[4] =
+static const ProtobufCEnumValue chat__status_code__enum_values_by_number[6] =
 {
   { "UNKNOWN_STATUS", "CHAT__STATUS_CODE__UNKNOWN_STATUS", 0 },
   { "OK", "CHAT__STATUS_CODE__OK", 200 },
   { "BAD_REQUEST", "CHAT__STATUS_CODE__BAD_REQUEST", 400 },
+  { "TOO_MANY_REQUESTS", "CHAT__STATUS_CODE__TOO_MANY_REQUESTS", 429 },
   { "INTERNAL_SERVER_ERROR", "CHAT__STATUS_CODE__INTERNAL_SERVER_ERROR", 500 },
+  { "SERVICE_UNAVAILABLE", "CHAT__STATUS_CODE__SERVICE_UNAVAILABLE", 503 },
 };
 static const ProtobufCIntRange chat__status_code__value_ranges[] = {
-{0, 0},{200, 1},{400, 2},{500, 3},{0, 4}
+{0, 0},{200, 1},{400, 2},{429, 3},{500, 4},{503, 5},{0, 6}
 };
-static const ProtobufCEnumValueIndex chat__status_code__enum_values_by_name[4] =
+static const ProtobufCEnumValueIndex chat__status_code__enum_values_by_name[6] =
 {
   { "BAD_REQUEST", 2 },
-  { "INTERNAL_SERVER_ERROR", 3 },
+  { "INTERNAL_SERVER_ERROR", 4 },
   { "OK", 1 },
+  { "SERVICE_UNAVAILABLE", 5 },
+  { "TOO_MANY_REQUESTS", 3 },
   { "UNKNOWN_STATUS", 0 },
 };
 const ProtobufCEnumDescriptor chat__status_code__descriptor =
@@ -1095,11 +2327,37 @@ const ProtobufCEnumDescriptor chat__status_code__descriptor =
   "StatusCode",
   "Chat__StatusCode",
   "chat",
-  4,
+  6,
   chat__status_code__enum_values_by_number,
-  4,
+  6,
   chat__status_code__enum_values_by_name,
-  4,
+  6,
   chat__status_code__value_ranges,
   NULL,NULL,NULL,NULL   /* reserved[1234] */
 };
+static const ProtobufCEnumValue chat__notice_type__enum_values_by_number[1] =
+{
+  { "DRAINING", "CHAT__NOTICE_TYPE__DRAINING", 0 },
+};
+static const ProtobufCIntRange chat__notice_type__value_ranges[] = {
+{0, 0},{0, 1}
+};
+static const ProtobufCEnumValueIndex chat__notice_type__enum_values_by_name[1] =
+{
+  { "DRAINING", 0 },
+};
+const ProtobufCEnumDescriptor chat__notice_type__descriptor =
+{
+  PROTOBUF_C__ENUM_DESCRIPTOR_MAGIC,
+  "chat.NoticeType",
+  "NoticeType",
+  "Chat__NoticeType",
+  "chat",
+  1,
+  chat__notice_type__enum_values_by_number,
+  1,
+  chat__notice_type__enum_values_by_name,
+  1,
+  chat__notice_type__value_ranges,
+  NULL,NULL,NULL,NULL   /* reserved[1234] */
+};
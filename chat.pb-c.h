@@ -17,12 +17,19 @@ PROTOBUF_C__BEGIN_DECLS
 
 typedef struct _Chat__User Chat__User;
 typedef struct _Chat__NewUserRequest Chat__NewUserRequest;
+typedef struct _Chat__Ack Chat__Ack;
 typedef struct _Chat__SendMessageRequest Chat__SendMessageRequest;
+typedef struct _Chat__Delivery Chat__Delivery;
 typedef struct _Chat__IncomingMessageResponse Chat__IncomingMessageResponse;
 typedef struct _Chat__UserListRequest Chat__UserListRequest;
 typedef struct _Chat__UserListResponse Chat__UserListResponse;
+typedef struct _Chat__PresenceRequest Chat__PresenceRequest;
 typedef struct _Chat__UpdateStatusRequest Chat__UpdateStatusRequest;
+typedef struct _Chat__Attachment Chat__Attachment;
+typedef struct _Chat__DownloadRequest Chat__DownloadRequest;
+typedef struct _Chat__MessageChunk Chat__MessageChunk;
 typedef struct _Chat__Request Chat__Request;
+typedef struct _Chat__ServerNoticeResponse Chat__ServerNoticeResponse;
 typedef struct _Chat__Response Chat__Response;
 
 
@@ -58,6 +65,25 @@ typedef enum _Chat__MessageType {
   CHAT__MESSAGE_TYPE__DIRECT = 1
     PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(CHAT__MESSAGE_TYPE)
 } Chat__MessageType;
+typedef enum _Chat__DeliveryStatus {
+  /*
+   * The recipient got the message.
+   */
+  CHAT__DELIVERY_STATUS__DELIVERED = 0,
+  /*
+   * The recipient got the message but is busy, it will probably not read it soon.
+   */
+  CHAT__DELIVERY_STATUS__DELIVERED_BUSY = 1,
+  /*
+   * The recipient is offline, the message was not delivered.
+   */
+  CHAT__DELIVERY_STATUS__RECIPIENT_OFFLINE = 2,
+  /*
+   * No user has this name.
+   */
+  CHAT__DELIVERY_STATUS__RECIPIENT_NOT_FOUND = 3
+    PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(CHAT__DELIVERY_STATUS)
+} Chat__DeliveryStatus;
 typedef enum _Chat__UserListType {
   /*
    * Fetch all connected users.
@@ -66,16 +92,65 @@ typedef enum _Chat__UserListType {
   /*
    * Fetch details for a single user.
    */
-  CHAT__USER_LIST_TYPE__SINGLE = 1
+  CHAT__USER_LIST_TYPE__SINGLE = 1,
+  /*
+   * Fetch the users of a list of names.
+   */
+  CHAT__USER_LIST_TYPE__BATCH = 2,
+  /*
+   * Fetch the users whose name starts with a prefix.
+   */
+  CHAT__USER_LIST_TYPE__PREFIX = 3
     PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(CHAT__USER_LIST_TYPE)
 } Chat__UserListType;
+typedef enum _Chat__ChunkType {
+  /*
+   * Opens a stream, names the recipient.
+   */
+  CHAT__CHUNK_TYPE__BEGIN = 0,
+  /*
+   * Carries the next part of the content.
+   */
+  CHAT__CHUNK_TYPE__DATA = 1,
+  /*
+   * The whole content was sent.
+   */
+  CHAT__CHUNK_TYPE__END = 2,
+  /*
+   * The stream stopped before its end, the content received so far should be dropped.
+   */
+  CHAT__CHUNK_TYPE__ABORT = 3
+    PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(CHAT__CHUNK_TYPE)
+} Chat__ChunkType;
 typedef enum _Chat__Operation {
   CHAT__OPERATION__REGISTER_USER = 0,
   CHAT__OPERATION__SEND_MESSAGE = 1,
   CHAT__OPERATION__UPDATE_STATUS = 2,
   CHAT__OPERATION__GET_USERS = 3,
   CHAT__OPERATION__UNREGISTER_USER = 4,
-  CHAT__OPERATION__INCOMING_MESSAGE = 5
+  CHAT__OPERATION__INCOMING_MESSAGE = 5,
+  CHAT__OPERATION__SERVER_NOTICE = 6,
+  CHAT__OPERATION__SEND_CHUNK = 7,
+  CHAT__OPERATION__INCOMING_CHUNK = 8,
+  CHAT__OPERATION__DOWNLOAD_ATTACHMENT = 9,
+  CHAT__OPERATION__INCOMING_ATTACHMENT = 10,
+  CHAT__OPERATION__ACK = 11,
+  /*
+   * Sent by the server to a quiet client, which answers with PONG.
+   */
+  CHAT__OPERATION__PING = 12,
+  /*
+   * Answer to PING, no payload.
+   */
+  CHAT__OPERATION__PONG = 13,
+  /*
+   * Follow or stop following the status of users.
+   */
+  CHAT__OPERATION__SUBSCRIBE_PRESENCE = 14,
+  /*
+   * Sent by the server to the followers of a user whose status changed.
+   */
+  CHAT__OPERATION__PRESENCE_EVENT = 15
     PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(CHAT__OPERATION)
 } Chat__Operation;
 typedef enum _Chat__StatusCode {
@@ -91,12 +166,27 @@ typedef enum _Chat__StatusCode {
    * Request cannot be fulfilled due to bad syntax (este podría ser el utilizado general)
    */
   CHAT__STATUS_CODE__BAD_REQUEST = 400,
+  /*
+   * The client is over its rate limit for this operation, try again after retry_after_ms
+   */
+  CHAT__STATUS_CODE__TOO_MANY_REQUESTS = 429,
   /*
    * A generic error message, given when no more specific message is suitable
    */
-  CHAT__STATUS_CODE__INTERNAL_SERVER_ERROR = 500
+  CHAT__STATUS_CODE__INTERNAL_SERVER_ERROR = 500,
+  /*
+   * The server is out of capacity (like its memory budget), try again later
+   */
+  CHAT__STATUS_CODE__SERVICE_UNAVAILABLE = 503
     PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(CHAT__STATUS_CODE)
 } Chat__StatusCode;
+typedef enum _Chat__NoticeType {
+  /*
+   * The server is shutting down, reconnect before the deadline.
+   */
+  CHAT__NOTICE_TYPE__DRAINING = 0
+    PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(CHAT__NOTICE_TYPE)
+} Chat__NoticeType;
 
 /* --- messages --- */
 
@@ -130,10 +220,36 @@ struct  _Chat__NewUserRequest
    * Desired username for the new user. Must be unique across all users.
    */
   char *username;
+  /*
+   * The user lost its connection, the frames the server kept for it are sent again after the answer.
+   */
+  protobuf_c_boolean resume;
+  /*
+   * Resume only. Frames the client received on the connection it lost.
+   */
+  uint64_t received;
+  /*
+   * The token the last registration gave, it proves the session parked under the name is ours.
+   */
+  ProtobufCBinaryData session_token;
 };
 #define CHAT__NEW_USER_REQUEST__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&chat__new_user_request__descriptor) \
-    , (char *)protobuf_c_empty_string }
+    , (char *)protobuf_c_empty_string, 0, 0, {0,NULL} }
+
+
+/*
+ * Ack tells the server how many frames the client received on this connection, counting every frame from the first one.
+ * It is cumulative and coalesced, the server keeps the frames after it to send them again if the connection is lost.
+ */
+struct  _Chat__Ack
+{
+  ProtobufCMessage base;
+  uint64_t received;
+};
+#define CHAT__ACK__INIT \
+ { PROTOBUF_C_MESSAGE_INIT (&chat__ack__descriptor) \
+    , 0 }
 
 
 /*
@@ -150,10 +266,33 @@ struct  _Chat__SendMessageRequest
    * Content of the message being sent.
    */
   char *content;
+  /*
+   * Chosen by the client, unique among its messages (0 for none). A message sent again with the same id is answered like the first one and not delivered twice.
+   */
+  uint64_t message_id;
+  /*
+   * More recipients of a direct message, with recipient if it is set. The answer tells what happened for each of them.
+   */
+  size_t n_recipients;
+  char **recipients;
 };
 #define CHAT__SEND_MESSAGE_REQUEST__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&chat__send_message_request__descriptor) \
-    , (char *)protobuf_c_empty_string, (char *)protobuf_c_empty_string }
+    , (char *)protobuf_c_empty_string, (char *)protobuf_c_empty_string, 0, 0,NULL }
+
+
+/*
+ * Delivery tells what happened to a direct message sent to several recipients, for one of them.
+ */
+struct  _Chat__Delivery
+{
+  ProtobufCMessage base;
+  char *username;
+  Chat__DeliveryStatus status;
+};
+#define CHAT__DELIVERY__INIT \
+ { PROTOBUF_C_MESSAGE_INIT (&chat__delivery__descriptor) \
+    , (char *)protobuf_c_empty_string, CHAT__DELIVERY_STATUS__DELIVERED }
 
 
 struct  _Chat__IncomingMessageResponse
@@ -171,10 +310,16 @@ struct  _Chat__IncomingMessageResponse
    * Type of message
    */
   Chat__MessageType type;
+  /*
+   * Number of the message in its channel, one more than the one before: the broadcasts share one
+   * channel and the direct messages of every recipient are another. Clients put the messages in this
+   * order and notice the ones missing. The answer to a broadcast carries it too, without the content
+   */
+  uint64_t sequence;
 };
 #define CHAT__INCOMING_MESSAGE_RESPONSE__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&chat__incoming_message_response__descriptor) \
-    , (char *)protobuf_c_empty_string, (char *)protobuf_c_empty_string, CHAT__MESSAGE_TYPE__BROADCAST }
+    , (char *)protobuf_c_empty_string, (char *)protobuf_c_empty_string, CHAT__MESSAGE_TYPE__BROADCAST, 0 }
 
 
 /*
@@ -187,10 +332,23 @@ struct  _Chat__UserListRequest
    * Specific username to fetch details for. If empty, fetches all connected users.
    */
   char *username;
+  /*
+   * Names to fetch in one request, the users found come in the same order.
+   */
+  size_t n_usernames;
+  char **usernames;
+  /*
+   * Fetch the users whose name starts with it, in the order of their names.
+   */
+  char *prefix;
+  /*
+   * Most users a prefix query returns, 0 for the limit of the server.
+   */
+  uint32_t limit;
 };
 #define CHAT__USER_LIST_REQUEST__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&chat__user_list_request__descriptor) \
-    , (char *)protobuf_c_empty_string }
+    , (char *)protobuf_c_empty_string, 0,NULL, (char *)protobuf_c_empty_string, 0 }
 
 
 /*
@@ -205,10 +363,35 @@ struct  _Chat__UserListResponse
   size_t n_users;
   Chat__User **users;
   Chat__UserListType type;
+  /*
+   * ALL only. The users come in pages of lookup_limit, every page but the last has it set.
+   */
+  protobuf_c_boolean more;
 };
 #define CHAT__USER_LIST_RESPONSE__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&chat__user_list_response__descriptor) \
-    , 0,NULL, CHAT__USER_LIST_TYPE__ALL }
+    , 0,NULL, CHAT__USER_LIST_TYPE__ALL, 0 }
+
+
+/*
+ * PresenceRequest follows the status of users, the answer lists the ones connected with their status.
+ */
+struct  _Chat__PresenceRequest
+{
+  ProtobufCMessage base;
+  /*
+   * Users to follow, they do not have to be connected yet.
+   */
+  size_t n_usernames;
+  char **usernames;
+  /*
+   * Stop following them instead.
+   */
+  protobuf_c_boolean unsubscribe;
+};
+#define CHAT__PRESENCE_REQUEST__INIT \
+ { PROTOBUF_C_MESSAGE_INIT (&chat__presence_request__descriptor) \
+    , 0,NULL, 0 }
 
 
 /*
@@ -231,13 +414,114 @@ struct  _Chat__UpdateStatusRequest
     , (char *)protobuf_c_empty_string, CHAT__USER_STATUS__ONLINE }
 
 
+/*
+ * Attachment describes a file uploaded to the server, its content is downloaded on its own.
+ */
+struct  _Chat__Attachment
+{
+  ProtobufCMessage base;
+  /*
+   * Given by the server, used to download it.
+   */
+  uint64_t id;
+  /*
+   * File name given by the sender.
+   */
+  char *name;
+  /*
+   * Bytes of content.
+   */
+  uint64_t size;
+  /*
+   * Username of the user who uploaded it.
+   */
+  char *sender;
+  /*
+   * Shared with everyone or with one user.
+   */
+  Chat__MessageType type;
+};
+#define CHAT__ATTACHMENT__INIT \
+ { PROTOBUF_C_MESSAGE_INIT (&chat__attachment__descriptor) \
+    , 0, (char *)protobuf_c_empty_string, 0, (char *)protobuf_c_empty_string, CHAT__MESSAGE_TYPE__BROADCAST }
+
+
+/*
+ * DownloadRequest asks for the content of an attachment, it comes back as chunks (BEGIN, DATA..., END) with message_id.
+ */
+struct  _Chat__DownloadRequest
+{
+  ProtobufCMessage base;
+  /*
+   * Id of the attachment.
+   */
+  uint64_t attachment_id;
+  /*
+   * Chosen by the client to tell its downloads apart.
+   */
+  uint32_t message_id;
+};
+#define CHAT__DOWNLOAD_REQUEST__INIT \
+ { PROTOBUF_C_MESSAGE_INIT (&chat__download_request__descriptor) \
+    , 0, 0 }
+
+
+/*
+ * MessageChunk is part of a message longer than message_length, sent as a stream of chunks between BEGIN and END.
+ * The server relays every chunk as it arrives and never holds the whole message.
+ */
+struct  _Chat__MessageChunk
+{
+  ProtobufCMessage base;
+  /*
+   * Chosen by the sender, unique among its open streams.
+   */
+  uint32_t message_id;
+  /*
+   * What the chunk does to the stream.
+   */
+  Chat__ChunkType type;
+  /*
+   * BEGIN only. If empty, the message is broadcast to all online users.
+   */
+  char *recipient;
+  /*
+   * DATA only, the next bytes of the content.
+   */
+  ProtobufCBinaryData data;
+  /*
+   * Set by the server on the chunks it relays.
+   */
+  char *sender;
+  /*
+   * Set by the server on the chunks it relays.
+   */
+  Chat__MessageType message_type;
+  /*
+   * BEGIN only. If set, the content is uploaded as an attachment instead of relayed.
+   */
+  char *filename;
+  /*
+   * Set by the server on the END answer of an upload and the BEGIN of a download.
+   */
+  Chat__Attachment *attachment;
+};
+#define CHAT__MESSAGE_CHUNK__INIT \
+ { PROTOBUF_C_MESSAGE_INIT (&chat__message_chunk__descriptor) \
+    , 0, CHAT__CHUNK_TYPE__BEGIN, (char *)protobuf_c_empty_string, {0,NULL}, (char *)protobuf_c_empty_string, CHAT__MESSAGE_TYPE__BROADCAST, (char *)protobuf_c_empty_string, NULL }
+
+
 typedef enum {
   CHAT__REQUEST__PAYLOAD__NOT_SET = 0,
   CHAT__REQUEST__PAYLOAD_REGISTER_USER = 2,
   CHAT__REQUEST__PAYLOAD_SEND_MESSAGE = 3,
   CHAT__REQUEST__PAYLOAD_UPDATE_STATUS = 4,
   CHAT__REQUEST__PAYLOAD_GET_USERS = 5,
-  CHAT__REQUEST__PAYLOAD_UNREGISTER_USER = 6
+  CHAT__REQUEST__PAYLOAD_UNREGISTER_USER = 6,
+  CHAT__REQUEST__PAYLOAD_SEND_CHUNK = 7,
+  CHAT__REQUEST__PAYLOAD_DOWNLOAD_ATTACHMENT = 8,
+  CHAT__REQUEST__PAYLOAD_ACK = 9,
+  CHAT__REQUEST__PAYLOAD_SUBSCRIBE_PRESENCE = 10
     PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(CHAT__REQUEST__PAYLOAD)
 } Chat__Request__PayloadCase;
 
@@ -258,6 +542,10 @@ struct  _Chat__Request
     Chat__UpdateStatusRequest *update_status;
     Chat__UserListRequest *get_users;
     Chat__User *unregister_user;
+    Chat__MessageChunk *send_chunk;
+    Chat__DownloadRequest *download_attachment;
+    Chat__Ack *ack;
+    Chat__PresenceRequest *subscribe_presence;
   };
 };
 #define CHAT__REQUEST__INIT \
@@ -265,10 +553,38 @@ struct  _Chat__Request
     , CHAT__OPERATION__REGISTER_USER, CHAT__REQUEST__PAYLOAD__NOT_SET, {0} }
 
 
+/*
+ * ServerNoticeResponse is sent by the server on its own, not as the answer to a request.
+ */
+struct  _Chat__ServerNoticeResponse
+{
+  ProtobufCMessage base;
+  /*
+   * What the server is announcing.
+   */
+  Chat__NoticeType type;
+  /*
+   * Address to reconnect to. If empty, any server behind the load balancer.
+   */
+  char *redirect;
+  /*
+   * Seconds left before the server closes the connection.
+   */
+  uint32_t deadline_seconds;
+};
+#define CHAT__SERVER_NOTICE_RESPONSE__INIT \
+ { PROTOBUF_C_MESSAGE_INIT (&chat__server_notice_response__descriptor) \
+    , CHAT__NOTICE_TYPE__DRAINING, (char *)protobuf_c_empty_string, 0 }
+
+
 typedef enum {
   CHAT__RESPONSE__RESULT__NOT_SET = 0,
   CHAT__RESPONSE__RESULT_USER_LIST = 4,
-  CHAT__RESPONSE__RESULT_INCOMING_MESSAGE = 5
+  CHAT__RESPONSE__RESULT_INCOMING_MESSAGE = 5,
+  CHAT__RESPONSE__RESULT_SERVER_NOTICE = 6,
+  CHAT__RESPONSE__RESULT_CHUNK = 8,
+  CHAT__RESPONSE__RESULT_ATTACHMENT = 9,
+  CHAT__RESPONSE__RESULT_PRESENCE = 17
     PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(CHAT__RESPONSE__RESULT)
 } Chat__Response__ResultCase;
 
@@ -290,6 +606,43 @@ struct  _Chat__Response
    * Human-readable (We XD) message providing more details about the result.
    */
   char *message;
+  /*
+   * Set when the request was refused for lack of capacity, wait this long before trying again.
+   */
+  uint32_t retry_after_ms;
+  /*
+   * Answer to a resume, frames sent again after it.
+   */
+  uint64_t replayed;
+  /*
+   * Answer to a resume, frames the client did not receive that were no longer kept.
+   */
+  uint64_t lost;
+  /*
+   * Answer to a registration, kept by the client to resume its session if the connection is lost.
+   */
+  ProtobufCBinaryData session_token;
+  /*
+   * Answer to a resume, the status the session had.
+   */
+  Chat__UserStatus status;
+  /*
+   * Answer to a message with recipients, one per distinct recipient in the order they were given.
+   */
+  size_t n_deliveries;
+  Chat__Delivery **deliveries;
+  /*
+   * Answer to a registration that took its parked session back, replayed, lost and status are set.
+   */
+  protobuf_c_boolean resumed;
+  /*
+   * Answer to a message whose id was already sent, it was not delivered again. Carries the number the first one got.
+   */
+  protobuf_c_boolean duplicate;
+  /*
+   * Answer to a change that makes the user get the broadcasts again (a status change from OFFLINE, a resume): the number of the last broadcast sent before, the ones up to it were not for the user.
+   */
+  uint64_t broadcast_sequence;
   Chat__Response__ResultCase result_case;
   union {
     /*
@@ -300,11 +653,27 @@ struct  _Chat__Response
      * Details specific to incoming chat messages.
      */
     Chat__IncomingMessageResponse *incoming_message;
+    /*
+     * Details specific to server notices.
+     */
+    Chat__ServerNoticeResponse *server_notice;
+    /*
+     * A relayed or downloaded chunk, or the stream an answer to SEND_CHUNK is about.
+     */
+    Chat__MessageChunk *chunk;
+    /*
+     * An attachment shared with the user.
+     */
+    Chat__Attachment *attachment;
+    /*
+     * A followed user and its new status, OFFLINE when it left.
+     */
+    Chat__User *presence;
   };
 };
 #define CHAT__RESPONSE__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&chat__response__descriptor) \
-    , CHAT__OPERATION__REGISTER_USER, CHAT__STATUS_CODE__UNKNOWN_STATUS, (char *)protobuf_c_empty_string, CHAT__RESPONSE__RESULT__NOT_SET, {0} }
+    , CHAT__OPERATION__REGISTER_USER, CHAT__STATUS_CODE__UNKNOWN_STATUS, (char *)protobuf_c_empty_string, 0, 0, 0, {0,NULL}, CHAT__USER_STATUS__ONLINE, 0,NULL, 0, 0, 0, CHAT__RESPONSE__RESULT__NOT_SET, {0} }
 
 
 /* Chat__User methods */
@@ -345,6 +714,25 @@ Chat__NewUserRequest *
 void   chat__new_user_request__free_unpacked
                      (Chat__NewUserRequest *message,
                       ProtobufCAllocator *allocator);
+/* Chat__Ack methods */
+void   chat__ack__init
+                     (Chat__Ack         *message);
+size_t chat__ack__get_packed_size
+                     (const Chat__Ack   *message);
+size_t chat__ack__pack
+                     (const Chat__Ack   *message,
+                      uint8_t             *out);
+size_t chat__ack__pack_to_buffer
+                     (const Chat__Ack   *message,
+                      ProtobufCBuffer     *buffer);
+Chat__Ack *
+       chat__ack__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data);
+void   chat__ack__free_unpacked
+                     (Chat__Ack *message,
+                      ProtobufCAllocator *allocator);
 /* Chat__SendMessageRequest methods */
 void   chat__send_message_request__init
                      (Chat__SendMessageRequest         *message);
@@ -364,6 +752,25 @@ Chat__SendMessageRequest *
 void   chat__send_message_request__free_unpacked
                      (Chat__SendMessageRequest *message,
                       ProtobufCAllocator *allocator);
+/* Chat__Delivery methods */
+void   chat__delivery__init
+                     (Chat__Delivery         *message);
+size_t chat__delivery__get_packed_size
+                     (const Chat__Delivery   *message);
+size_t chat__delivery__pack
+                     (const Chat__Delivery   *message,
+                      uint8_t             *out);
+size_t chat__delivery__pack_to_buffer
+                     (const Chat__Delivery   *message,
+                      ProtobufCBuffer     *buffer);
+Chat__Delivery *
+       chat__delivery__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data);
+void   chat__delivery__free_unpacked
+                     (Chat__Delivery *message,
+                      ProtobufCAllocator *allocator);
 /* Chat__IncomingMessageResponse methods */
 void   chat__incoming_message_response__init
                      (Chat__IncomingMessageResponse         *message);
@@ -421,6 +828,25 @@ Chat__UserListResponse *
 void   chat__user_list_response__free_unpacked
                      (Chat__UserListResponse *message,
                       ProtobufCAllocator *allocator);
+/* Chat__PresenceRequest methods */
+void   chat__presence_request__init
+                     (Chat__PresenceRequest         *message);
+size_t chat__presence_request__get_packed_size
+                     (const Chat__PresenceRequest   *message);
+size_t chat__presence_request__pack
+                     (const Chat__PresenceRequest   *message,
+                      uint8_t             *out);
+size_t chat__presence_request__pack_to_buffer
+                     (const Chat__PresenceRequest   *message,
+                      ProtobufCBuffer     *buffer);
+Chat__PresenceRequest *
+       chat__presence_request__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data);
+void   chat__presence_request__free_unpacked
+                     (Chat__PresenceRequest *message,
+                      ProtobufCAllocator *allocator);
 /* Chat__UpdateStatusRequest methods */
 void   chat__update_status_request__init
                      (Chat__UpdateStatusRequest         *message);
@@ -440,6 +866,63 @@ Chat__UpdateStatusRequest *
 void   chat__update_status_request__free_unpacked
                      (Chat__UpdateStatusRequest *message,
                       ProtobufCAllocator *allocator);
+/* Chat__Attachment methods */
+void   chat__attachment__init
+                     (Chat__Attachment         *message);
+size_t chat__attachment__get_packed_size
+                     (const Chat__Attachment   *message);
+size_t chat__attachment__pack
+                     (const Chat__Attachment   *message,
+                      uint8_t             *out);
+size_t chat__attachment__pack_to_buffer
+                     (const Chat__Attachment   *message,
+                      ProtobufCBuffer     *buffer);
+Chat__Attachment *
+       chat__attachment__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data);
+void   chat__attachment__free_unpacked
+                     (Chat__Attachment *message,
+                      ProtobufCAllocator *allocator);
+/* Chat__DownloadRequest methods */
+void   chat__download_request__init
+                     (Chat__DownloadRequest         *message);
+size_t chat__download_request__get_packed_size
+                     (const Chat__DownloadRequest   *message);
+size_t chat__download_request__pack
+                     (const Chat__DownloadRequest   *message,
+                      uint8_t             *out);
+size_t chat__download_request__pack_to_buffer
+                     (const Chat__DownloadRequest   *message,
+                      ProtobufCBuffer     *buffer);
+Chat__DownloadRequest *
+       chat__download_request__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data);
+void   chat__download_request__free_unpacked
+                     (Chat__DownloadRequest *message,
+                      ProtobufCAllocator *allocator);
+/* Chat__MessageChunk methods */
+void   chat__message_chunk__init
+                     (Chat__MessageChunk         *message);
+size_t chat__message_chunk__get_packed_size
+                     (const Chat__MessageChunk   *message);
+size_t chat__message_chunk__pack
+                     (const Chat__MessageChunk   *message,
+                      uint8_t             *out);
+size_t chat__message_chunk__pack_to_buffer
+                     (const Chat__MessageChunk   *message,
+                      ProtobufCBuffer     *buffer);
+Chat__MessageChunk *
+       chat__message_chunk__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data);
+void   chat__message_chunk__free_unpacked
+                     (Chat__MessageChunk *message,
+                      ProtobufCAllocator *allocator);
 /* Chat__Request methods */
 void   chat__request__init
                      (Chat__Request         *message);
@@ -459,6 +942,25 @@ Chat__Request *
 void   chat__request__free_unpacked
                      (Chat__Request *message,
                       ProtobufCAllocator *allocator);
+/* Chat__ServerNoticeResponse methods */
+void   chat__server_notice_response__init
+                     (Chat__ServerNoticeResponse         *message);
+size_t chat__server_notice_response__get_packed_size
+                     (const Chat__ServerNoticeResponse   *message);
+size_t chat__server_notice_response__pack
+                     (const Chat__ServerNoticeResponse   *message,
+                      uint8_t             *out);
+size_t chat__server_notice_response__pack_to_buffer
+                     (const Chat__ServerNoticeResponse   *message,
+                      ProtobufCBuffer     *buffer);
+Chat__ServerNoticeResponse *
+       chat__server_notice_response__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data);
+void   chat__server_notice_response__free_unpacked
+                     (Chat__ServerNoticeResponse *message,
+                      ProtobufCAllocator *allocator);
 /* Chat__Response methods */
 void   chat__response__init
                      (Chat__Response         *message);
@@ -486,9 +988,15 @@ typedef void (*Chat__User_Closure)
 typedef void (*Chat__NewUserRequest_Closure)
                  (const Chat__NewUserRequest *message,
                   void *closure_data);
+typedef void (*Chat__Ack_Closure)
+                 (const Chat__Ack *message,
+                  void *closure_data);
 typedef void (*Chat__SendMessageRequest_Closure)
                  (const Chat__SendMessageRequest *message,
                   void *closure_data);
+typedef void (*Chat__Delivery_Closure)
+                 (const Chat__Delivery *message,
+                  void *closure_data);
 typedef void (*Chat__IncomingMessageResponse_Closure)
                  (const Chat__IncomingMessageResponse *message,
                   void *closure_data);
@@ -498,12 +1006,27 @@ typedef void (*Chat__UserListRequest_Closure)
 typedef void (*Chat__UserListResponse_Closure)
                  (const Chat__UserListResponse *message,
                   void *closure_data);
+typedef void (*Chat__PresenceRequest_Closure)
+                 (const Chat__PresenceRequest *message,
+                  void *closure_data);
 typedef void (*Chat__UpdateStatusRequest_Closure)
                  (const Chat__UpdateStatusRequest *message,
                   void *closure_data);
+typedef void (*Chat__Attachment_Closure)
+                 (const Chat__Attachment *message,
+                  void *closure_data);
+typedef void (*Chat__DownloadRequest_Closure)
+                 (const Chat__DownloadRequest *message,
+                  void *closure_data);
+typedef void (*Chat__MessageChunk_Closure)
+                 (const Chat__MessageChunk *message,
+                  void *closure_data);
 typedef void (*Chat__Request_Closure)
                  (const Chat__Request *message,
                   void *closure_data);
+typedef void (*Chat__ServerNoticeResponse_Closure)
+                 (const Chat__ServerNoticeResponse *message,
+                  void *closure_data);
 typedef void (*Chat__Response_Closure)
                  (const Chat__Response *message,
                   void *closure_data);
@@ -515,17 +1038,27 @@ typedef void (*Chat__Response_Closure)
 
 extern const ProtobufCEnumDescriptor    chat__user_status__descriptor;
 extern const ProtobufCEnumDescriptor    chat__message_type__descriptor;
+extern const ProtobufCEnumDescriptor    chat__delivery_status__descriptor;
 extern const ProtobufCEnumDescriptor    chat__user_list_type__descriptor;
+extern const ProtobufCEnumDescriptor    chat__chunk_type__descriptor;
 extern const ProtobufCEnumDescriptor    chat__operation__descriptor;
 extern const ProtobufCEnumDescriptor    chat__status_code__descriptor;
+extern const ProtobufCEnumDescriptor    chat__notice_type__descriptor;
 extern const ProtobufCMessageDescriptor chat__user__descriptor;
 extern const ProtobufCMessageDescriptor chat__new_user_request__descriptor;
+extern const ProtobufCMessageDescriptor chat__ack__descriptor;
 extern const ProtobufCMessageDescriptor chat__send_message_request__descriptor;
+extern const ProtobufCMessageDescriptor chat__delivery__descriptor;
 extern const ProtobufCMessageDescriptor chat__incoming_message_response__descriptor;
 extern const ProtobufCMessageDescriptor chat__user_list_request__descriptor;
 extern const ProtobufCMessageDescriptor chat__user_list_response__descriptor;
+extern const ProtobufCMessageDescriptor chat__presence_request__descriptor;
 extern const ProtobufCMessageDescriptor chat__update_status_request__descriptor;
+extern const ProtobufCMessageDescriptor chat__attachment__descriptor;
+extern const ProtobufCMessageDescriptor chat__download_request__descriptor;
+extern const ProtobufCMessageDescriptor chat__message_chunk__descriptor;
 extern const ProtobufCMessageDescriptor chat__request__descriptor;
+extern const ProtobufCMessageDescriptor chat__server_notice_response__descriptor;
 extern const ProtobufCMessageDescriptor chat__response__descriptor;
 
 PROTOBUF_C__END_DECLS
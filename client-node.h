@@ -5,9 +5,61 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <sys/epoll.h>
 #include "chat.pb-c.h"
+#include "buffer-pool.h"
+#include "mpsc-queue.h"
+#include "token-bucket.h"
+#include "retransmit-window.h"
+#include "timer-wheel.h"
+#include "watch-table.h"
 #include "env.h"
 
+// An attachment the I/O thread of a client writes to it, one frame at a time in the file lane
+typedef struct download {
+    Attachment *file;
+    uint32_t message_id;
+    // Set once the BEGIN chunk was queued, and the next byte of the content to queue
+    int begun;
+    uint64_t next;
+    struct timespec start;
+    struct download *next_download;
+} Download;
+
+// Entry of the outbound queue of a client, only allocated while a frame is waiting for the socket.
+// It is posted to the mailbox of the client first, a NULL frame asks the I/O thread to close the
+// client, unless the item carries a download for it to start
+typedef struct out_item {
+    MpscNode link;
+    Frame *frame;
+    Download *download;
+    size_t offset;
+    struct out_item *next;
+} OutItem;
+
+// A message the client is streaming in chunks, only where it goes is kept, the content is relayed as it comes
+typedef struct stream {
+    uint32_t id;
+    int open;
+    int broadcast;
+    // Presence slot the recipient had at the last chunk, -1 to look it up by name
+    int slot;
+    char recipient[MAX_USERNAME_LENGTH];
+    size_t bytes;
+    // Attachment the content is written to instead (0 if relayed), opened again by id after a hot restart
+    uint64_t attachment;
+    Attachment *file;
+} Stream;
+
+// Why the requests of a client are not handed to its worker right now
+typedef enum stall {
+    STALL_NONE,
+    // The worker ring is full, the socket is not read until there is room
+    STALL_RING,
+    // The worker has a quantum of the client waiting, the rest waits until it handled some
+    STALL_BUDGET
+} Stall;
+
 typedef struct node {
     int data;
     struct node *linked_to;
@@ -15,12 +67,147 @@ typedef struct node {
     char name[MAX_USERNAME_LENGTH];
     Chat__UserStatus status;
     char ip[16];
-    clock_t last_seen;
+    time_t last_seen;
+    // Last time a request came, set by the I/O thread, and the heartbeat timer of the connection
+    time_t last_heard;
+    TimerLink heartbeat;
     int active;
+    int slot;
+    // Set from accept until the client registers, counted in handshakes
+    int handshaking;
+    // Set once a drain asked its I/O thread to close it, every frame it had was delivered
+    int drained;
+    // Outbound queue of every lane, the lane of a frame that was partly written (-1 if none) and the
+    // frames of earlier lanes written in a row while each lane waited
+    OutItem *out_head[LANES];
+    OutItem *out_tail[LANES];
+    int out_lane;
+    int skipped[LANES];
+    size_t out_bytes;
+    // Attachments being written to the client in order, and the bytes and time of the finished ones
+    Download *downloads;
+    Download *downloads_tail;
+    unsigned long file_bytes;
+    unsigned long file_ns;
+    // Frames written that the client may not have received, and how many it acknowledged (set by its worker)
+    RetransmitWindow window;
+    uint64_t acked;
+    // Sequencer of the direct messages to the client, the number of the last one
+    uint64_t direct_sequence;
+    // Given at registration, a new connection with it takes the session over (all 0 before)
+    unsigned char session_token[SESSION_TOKEN_LENGTH];
+    // Usernames whose presence changes are pushed to the client
+    WatchList watching;
+    // MSG_ZEROCOPY state of the socket (0 not tried, 1 on, -1 not supported), the id of its next
+    // zerocopy send and the frames the kernel may still read, the offset of each holds its send id
+    int zerocopy;
+    uint32_t zerocopy_next;
+    OutItem *zerocopy_sent;
+    // References held by the list, the I/O thread and every job or frame in flight for the client
+    int refs;
+    // I/O thread that owns the socket and worker that runs the requests, fixed for the connection
+    int io;
+    int worker;
+    // Bytes of an incomplete request, only allocated while one is pending
+    char *rx;
+    size_t rx_len;
+    // Set while the requests of the client wait, in the list of the I/O thread for that reason
+    Stall stalled;
+    struct node *next_stalled;
+    // Events the socket is watched for, so an unchanged set costs no system call
+    uint32_t events;
+    // Bytes of requests handed to the worker and not handled yet, at most read_quantum
+    size_t inflight;
+    // While stalled on the budget, the most bytes in flight with which its next request fits. The
+    // worker that brings inflight down to it wakes the I/O thread
+    size_t budget_room;
+    // Requests the worker handled for the client and the time it spent on them
+    unsigned long served;
+    unsigned long service_ns;
+    // Frames posted by any thread, only the I/O thread of the client takes them
+    MpscQueue mailbox;
+    // Set while the client waits in the ready queue of its I/O thread
+    int scheduled;
+    MpscNode ready_link;
+    // Rate limits of the requests and how many were refused, only touched by the worker of the client
+    TokenBucket buckets[RATE_KINDS];
+    unsigned long throttled;
+    // MAX_STREAMS messages being streamed, allocated by the first one and only touched by the worker
+    Stream *streams;
+    // Bytes held by the connection itself: the node, its streams and its receive buffer while it has one
+    size_t memory;
 } CNode;
 
-CNode *create_node(int socket, char *ip, char *name) {
-    CNode *node = (CNode *) malloc(sizeof(CNode));
+/*
+* Out item create function
+* @param frame: the frame, the item takes a reference, NULL for a close request
+* @param offset: the bytes of the frame that were already sent
+* @return: the item, NULL if the allocation failed
+*/
+OutItem *out_item_create(Frame *frame, size_t offset) {
+    OutItem *item = (OutItem *) malloc(sizeof(OutItem));
+    if (item) {
+        item->frame = frame ? frame_retain(frame) : NULL;
+        item->download = NULL;
+        item->offset = offset;
+        item->next = NULL;
+        mem_charge(MEM_QUEUES, sizeof(OutItem));
+    }
+    return item;
+}
+
+/*
+* Download create function
+* @param file: the attachment, the download takes the reference of the caller
+* @param message_id: the id the client gave the download
+* @return: the download, NULL if the allocation failed
+*/
+Download *download_create(Attachment *file, uint32_t message_id) {
+    Download *download = (Download *) calloc(1, sizeof(Download));
+    if (download) {
+        download->file = file;
+        download->message_id = message_id;
+        mem_charge(MEM_QUEUES, sizeof(Download));
+    }
+    return download;
+}
+
+/*
+* Download free function
+* @param download: the download, its attachment reference is released
+* @return: void
+*/
+void download_free(Download *download) {
+    attachment_release(download->file);
+    mem_release(MEM_QUEUES, sizeof(Download));
+    free(download);
+}
+
+/*
+* Out item free function
+* @param item: the item, its frame reference and the download it carries are released
+* @return: void
+*/
+void out_item_free(OutItem *item) {
+    if (item->download) {
+        download_free(item->download);
+    }
+    frame_release(item->frame);
+    mem_release(MEM_QUEUES, sizeof(OutItem));
+    free(item);
+}
+
+/*
+* Init node function
+* @param node: the memory of the node, from malloc
+* @param socket: the socket of the client
+* @param ip: its address
+* @param name: its name, NULL for Anon
+* @return: the node
+* This function will be used for the nodes the I/O threads allocate on their NUMA node ahead of the connections
+*/
+CNode *init_node(CNode *node, int socket, char *ip, char *name) {
+    mem_charge(MEM_CONNECTIONS, sizeof(CNode));
     node->data = socket;
     node->linked_to = NULL;
     node->linked_from = NULL;
@@ -31,9 +218,121 @@ CNode *create_node(int socket, char *ip, char *name) {
     } else {
         strncpy(node->name, "Anon", 20);
     }
-    node->last_seen = clock();
+    node->last_seen = time(NULL);
+    node->last_heard = node->last_seen;
+    node->heartbeat.next = NULL;
+    node->heartbeat.prev = NULL;
+    node->heartbeat.armed = 0;
     node->active = 1;
+    node->slot = -1;
+    node->handshaking = 0;
+    node->drained = 0;
+    node->watching.head = NULL;
+    node->watching.count = 0;
+    int64_t now_ms = monotonic_ms();
+    for (int kind = 0; kind < RATE_KINDS; kind++) {
+        bucket_fill(&node->buckets[kind], now_ms);
+    }
+    node->throttled = 0;
+    node->streams = NULL;
+    node->memory = sizeof(CNode);
+    for (int lane = 0; lane < LANES; lane++) {
+        node->out_head[lane] = NULL;
+        node->out_tail[lane] = NULL;
+        node->skipped[lane] = 0;
+    }
+    node->out_lane = -1;
+    node->out_bytes = 0;
+    node->downloads = NULL;
+    node->downloads_tail = NULL;
+    node->file_bytes = 0;
+    node->file_ns = 0;
+    window_init(&node->window);
+    node->acked = 0;
+    node->direct_sequence = 0;
+    memset(node->session_token, 0, SESSION_TOKEN_LENGTH);
+    node->zerocopy = 0;
+    node->zerocopy_next = 0;
+    node->zerocopy_sent = NULL;
+    node->refs = 0;
+    node->io = 0;
+    node->worker = 0;
+    node->rx = NULL;
+    node->rx_len = 0;
+    node->stalled = 0;
+    node->next_stalled = NULL;
+    node->events = EPOLLIN;
+    node->inflight = 0;
+    node->budget_room = 0;
+    node->served = 0;
+    node->service_ns = 0;
+    mpsc_init(&node->mailbox);
+    node->scheduled = 0;
+    node->ready_link.next = NULL;
+    return node;
+}
+
+CNode *create_node(int socket, char *ip, char *name) {
+    CNode *node = (CNode *) malloc(sizeof(CNode));
+    if (node == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    return init_node(node, socket, ip, name);
+}
+
+/*
+* Out empty function
+* @param node: the client node
+* @return: 1 if nothing waits in the outbound queues
+*/
+int out_empty(CNode *node) {
+    for (int lane = 0; lane < LANES; lane++) {
+        if (node->out_head[lane]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+* Node retain function
+* @param node: the client node
+* @return: the same node
+*/
+CNode *node_retain(CNode *node) {
+    __atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
     return node;
 }
 
+/*
+* Node release function
+* @param node: the client node
+* @return: void
+* This function will be used to drop a reference, the last one frees the node
+*/
+void node_release(CNode *node) {
+    if (__atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        if (node->streams) {
+            // An upload that was not finished is never shared, its file goes
+            for (int i = 0; i < MAX_STREAMS; i++) {
+                Stream *stream = &node->streams[i];
+                Attachment *file = stream->open && stream->attachment ? stream->file : NULL;
+                if (stream->open && stream->attachment && file == NULL) {
+                    file = attachment_find(stream->attachment);
+                }
+                if (file) {
+                    attachment_remove(file);
+                    attachment_release(file);
+                }
+            }
+            mem_release(MEM_CONNECTIONS, sizeof(Stream) * MAX_STREAMS);
+            free(node->streams);
+        }
+        window_free(&node->window);
+        mem_release(MEM_CONNECTIONS, sizeof(CNode));
+        free(node);
+    }
+}
+
 #endif
\ No newline at end of file
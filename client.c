@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <stdlib.h>
@@ -11,6 +12,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <time.h>
+#include <errno.h>
 
 int cli_socket_descript = 0;
 int is_connected = 0;
@@ -18,6 +20,112 @@ char cli_name[MAX_USERNAME_LENGTH] = {};
 Chat__MessageType channel = CHAT__MESSAGE_TYPE__BROADCAST;
 char current_chat[MAX_USERNAME_LENGTH] = {};
 int cli_status = CHAT__USER_STATUS__OFFLINE;
+// Id of the last message streamed in chunks
+uint32_t last_stream_id = 0;
+// Id of the last message sent, it starts at a random point so ids do not repeat across runs
+uint64_t last_message_id = 0;
+
+// A message that is arriving in chunks, it is shown once it is complete
+typedef struct incoming_stream {
+    int open;
+    uint32_t id;
+    char sender[MAX_USERNAME_LENGTH];
+    Chat__MessageType type;
+    char *content;
+    size_t len;
+} IncomingStream;
+
+IncomingStream incoming[INCOMING_STREAMS];
+
+// The attachment being downloaded, the server sends one after the other so its content goes straight to a file
+FILE *download_file = NULL;
+uint32_t download_id = 0;
+char download_path[ATTACHMENT_NAME_LENGTH + 32];
+
+// Frames received on this connection and how many were acknowledged, the server keeps the others
+// to send them again if the connection is lost. The listener and the menu both send, one at a time
+uint64_t frames_received = 0;
+uint64_t frames_acked = 0;
+pthread_mutex_t send_lock = PTHREAD_MUTEX_INITIALIZER;
+// When a request was sent last, a client that says nothing for a while tells the server it is there
+time_t last_sent = 0;
+
+// Where the server is and the token of our session, a lost connection is replaced by a new one that
+// resumes it. connection counts the replacements, a thread that saw the old one fail waits for the new one
+struct sockaddr_in server_address;
+// Where a draining server told us to go, tried first by the next reconnect
+struct sockaddr_in redirect_address;
+int has_redirect = 0;
+unsigned char session_token[SESSION_TOKEN_LENGTH];
+int has_session = 0;
+int connection = 0;
+pthread_mutex_t reconnect_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Users whose status changes the server pushes to us, followed again on a new connection and when
+// entering the chatroom, the server only pushes them while we are in it
+char watched[WATCHED_USERS][MAX_USERNAME_LENGTH];
+int watched_count = 0;
+pthread_mutex_t watched_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// A message that came ahead of one missing before it, shown once the gap is filled. The answer to
+// a broadcast of our own only fills its place, it has no content
+typedef struct held_message {
+    int used;
+    uint64_t sequence;
+    char *sender;
+    char *content;
+} HeldMessage;
+
+// Order of the messages of a channel: the number of the next one to show (0 until the first one
+// arrives), the ones held back and since when the oldest gap is open
+typedef struct channel_order {
+    uint64_t next;
+    // The last number sent while the server was not sending us the channel, the ones up to it are not missing
+    uint64_t joined;
+    HeldMessage held[REORDER_WINDOW];
+    int waiting;
+    struct timespec since;
+    unsigned long lost;
+} ChannelOrder;
+
+// Indexed by the message type, the broadcasts and the direct messages are numbered apart
+ChannelOrder orders[2];
+pthread_mutex_t order_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+* Order joined function
+* @param last: the number of the last broadcast sent before the server sent them to us again
+* @return: void
+* This function will be used on the answers that make us get the broadcasts again, the numbers up to
+* last went out while we were OFFLINE or away and are not reported missing
+*/
+void order_joined(uint64_t last) {
+    pthread_mutex_lock(&order_lock);
+    orders[CHAT__MESSAGE_TYPE__BROADCAST].joined = last;
+    pthread_mutex_unlock(&order_lock);
+}
+
+/*
+* Order reset function
+* @return: void
+* This function will be used when joining the chatroom, the messages sent while away were not for us
+*/
+void order_reset() {
+    pthread_mutex_lock(&order_lock);
+    for (int type = 0; type < 2; type++) {
+        for (int i = 0; i < REORDER_WINDOW; i++) {
+            if (orders[type].held[i].used) {
+                free(orders[type].held[i].sender);
+                free(orders[type].held[i].content);
+                orders[type].held[i].used = 0;
+            }
+        }
+        orders[type].next = 0;
+        orders[type].joined = 0;
+        orders[type].waiting = 0;
+    }
+    pthread_mutex_unlock(&order_lock);
+}
 
 void exit_service(int signal) {
     printf("\nShutting down...\n");
@@ -25,6 +133,713 @@ void exit_service(int signal) {
     exit(EXIT_SUCCESS);
 }
 
+/*
+* Send once function
+* @param buffer: the packed request
+* @param len: the size of the request
+* @param generation: the connection the request is meant for
+* @return: the bytes of the request sent, -1 if failed or the connection was replaced meanwhile
+* This function will be used to send a request after its length, the server reads requests by their length
+*/
+int send_once(void *buffer, size_t len, int generation) {
+    char *frame = malloc(FRAME_HEADER_SIZE + len);
+    if (frame == NULL) {
+        return -1;
+    }
+    uint32_t header = htonl((uint32_t) len);
+    memcpy(frame, &header, FRAME_HEADER_SIZE);
+    memcpy(frame + FRAME_HEADER_SIZE, buffer, len);
+    size_t sent = 0;
+    pthread_mutex_lock(&send_lock);
+    if (connection != generation) {
+        pthread_mutex_unlock(&send_lock);
+        free(frame);
+        return -1;
+    }
+    while (sent < FRAME_HEADER_SIZE + len) {
+        ssize_t bytes = send(cli_socket_descript, frame + sent, FRAME_HEADER_SIZE + len - sent, MSG_NOSIGNAL);
+        if (bytes <= 0) {
+            pthread_mutex_unlock(&send_lock);
+            free(frame);
+            return -1;
+        }
+        sent += bytes;
+    }
+    __atomic_store_n(&last_sent, time(NULL), __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&send_lock);
+    free(frame);
+    return (int) len;
+}
+
+/*
+* Tune socket function
+* @param descript: a socket connected to the server
+* @return: void
+*/
+void tune_socket(int descript) {
+    // Wake up a waiting receive now and then to acknowledge the frames of a quiet connection
+    struct timeval ack_delay = {ACK_DELAY_MS / 1000, (ACK_DELAY_MS % 1000) * 1000};
+    setsockopt(descript, SOL_SOCKET, SO_RCVTIMEO, &ack_delay, sizeof(ack_delay));
+    // A request the server does not acknowledge in time means the connection is gone
+    unsigned int user_timeout = DEFAULT_USER_TIMEOUT_MS;
+    setsockopt(descript, IPPROTO_TCP, TCP_USER_TIMEOUT, &user_timeout, sizeof(user_timeout));
+}
+
+/*
+* Resume request function
+* @param descript: a new connection to the server
+* @return: the answer of the server, NULL if none came
+* This function will be used to resume our session on a new connection, the answer is its first frame
+*/
+Chat__Response *resume_request(int descript) {
+    Chat__NewUserRequest new_user_request = CHAT__NEW_USER_REQUEST__INIT;
+    new_user_request.username = cli_name;
+    new_user_request.resume = 1;
+    new_user_request.received = __atomic_load_n(&frames_received, __ATOMIC_RELAXED);
+    new_user_request.session_token.data = session_token;
+    new_user_request.session_token.len = SESSION_TOKEN_LENGTH;
+
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__REGISTER_USER;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_REGISTER_USER;
+    request.register_user = &new_user_request;
+
+    // Serialize the request after its length
+    size_t req_len = chat__request__get_packed_size(&request);
+    char frame[FRAME_HEADER_SIZE + BUFFER_SIZE];
+    if (req_len > BUFFER_SIZE) {
+        return NULL;
+    }
+    uint32_t header = htonl((uint32_t) req_len);
+    memcpy(frame, &header, FRAME_HEADER_SIZE);
+    chat__request__pack(&request, (uint8_t *) frame + FRAME_HEADER_SIZE);
+    if (send(descript, frame, FRAME_HEADER_SIZE + req_len, MSG_NOSIGNAL) != (ssize_t) (FRAME_HEADER_SIZE + req_len)) {
+        return NULL;
+    }
+
+    // Read the answer, the receive timeout is short so the wait is counted
+    size_t len = 0, received = 0;
+    int waits = 0;
+    while (received < FRAME_HEADER_SIZE + len) {
+        ssize_t bytes = recv(descript, frame + received, (received < FRAME_HEADER_SIZE ? FRAME_HEADER_SIZE : FRAME_HEADER_SIZE + len) - received, 0);
+        if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && ++waits * ACK_DELAY_MS < RECONNECT_MAX_MS) {
+            continue;
+        }
+        if (bytes <= 0) {
+            return NULL;
+        }
+        received += bytes;
+        if (received == FRAME_HEADER_SIZE) {
+            memcpy(&header, frame, FRAME_HEADER_SIZE);
+            len = ntohl(header);
+            if (len > BUFFER_SIZE) {
+                return NULL;
+            }
+        }
+    }
+    return chat__response__unpack(NULL, len, (uint8_t *) frame + FRAME_HEADER_SIZE);
+}
+
+/*
+* Presence request function
+* @param names: the usernames, NULL for all the ones we follow
+* @param count: how many names
+* @param unsubscribe: stop following them instead
+* @param len: where the size of the request is written
+* @return: the packed request the caller sends and frees, NULL if there is nothing to send
+*/
+void *presence_request(char **names, size_t count, int unsubscribe, size_t *len){
+    char *followed[WATCHED_USERS];
+    Chat__PresenceRequest presence_request = CHAT__PRESENCE_REQUEST__INIT;
+    presence_request.unsubscribe = unsubscribe;
+    presence_request.n_usernames = count;
+    presence_request.usernames = names;
+
+    pthread_mutex_lock(&watched_lock);
+    if (names == NULL){
+        for (int i = 0; i < watched_count; i++){
+            followed[i] = watched[i];
+        }
+        presence_request.n_usernames = watched_count;
+        presence_request.usernames = followed;
+    }
+    void *req_buffer = NULL;
+    if (presence_request.n_usernames > 0){
+        Chat__Request request = CHAT__REQUEST__INIT;
+        request.operation = CHAT__OPERATION__SUBSCRIBE_PRESENCE;
+        request.payload_case = CHAT__REQUEST__PAYLOAD_SUBSCRIBE_PRESENCE;
+        request.subscribe_presence = &presence_request;
+
+        // Serialize the request
+        *len = chat__request__get_packed_size(&request);
+        req_buffer = malloc(*len);
+        if (req_buffer == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        chat__request__pack(&request, req_buffer);
+    }
+    pthread_mutex_unlock(&watched_lock);
+    return req_buffer;
+}
+
+/*
+* Status request function
+* @param status: the status to set
+* @param len: where the size of the request is written
+* @return: the packed request the caller sends and frees
+*/
+void *status_request(Chat__UserStatus status, size_t *len){
+    Chat__UpdateStatusRequest change_status_request = CHAT__UPDATE_STATUS_REQUEST__INIT;
+    change_status_request.new_status = status;
+    change_status_request.username = cli_name;
+
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__UPDATE_STATUS;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_UPDATE_STATUS;
+    request.update_status = &change_status_request;
+
+    // Serialize the request
+    *len = chat__request__get_packed_size(&request);
+    void *req_buffer = malloc(*len);
+    if (req_buffer == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    chat__request__pack(&request, req_buffer);
+    return req_buffer;
+}
+
+/*
+* Set redirect function
+* @param redirect: "<ip>:<port>", or "<ip>" for the port of the server
+* @return: 0 if successful, -1 if it is not an address
+* This function will be used on a DRAINING notice, the next reconnect goes there first
+*/
+int set_redirect(char *redirect) {
+    char host[INET_ADDRSTRLEN];
+    char *colon = strrchr(redirect, ':');
+    size_t len = colon ? (size_t) (colon - redirect) : strlen(redirect);
+    if (len == 0 || len >= sizeof(host)) {
+        return -1;
+    }
+    memcpy(host, redirect, len);
+    host[len] = 0;
+    struct sockaddr_in address = server_address;
+    if (inet_pton(AF_INET, host, &address.sin_addr) != 1) {
+        return -1;
+    }
+    if (colon) {
+        char *end;
+        long port = strtol(colon + 1, &end, 10);
+        if (*end != 0 || port <= 0 || port > 65535) {
+            return -1;
+        }
+        address.sin_port = htons((uint16_t) port);
+    }
+    pthread_mutex_lock(&reconnect_lock);
+    redirect_address = address;
+    has_redirect = 1;
+    pthread_mutex_unlock(&reconnect_lock);
+    return 0;
+}
+
+/*
+* Connect server function
+* @param address: the address of the server
+* @return: the connected socket, -1 if failed
+*/
+int connect_server(struct sockaddr_in *address) {
+    int descript = socket(AF_INET, SOCK_STREAM, 0);
+    if (descript == -1) {
+        return -1;
+    }
+    if (connect(descript, (struct sockaddr *) address, sizeof(*address)) == -1) {
+        close(descript);
+        return -1;
+    }
+    return descript;
+}
+
+/*
+* Reconnect action function
+* @param generation: the connection that failed
+* @return: 0 if a new connection resumed the session, -1 if the server could not be reached
+* This function will be used by any thread that finds the connection lost, the first one replaces it
+* and the others wait for it. The attempts wait longer and longer, a random part of it so all the
+* clients of a blip do not come back at the same moment
+*/
+int reconnect_action(int generation) {
+    pthread_mutex_lock(&reconnect_lock);
+    if (__atomic_load_n(&connection, __ATOMIC_ACQUIRE) != generation) {
+        pthread_mutex_unlock(&reconnect_lock);
+        return 0;
+    }
+    if (!has_session || !is_connected) {
+        pthread_mutex_unlock(&reconnect_lock);
+        return -1;
+    }
+    // A thread blocked on the old connection wakes up and waits here
+    shutdown(cli_socket_descript, SHUT_RDWR);
+    printf("\n\033[0;33mWARNING!\033[0m Connection lost, reconnecting...\n");
+    unsigned int seed = (unsigned int) time(NULL) ^ (unsigned int) getpid();
+    uint32_t retry_after = 0;
+    for (int attempt = 0; attempt < RECONNECT_ATTEMPTS; attempt++) {
+        uint32_t ceiling = attempt < 8 && (RECONNECT_BASE_MS << attempt) < RECONNECT_MAX_MS ? RECONNECT_BASE_MS << attempt : RECONNECT_MAX_MS;
+        uint32_t wait = rand_r(&seed) % ceiling;
+        usleep((wait > retry_after ? wait : retry_after) * 1000);
+        retry_after = 0;
+
+        // The redirect goes first, the address we came from is tried too in case it is not up yet
+        struct sockaddr_in *address = has_redirect ? &redirect_address : &server_address;
+        int descript = connect_server(address);
+        if (descript == -1 && address == &redirect_address) {
+            address = &server_address;
+            descript = connect_server(address);
+        }
+        if (descript == -1) {
+            continue;
+        }
+        tune_socket(descript);
+        Chat__Response *response = resume_request(descript);
+        if (response && response->status_code == CHAT__STATUS_CODE__OK) {
+            if (response->session_token.len == SESSION_TOKEN_LENGTH) {
+                memcpy(session_token, response->session_token.data, SESSION_TOKEN_LENGTH);
+            }
+            // The new connection takes the number of the old one, the answer was its first frame
+            pthread_mutex_lock(&send_lock);
+            dup2(descript, cli_socket_descript);
+            close(descript);
+            __atomic_store_n(&frames_received, 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&frames_acked, 0, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&connection, 1, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&send_lock);
+            // The server we were sent to is the one to come back to from now on
+            if (address == &redirect_address) {
+                server_address = redirect_address;
+                has_redirect = 0;
+            }
+            if (response->resumed) {
+                cli_status = response->status;
+                order_joined(response->broadcast_sequence);
+                printf("Reconnected, %llu messages sent again", (unsigned long long) response->replayed);
+                if (response->lost > 0) {
+                    printf(", \033[0;33mWARNING!\033[0m %llu were lost", (unsigned long long) response->lost);
+                }
+                printf("\n");
+            } else {
+                printf("Reconnected, \033[0;33mWARNING!\033[0m the session was not kept, messages sent meanwhile were lost\n");
+            }
+            size_t req_len;
+            void *req_buffer;
+            if (!response->resumed) {
+                // A new session (a new server after a drain) numbers the messages from the start and
+                // knows nothing of our status
+                order_reset();
+                if (cli_status != CHAT__USER_STATUS__OFFLINE) {
+                    req_buffer = status_request(cli_status, &req_len);
+                    send_once(req_buffer, req_len, __atomic_load_n(&connection, __ATOMIC_ACQUIRE));
+                    free(req_buffer);
+                }
+            }
+            // The subscriptions were of the old connection, the answer tells the statuses we missed
+            req_buffer = cli_status != CHAT__USER_STATUS__OFFLINE ? presence_request(NULL, 0, 0, &req_len) : NULL;
+            if (req_buffer){
+                send_once(req_buffer, req_len, __atomic_load_n(&connection, __ATOMIC_ACQUIRE));
+                free(req_buffer);
+            }
+            chat__response__free_unpacked(response, NULL);
+            pthread_mutex_unlock(&reconnect_lock);
+            return 0;
+        }
+        if (response) {
+            printf("Reconnect refused: %s\n", response->message);
+            retry_after = response->retry_after_ms;
+            chat__response__free_unpacked(response, NULL);
+        }
+        close(descript);
+    }
+    printf("Could not reconnect!\n");
+    pthread_mutex_unlock(&reconnect_lock);
+    return -1;
+}
+
+/*
+* Send framed function
+* @param buffer: the packed request
+* @param len: the size of the request
+* @return: the bytes of the request sent, -1 if failed
+* This function will be used to send a request, sent again on a new connection if the one it was
+* sent on is lost. The requests are safe to repeat, a message has its id
+*/
+int send_framed(void *buffer, size_t len) {
+    while (1) {
+        int generation = __atomic_load_n(&connection, __ATOMIC_ACQUIRE);
+        if (send_once(buffer, len, generation) >= 0) {
+            return (int) len;
+        }
+        if (reconnect_action(generation) == -1) {
+            return -1;
+        }
+    }
+}
+
+/*
+* Pong action function
+* @return: void
+* This function will be used to answer a ping of the server, and to tell it we are there while
+* nothing else is sent
+*/
+void pong_action() {
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__PONG;
+
+    // Serialize the request
+    size_t req_len = chat__request__get_packed_size(&request);
+    void *req_buffer = malloc(req_len);
+    if (req_buffer == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    chat__request__pack(&request, req_buffer);
+    // A lost pong is noticed by the server only if nothing else is sent before its timeout
+    send_framed(req_buffer, req_len);
+    free(req_buffer);
+}
+
+/*
+* Heartbeat function
+* @param arg: unused
+* @return: NULL
+* This function will be used by a thread of its own, the menu does not read the socket while it
+* waits for the user, so the pings it does not see are covered
+*/
+void *heartbeat(void *arg) {
+    while (is_connected) {
+        sleep(1);
+        if (time(NULL) - __atomic_load_n(&last_sent, __ATOMIC_RELAXED) >= CLIENT_HEARTBEAT) {
+            pong_action();
+        }
+    }
+    return NULL;
+}
+
+/*
+* Ack action function
+* @return: void
+* This function will be used to tell the server how many frames arrived, every ACK_EVERY frames
+* or once no frame came for ACK_DELAY_MS, so one ack covers a whole burst
+*/
+void ack_action() {
+    // The count belongs to one connection, the ack is not sent on another one
+    int generation = __atomic_load_n(&connection, __ATOMIC_ACQUIRE);
+    uint64_t received = __atomic_load_n(&frames_received, __ATOMIC_RELAXED);
+    Chat__Ack ack = CHAT__ACK__INIT;
+    ack.received = received;
+
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__ACK;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_ACK;
+    request.ack = &ack;
+
+    // Serialize the request
+    size_t req_len = chat__request__get_packed_size(&request);
+    void *req_buffer = malloc(req_len);
+    if (req_buffer == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    chat__request__pack(&request, req_buffer);
+    // A lost ack is covered by the next one
+    if (send_once(req_buffer, req_len, generation) >= 0) {
+        __atomic_store_n(&frames_acked, received, __ATOMIC_RELAXED);
+    }
+    free(req_buffer);
+}
+
+/*
+* Show message function
+* @param type: the channel of the message
+* @param sender: the username of the sender
+* @param content: the message, NULL for a broadcast of our own
+* @return: void
+*/
+void show_message(Chat__MessageType type, char *sender, char *content) {
+    if (content == NULL) {
+        return;
+    }
+    if (type == CHAT__MESSAGE_TYPE__BROADCAST){
+        printf("\n\033[0;35mGLOBAL\033[0m - Message from %s: %s\n\n", sender, content);
+    } else {
+        printf("\n\033[0;34mPRIVATE\033[0m - Message from %s: %s\n\n", sender, content);
+    }
+}
+
+/*
+* Release held function
+* @param type: the channel
+* @return: void
+* This function will be used once the next message of a channel was shown, the ones held after it follow
+*/
+void release_held(Chat__MessageType type) {
+    ChannelOrder *order = &orders[type];
+    HeldMessage *held = &order->held[order->next % REORDER_WINDOW];
+    while (held->used && held->sequence == order->next) {
+        show_message(type, held->sender, held->content);
+        free(held->sender);
+        free(held->content);
+        held->used = 0;
+        order->waiting--;
+        order->next++;
+        held = &order->held[order->next % REORDER_WINDOW];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &order->since);
+}
+
+/*
+* Skip gap function
+* @param type: the channel
+* @return: void
+* This function will be used when the messages missing in front of the held ones are given up,
+* the held ones are shown and the missing ones reported
+*/
+void skip_gap(Chat__MessageType type) {
+    ChannelOrder *order = &orders[type];
+    unsigned long missing = 0;
+    while (order->waiting > 0 && !(order->held[order->next % REORDER_WINDOW].used && order->held[order->next % REORDER_WINDOW].sequence == order->next)) {
+        missing += order->next > order->joined;
+        order->next++;
+    }
+    if (missing > 0) {
+        order->lost += missing;
+        printf("\n\033[0;33mWARNING!\033[0m %lu %s messages did not arrive\n\n", missing, type == CHAT__MESSAGE_TYPE__BROADCAST ? "GLOBAL" : "PRIVATE");
+    }
+    release_held(type);
+}
+
+/*
+* Order message function
+* @param type: the channel of the message
+* @param sequence: its number in the channel, 0 if the server does not number them
+* @param sender: the username of the sender
+* @param content: the message, NULL for the answer to a broadcast of our own
+* @return: void
+* This function will be used by the listener, a message is shown once every message before it was.
+* One that comes early is held, a repeated one is dropped
+*/
+void order_message(Chat__MessageType type, uint64_t sequence, char *sender, char *content) {
+    pthread_mutex_lock(&order_lock);
+    ChannelOrder *order = &orders[type];
+    if (sequence == 0) {
+        show_message(type, sender, content);
+        pthread_mutex_unlock(&order_lock);
+        return;
+    }
+    if (order->next == 0) {
+        order->next = sequence;
+    }
+    // Past the numbers sent while we did not get the channel, the held ones are shown and the others forgotten
+    if (sequence > order->joined && order->next <= order->joined) {
+        while (order->next <= order->joined && order->waiting > 0) {
+            HeldMessage *held = &order->held[order->next % REORDER_WINDOW];
+            if (!(held->used && held->sequence == order->next)) {
+                order->next++;
+            }
+            release_held(type);
+        }
+        if (order->next <= order->joined) {
+            order->next = order->joined + 1;
+        }
+    }
+    if (sequence < order->next) {
+        // Far behind, the server started counting again, otherwise it was shown already
+        if (order->next - sequence <= REORDER_WINDOW) {
+            pthread_mutex_unlock(&order_lock);
+            return;
+        }
+        while (order->waiting > 0) {
+            skip_gap(type);
+        }
+        order->next = sequence;
+    }
+    // Too far ahead to be held, the oldest gaps are given up
+    while (sequence >= order->next + REORDER_WINDOW) {
+        if (order->waiting == 0) {
+            order->lost += sequence - order->next;
+            printf("\n\033[0;33mWARNING!\033[0m %llu %s messages did not arrive\n\n", (unsigned long long) (sequence - order->next), type == CHAT__MESSAGE_TYPE__BROADCAST ? "GLOBAL" : "PRIVATE");
+            order->next = sequence;
+        } else {
+            skip_gap(type);
+        }
+    }
+    if (sequence == order->next) {
+        show_message(type, sender, content);
+        order->next++;
+        release_held(type);
+    } else {
+        HeldMessage *held = &order->held[sequence % REORDER_WINDOW];
+        if (!held->used) {
+            if (order->waiting == 0) {
+                clock_gettime(CLOCK_MONOTONIC, &order->since);
+            }
+            held->used = 1;
+            held->sequence = sequence;
+            held->sender = strdup(sender ? sender : "");
+            held->content = content ? strdup(content) : NULL;
+            order->waiting++;
+        }
+    }
+    pthread_mutex_unlock(&order_lock);
+}
+
+/*
+* Order tick function
+* @return: void
+* This function will be used while waiting for the server, a gap open for REORDER_WAIT_MS is given up
+*/
+void order_tick() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    pthread_mutex_lock(&order_lock);
+    for (int type = 0; type < 2; type++) {
+        ChannelOrder *order = &orders[type];
+        long waited = (now.tv_sec - order->since.tv_sec) * 1000 + (now.tv_nsec - order->since.tv_nsec) / 1000000;
+        if (order->waiting > 0 && waited >= REORDER_WAIT_MS) {
+            skip_gap(type);
+        }
+    }
+    pthread_mutex_unlock(&order_lock);
+}
+
+/*
+* Receive exact function
+* @param buffer: where to store the bytes
+* @param len: the number of bytes to read
+* @param generation: the connection the bytes are read from
+* @return: 0 if successful, -1 if failed, the server closed the connection or it was replaced
+*/
+int recv_exact(void *buffer, size_t len, int generation) {
+    size_t received = 0;
+    while (received < len) {
+        if (__atomic_load_n(&connection, __ATOMIC_ACQUIRE) != generation) {
+            return -1;
+        }
+        ssize_t bytes = recv(cli_socket_descript, (char *) buffer + received, len - received, 0);
+        // The receive timeout is ACK_DELAY_MS, a quiet connection acknowledges what it got
+        if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            if (__atomic_load_n(&frames_received, __ATOMIC_RELAXED) > __atomic_load_n(&frames_acked, __ATOMIC_RELAXED)) {
+                ack_action();
+            }
+            order_tick();
+            continue;
+        }
+        if (bytes <= 0) {
+            return -1;
+        }
+        received += bytes;
+    }
+    return 0;
+}
+
+/*
+* Frame received function
+* @param buffer: the response
+* @param len: its size
+* @return: 1 if it was a ping, answered here, 0 otherwise
+* This function will be used on every frame read, a ping is answered whoever reads and is never taken
+* for the answer to a request
+*/
+int frame_received(void *buffer, size_t len) {
+    if (__atomic_add_fetch(&frames_received, 1, __ATOMIC_RELAXED) - __atomic_load_n(&frames_acked, __ATOMIC_RELAXED) >= ACK_EVERY) {
+        ack_action();
+    }
+    if (len < PING_FRAME_LENGTH) {
+        Chat__Response *response = chat__response__unpack(NULL, len, buffer);
+        int ping = response && response->operation == CHAT__OPERATION__PING;
+        chat__response__free_unpacked(response, NULL);
+        if (ping) {
+            pong_action();
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+* Receive framed function
+* @param buffer: where to store the response
+* @param max: the size of buffer
+* @return: the size of the response, -1 if failed
+* This function will be used to read one whole response, a response may arrive in several segments.
+* If the connection is lost the response is read from the new one. A response longer than max is
+* read and skipped with a warning
+*/
+int recv_framed(void *buffer, size_t max) {
+    int generation = __atomic_load_n(&connection, __ATOMIC_ACQUIRE);
+    uint32_t header;
+    if (recv_exact(&header, FRAME_HEADER_SIZE, generation) == -1) {
+        if (reconnect_action(generation) == -1) {
+            return -1;
+        }
+        return recv_framed(buffer, max);
+    }
+    size_t len = ntohl(header);
+    // The buffer is the scratch space for the bytes of a response too long for it
+    for (size_t read = 0; read < len; ) {
+        size_t part = len - read < max ? len - read : max;
+        if (recv_exact(buffer, part, generation) == -1) {
+            if (reconnect_action(generation) == -1) {
+                return -1;
+            }
+            return recv_framed(buffer, max);
+        }
+        read += part;
+    }
+    if (frame_received(buffer, len)) {
+        return recv_framed(buffer, max);
+    }
+    if (len > max) {
+        printf("\n\033[0;33mWARNING!\033[0m A response of %zu bytes did not fit in %zu and was skipped\n", len, max);
+        return recv_framed(buffer, max);
+    }
+    return (int) len;
+}
+
+/*
+* Receive framed alloc function
+* @param buffer: set to the response, allocated to its size, the caller frees it
+* @return: the size of the response, -1 if failed
+* This function will be used for the responses with no bound on their size, like a page of users
+*/
+int recv_framed_alloc(void **buffer) {
+    int generation = __atomic_load_n(&connection, __ATOMIC_ACQUIRE);
+    uint32_t header;
+    if (recv_exact(&header, FRAME_HEADER_SIZE, generation) == -1) {
+        if (reconnect_action(generation) == -1) {
+            return -1;
+        }
+        return recv_framed_alloc(buffer);
+    }
+    size_t len = ntohl(header);
+    *buffer = malloc(len > 0 ? len : 1);
+    if (*buffer == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    if (recv_exact(*buffer, len, generation) == -1) {
+        free(*buffer);
+        if (reconnect_action(generation) == -1) {
+            return -1;
+        }
+        return recv_framed_alloc(buffer);
+    }
+    if (frame_received(*buffer, len)) {
+        free(*buffer);
+        return recv_framed_alloc(buffer);
+    }
+    return (int) len;
+}
+
 void create_user_action(){
     // Prepare a petition to set the username
     Chat__NewUserRequest new_user_request = CHAT__NEW_USER_REQUEST__INIT;
@@ -45,14 +860,14 @@ void create_user_action(){
     chat__request__pack(&request, req_buffer);
 
     // Send the request
-    int bytes_sent = send(cli_socket_descript, req_buffer, req_len, 0);
+    int bytes_sent = send_framed(req_buffer, req_len);
     if(bytes_sent<0){
         printf("Send failed!\n");
         exit(EXIT_FAILURE);
     }
 
     char res_buffer[BUFFER_SIZE];
-    int res = recv(cli_socket_descript, res_buffer, BUFFER_SIZE, 0);
+    int res = recv_framed(res_buffer, BUFFER_SIZE);
     if (res < 0) {
         printf("Receive failed!\n");
         exit(EXIT_FAILURE);
@@ -66,6 +881,15 @@ void create_user_action(){
 
     if (response->status_code == CHAT__STATUS_CODE__OK) {
         printf("Message: %s\n", response->message);
+        // Kept to resume the session if the connection is lost
+        if (response->session_token.len == SESSION_TOKEN_LENGTH) {
+            memcpy(session_token, response->session_token.data, SESSION_TOKEN_LENGTH);
+            has_session = 1;
+        }
+    } else if (response->retry_after_ms > 0) {
+        // The server is out of capacity, not refusing the user
+        printf("Error: %s (retry in %u ms)\n", response->message, response->retry_after_ms);
+        exit(EXIT_FAILURE);
     } else {
         printf("Error: %s\n", response->message);
         exit(EXIT_FAILURE);
@@ -85,11 +909,128 @@ char* parse_user_status(int status){
     }
 }
 
+char* parse_delivery_status(int status){
+    switch (status){
+        case CHAT__DELIVERY_STATUS__DELIVERED:
+            return "Delivered";
+        case CHAT__DELIVERY_STATUS__DELIVERED_BUSY:
+            return "Delivered, the user is busy";
+        case CHAT__DELIVERY_STATUS__RECIPIENT_OFFLINE:
+            return "Not delivered, the user is offline";
+        case CHAT__DELIVERY_STATUS__RECIPIENT_NOT_FOUND:
+            return "Not delivered, the user does not exist";
+        default:
+            return "Unknown";
+    }
+}
+
+/*
+* Receive chunk function
+* @param chunk: a chunk relayed by the server
+* @return: void
+* This function will be used by the listener to put a streamed message together, the chunks of
+* a stream it did not see begin (like when the stream table is full) are dropped
+*/
+void receive_chunk(Chat__MessageChunk *chunk) {
+    IncomingStream *stream = NULL;
+    for (int i = 0; i < INCOMING_STREAMS && stream == NULL; i++) {
+        if (incoming[i].open && incoming[i].id == chunk->message_id && strcmp(incoming[i].sender, chunk->sender) == 0) {
+            stream = &incoming[i];
+        }
+    }
+    if (chunk->type == CHAT__CHUNK_TYPE__BEGIN) {
+        for (int i = 0; i < INCOMING_STREAMS && stream == NULL; i++) {
+            if (!incoming[i].open) {
+                stream = &incoming[i];
+                stream->open = 1;
+                stream->id = chunk->message_id;
+                strncpy(stream->sender, chunk->sender, MAX_USERNAME_LENGTH - 1);
+                stream->type = chunk->message_type;
+                stream->content = NULL;
+                stream->len = 0;
+            }
+        }
+        if (stream == NULL) {
+            printf("\n\033[0;33mWARNING!\033[0m Too many long messages at once, the one from %s is dropped\n", chunk->sender);
+        }
+        return;
+    }
+    if (stream == NULL) {
+        return;
+    }
+    if (chunk->type == CHAT__CHUNK_TYPE__DATA) {
+        char *content = realloc(stream->content, stream->len + chunk->data.len + 1);
+        if (content == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(content + stream->len, chunk->data.data, chunk->data.len);
+        stream->content = content;
+        stream->len += chunk->data.len;
+        stream->content[stream->len] = '\0';
+        return;
+    }
+    if (chunk->type == CHAT__CHUNK_TYPE__END) {
+        if (stream->type == CHAT__MESSAGE_TYPE__BROADCAST){
+            printf("\n\033[0;35mGLOBAL\033[0m - Message from %s: %s\n\n", stream->sender, stream->content ? stream->content : "");
+        } else {
+            printf("\n\033[0;34mPRIVATE\033[0m - Message from %s: %s\n\n", stream->sender, stream->content ? stream->content : "");
+        }
+    } else {
+        printf("\n\033[0;33mWARNING!\033[0m The message from %s was not completed\n", stream->sender);
+    }
+    free(stream->content);
+    stream->open = 0;
+}
+
+/*
+* Receive download function
+* @param chunk: a chunk of an attachment the user asked for
+* @return: void
+* This function will be used by the listener to write a download to <id>-<name> in the current directory
+*/
+void receive_download(Chat__MessageChunk *chunk) {
+    if (chunk->type == CHAT__CHUNK_TYPE__BEGIN && chunk->attachment) {
+        if (download_file) {
+            fclose(download_file);
+        }
+        snprintf(download_path, sizeof(download_path), "%llu-%s", (unsigned long long) chunk->attachment->id, chunk->attachment->name);
+        download_file = fopen(download_path, "wb");
+        download_id = chunk->message_id;
+        if (download_file == NULL) {
+            printf("Could not create %s!\n", download_path);
+        } else {
+            printf("Downloading %s (%llu bytes) from %s...\n", chunk->attachment->name, (unsigned long long) chunk->attachment->size, chunk->attachment->sender);
+        }
+        return;
+    }
+    if (download_file == NULL || chunk->message_id != download_id) {
+        return;
+    }
+    if (chunk->type == CHAT__CHUNK_TYPE__DATA) {
+        if (fwrite(chunk->data.data, 1, chunk->data.len, download_file) != chunk->data.len) {
+            printf("Could not write %s!\n", download_path);
+            fclose(download_file);
+            download_file = NULL;
+        }
+        return;
+    }
+    fclose(download_file);
+    download_file = NULL;
+    if (chunk->type == CHAT__CHUNK_TYPE__END) {
+        printf("Saved %s\n", download_path);
+    } else {
+        remove(download_path);
+        printf("\n\033[0;33mWARNING!\033[0m The download of %s was not completed\n", download_path);
+    }
+}
+
 void *message_listener(void * arg){
     pthread_detach(pthread_self());
     while (is_connected){
-        char res_buffer[BUFFER_SIZE];
-        int res = recv(cli_socket_descript, res_buffer, BUFFER_SIZE, 0);
+        // A downloaded chunk carries up to ATTACHMENT_FRAME bytes of the file
+        char res_buffer[ATTACHMENT_FRAME + BUFFER_SIZE];
+        int res = recv_framed(res_buffer, sizeof(res_buffer));
         if (res < 0) {
             printf("Receive failed!\n");
             exit(EXIT_FAILURE);
@@ -102,29 +1043,89 @@ void *message_listener(void * arg){
         }
 
 
+        if (response->operation == CHAT__OPERATION__SERVER_NOTICE && response->server_notice){
+            // The server is going away, it closes the connection once we acknowledged every frame it
+            // wrote and the session is resumed on the new one
+            printf("\n\033[0;33mWARNING!\033[0m %s\n", response->message);
+            if (strlen(response->server_notice->redirect) > 0 && set_redirect(response->server_notice->redirect) == 0){
+                printf("Reconnecting to %s within %u seconds\n\n", response->server_notice->redirect, response->server_notice->deadline_seconds);
+            } else {
+                printf("Reconnecting within %u seconds\n\n", response->server_notice->deadline_seconds);
+            }
+            ack_action();
+            chat__response__free_unpacked(response, NULL);
+            continue;
+        }
+
         if (response->status_code == CHAT__STATUS_CODE__OK) {
-            if (response->operation == CHAT__OPERATION__INCOMING_MESSAGE){
-                if (response->incoming_message->type == CHAT__MESSAGE_TYPE__BROADCAST){
-                    printf("\n\033[0;35mGLOBAL\033[0m - Message from %s: %s\n\n", response->incoming_message->sender, response->incoming_message->content);
-                } else {
-                    printf("\n\033[0;34mPRIVATE\033[0m - Message from %s: %s\n\n", response->incoming_message->sender, response->incoming_message->content);
-                }
+            if (response->operation == CHAT__OPERATION__INCOMING_MESSAGE && response->incoming_message){
+                // Shown in the order of their channel, not in the order they arrive
+                Chat__IncomingMessageResponse *message = response->incoming_message;
+                order_message(message->type == CHAT__MESSAGE_TYPE__DIRECT ? CHAT__MESSAGE_TYPE__DIRECT : CHAT__MESSAGE_TYPE__BROADCAST, message->sequence, message->sender, message->content);
             } 
 
+            if (response->operation == CHAT__OPERATION__INCOMING_CHUNK && response->chunk){
+                receive_chunk(response->chunk);
+            }
+
+            if (response->operation == CHAT__OPERATION__INCOMING_ATTACHMENT && response->attachment){
+                Chat__Attachment *attachment = response->attachment;
+                printf("\n%s - %s shared %s (%llu bytes), type --get %llu to download it\n\n", attachment->type == CHAT__MESSAGE_TYPE__BROADCAST ? "\033[0;35mGLOBAL\033[0m" : "\033[0;34mPRIVATE\033[0m",
+                    attachment->sender, attachment->name, (unsigned long long) attachment->size, (unsigned long long) attachment->id);
+            }
+
+            if (response->operation == CHAT__OPERATION__DOWNLOAD_ATTACHMENT && response->chunk){
+                receive_download(response->chunk);
+            }
+
+            if (response->operation == CHAT__OPERATION__SEND_CHUNK){
+                if (response->chunk && response->chunk->attachment){
+                    printf("%s Its id is %llu\n", response->message, (unsigned long long) response->chunk->attachment->id);
+                } else if (strlen(response->message) > 0){
+                    printf("%s\n", response->message);
+                }
+            }
+
             if (response->operation == CHAT__OPERATION__SEND_MESSAGE){
+                // The number our broadcast got, the others see it there
+                if (response->incoming_message && response->incoming_message->type == CHAT__MESSAGE_TYPE__BROADCAST){
+                    order_message(CHAT__MESSAGE_TYPE__BROADCAST, response->incoming_message->sequence, NULL, NULL);
+                }
                 if (strlen(response->message) > 0){
                     printf("%s\n", response->message);
                 } 
+                // What happened for every recipient of a --to message
+                for (size_t i = 0; i < response->n_deliveries; i++){
+                    printf("\t%s: %s\n", response->deliveries[i]->username, parse_delivery_status(response->deliveries[i]->status));
+                }
             }
 
             if (response->operation == CHAT__OPERATION__UPDATE_STATUS){
+                // Back from OFFLINE, the broadcasts sent meanwhile were not for us
+                if (response->broadcast_sequence > 0){
+                    order_joined(response->broadcast_sequence);
+                }
                 if (strlen(response->message) > 0){
                     printf("%s\n", response->message);
                 } 
             }
+
+            if (response->operation == CHAT__OPERATION__SUBSCRIBE_PRESENCE && response->user_list){
+                printf("%s\n", response->message);
+                for (size_t i = 0; i < response->user_list->n_users; i++){
+                    printf("\t%s: %s\n", response->user_list->users[i]->username, parse_user_status(response->user_list->users[i]->status));
+                }
+            }
+
+            if (response->operation == CHAT__OPERATION__PRESENCE_EVENT && response->presence){
+                printf("\033[0;33mPRESENCE\033[0m - %s is now %s\n", response->presence->username, parse_user_status(response->presence->status));
+            }
             
         } else {
-            if (strlen(response->message) > 0){
+            if (response->retry_after_ms > 0){
+                // Rate limited or out of capacity, the request can be sent again later
+                printf("Error: %s (retry in %u ms)\n", response->message, response->retry_after_ms);
+            } else if (strlen(response->message) > 0){
                 printf("Error: %s\n", response->message);
             } else {
                 printf("Server disconnected!\n");
@@ -154,20 +1155,22 @@ int check_user_status(char* username){
     chat__request__pack(&request, req_buffer);
 
     // Send the request
-    int bytes_sent = send(cli_socket_descript, req_buffer, req_len, 0);
+    int bytes_sent = send_framed(req_buffer, req_len);
     if(bytes_sent<0){
         printf("Send failed!\n");
         exit(EXIT_FAILURE);
     }
 
-    char res_buffer[BUFFER_SIZE];
-    int res = recv(cli_socket_descript, res_buffer, BUFFER_SIZE, 0);
+    // Sized from the length of the response, not from BUFFER_SIZE
+    void *res_buffer;
+    int res = recv_framed_alloc(&res_buffer);
     if (res < 0) {
         printf("Receive failed!\n");
         exit(EXIT_FAILURE);
     }
 
     Chat__Response *response = chat__response__unpack(NULL, res, res_buffer);
+    free(res_buffer);
     if (response == NULL) {
         printf("Error unpacking response\n");
         exit(EXIT_FAILURE);
@@ -210,14 +1213,15 @@ char* get_all_users_action(char* username){
         chat__request__pack(&request, req_buffer);
 
         // Send the request
-        int bytes_sent = send(cli_socket_descript, req_buffer, req_len, 0);
+        int bytes_sent = send_framed(req_buffer, req_len);
         if(bytes_sent<0){
             printf("Send failed!\n");
             exit(EXIT_FAILURE);
         }
 
-        char res_buffer[BUFFER_SIZE];
-        int res = recv(cli_socket_descript, res_buffer, BUFFER_SIZE, 0);
+        // Sized from the length of the response, not from BUFFER_SIZE
+        void *res_buffer;
+        int res = recv_framed_alloc(&res_buffer);
         if (res < 0) {
             printf("Receive failed!\n");
             exit(EXIT_FAILURE);
@@ -226,6 +1230,7 @@ char* get_all_users_action(char* username){
         printf("Received!\n");
 
         Chat__Response *response = chat__response__unpack(NULL, res, res_buffer);
+        free(res_buffer);
         if (response == NULL) {
             printf("Error unpacking response\n");
             exit(EXIT_FAILURE);
@@ -265,43 +1270,128 @@ char* get_all_users_action(char* username){
         chat__request__pack(&request, req_buffer);
 
         // Send the request
-        int bytes_sent = send(cli_socket_descript, req_buffer, req_len, 0);
+        int bytes_sent = send_framed(req_buffer, req_len);
         if(bytes_sent<0){
             printf("Send failed!\n");
             exit(EXIT_FAILURE);
         }
 
-        char res_buffer[BUFFER_SIZE];
-        int res = recv(cli_socket_descript, res_buffer, BUFFER_SIZE, 0);
-        if (res < 0) {
-            printf("Receive failed!\n");
-            exit(EXIT_FAILURE);
-        }
+        // The users come in pages, read until the last one
+        int more = 1;
+        for (int page = 0; more; page++) {
+            // Sized from the length of the response, not from BUFFER_SIZE
+            void *res_buffer;
+            int res = recv_framed_alloc(&res_buffer);
+            if (res < 0) {
+                printf("Receive failed!\n");
+                exit(EXIT_FAILURE);
+            }
 
-        Chat__Response *response = chat__response__unpack(NULL, res, res_buffer);
-        if (response == NULL) {
-            printf("Error unpacking response\n");
-            exit(EXIT_FAILURE);
-        }
+            Chat__Response *response = chat__response__unpack(NULL, res, res_buffer);
+            free(res_buffer);
+            if (response == NULL) {
+                printf("Error unpacking response\n");
+                exit(EXIT_FAILURE);
+            }
 
-        if (response->status_code == CHAT__STATUS_CODE__OK) {
-            printf("\nMessage: %s\n", response->message);
-            for (int i = 0; i < response->user_list->n_users; i++){
-                printf("\n");
-                printf("Username: %s\n", response->user_list->users[i]->username);
-                printf("Status: %s\n", parse_user_status(response->user_list->users[i]->status));
+            if (response->status_code == CHAT__STATUS_CODE__OK && response->user_list) {
+                if (page == 0) {
+                    printf("\nMessage: %s\n", response->message);
+                }
+                for (int i = 0; i < response->user_list->n_users; i++){
+                    printf("\n");
+                    printf("Username: %s\n", response->user_list->users[i]->username);
+                    printf("Status: %s\n", parse_user_status(response->user_list->users[i]->status));
+                }
+                more = response->user_list->more;
+            } else {
+                printf("Error: %s\n", response->message);
+                exit(EXIT_FAILURE);
             }
-        } else {
-            printf("Error: %s\n", response->message);
-            exit(EXIT_FAILURE);
+            chat__response__free_unpacked(response, NULL);
         }
     }
     return "";
 }
 
+/*
+* Lookup users action function
+* @param query: names separated by commas, or the start of a name followed by '*'
+* @return: void
+* This function will be used to get several users in one request or the users whose name starts the same
+*/
+void lookup_users_action(char* query){
+    Chat__UserListRequest user_list_request = CHAT__USER_LIST_REQUEST__INIT;
+    size_t len = strlen(query);
+    size_t count = 1;
+    for (char *comma = strchr(query, ','); comma; comma = strchr(comma + 1, ',')){
+        count++;
+    }
+    char *usernames[count];
+    if (len > 0 && query[len - 1] == '*'){
+        query[len - 1] = 0;
+        user_list_request.prefix = query;
+        // As many as fit in one response buffer
+        user_list_request.limit = LOOKUP_RESULTS;
+    } else {
+        char *saveptr;
+        for (char *name = strtok_r(query, ",", &saveptr); name; name = strtok_r(NULL, ",", &saveptr)){
+            usernames[user_list_request.n_usernames++] = name;
+        }
+        user_list_request.usernames = usernames;
+    }
+
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__GET_USERS;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_GET_USERS;
+    request.get_users = &user_list_request;
+
+    // Serialize the request
+    size_t req_len = chat__request__get_packed_size(&request);
+    void *req_buffer = malloc(req_len);
+    if (req_buffer == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    chat__request__pack(&request, req_buffer);
+
+    // Send the request
+    int bytes_sent = send_framed(req_buffer, req_len);
+    if(bytes_sent<0){
+        printf("Send failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char res_buffer[BUFFER_SIZE];
+    int res = recv_framed(res_buffer, BUFFER_SIZE);
+    if (res < 0) {
+        printf("Receive failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    Chat__Response *response = chat__response__unpack(NULL, res, res_buffer);
+    if (response == NULL) {
+        printf("Error unpacking response\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (response->status_code == CHAT__STATUS_CODE__OK) {
+        printf("\nMessage: %s\n", response->message);
+        for (int i = 0; i < response->user_list->n_users; i++){
+            printf("\n");
+            printf("Username: %s\n", response->user_list->users[i]->username);
+            printf("Status: %s\n", parse_user_status(response->user_list->users[i]->status));
+        }
+    } else {
+        printf("Error: %s\n", response->message);
+    }
+    chat__response__free_unpacked(response, NULL);
+}
+
 void send_message_action(char* message){
     Chat__SendMessageRequest send_message_request = CHAT__SEND_MESSAGE_REQUEST__INIT;
     send_message_request.content = message;
+    send_message_request.message_id = ++last_message_id;
     if (channel == CHAT__MESSAGE_TYPE__BROADCAST){
         send_message_request.recipient = "";
     } else {
@@ -324,7 +1414,234 @@ void send_message_action(char* message){
     chat__request__pack(&request, req_buffer);
 
     // Send the request
-    int bytes_sent = send(cli_socket_descript, req_buffer, req_len, 0);
+    int bytes_sent = send_framed(req_buffer, req_len);
+    if(bytes_sent<0){
+        printf("Send failed!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+* Send multi action function
+* @param line: the recipients separated by commas, a space and the message
+* @return: void
+* This function will be used for --to, the message goes to every recipient in one request
+*/
+void send_multi_action(char* line){
+    char *message = strchr(line, ' ');
+    if (message == NULL || strlen(message + 1) == 0){
+        printf("Usage: --to <user>,<user>... <message>\n");
+        return;
+    }
+    *message++ = 0;
+    size_t count = 1;
+    for (char *comma = strchr(line, ','); comma; comma = strchr(comma + 1, ',')){
+        count++;
+    }
+    char *recipients[count];
+    size_t n_recipients = 0;
+    char *saveptr;
+    for (char *name = strtok_r(line, ",", &saveptr); name; name = strtok_r(NULL, ",", &saveptr)){
+        recipients[n_recipients++] = name;
+    }
+
+    Chat__SendMessageRequest send_message_request = CHAT__SEND_MESSAGE_REQUEST__INIT;
+    send_message_request.content = message;
+    send_message_request.message_id = ++last_message_id;
+    send_message_request.recipient = "";
+    send_message_request.n_recipients = n_recipients;
+    send_message_request.recipients = recipients;
+
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__SEND_MESSAGE;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_SEND_MESSAGE;
+    request.send_message = &send_message_request;
+
+    // Serialize the request
+    size_t req_len = chat__request__get_packed_size(&request);
+    void *req_buffer = malloc(req_len);
+    if (req_buffer == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    chat__request__pack(&request, req_buffer);
+
+    // Send the request
+    int bytes_sent = send_framed(req_buffer, req_len);
+    if(bytes_sent<0){
+        printf("Send failed!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+* Watch action function
+* @param line: usernames separated by commas
+* @param unsubscribe: stop following them instead
+* @return: void
+* This function will be used for --watch and --unwatch, the server pushes the status changes of the users we follow
+*/
+void watch_action(char* line, int unsubscribe){
+    size_t count = 1;
+    for (char *comma = strchr(line, ','); comma; comma = strchr(comma + 1, ',')){
+        count++;
+    }
+    char *names[count];
+    size_t n_names = 0;
+    char *saveptr;
+    pthread_mutex_lock(&watched_lock);
+    for (char *name = strtok_r(line, ",", &saveptr); name; name = strtok_r(NULL, ",", &saveptr)){
+        if (strlen(name) >= MAX_USERNAME_LENGTH){
+            continue;
+        }
+        names[n_names++] = name;
+        int at = -1;
+        for (int i = 0; i < watched_count && at < 0; i++){
+            if (strcmp(watched[i], name) == 0){
+                at = i;
+            }
+        }
+        if (unsubscribe && at >= 0){
+            strcpy(watched[at], watched[--watched_count]);
+        } else if (!unsubscribe && at < 0 && watched_count < WATCHED_USERS){
+            strcpy(watched[watched_count++], name);
+        }
+    }
+    pthread_mutex_unlock(&watched_lock);
+
+    size_t req_len;
+    void *req_buffer = presence_request(names, n_names, unsubscribe, &req_len);
+    if (req_buffer == NULL){
+        printf("Usage: --%s <user>,<user>...\n", unsubscribe ? "unwatch" : "watch");
+        return;
+    }
+
+    // Send the request
+    int bytes_sent = send_framed(req_buffer, req_len);
+    free(req_buffer);
+    if(bytes_sent<0){
+        printf("Send failed!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+* Send chunk action function
+* @param id: the message id of the stream
+* @param type: what the chunk does
+* @param data: the content of a DATA chunk, NULL for none
+* @param len: the size of the content
+* @param filename: for BEGIN, the name of a file to upload as an attachment, NULL to stream a message
+* @return: void
+*/
+void send_chunk_action(uint32_t id, Chat__ChunkType type, char *data, size_t len, char *filename){
+    Chat__MessageChunk chunk = CHAT__MESSAGE_CHUNK__INIT;
+    chunk.message_id = id;
+    chunk.type = type;
+    chunk.data.data = (uint8_t *) data;
+    chunk.data.len = len;
+    if (type == CHAT__CHUNK_TYPE__BEGIN && channel == CHAT__MESSAGE_TYPE__DIRECT){
+        chunk.recipient = current_chat;
+    }
+    if (filename){
+        chunk.filename = filename;
+    }
+
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__SEND_CHUNK;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_SEND_CHUNK;
+    request.send_chunk = &chunk;
+
+    // Serialize the request
+    size_t req_len = chat__request__get_packed_size(&request);
+    void *req_buffer = malloc(req_len);
+    if (req_buffer == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    chat__request__pack(&request, req_buffer);
+
+    // Send the request
+    int bytes_sent = send_framed(req_buffer, req_len);
+    free(req_buffer);
+    if(bytes_sent<0){
+        printf("Send failed!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+* Send stream action function
+* @param message: a message longer than MAX_MESSAGE_LENGTH
+* @return: void
+* This function will be used to send a long message in chunks, the server relays them as they come
+*/
+void send_stream_action(char* message){
+    uint32_t id = ++last_stream_id;
+    size_t len = strlen(message);
+    send_chunk_action(id, CHAT__CHUNK_TYPE__BEGIN, NULL, 0, NULL);
+    for (size_t offset = 0; offset < len; offset += STREAM_CHUNK_SIZE){
+        send_chunk_action(id, CHAT__CHUNK_TYPE__DATA, message + offset, len - offset < STREAM_CHUNK_SIZE ? len - offset : STREAM_CHUNK_SIZE, NULL);
+    }
+    send_chunk_action(id, CHAT__CHUNK_TYPE__END, NULL, 0, NULL);
+}
+
+/*
+* Send file action function
+* @param path: the file to share with the current channel
+* @return: void
+* This function will be used for --send, the file is uploaded in chunks and the server keeps it as an attachment
+*/
+void send_file_action(char* path){
+    FILE *file = fopen(path, "rb");
+    if (file == NULL){
+        printf("Could not open %s!\n", path);
+        return;
+    }
+    char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    uint32_t id = ++last_stream_id;
+    send_chunk_action(id, CHAT__CHUNK_TYPE__BEGIN, NULL, 0, name);
+    char data[STREAM_CHUNK_SIZE];
+    size_t len;
+    while ((len = fread(data, 1, sizeof(data), file)) > 0){
+        send_chunk_action(id, CHAT__CHUNK_TYPE__DATA, data, len, NULL);
+    }
+    send_chunk_action(id, ferror(file) ? CHAT__CHUNK_TYPE__ABORT : CHAT__CHUNK_TYPE__END, NULL, 0, NULL);
+    fclose(file);
+}
+
+/*
+* Download action function
+* @param id: the id of an attachment shared with the user
+* @return: void
+* This function will be used for --get, the listener writes the content to a file as it comes
+*/
+void download_action(uint64_t id){
+    Chat__DownloadRequest download_request = CHAT__DOWNLOAD_REQUEST__INIT;
+    download_request.attachment_id = id;
+    download_request.message_id = ++last_stream_id;
+
+    Chat__Request request = CHAT__REQUEST__INIT;
+    request.operation = CHAT__OPERATION__DOWNLOAD_ATTACHMENT;
+    request.payload_case = CHAT__REQUEST__PAYLOAD_DOWNLOAD_ATTACHMENT;
+    request.download_attachment = &download_request;
+
+    // Serialize the request
+    size_t req_len = chat__request__get_packed_size(&request);
+    void *req_buffer = malloc(req_len);
+    if (req_buffer == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    chat__request__pack(&request, req_buffer);
+
+    // Send the request
+    int bytes_sent = send_framed(req_buffer, req_len);
+    free(req_buffer);
     if(bytes_sent<0){
         printf("Send failed!\n");
         exit(EXIT_FAILURE);
@@ -352,7 +1669,7 @@ void change_status_action (Chat__UserStatus status){
     chat__request__pack(&request, req_buffer);
 
     // Send the request
-    int bytes_sent = send(cli_socket_descript, req_buffer, req_len, 0);
+    int bytes_sent = send_framed(req_buffer, req_len);
     if(bytes_sent<0){
         printf("Send failed!\n");
         exit(EXIT_FAILURE);
@@ -361,7 +1678,7 @@ void change_status_action (Chat__UserStatus status){
     cli_status = status;
 
     char res_buffer[BUFFER_SIZE];
-    int res = recv(cli_socket_descript, res_buffer, BUFFER_SIZE, 0);
+    int res = recv_framed(res_buffer, BUFFER_SIZE);
     if (res < 0) {
         printf("Receive failed!\n");
         exit(EXIT_FAILURE);
@@ -375,6 +1692,9 @@ void change_status_action (Chat__UserStatus status){
 
     if (response->status_code == CHAT__STATUS_CODE__OK) {
         printf("Message: %s\n", response->message);
+        if (response->broadcast_sequence > 0) {
+            order_joined(response->broadcast_sequence);
+        }
     } else {
         printf("Error: %s\n", response->message);
         exit(EXIT_FAILURE);
@@ -402,7 +1722,7 @@ void client_disconnect_action() {
     chat__request__pack(&request, req_buffer);
 
     // Send the request
-    int bytes_sent = send(cli_socket_descript, req_buffer, req_len, 0);
+    int bytes_sent = send_framed(req_buffer, req_len);
     if(bytes_sent<0){
         printf("Send failed!\n");
         exit(EXIT_FAILURE);
@@ -474,6 +1794,11 @@ int main(int argc, char *argv[]){
 
     signal(SIGINT, exit_service);
 
+    // The server remembers the ids of our messages for a while, a new run must not reuse them
+    struct timespec started;
+    clock_gettime(CLOCK_REALTIME, &started);
+    last_message_id = ((uint64_t) started.tv_sec << 32 ^ (uint64_t) started.tv_nsec << 8 ^ (uint64_t) getpid()) & ~0xffffffull;
+
     cli_socket_descript = socket(AF_INET, SOCK_STREAM, 0);
     if (cli_socket_descript == -1) {
         printf("Socket creation failed!\n");
@@ -495,6 +1820,7 @@ int main(int argc, char *argv[]){
     srv_address.sin_family = AF_INET;
     srv_address.sin_port = htons(port);
     srv_address.sin_addr.s_addr = inet_addr(ip);
+    server_address = srv_address;
 
     // Connect to the server
     if (connect(cli_socket_descript, (struct sockaddr *) &srv_address, srv_addr_len) == -1) {
@@ -508,8 +1834,13 @@ int main(int argc, char *argv[]){
         printf("Your IP address is %s and your port is %d\n", inet_ntoa(cli_address.sin_addr), ntohs(cli_address.sin_port));
         is_connected = 1;
     }
+    tune_socket(cli_socket_descript);
 
     create_user_action();
+    pthread_t heartbeat_thread;
+    if (pthread_create(&heartbeat_thread, NULL, heartbeat, NULL) == 0) {
+        pthread_detach(heartbeat_thread);
+    }
 
     // Main loop
     while (is_connected){
@@ -531,29 +1862,55 @@ int main(int argc, char *argv[]){
 
         switch (option){
             case 1:
+                order_reset();
                 change_status_action(CHAT__USER_STATUS__ONLINE);
                 printf("Welcome to the chatroom! Your status is now \033[0;32mONLINE\033[0m\n");
                 printf("You are sending messages to the %s channel\n", channel == CHAT__MESSAGE_TYPE__BROADCAST ? "\033[0;35mGLOBAL\033[0m" : "\033[0;34mPRIVATE\033[0m");
                 printf("You can leave the chatroom by typing '--exit'\n");
+                printf("Share a file with '--send <path>' and download one with '--get <id>'\n");
+                printf("Send a private message to several users with '--to <user>,<user> <message>'\n");
+                printf("Follow the status of users with '--watch <user>,<user>' and stop with '--unwatch'\n");
                 pthread_t listener_thread;
                 pthread_create(&listener_thread, NULL, message_listener, NULL);
                 if (pthread_detach(listener_thread) != 0) {
                     printf("Thread creation failed!\n");
                     continue;
                 }
+                // The server pushes nothing while we are away, the answer has the statuses we missed
+                size_t watch_len;
+                void *watch_buffer = presence_request(NULL, 0, 0, &watch_len);
+                if (watch_buffer){
+                    send_framed(watch_buffer, watch_len);
+                    free(watch_buffer);
+                }
                 printf("Type your messages:\n");
-                char message[MAX_MESSAGE_LENGTH];
-                while (fgets(message, MAX_MESSAGE_LENGTH, stdin)) {
+                // A line of any length is one message, a long one is streamed in chunks
+                char *message = NULL;
+                size_t message_size = 0;
+                while (getline(&message, &message_size, stdin) != -1) {
                     
                     message[strcspn(message, "\n")] = 0;
                     if (strcmp(message, "--exit") == 0){
                         break;
                     }
-                    if (strlen(message) > 0){
+                    if (strncmp(message, "--to ", 5) == 0){
+                        send_multi_action(message + 5);
+                    } else if (strncmp(message, "--watch ", 8) == 0){
+                        watch_action(message + 8, 0);
+                    } else if (strncmp(message, "--unwatch ", 10) == 0){
+                        watch_action(message + 10, 1);
+                    } else if (strncmp(message, "--send ", 7) == 0){
+                        send_file_action(message + 7);
+                    } else if (strncmp(message, "--get ", 6) == 0){
+                        download_action(strtoull(message + 6, NULL, 10));
+                    } else if (strlen(message) > MAX_MESSAGE_LENGTH){
+                        send_stream_action(message);
+                    } else if (strlen(message) > 0){
                         send_message_action(message);
                     }
                     
                 }
+                free(message);
                 printf("Leaving chatroom...\n");
                 change_status_action(CHAT__USER_STATUS__OFFLINE);
                 printf("Your status is now \033[0;31mOFFLINE\033[0m\n");
@@ -566,13 +1923,18 @@ int main(int argc, char *argv[]){
                 printf("\tSelect option 1 from the main menu.\n ");
                 printf("\tAutomatically, your status will be changed to 'Online'.\n");
                 printf("\tYou can start sending messages to the active channel (Global or Private).\n");
+                printf("\tTo share a file with the channel, type --send followed by its path. The others get its id.\n");
+                printf("\tTo download a file shared with you, type --get followed by its id.\n");
+                printf("\tTo send a private message to several users at once, type --to, their names separated by commas and the message.\n");
+                printf("\tTo be told when users come, go or change their status, type --watch and their names separated by commas, --unwatch to stop.\n");
                 printf("\tTo exit the chat and return to the main menu, type --exit.\n\n");
                 printf("\n3. List Users\n\n");
                 printf("Description: Displays a list of all online users or allows you to search for a specific user\n");
                 printf("How to use it:\n");
                 printf("\tYou will be asked if you want to see all users or search for a specific user:\n");
                 printf("\t\tIf you choose to view all, a list of user names and statuses will be displayed.\n");
-                printf("\t\tIf you choose to search for a specific user, you will need to enter the name of the desired user.\n\n");
+                printf("\t\tIf you choose to search for a specific user, you will need to enter the name of the desired user.\n");
+                printf("\t\tSeveral names separated by commas are looked up at once, and a name ending with '*' lists the users whose name starts that way.\n\n");
                 printf("\n4. Change Channel\n\n");
                 printf("Description: Allows you to switch between the global channel or start a private chat with another user.\n");
                 printf("How to use it:\n");
@@ -605,10 +1967,14 @@ int main(int argc, char *argv[]){
                 if (answer == 'y'){
                     get_all_users_action("");
                 } else {
-                    printf("Type the username if you want to get an specific user\n");
-                    char username[MAX_USERNAME_LENGTH];
-                    scanf("%s", username);
-                    get_all_users_action(username);
+                    printf("Type the username if you want to get an specific user, several separated by commas, or the start of a name followed by '*'\n");
+                    char query[1024];
+                    scanf("%1023s", query);
+                    if (strchr(query, ',') || query[strlen(query) - 1] == '*'){
+                        lookup_users_action(query);
+                    } else {
+                        get_all_users_action(query);
+                    }
                 }
                 break;
             case 4:
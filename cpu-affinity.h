@@ -0,0 +1,108 @@
+#ifndef CAFFINITY
+#define CAFFINITY
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/*
+* CPU affinity
+* CPU lists use the same text as taskset -c, like "0-3,8,10-11", an empty list leaves the thread
+* where the scheduler puts it. A pinned thread allocates its own buffers after it is pinned, so the
+* kernel places their pages on the NUMA node of that CPU the first time they are touched.
+*/
+
+/*
+* CPU list parse function
+* @param text: the CPU list
+* @param set: where to store the CPUs
+* @return: the number of CPUs in the list, -1 if it is invalid
+*/
+int cpu_list_parse(const char *text, cpu_set_t *set) {
+    CPU_ZERO(set);
+    const char *cursor = text;
+    while (*cursor) {
+        char *end;
+        long first = strtol(cursor, &end, 10);
+        long last = first;
+        if (end == cursor) {
+            return -1;
+        }
+        if (*end == '-') {
+            cursor = end + 1;
+            last = strtol(cursor, &end, 10);
+            if (end == cursor) {
+                return -1;
+            }
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, set);
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return -1;
+        }
+        cursor = end;
+    }
+    return CPU_COUNT(set);
+}
+
+/*
+* CPU list nth function
+* @param set: the CPUs of a list
+* @param index: the index of the thread
+* @return: the CPU of the thread, the threads wrap around the list, -1 if the list is empty
+* This function will be used to give every thread of a group its own CPU of the list
+*/
+int cpu_list_nth(const cpu_set_t *set, int index) {
+    int count = CPU_COUNT(set);
+    if (count == 0) {
+        return -1;
+    }
+    index %= count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, set) && index-- == 0) {
+            return cpu;
+        }
+    }
+    return -1;
+}
+
+/*
+* Pin thread function
+* @param cpu: the CPU for the calling thread, -1 to leave it unpinned
+* @return: 0 if successful, -1 if failed
+*/
+int pin_thread(int cpu) {
+    if (cpu < 0) {
+        return 0;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+/*
+* Current placement function
+* @param cpu: where to store the CPU the calling thread runs on
+* @param node: where to store the NUMA node of that CPU
+* @return: void
+*/
+void current_placement(int *cpu, int *node) {
+    unsigned int current_cpu = 0, current_node = 0;
+    if (syscall(SYS_getcpu, &current_cpu, &current_node, NULL) == -1) {
+        *cpu = *node = -1;
+        return;
+    }
+    *cpu = current_cpu;
+    *node = current_node;
+}
+
+#endif
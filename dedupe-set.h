@@ -0,0 +1,371 @@
+#ifndef DEDUPE
+#define DEDUPE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "env.h"
+
+/*
+* Dedupe set
+* Remembers the messages every sender sent with an id, so a retry of one is answered with what it
+* got the first time instead of being sent again. A message is a 64-bit key, the hash of the sender
+* and its id, and its result, 16 bytes in an open addressing table kept at most half full. The
+* senders are spread over DEDUPE_SHARDS shards by the hash of their name, each with its own lock.
+* A shard has DEDUPE_GENERATIONS tables for consecutive spans of time: messages go to the newest
+* one and when a span ends the oldest table is emptied and becomes the newest, so a message is
+* remembered for the window and up to one span more, and nothing is removed one by one. A message
+* is remembered as pending from the moment it is checked, so a retry that comes while it is going out
+* is not sent too, and forgotten if it is refused.
+*/
+typedef struct dedupe_entry {
+    // 0 for an empty slot
+    uint64_t key;
+    // The number the message got, shifted left by 2, and its DEDUPE_* outcome in the low bits
+    uint64_t result;
+} DedupeEntry;
+
+typedef struct dedupe_table {
+    DedupeEntry *slots;
+    uint32_t mask;
+    uint32_t used;
+} DedupeTable;
+
+typedef struct dedupe_shard {
+    pthread_mutex_t lock;
+    DedupeTable tables[DEDUPE_GENERATIONS];
+    // Table messages go to and when its span started
+    int current;
+    time_t started;
+} DedupeShard;
+
+typedef struct dedupe_set {
+    DedupeShard shards[DEDUPE_SHARDS];
+} DedupeSet;
+
+// What a remembered message did, replayed to a retry
+enum {
+    DEDUPE_BROADCAST,
+    DEDUPE_DIRECT,
+    // Direct message to a busy recipient, the sender was warned
+    DEDUPE_BUSY,
+    // Direct message to several recipients, only that it went out is kept
+    DEDUPE_MULTI
+};
+
+// Result of a message that is still going out, a retry meanwhile is not sent again either
+#define DEDUPE_PENDING UINT64_MAX
+
+/*
+* Dedupe init function
+* @param set: the set
+* @return: void
+*/
+void dedupe_init(DedupeSet *set) {
+    memset(set, 0, sizeof(DedupeSet));
+    for (int i = 0; i < DEDUPE_SHARDS; i++) {
+        pthread_mutex_init(&set->shards[i].lock, NULL);
+        set->shards[i].started = time(NULL);
+    }
+}
+
+/*
+* Dedupe sender hash function
+* @param sender: the username
+* @return: the 64-bit hash of the name
+*/
+uint64_t dedupe_sender_hash(const char *sender) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    while (*sender) {
+        hash = (hash ^ (unsigned char) *sender++) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/*
+* Dedupe key function
+* @param sender_hash: the hash of the sender
+* @param id: the id the sender gave the message
+* @return: the key of the message, never 0
+*/
+uint64_t dedupe_key(uint64_t sender_hash, uint64_t id) {
+    // splitmix64 finalizer, so ids that only differ in a few bits land far apart
+    uint64_t key = sender_hash ^ (id + 0x9e3779b97f4a7c15ull);
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ull;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebull;
+    key ^= key >> 31;
+    return key ? key : 1;
+}
+
+/*
+* Dedupe rotate function
+* @param shard: the shard, the caller holds its lock
+* @param window: seconds a message is remembered
+* @param now: the current time
+* @return: void
+* This function will be used to empty the tables whose span is over before the shard is used
+*/
+void dedupe_rotate(DedupeShard *shard, int window, time_t now) {
+    // The other tables cover the window, the newest one fills during one more span
+    time_t span = (window + DEDUPE_GENERATIONS - 2) / (DEDUPE_GENERATIONS - 1);
+    span = span > 0 ? span : 1;
+    time_t steps = (now - shard->started) / span;
+    if (steps <= 0) {
+        return;
+    }
+    for (time_t i = 0; i < steps && i < DEDUPE_GENERATIONS; i++) {
+        shard->current = (shard->current + 1) % DEDUPE_GENERATIONS;
+        DedupeTable *table = &shard->tables[shard->current];
+        // An emptied table gives its memory back, a shard whose senders left costs nothing
+        free(table->slots);
+        table->slots = NULL;
+        table->mask = 0;
+        table->used = 0;
+    }
+    shard->started = steps < DEDUPE_GENERATIONS ? shard->started + steps * span : now;
+}
+
+/*
+* Dedupe table find function
+* @param table: the table, it has slots
+* @param key: the key
+* @return: the slot of the key or the empty slot where it goes
+*/
+DedupeEntry *dedupe_table_find(DedupeTable *table, uint64_t key) {
+    uint32_t index = (uint32_t) key & table->mask;
+    while (table->slots[index].key != 0 && table->slots[index].key != key) {
+        index = (index + 1) & table->mask;
+    }
+    return &table->slots[index];
+}
+
+/*
+* Dedupe table grow function
+* @param table: the table
+* @return: 0 if successful, -1 if failed
+*/
+int dedupe_table_grow(DedupeTable *table) {
+    uint32_t size = table->slots ? (table->mask + 1) * 2 : DEDUPE_INITIAL_SLOTS;
+    DedupeEntry *slots = (DedupeEntry *) calloc(size, sizeof(DedupeEntry));
+    if (slots == NULL) {
+        return -1;
+    }
+    DedupeTable grown = {slots, size - 1, table->used};
+    for (uint32_t i = 0; table->slots && i <= table->mask; i++) {
+        if (table->slots[i].key != 0) {
+            *dedupe_table_find(&grown, table->slots[i].key) = table->slots[i];
+        }
+    }
+    free(table->slots);
+    *table = grown;
+    return 0;
+}
+
+/*
+* Dedupe table put function
+* @param table: the table
+* @param key: the key of the message
+* @param result: its result
+* @return: 0 if successful, -1 if the table could not grow and the message is not remembered
+*/
+int dedupe_table_put(DedupeTable *table, uint64_t key, uint64_t result) {
+    if ((table->used + 1) * 2 > (table->slots ? table->mask + 1 : 0) && dedupe_table_grow(table) < 0) {
+        return -1;
+    }
+    DedupeEntry *entry = dedupe_table_find(table, key);
+    if (entry->key == 0) {
+        table->used++;
+    }
+    entry->key = key;
+    entry->result = result;
+    return 0;
+}
+
+/*
+* Dedupe table remove function
+* @param table: the table
+* @param entry: a slot in use
+* @return: void
+* This function will be used to forget a message, the entries after it move back so no search stops early
+*/
+void dedupe_table_remove(DedupeTable *table, DedupeEntry *entry) {
+    uint32_t hole = (uint32_t) (entry - table->slots);
+    for (uint32_t index = (hole + 1) & table->mask; table->slots[index].key != 0; index = (index + 1) & table->mask) {
+        // An entry may only move back if the hole is between its own slot and where it is
+        uint32_t home = (uint32_t) table->slots[index].key & table->mask;
+        if (((index - home) & table->mask) >= ((index - hole) & table->mask)) {
+            table->slots[hole] = table->slots[index];
+            hole = index;
+        }
+    }
+    table->slots[hole].key = 0;
+    table->slots[hole].result = 0;
+    table->used--;
+}
+
+/*
+* Dedupe shard find function
+* @param shard: the shard, the caller holds its lock
+* @param key: the key of the message
+* @return: its entry, NULL if the message is not remembered
+*/
+DedupeEntry *dedupe_shard_find(DedupeShard *shard, uint64_t key) {
+    for (int i = 0; i < DEDUPE_GENERATIONS; i++) {
+        DedupeTable *table = &shard->tables[i];
+        if (table->used > 0) {
+            DedupeEntry *entry = dedupe_table_find(table, key);
+            if (entry->key == key) {
+                return entry;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+* Dedupe claim function
+* @param set: the set
+* @param sender: the username of the sender
+* @param id: the id the sender gave the message
+* @param window: seconds a message is remembered
+* @param result: where the result of the message is written, DEDUPE_PENDING while it is going out
+* @return: 1 if the sender already sent the message, 0 if not and it is now remembered as pending
+* This function will be used before a message goes out, a retry that comes before the first one is
+* done finds it all the same. The caller settles it with dedupe_add or dedupe_forget
+*/
+int dedupe_claim(DedupeSet *set, const char *sender, uint64_t id, int window, uint64_t *result) {
+    uint64_t hash = dedupe_sender_hash(sender);
+    uint64_t key = dedupe_key(hash, id);
+    DedupeShard *shard = &set->shards[hash % DEDUPE_SHARDS];
+    pthread_mutex_lock(&shard->lock);
+    dedupe_rotate(shard, window, time(NULL));
+    DedupeEntry *entry = dedupe_shard_find(shard, key);
+    if (entry) {
+        *result = entry->result;
+    } else {
+        // Without memory the message is not remembered, a retry is sent again as before
+        dedupe_table_put(&shard->tables[shard->current], key, DEDUPE_PENDING);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return entry != NULL;
+}
+
+/*
+* Dedupe add function
+* @param set: the set
+* @param sender: the username of the sender
+* @param id: the id the sender gave the message
+* @param window: seconds a message is remembered
+* @param result: the result of the message
+* @return: 0 if successful, -1 if the table could not grow and the message is not remembered
+* This function will be used once a claimed message went out, its pending entry gets the result
+*/
+int dedupe_add(DedupeSet *set, const char *sender, uint64_t id, int window, uint64_t result) {
+    uint64_t hash = dedupe_sender_hash(sender);
+    uint64_t key = dedupe_key(hash, id);
+    DedupeShard *shard = &set->shards[hash % DEDUPE_SHARDS];
+    int status = 0;
+    pthread_mutex_lock(&shard->lock);
+    dedupe_rotate(shard, window, time(NULL));
+    DedupeEntry *entry = dedupe_shard_find(shard, key);
+    if (entry) {
+        entry->result = result;
+    } else {
+        status = dedupe_table_put(&shard->tables[shard->current], key, result);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return status;
+}
+
+/*
+* Dedupe forget function
+* @param set: the set
+* @param sender: the username of the sender
+* @param id: the id the sender gave the message
+* @return: void
+* This function will be used when a claimed message was refused, a retry is handled like a new message
+*/
+void dedupe_forget(DedupeSet *set, const char *sender, uint64_t id) {
+    uint64_t hash = dedupe_sender_hash(sender);
+    uint64_t key = dedupe_key(hash, id);
+    DedupeShard *shard = &set->shards[hash % DEDUPE_SHARDS];
+    pthread_mutex_lock(&shard->lock);
+    for (int i = 0; i < DEDUPE_GENERATIONS; i++) {
+        DedupeTable *table = &shard->tables[i];
+        if (table->used > 0) {
+            DedupeEntry *entry = dedupe_table_find(table, key);
+            if (entry->key == key) {
+                dedupe_table_remove(table, entry);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/*
+* Dedupe restore function
+* @param set: the set
+* @param shard: the shard the messages were in
+* @param generation: how many tables back from the newest one they were
+* @param entries: the messages
+* @param count: how many
+* @param age: seconds since the span of the newest table started
+* @return: 0 if successful, -1 if a table could not grow
+* This function will be used by a new server taking the clients over (hot restart), every message is
+* remembered as long as it would have been by the old one
+*/
+int dedupe_restore(DedupeSet *set, uint32_t shard, uint32_t generation, DedupeEntry *entries, uint32_t count, time_t age) {
+    DedupeShard *restored = &set->shards[shard % DEDUPE_SHARDS];
+    int status = 0;
+    pthread_mutex_lock(&restored->lock);
+    restored->started = time(NULL) - age;
+    DedupeTable *table = &restored->tables[(restored->current + DEDUPE_GENERATIONS - generation % DEDUPE_GENERATIONS) % DEDUPE_GENERATIONS];
+    for (uint32_t i = 0; i < count && status == 0; i++) {
+        status = dedupe_table_put(table, entries[i].key, entries[i].result);
+    }
+    pthread_mutex_unlock(&restored->lock);
+    return status;
+}
+
+/*
+* Dedupe sweep function
+* @param set: the set
+* @param window: seconds a message is remembered
+* @return: void
+* This function will be used by the main thread, so the shards nobody sends to give their memory back
+*/
+void dedupe_sweep(DedupeSet *set, int window) {
+    time_t now = time(NULL);
+    for (int i = 0; i < DEDUPE_SHARDS; i++) {
+        pthread_mutex_lock(&set->shards[i].lock);
+        dedupe_rotate(&set->shards[i], window, now);
+        pthread_mutex_unlock(&set->shards[i].lock);
+    }
+}
+
+/*
+* Dedupe count function
+* @param set: the set
+* @param bytes: where the bytes of the tables are written
+* @return: the number of messages remembered
+*/
+unsigned long dedupe_count(DedupeSet *set, size_t *bytes) {
+    unsigned long count = 0;
+    *bytes = 0;
+    for (int i = 0; i < DEDUPE_SHARDS; i++) {
+        pthread_mutex_lock(&set->shards[i].lock);
+        for (int j = 0; j < DEDUPE_GENERATIONS; j++) {
+            DedupeTable *table = &set->shards[i].tables[j];
+            count += table->used;
+            *bytes += table->slots ? (table->mask + 1) * sizeof(DedupeEntry) : 0;
+        }
+        pthread_mutex_unlock(&set->shards[i].lock);
+    }
+    return count;
+}
+
+#endif
@@ -5,6 +5,91 @@
 #define MAX_USERNAME_LENGTH 50
 #define MAX_MESSAGE_LENGTH 256
 #define BUFFER_SIZE 4096
-#define MAX_USERS 10
+#define DEFAULT_MAX_USERS 100000
+#define INITIAL_USER_SLOTS 1024
+#define RECV_POOL_CACHED 64
+#define NODE_STASH 64
+#define MAX_EVENTS 256
+#define DEFAULT_QUEUE_LIMIT (1024 * 1024)
+#define DEFAULT_CONFIG_PATH "server.conf"
+#define DEFAULT_DRAIN_TIMEOUT 10
+#define DEFAULT_IO_THREADS 2
+#define DEFAULT_WORKER_THREADS 4
+#define DEFAULT_RING_SIZE 4096
+#define DEFAULT_MEMORY_LIMIT_MB 1024
+#define DEFAULT_MAX_PER_IP 256
+#define DEFAULT_MAX_HANDSHAKES 1024
+#define DEFAULT_SHED_DEPTH 1024
+#define DEFAULT_RETRY_AFTER_MS 1000
+#define INITIAL_IP_SLOTS 1024
+#define DEFAULT_REGISTER_RATE 1
+#define DEFAULT_REGISTER_BURST 5
+#define DEFAULT_DIRECT_RATE 20
+#define DEFAULT_DIRECT_BURST 40
+#define DEFAULT_BROADCAST_RATE 2
+#define DEFAULT_BROADCAST_BURST 10
+#define DEFAULT_STATUS_RATE 5
+#define DEFAULT_STATUS_BURST 10
+#define DEFAULT_USERS_RATE 5
+#define DEFAULT_USERS_BURST 10
+#define DEFAULT_DOWNLOAD_RATE 2
+#define DEFAULT_DOWNLOAD_BURST 10
+#define TOP_CLIENTS_SHOWN 5
+#define CONTROL_BURST 16
+#define DEFAULT_READ_QUANTUM 4096
+#define DEFAULT_ZEROCOPY_THRESHOLD 0
+#define ZEROCOPY_LINGER 10
+#define LINGER_CHECK_MS 100
+#define DEFAULT_STREAM_LENGTH (16 * 1024 * 1024)
+#define MAX_STREAMS 4
+#define STREAM_CHUNK_SIZE 2048
+#define INCOMING_STREAMS 16
+#define DEFAULT_SPOOL_DIR "spool"
+#define SPOOL_DIR_LENGTH 128
+#define ATTACHMENT_NAME_LENGTH 128
+#define DEFAULT_ATTACHMENT_LENGTH (64 * 1024 * 1024)
+#define DEFAULT_SPOOL_LIMIT_MB 1024
+#define DEFAULT_ATTACHMENT_TTL 86400
+#define ATTACHMENT_FRAME (64 * 1024)
+#define SPOOL_SWEEP_INTERVAL 60
+#define DEFAULT_RETRANSMIT_WINDOW 512
+#define DEFAULT_RESUME_GRACE 30
+#define WINDOW_INITIAL_FRAMES 16
+#define PARKED_BUCKETS 4096
+#define ACK_EVERY 32
+#define ACK_DELAY_MS 200
+#define REORDER_WINDOW 64
+#define REORDER_WAIT_MS 500
+#define DEFAULT_DEDUPE_WINDOW 120
+#define DEDUPE_SHARDS 64
+#define DEDUPE_GENERATIONS 4
+#define DEDUPE_INITIAL_SLOTS 16
+#define DEFAULT_PING_INTERVAL 15
+#define DEFAULT_PING_TIMEOUT 10
+#define DEFAULT_KEEPALIVE_IDLE 60
+#define DEFAULT_KEEPALIVE_INTERVAL 10
+#define DEFAULT_KEEPALIVE_COUNT 3
+#define DEFAULT_USER_TIMEOUT_MS 30000
+#define TIMER_SLOTS 256
+#define CLIENT_HEARTBEAT 10
+#define PING_FRAME_LENGTH 16
+#define SESSION_TOKEN_LENGTH 16
+#define SESSION_TAKEOVER_MS 100
+#define RECONNECT_BASE_MS 250
+#define RECONNECT_MAX_MS 30000
+#define RECONNECT_ATTEMPTS 12
+#define LOOKUP_RESULTS 32
+#define WATCHED_USERS 64
+#define DEFAULT_MAX_RECIPIENTS 32
+#define DEFAULT_LOOKUP_LIMIT 64
+#define DEFAULT_MAX_WATCHES 256
+#define WATCH_INITIAL_BUCKETS 256
+#define FRAME_HEADER_SIZE 4
+// Bytes of tags and lengths a request adds around its strings, and around every name in it
+#define REQUEST_OVERHEAD 32
+#define NAME_OVERHEAD 2
+#define SEND_BATCH 256
+#define WORKER_BATCH 64
+#define CPU_LIST_LENGTH 128
 
 #endif
\ No newline at end of file
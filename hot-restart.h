@@ -0,0 +1,291 @@
+#ifndef HRESTART
+#define HRESTART
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include "env.h"
+
+/*
+* Hot restart
+* The running server listens on a UNIX socket, a new server started with -t connects to it and
+* receives the listening socket and every client socket with SCM_RIGHTS, so no connection is closed.
+* SOCK_SEQPACKET keeps every message (and the descriptors attached to it) in one piece:
+*   1. old -> new: HandoffHeader + the listening socket
+*   2. old -> new: a batch of up to HANDOFF_BATCH HandoffRecord + their client sockets
+*   3. old -> new: the bytes still queued for the clients of that batch, the start of a request
+*      they did not finish sending, in chunks, the messages they are streaming, the attachments
+*      they are downloading, the frames kept for a resume and the names they follow
+*   4. repeat 2 and 3
+*   5. old -> new: HandoffTail, the parked sessions with their frames and the messages the dedupe
+*      set remembers, shard by shard and table by table
+*   6. new -> old: one byte to confirm, the old server exits
+*/
+#define HANDOFF_MAGIC 0x4f534348
+#define HANDOFF_BATCH 128
+#define HANDOFF_CHUNK (64 * 1024)
+#define HANDOFF_TIMEOUT 5
+
+typedef struct handoff_header {
+    uint32_t magic;
+    uint32_t clients;
+    // The clients expect the numbers of the broadcasts to go on
+    uint64_t broadcast_sequence;
+} HandoffHeader;
+
+// State of a connection that is not in the socket itself
+typedef struct handoff_record {
+    char name[MAX_USERNAME_LENGTH];
+    char ip[16];
+    int32_t status;
+    int32_t registered;
+    int64_t last_seen;
+    uint32_t pending;
+    uint32_t partial;
+    // MSG_ZEROCOPY is a socket option, the new server continues the ids of the sends
+    int32_t zerocopy;
+    uint32_t zerocopy_next;
+    // Open streams and downloads, their state follows the partial request
+    uint32_t streams;
+    uint32_t downloads;
+    // Frames of the retransmit window and names followed, they follow the downloads
+    uint32_t kept;
+    uint32_t watches;
+    // Frames numbered so far, the queued ones included, and how many the client acknowledged. The
+    // client keeps counting, the last kept ones (queued included) follow for a resume
+    uint64_t sent;
+    uint64_t acked;
+    uint64_t direct_sequence;
+    // The client resumes with it if the new server loses its connection
+    unsigned char session_token[SESSION_TOKEN_LENGTH];
+} HandoffRecord;
+
+// A download in progress, the attachment is in the spool both servers share
+typedef struct handoff_download {
+    uint64_t attachment;
+    uint64_t next;
+    uint32_t message_id;
+    int32_t begun;
+} HandoffDownload;
+
+// A frame kept for a resume, its bytes follow in chunks. An empty one is a file frame, whose
+// content is not kept
+typedef struct handoff_kept {
+    uint32_t len;
+    int32_t lane;
+} HandoffKept;
+
+// What follows the last batch of clients
+typedef struct handoff_tail {
+    uint32_t parked;
+    uint32_t dedupe_tables;
+} HandoffTail;
+
+// A session parked for a resume, its kept frames follow
+typedef struct handoff_parked {
+    char name[MAX_USERNAME_LENGTH];
+    unsigned char token[SESSION_TOKEN_LENGTH];
+    int32_t status;
+    uint32_t kept;
+    uint64_t sent;
+    uint64_t direct_sequence;
+    int64_t parked_at;
+} HandoffParked;
+
+// A table of the dedupe set that is not empty, its entries follow. generation counts back from the
+// table messages go to, age is how long ago the span of that one started
+typedef struct handoff_dedupe {
+    uint32_t shard;
+    uint32_t generation;
+    uint32_t count;
+    int64_t age;
+} HandoffDedupe;
+
+/*
+* Handoff listen function
+* @param path: the path of the UNIX socket
+* @return: the listening socket, -1 if failed
+* This function will be used by the running server to wait for its replacement
+*/
+int handoff_listen(const char *path) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    int descript = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0);
+    if (descript == -1) {
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    // A previous server may have left the path behind
+    unlink(path);
+    if (bind(descript, (struct sockaddr *) &address, sizeof(address)) == -1 || listen(descript, 1) == -1) {
+        close(descript);
+        return -1;
+    }
+    return descript;
+}
+
+/*
+* Handoff connect function
+* @param path: the path of the UNIX socket
+* @return: the connected socket, -1 if failed
+* This function will be used by the new server to reach the running one
+*/
+int handoff_connect(const char *path) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    int descript = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (descript == -1) {
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    if (connect(descript, (struct sockaddr *) &address, sizeof(address)) == -1) {
+        close(descript);
+        return -1;
+    }
+    return descript;
+}
+
+/*
+* Handoff timeout function
+* @param channel: the handoff socket
+* @return: void
+* This function will be used to make sure a stuck peer cannot block a server forever
+*/
+void handoff_timeout(int channel) {
+    struct timeval timeout = {HANDOFF_TIMEOUT, 0};
+    setsockopt(channel, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(channel, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+/*
+* Handoff send function
+* @param channel: the handoff socket
+* @param data: the message
+* @param len: the size of the message
+* @param fds: the descriptors to pass, NULL for none
+* @param count: the number of descriptors
+* @return: 0 if successful, -1 if failed
+*/
+int handoff_send(int channel, const void *data, size_t len, const int *fds, int count) {
+    struct iovec vector = {(void *) data, len};
+    struct msghdr message;
+    char control[CMSG_SPACE(sizeof(int) * HANDOFF_BATCH)];
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    if (count > 0) {
+        memset(control, 0, sizeof(control));
+        message.msg_control = control;
+        message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+        struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        memcpy(CMSG_DATA(header), fds, sizeof(int) * count);
+    }
+    return sendmsg(channel, &message, MSG_NOSIGNAL) == (ssize_t) len ? 0 : -1;
+}
+
+/*
+* Handoff close passed function
+* @param message: a received message
+* @return: void
+* This function will be used when a message is refused, the descriptors it carried are already open
+* in this process and would leak
+*/
+void handoff_close_passed(struct msghdr *message) {
+    for (struct cmsghdr *header = CMSG_FIRSTHDR(message); header; header = CMSG_NXTHDR(message, header)) {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+            int passed = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            int *fds = (int *) CMSG_DATA(header);
+            for (int i = 0; i < passed; i++) {
+                close(fds[i]);
+            }
+        }
+    }
+}
+
+/*
+* Handoff receive function
+* @param channel: the handoff socket
+* @param data: where to store the message
+* @param len: the size of data
+* @param fds: where to store the descriptors
+* @param max: the size of fds
+* @return: the size of the message, -1 if failed. The number of descriptors is stored in count, on a
+* failure none is left open
+*/
+ssize_t handoff_recv(int channel, void *data, size_t len, int *fds, int max, int *count) {
+    struct iovec vector = {data, len};
+    struct msghdr message;
+    char control[CMSG_SPACE(sizeof(int) * HANDOFF_BATCH)];
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t received = recvmsg(channel, &message, MSG_CMSG_CLOEXEC);
+    *count = 0;
+    if (received <= 0) {
+        return -1;
+    }
+    // A truncated message is refused, the descriptors that did fit were installed all the same
+    if (message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+        handoff_close_passed(&message);
+        return -1;
+    }
+    int passed = 0;
+    for (struct cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+            passed += (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        }
+    }
+    if (passed > max) {
+        handoff_close_passed(&message);
+        return -1;
+    }
+    for (struct cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+            int part = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds + *count, CMSG_DATA(header), sizeof(int) * part);
+            *count += part;
+        }
+    }
+    return received;
+}
+
+/*
+* Handoff receive all function
+* @param channel: the handoff socket
+* @param data: where to store the bytes
+* @param len: the number of bytes to receive
+* @return: 0 if successful, -1 if failed
+* This function will be used for the queued bytes of a connection, the old server may send them in several messages.
+* They carry no descriptor, one that comes anyway is closed and the handoff fails
+*/
+int handoff_recv_all(int channel, void *data, size_t len) {
+    size_t received = 0;
+    while (received < len) {
+        int none = 0;
+        ssize_t chunk = handoff_recv(channel, (char *) data + received, len - received, NULL, 0, &none);
+        if (chunk == -1) {
+            return -1;
+        }
+        received += chunk;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef IPTABLE
+#define IPTABLE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+* IP table
+* Open addressing hash table from an IPv4 address to the number of connections it has open, 8 bytes
+* per slot. It is kept at most half full and an address is removed with a backward shift when its
+* last connection closes, so lookups never walk over deleted slots. The accept thread adds and the
+* I/O threads remove, the table has its own lock.
+*/
+typedef struct ip_slot {
+    uint32_t addr;
+    uint32_t count;
+} IpSlot;
+
+typedef struct ip_table {
+    pthread_mutex_t lock;
+    IpSlot *slots;
+    uint32_t mask;
+    uint32_t used;
+} IpTable;
+
+/*
+* IP hash function
+* @param addr: the address
+* @return: the hash of the address
+*/
+uint32_t ip_hash(uint32_t addr) {
+    addr ^= addr >> 16;
+    addr *= 0x45d9f3b;
+    addr ^= addr >> 16;
+    return addr;
+}
+
+/*
+* IP table init function
+* @param table: the table
+* @param capacity: the number of slots, rounded up to a power of two
+* @return: 0 if successful, -1 if failed
+*/
+int ip_table_init(IpTable *table, uint32_t capacity) {
+    uint32_t size = 16;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    pthread_mutex_init(&table->lock, NULL);
+    table->slots = (IpSlot *) calloc(size, sizeof(IpSlot));
+    table->mask = size - 1;
+    table->used = 0;
+    return table->slots ? 0 : -1;
+}
+
+/*
+* IP table find function
+* @param table: the table, the caller holds its lock
+* @param addr: the address
+* @return: the slot of the address or the empty slot where it goes
+*/
+IpSlot *ip_table_find(IpTable *table, uint32_t addr) {
+    uint32_t index = ip_hash(addr) & table->mask;
+    while (table->slots[index].count > 0 && table->slots[index].addr != addr) {
+        index = (index + 1) & table->mask;
+    }
+    return &table->slots[index];
+}
+
+/*
+* IP table grow function
+* @param table: the table, the caller holds its lock
+* @return: 0 if successful, -1 if failed
+*/
+int ip_table_grow(IpTable *table) {
+    IpSlot *old_slots = table->slots;
+    uint32_t old_size = table->mask + 1;
+    IpSlot *slots = (IpSlot *) calloc(old_size * 2, sizeof(IpSlot));
+    if (slots == NULL) {
+        return -1;
+    }
+    table->slots = slots;
+    table->mask = old_size * 2 - 1;
+    for (uint32_t i = 0; i < old_size; i++) {
+        if (old_slots[i].count > 0) {
+            *ip_table_find(table, old_slots[i].addr) = old_slots[i];
+        }
+    }
+    free(old_slots);
+    return 0;
+}
+
+/*
+* IP table add function
+* @param table: the table
+* @param addr: the address of a new connection
+* @param limit: the connections an address may have, 0 for no limit
+* @return: 0 if the connection was counted, -1 if the address is at its limit or the table could not grow
+*/
+int ip_table_add(IpTable *table, uint32_t addr, uint32_t limit) {
+    pthread_mutex_lock(&table->lock);
+    IpSlot *slot = ip_table_find(table, addr);
+    if (slot->count == 0 && (table->used + 1) * 2 > table->mask + 1) {
+        if (ip_table_grow(table) == -1) {
+            pthread_mutex_unlock(&table->lock);
+            return -1;
+        }
+        slot = ip_table_find(table, addr);
+    }
+    if (limit > 0 && slot->count >= limit) {
+        pthread_mutex_unlock(&table->lock);
+        return -1;
+    }
+    if (slot->count == 0) {
+        slot->addr = addr;
+        table->used++;
+    }
+    slot->count++;
+    pthread_mutex_unlock(&table->lock);
+    return 0;
+}
+
+/*
+* IP table remove function
+* @param table: the table
+* @param addr: the address of a closed connection
+* @return: void
+*/
+void ip_table_remove(IpTable *table, uint32_t addr) {
+    pthread_mutex_lock(&table->lock);
+    IpSlot *slot = ip_table_find(table, addr);
+    if (slot->count > 1) {
+        slot->count--;
+    } else if (slot->count == 1) {
+        // Move the following entries of the run back so no lookup stops at the hole
+        uint32_t hole = slot - table->slots;
+        uint32_t index = hole;
+        while (1) {
+            index = (index + 1) & table->mask;
+            if (table->slots[index].count == 0) {
+                break;
+            }
+            uint32_t home = ip_hash(table->slots[index].addr) & table->mask;
+            // Stays if its home is cyclically in (hole, index]
+            if (hole <= index ? (home > hole && home <= index) : (home > hole || home <= index)) {
+                continue;
+            }
+            table->slots[hole] = table->slots[index];
+            hole = index;
+        }
+        table->slots[hole].count = 0;
+        table->slots[hole].addr = 0;
+        table->used--;
+    }
+    pthread_mutex_unlock(&table->lock);
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef MBUDGET
+#define MBUDGET
+
+#include <stddef.h>
+
+/*
+* Memory budget
+* Bytes the server holds for each kind of allocation that grows with the load. Every allocation of
+* those kinds charges the budget and every free releases it, so total follows the heap used by the
+* connections. Once total passes limit the server refuses new connections, sheds broadcasts and
+* stops caching receive buffers until it is below again. A limit of 0 means no limit.
+*/
+typedef enum mem_kind {
+    MEM_CONNECTIONS,
+    MEM_RECEIVE,
+    MEM_FRAMES,
+    MEM_QUEUES,
+    MEM_KINDS
+} MemKind;
+
+const char *mem_kind_names[MEM_KINDS] = {"connections", "receive buffers", "frames", "queue entries"};
+
+typedef struct mem_budget {
+    size_t used[MEM_KINDS];
+    size_t total;
+    size_t peak;
+    size_t limit;
+    // Connections refused and broadcasts shed while over the limit
+    unsigned long refused;
+    unsigned long shed;
+} MemBudget;
+
+MemBudget memory = {{0}, 0, 0, 0, 0, 0};
+
+/*
+* Mem charge function
+* @param kind: the kind of allocation
+* @param bytes: the bytes allocated
+* @return: void
+*/
+void mem_charge(MemKind kind, size_t bytes) {
+    __atomic_add_fetch(&memory.used[kind], bytes, __ATOMIC_RELAXED);
+    size_t total = __atomic_add_fetch(&memory.total, bytes, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&memory.peak, __ATOMIC_RELAXED);
+    while (total > peak && !__atomic_compare_exchange_n(&memory.peak, &peak, total, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/*
+* Mem release function
+* @param kind: the kind of allocation
+* @param bytes: the bytes freed
+* @return: void
+*/
+void mem_release(MemKind kind, size_t bytes) {
+    __atomic_sub_fetch(&memory.used[kind], bytes, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&memory.total, bytes, __ATOMIC_RELAXED);
+}
+
+/*
+* Mem over function
+* @return: 1 if the budget is exceeded
+*/
+int mem_over() {
+    size_t limit = __atomic_load_n(&memory.limit, __ATOMIC_RELAXED);
+    return limit > 0 && __atomic_load_n(&memory.total, __ATOMIC_RELAXED) > limit;
+}
+
+#endif
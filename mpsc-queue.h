@@ -0,0 +1,98 @@
+#ifndef MPSCQUEUE
+#define MPSCQUEUE
+
+#include <stddef.h>
+
+/*
+* MPSC queue
+* Intrusive lock-free queue (Vyukov) with any number of producer threads and exactly one consumer
+* thread. The element embeds an MpscNode, so a push is one atomic exchange that never waits and
+* never allocates. The stub node lets the consumer take the last element while producers keep
+* pushing. A pop can miss an element whose producer is between its two steps, that producer has
+* not returned yet and the caller has to look again once it is told (see post_frame in server.c).
+*/
+typedef struct mpsc_node {
+    struct mpsc_node *next;
+} MpscNode;
+
+typedef struct mpsc_queue {
+    // Swapped by the producers
+    MpscNode *tail;
+    // Only touched by the consumer
+    MpscNode *head;
+    MpscNode stub;
+} MpscQueue;
+
+// Element that embeds the node
+#define mpsc_entry(node, type, member) ((type *) ((char *) (node) - offsetof(type, member)))
+
+/*
+* MPSC init function
+* @param queue: the queue
+* @return: void
+*/
+void mpsc_init(MpscQueue *queue) {
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+}
+
+/*
+* MPSC push function
+* @param queue: the queue
+* @param node: the node embedded in the element
+* @return: void
+* This function can be called by any thread at the same time
+*/
+void mpsc_push(MpscQueue *queue, MpscNode *node) {
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+    MpscNode *prev = __atomic_exchange_n(&queue->tail, node, __ATOMIC_ACQ_REL);
+    // Between the exchange and this store the node is in the queue but not reachable yet
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+/*
+* MPSC pop function
+* @param queue: the queue
+* @return: the oldest node, NULL if the queue is empty or its next node is still being pushed
+* This function must only be called by the consumer thread of the queue
+*/
+MpscNode *mpsc_pop(MpscQueue *queue) {
+    MpscNode *head = queue->head;
+    MpscNode *next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    if (head == &queue->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        queue->head = next;
+        head = next;
+        next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        queue->head = next;
+        return head;
+    }
+    if (head != __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    // head is the last node, put the stub behind it so it can be taken
+    mpsc_push(queue, &queue->stub);
+    next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        queue->head = next;
+        return head;
+    }
+    return NULL;
+}
+
+/*
+* MPSC empty function
+* @param queue: the queue
+* @return: 1 if nothing was pushed since the consumer took the last node
+* This function must only be called by the consumer thread of the queue
+*/
+int mpsc_empty(MpscQueue *queue) {
+    return queue->head == &queue->stub && __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) == &queue->stub;
+}
+
+#endif
@@ -0,0 +1,235 @@
+#ifndef NINDEX
+#define NINDEX
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+* Name index
+* Crit-bit tree of the registered usernames, so a name is found by looking at its own bytes once
+* instead of comparing it with every user, and the names that start with a prefix are the leaves
+* under one node, in order. An inner node keeps the first bit where its two sides differ and a leaf
+* is the element itself, its name is read at key_offset bytes into it, so the tree costs one inner
+* node per name and no copy of the names. Inner nodes are told from leaves by the low bit of the
+* pointer, the elements come from malloc and never have it set. The caller locks the index.
+*/
+typedef struct name_index_node {
+    void *child[2];
+    uint32_t byte;
+    // Every bit but the critical one set
+    uint8_t otherbits;
+} NameIndexNode;
+
+typedef struct name_index {
+    void *root;
+    size_t key_offset;
+    int count;
+} NameIndex;
+
+#define name_index_inner(p) ((uintptr_t) (p) & 1)
+#define name_index_node(p) ((NameIndexNode *) ((uintptr_t) (p) - 1))
+#define name_index_key(index, p) ((const char *) (p) + (index)->key_offset)
+
+/*
+* Name index init function
+* @param index: the index
+* @param key_offset: where the name is in the elements, offsetof of its member
+* @return: void
+*/
+void name_index_init(NameIndex *index, size_t key_offset) {
+    index->root = NULL;
+    index->key_offset = key_offset;
+    index->count = 0;
+}
+
+/*
+* Name index direction function
+* @param node: an inner node
+* @param name: the name looked for
+* @param len: its length
+* @return: the side of the node the name is on
+*/
+int name_index_direction(NameIndexNode *node, const char *name, size_t len) {
+    uint8_t c = node->byte < len ? (uint8_t) name[node->byte] : 0;
+    return (1 + (node->otherbits | c)) >> 8;
+}
+
+/*
+* Name index closest function
+* @param index: the index, it is not empty
+* @param name: the name
+* @param len: its length
+* @return: the element the bits of the name lead to, it has the name if any element has it
+*/
+void *name_index_closest(NameIndex *index, const char *name, size_t len) {
+    void *p = index->root;
+    while (name_index_inner(p)) {
+        NameIndexNode *node = name_index_node(p);
+        p = node->child[name_index_direction(node, name, len)];
+    }
+    return p;
+}
+
+/*
+* Name index find function
+* @param index: the index
+* @param name: the name
+* @return: the element with the name, NULL if there is none
+*/
+void *name_index_find(NameIndex *index, const char *name) {
+    if (index->root == NULL) {
+        return NULL;
+    }
+    void *p = name_index_closest(index, name, strlen(name));
+    return strcmp(name_index_key(index, p), name) == 0 ? p : NULL;
+}
+
+/*
+* Name index insert function
+* @param index: the index
+* @param element: the element, its name is not in the index
+* @return: 0 if successful, 1 if the name is taken, -1 if failed
+*/
+int name_index_insert(NameIndex *index, void *element) {
+    const char *name = name_index_key(index, element);
+    size_t len = strlen(name);
+    if (index->root == NULL) {
+        index->root = element;
+        index->count++;
+        return 0;
+    }
+
+    // The first byte and bit where the name leaves the closest one
+    const char *closest = name_index_key(index, name_index_closest(index, name, len));
+    uint32_t byte = 0;
+    uint32_t bits;
+    while (1) {
+        bits = (uint8_t) closest[byte] ^ (uint8_t) name[byte];
+        if (bits != 0) {
+            break;
+        }
+        if (name[byte] == '\0') {
+            return 1;
+        }
+        byte++;
+    }
+    while (bits & (bits - 1)) {
+        bits &= bits - 1;
+    }
+    uint8_t otherbits = (uint8_t) (bits ^ 255);
+    int direction = (1 + (otherbits | (uint8_t) closest[byte])) >> 8;
+
+    NameIndexNode *node = (NameIndexNode *) malloc(sizeof(NameIndexNode));
+    if (node == NULL) {
+        return -1;
+    }
+    node->byte = byte;
+    node->otherbits = otherbits;
+    node->child[1 - direction] = element;
+
+    // The node goes above the first one that differs later than it
+    void **where = &index->root;
+    while (name_index_inner(*where)) {
+        NameIndexNode *inner = name_index_node(*where);
+        if (inner->byte > byte || (inner->byte == byte && inner->otherbits > otherbits)) {
+            break;
+        }
+        where = &inner->child[name_index_direction(inner, name, len)];
+    }
+    node->child[direction] = *where;
+    *where = (void *) ((uintptr_t) node + 1);
+    index->count++;
+    return 0;
+}
+
+/*
+* Name index remove function
+* @param index: the index
+* @param element: the element to take out
+* @return: 1 if it was in the index, 0 if not
+* This function will be used when a user leaves, nothing happens if its name belongs to another element
+*/
+int name_index_remove(NameIndex *index, void *element) {
+    if (index->root == NULL) {
+        return 0;
+    }
+    const char *name = name_index_key(index, element);
+    size_t len = strlen(name);
+    void **where = &index->root;
+    void **parent = NULL;
+    NameIndexNode *node = NULL;
+    int direction = 0;
+    while (name_index_inner(*where)) {
+        parent = where;
+        node = name_index_node(*where);
+        direction = name_index_direction(node, name, len);
+        where = &node->child[direction];
+    }
+    if (*where != element) {
+        return 0;
+    }
+    if (parent == NULL) {
+        index->root = NULL;
+    } else {
+        // The other side takes the place of the node
+        *parent = node->child[1 - direction];
+        free(node);
+    }
+    index->count--;
+    return 1;
+}
+
+/*
+* Name index walk function
+* @param p: a subtree
+* @param out: where the elements are written
+* @param count: how many were written
+* @param limit: the size of out
+* @return: void
+*/
+void name_index_walk(void *p, void **out, int *count, int limit) {
+    while (name_index_inner(p) && *count < limit) {
+        NameIndexNode *node = name_index_node(p);
+        name_index_walk(node->child[0], out, count, limit);
+        p = node->child[1];
+    }
+    if (!name_index_inner(p) && *count < limit) {
+        out[(*count)++] = p;
+    }
+}
+
+/*
+* Name index prefix function
+* @param index: the index
+* @param prefix: the start of the names
+* @param out: where the elements are written, in the order of their names
+* @param limit: the size of out
+* @return: the number of elements written
+* This function will be used to complete a name, the cost is the length of the prefix and the names written
+*/
+int name_index_prefix(NameIndex *index, const char *prefix, void **out, int limit) {
+    if (index->root == NULL || limit <= 0) {
+        return 0;
+    }
+    size_t len = strlen(prefix);
+    void *p = index->root;
+    void *top = p;
+    // Down to the first node that does not look at the prefix, everything under it starts the same
+    while (name_index_inner(p)) {
+        NameIndexNode *node = name_index_node(p);
+        p = node->child[name_index_direction(node, prefix, len)];
+        if (node->byte < len) {
+            top = p;
+        }
+    }
+    if (strncmp(name_index_key(index, p), prefix, len) != 0) {
+        return 0;
+    }
+    int count = 0;
+    name_index_walk(top, out, &count, limit);
+    return count;
+}
+
+#endif
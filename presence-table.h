@@ -0,0 +1,185 @@
+#ifndef PTABLE
+#define PTABLE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chat.pb-c.h"
+
+#define PRESENCE_WORD_BITS 64
+
+/*
+* Presence table
+* Dense structure-of-arrays copy of the data the broadcast loop needs, indexed by user slot.
+* owners points back to the connection of each slot so the frame can be queued on it.
+* A set bit in eligible means the slot receives broadcasts (registered and not OFFLINE),
+* so a broadcast only has to walk a few cache lines of bitmap instead of every CNode.
+*/
+typedef struct presence_table {
+    int capacity;
+    int count;
+    unsigned char *status;
+    void **owners;
+    uint64_t *used;
+    uint64_t *eligible;
+} PresenceTable;
+
+/*
+* Presence init function
+* @param table: the presence table
+* @param capacity: the number of user slots
+* @return: 0 if successful, -1 if failed
+* This function will be used to allocate the arrays of the presence table
+*/
+int presence_init(PresenceTable *table, int capacity) {
+    int words = (capacity + PRESENCE_WORD_BITS - 1) / PRESENCE_WORD_BITS;
+    table->capacity = capacity;
+    table->count = 0;
+    table->status = (unsigned char *) malloc(capacity);
+    table->owners = (void **) calloc(capacity, sizeof(void *));
+    table->used = (uint64_t *) calloc(words, sizeof(uint64_t));
+    table->eligible = (uint64_t *) calloc(words, sizeof(uint64_t));
+    if (!table->status || !table->owners || !table->used || !table->eligible) {
+        return -1;
+    }
+    memset(table->status, CHAT__USER_STATUS__OFFLINE, capacity);
+    return 0;
+}
+
+/*
+* Presence grow function
+* @param table: the presence table
+* @param capacity: the new number of user slots
+* @return: 0 if successful, -1 if failed
+* This function will be used to make room for more users without a compile-time cap
+*/
+int presence_grow(PresenceTable *table, int capacity) {
+    if (capacity <= table->capacity) {
+        return 0;
+    }
+    int old_words = (table->capacity + PRESENCE_WORD_BITS - 1) / PRESENCE_WORD_BITS;
+    int words = (capacity + PRESENCE_WORD_BITS - 1) / PRESENCE_WORD_BITS;
+    unsigned char *status = (unsigned char *) realloc(table->status, capacity);
+    if (status) {
+        table->status = status;
+    }
+    void **owners = (void **) realloc(table->owners, sizeof(void *) * capacity);
+    if (owners) {
+        table->owners = owners;
+    }
+    uint64_t *used = (uint64_t *) realloc(table->used, sizeof(uint64_t) * words);
+    if (used) {
+        table->used = used;
+    }
+    uint64_t *eligible = (uint64_t *) realloc(table->eligible, sizeof(uint64_t) * words);
+    if (eligible) {
+        table->eligible = eligible;
+    }
+    if (!status || !owners || !used || !eligible) {
+        return -1;
+    }
+    memset(table->status + table->capacity, CHAT__USER_STATUS__OFFLINE, capacity - table->capacity);
+    memset(table->used + old_words, 0, sizeof(uint64_t) * (words - old_words));
+    memset(table->eligible + old_words, 0, sizeof(uint64_t) * (words - old_words));
+    table->capacity = capacity;
+    return 0;
+}
+
+/*
+* Presence acquire function
+* @param table: the presence table
+* @param owner: the connection that takes the slot
+* @return: the slot index, -1 if the table is full
+* This function will be used to reserve a slot for a registered user
+*/
+int presence_acquire(PresenceTable *table, void *owner) {
+    int words = (table->capacity + PRESENCE_WORD_BITS - 1) / PRESENCE_WORD_BITS;
+    for (int w = 0; w < words; w++) {
+        uint64_t free_bits = ~table->used[w];
+        if (free_bits == 0) {
+            continue;
+        }
+        int slot = w * PRESENCE_WORD_BITS + __builtin_ctzll(free_bits);
+        if (slot >= table->capacity) {
+            return -1;
+        }
+        table->used[w] |= 1ULL << (slot % PRESENCE_WORD_BITS);
+        table->status[slot] = CHAT__USER_STATUS__OFFLINE;
+        table->owners[slot] = owner;
+        table->count++;
+        return slot;
+    }
+    return -1;
+}
+
+/*
+* Presence release function
+* @param table: the presence table
+* @param slot: the slot to release
+* @return: void
+* This function will be used to free the slot of a user that left
+*/
+void presence_release(PresenceTable *table, int slot) {
+    if (slot < 0 || slot >= table->capacity) {
+        return;
+    }
+    uint64_t mask = 1ULL << (slot % PRESENCE_WORD_BITS);
+    table->used[slot / PRESENCE_WORD_BITS] &= ~mask;
+    table->eligible[slot / PRESENCE_WORD_BITS] &= ~mask;
+    table->status[slot] = CHAT__USER_STATUS__OFFLINE;
+    table->owners[slot] = NULL;
+    table->count--;
+}
+
+/*
+* Presence set status function
+* @param table: the presence table
+* @param slot: the slot of the user
+* @param status: the new status
+* @return: void
+* This function will be used to keep the status byte and the broadcast bit in sync
+*/
+void presence_set_status(PresenceTable *table, int slot, Chat__UserStatus status) {
+    if (slot < 0 || slot >= table->capacity) {
+        return;
+    }
+    uint64_t mask = 1ULL << (slot % PRESENCE_WORD_BITS);
+    table->status[slot] = (unsigned char) status;
+    if (status == CHAT__USER_STATUS__OFFLINE) {
+        table->eligible[slot / PRESENCE_WORD_BITS] &= ~mask;
+    } else {
+        table->eligible[slot / PRESENCE_WORD_BITS] |= mask;
+    }
+}
+
+/*
+* Presence next function
+* @param table: the presence table
+* @param from: the slot to start searching from
+* @param skip: a slot to leave out (the sender), -1 for none
+* @return: the next eligible slot, -1 if there are no more
+* This function will be used to iterate the broadcast recipients with a bitwise scan
+*/
+int presence_next(PresenceTable *table, int from, int skip) {
+    int words = (table->capacity + PRESENCE_WORD_BITS - 1) / PRESENCE_WORD_BITS;
+    int w = from / PRESENCE_WORD_BITS;
+    if (from < 0 || w >= words) {
+        return -1;
+    }
+    // Mask out the bits before the starting slot
+    uint64_t bits = table->eligible[w] & (~0ULL << (from % PRESENCE_WORD_BITS));
+    while (1) {
+        if (skip >= 0 && skip / PRESENCE_WORD_BITS == w) {
+            bits &= ~(1ULL << (skip % PRESENCE_WORD_BITS));
+        }
+        if (bits) {
+            return w * PRESENCE_WORD_BITS + __builtin_ctzll(bits);
+        }
+        if (++w >= words) {
+            return -1;
+        }
+        bits = table->eligible[w];
+    }
+}
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef RWINDOW
+#define RWINDOW
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "buffer-pool.h"
+#include "mem-budget.h"
+#include "env.h"
+
+/*
+* Retransmit window
+* Every frame written to a connection is numbered, from 1 in the order they left, and the client
+* acknowledges how many it has received. The window keeps a reference to the frames written since
+* the last acknowledgment, up to retransmit_window of them, the oldest goes when it is full. Frames
+* are shared, so a broadcast costs one pointer per recipient. The window belongs to the I/O thread
+* of the connection, which only reads the number acknowledged by the worker.
+* When a registered client goes away its session is parked under its name for resume_grace seconds:
+* its window, its status and the token it was given. Only a registration with the token takes it,
+* and gets the frames the client did not receive again, the name is not given to anyone else meanwhile.
+*/
+typedef struct retransmit_window {
+    // Ring of the last count frames, the oldest is number sent - count + 1. File frames are NULL,
+    // their content is not kept, a download stops with its connection
+    Frame **frames;
+    uint32_t capacity;
+    uint32_t start;
+    uint32_t count;
+    uint64_t sent;
+} RetransmitWindow;
+
+typedef struct parked_window {
+    char name[MAX_USERNAME_LENGTH];
+    unsigned char token[SESSION_TOKEN_LENGTH];
+    int status;
+    RetransmitWindow window;
+    // Number of the last direct message to the client, a resume goes on from it
+    uint64_t direct_sequence;
+    time_t parked_at;
+    struct parked_window *next;
+} ParkedWindow;
+
+// Windows of the clients that went away, by the hash of their name
+typedef struct parked_table {
+    pthread_mutex_t lock;
+    ParkedWindow *buckets[PARKED_BUCKETS];
+    int count;
+} ParkedTable;
+
+/*
+* Window init function
+* @param window: the window
+* @return: void
+*/
+void window_init(RetransmitWindow *window) {
+    window->frames = NULL;
+    window->capacity = 0;
+    window->start = 0;
+    window->count = 0;
+    window->sent = 0;
+}
+
+/*
+* Window first function
+* @param window: the window
+* @return: the number of the oldest frame kept, sent + 1 if none is
+*/
+uint64_t window_first(RetransmitWindow *window) {
+    return window->sent - window->count + 1;
+}
+
+/*
+* Window at function
+* @param window: the window
+* @param seq: a number between window_first and sent
+* @return: the frame, NULL if it is not kept
+*/
+Frame *window_at(RetransmitWindow *window, uint64_t seq) {
+    return window->frames[(window->start + (seq - window_first(window))) % window->capacity];
+}
+
+/*
+* Window trim function
+* @param window: the window
+* @param acked: the number of frames the client received
+* @return: void
+* This function will be used to release the frames the client acknowledged
+*/
+void window_trim(RetransmitWindow *window, uint64_t acked) {
+    while (window->count > 0 && window_first(window) <= acked) {
+        frame_release(window->frames[window->start]);
+        window->start = (window->start + 1) % window->capacity;
+        window->count--;
+    }
+}
+
+/*
+* Window push function
+* @param window: the window
+* @param frame: the frame that was written, the window takes a reference, NULL to only number it
+* @param limit: the most frames kept, 0 to keep none
+* @return: void
+* This function will be used by the I/O thread every time a frame left, the ring grows to the limit
+*/
+void window_push(RetransmitWindow *window, Frame *frame, uint32_t limit) {
+    window->sent++;
+    if (window->count == window->capacity && window->capacity < limit) {
+        uint32_t capacity = window->capacity ? window->capacity * 2 : WINDOW_INITIAL_FRAMES;
+        capacity = capacity < limit ? capacity : limit;
+        Frame **frames = (Frame **) malloc(sizeof(Frame *) * capacity);
+        if (frames) {
+            for (uint32_t i = 0; i < window->count; i++) {
+                frames[i] = window->frames[(window->start + i) % window->capacity];
+            }
+            mem_release(MEM_QUEUES, sizeof(Frame *) * window->capacity);
+            mem_charge(MEM_QUEUES, sizeof(Frame *) * capacity);
+            free(window->frames);
+            window->frames = frames;
+            window->capacity = capacity;
+            window->start = 0;
+        }
+    }
+    // Full at the limit (or a smaller limit after a reload), the oldest frames go
+    while (window->count > 0 && window->count >= (limit < window->capacity ? limit : window->capacity)) {
+        frame_release(window->frames[window->start]);
+        window->start = (window->start + 1) % window->capacity;
+        window->count--;
+    }
+    if (window->capacity == 0 || limit == 0) {
+        return;
+    }
+    window->frames[(window->start + window->count) % window->capacity] = frame ? frame_retain(frame) : NULL;
+    window->count++;
+}
+
+/*
+* Window free function
+* @param window: the window, its frames are released
+* @return: void
+*/
+void window_free(RetransmitWindow *window) {
+    window_trim(window, window->sent);
+    mem_release(MEM_QUEUES, sizeof(Frame *) * window->capacity);
+    free(window->frames);
+    window->frames = NULL;
+    window->capacity = 0;
+}
+
+/*
+* Parked hash function
+* @param name: the username
+* @return: the bucket of the name
+*/
+uint32_t parked_hash(const char *name) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash = (hash ^ (unsigned char) *name++) * 16777619u;
+    }
+    return hash % PARKED_BUCKETS;
+}
+
+/*
+* Token equal function
+* @param a: a session token
+* @param b: another one
+* @return: 1 if they are the same
+* This function will be used to check a token, it takes as long whatever bytes differ
+*/
+int token_equal(const unsigned char *a, const unsigned char *b) {
+    unsigned char diff = 0;
+    for (int i = 0; i < SESSION_TOKEN_LENGTH; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+/*
+* Parked put function
+* @param table: the table
+* @param name: the username of the client that went away
+* @param token: the token of its session
+* @param status: its status
+* @param window: its window, the table takes the frames
+* @param direct_sequence: the number of the last direct message to the client
+* @param parked_at: when the client went away
+* @return: 0 if successful, -1 if the allocation failed and the frames were released
+*/
+int parked_put(ParkedTable *table, const char *name, const unsigned char *token, int status, RetransmitWindow *window, uint64_t direct_sequence, time_t parked_at) {
+    ParkedWindow *parked = (ParkedWindow *) malloc(sizeof(ParkedWindow));
+    if (parked == NULL) {
+        window_free(window);
+        return -1;
+    }
+    mem_charge(MEM_QUEUES, sizeof(ParkedWindow));
+    strncpy(parked->name, name, MAX_USERNAME_LENGTH - 1);
+    parked->name[MAX_USERNAME_LENGTH - 1] = '\0';
+    memcpy(parked->token, token, SESSION_TOKEN_LENGTH);
+    parked->status = status;
+    parked->window = *window;
+    parked->direct_sequence = direct_sequence;
+    parked->parked_at = parked_at;
+    window_init(window);
+    uint32_t bucket = parked_hash(parked->name);
+    pthread_mutex_lock(&table->lock);
+    parked->next = table->buckets[bucket];
+    table->buckets[bucket] = parked;
+    table->count++;
+    pthread_mutex_unlock(&table->lock);
+    return 0;
+}
+
+/*
+* Parked claim function
+* @param table: the table
+* @param name: the username
+* @param token: the token the client was given, NULL if it has none
+* @param claimed: where the session is moved, only the time it was parked if the token is wrong
+* @return: 0 if the session was taken, -1 if none is parked for the name, -2 if the token is wrong
+* This function will be used by every registration, a session is only given to the client it belongs to
+*/
+int parked_claim(ParkedTable *table, const char *name, const unsigned char *token, ParkedWindow *claimed) {
+    ParkedWindow *found = NULL;
+    int status = -1;
+    pthread_mutex_lock(&table->lock);
+    for (ParkedWindow **link = &table->buckets[parked_hash(name)]; *link; link = &(*link)->next) {
+        if (strcmp((*link)->name, name) == 0) {
+            if (token == NULL || !token_equal((*link)->token, token)) {
+                claimed->parked_at = (*link)->parked_at;
+                status = -2;
+                break;
+            }
+            found = *link;
+            *link = found->next;
+            table->count--;
+            status = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&table->lock);
+    if (found) {
+        *claimed = *found;
+        claimed->next = NULL;
+        mem_release(MEM_QUEUES, sizeof(ParkedWindow));
+        free(found);
+    }
+    return status;
+}
+
+/*
+* Parked expire function
+* @param table: the table
+* @param grace: seconds a window is kept
+* @return: the number of windows dropped
+* This function will be used by the main thread to drop the windows nobody came back for
+*/
+int parked_expire(ParkedTable *table, int grace) {
+    ParkedWindow *expired = NULL;
+    time_t now = time(NULL);
+    pthread_mutex_lock(&table->lock);
+    for (int bucket = 0; bucket < PARKED_BUCKETS && table->count > 0; bucket++) {
+        ParkedWindow **link = &table->buckets[bucket];
+        while (*link) {
+            ParkedWindow *parked = *link;
+            if (now - parked->parked_at >= grace) {
+                *link = parked->next;
+                parked->next = expired;
+                expired = parked;
+                table->count--;
+            } else {
+                link = &parked->next;
+            }
+        }
+    }
+    pthread_mutex_unlock(&table->lock);
+    // The frames are released outside the lock
+    int dropped = 0;
+    while (expired) {
+        ParkedWindow *parked = expired;
+        expired = parked->next;
+        window_free(&parked->window);
+        mem_release(MEM_QUEUES, sizeof(ParkedWindow));
+        free(parked);
+        dropped++;
+    }
+    return dropped;
+}
+
+#endif
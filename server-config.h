@@ -0,0 +1,379 @@
+#ifndef SCONFIG
+#define SCONFIG
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "token-bucket.h"
+#include "env.h"
+
+/*
+* Server config
+* Runtime copy of the knobs that used to be compile-time constants. env.h only keeps the defaults
+* and the sizes of fixed arrays, every field here can be changed by the config file, the command
+* line and a reload (kill -HUP <pid>) without dropping connections. The thread counts, the ring
+* size and the CPU lists are only read at startup, a hot restart applies them.
+*/
+typedef struct server_config {
+    int max_users;
+    int inactive_time;
+    int username_length;
+    int message_length;
+    int buffer_size;
+    int pool_cached;
+    int queue_limit;
+    int drain_timeout;
+    int io_threads;
+    int worker_threads;
+    int ring_size;
+    // Megabytes the connections may hold before new work is refused, 0 for no limit
+    int memory_limit_mb;
+    // Admission control: connections per source address, connections not registered yet, requests
+    // waiting for a worker before registrations are refused, and how long a refused client waits
+    int max_per_ip;
+    int max_handshakes;
+    int shed_depth;
+    int retry_after_ms;
+    // Requests per second and burst of every connection for each kind of request, a rate of 0 for no limit
+    int rate[RATE_KINDS];
+    int burst[RATE_KINDS];
+    // Bytes of requests every connection may have waiting for its worker
+    int read_quantum;
+    // Frames of at least this many bytes are sent with MSG_ZEROCOPY, 0 to always copy
+    int zerocopy_threshold;
+    // Bytes a message streamed in chunks may have, 0 to refuse streams
+    int stream_length;
+    // Bytes an attachment may have (0 to refuse uploads), megabytes the spool may hold (0 for no limit)
+    // and seconds an attachment is kept. The spool directory is only read at startup
+    int attachment_length;
+    int spool_limit_mb;
+    int attachment_ttl;
+    char spool_dir[SPOOL_DIR_LENGTH];
+    // Frames written to a client that are kept until it acknowledges them (0 to keep none), and
+    // seconds the window of a client that went away waits for it to resume
+    int retransmit_window;
+    int resume_grace;
+    // Seconds the id of a message is remembered so a retry of it is not sent again, 0 to not check
+    int dedupe_window;
+    // Recipients a direct message may have
+    int max_recipients;
+    // Names a user lookup may ask for and users a prefix query returns
+    int lookup_limit;
+    // Usernames a client may watch the presence of, 0 to turn subscriptions off
+    int max_watches;
+    // Seconds a quiet client waits for a ping (0 to never ping) and then for any answer before it is closed
+    int ping_interval;
+    int ping_timeout;
+    // TCP keepalive of the client sockets (an idle time of 0 turns it off) and milliseconds sent data may
+    // stay unacknowledged (0 for the kernel default), applied to the connections accepted after a change
+    int keepalive_idle;
+    int keepalive_interval;
+    int keepalive_count;
+    int user_timeout_ms;
+    // CPU lists (like "0-3,8"), empty to leave the threads unpinned
+    char accept_cpus[CPU_LIST_LENGTH];
+    char io_cpus[CPU_LIST_LENGTH];
+    char worker_cpus[CPU_LIST_LENGTH];
+} ServerConfig;
+
+// Name, place and accepted range of every config key, a text key has max - 1 characters at most
+typedef struct config_key {
+    const char *name;
+    size_t offset;
+    int min;
+    int max;
+    int text;
+} ConfigKey;
+
+const ConfigKey config_keys[] = {
+    {"max_users", offsetof(ServerConfig, max_users), 1, 1 << 24, 0},
+    {"inactive_time", offsetof(ServerConfig, inactive_time), 1, 86400, 0},
+    {"username_length", offsetof(ServerConfig, username_length), 1, MAX_USERNAME_LENGTH - 1, 0},
+    {"message_length", offsetof(ServerConfig, message_length), 1, 1 << 20, 0},
+    {"buffer_size", offsetof(ServerConfig, buffer_size), 64, 1 << 24, 0},
+    {"pool_cached", offsetof(ServerConfig, pool_cached), 0, 1 << 16, 0},
+    {"queue_limit", offsetof(ServerConfig, queue_limit), 1024, 1 << 30, 0},
+    {"drain_timeout", offsetof(ServerConfig, drain_timeout), 0, 3600, 0},
+    {"io_threads", offsetof(ServerConfig, io_threads), 1, 64, 0},
+    {"worker_threads", offsetof(ServerConfig, worker_threads), 1, 256, 0},
+    {"ring_size", offsetof(ServerConfig, ring_size), 64, 1 << 20, 0},
+    {"memory_limit_mb", offsetof(ServerConfig, memory_limit_mb), 0, 1 << 20, 0},
+    {"max_per_ip", offsetof(ServerConfig, max_per_ip), 0, 1 << 24, 0},
+    {"max_handshakes", offsetof(ServerConfig, max_handshakes), 1, 1 << 24, 0},
+    {"shed_depth", offsetof(ServerConfig, shed_depth), 1, 1 << 24, 0},
+    {"retry_after_ms", offsetof(ServerConfig, retry_after_ms), 1, 600000, 0},
+    {"register_rate", offsetof(ServerConfig, rate[RATE_REGISTER]), 0, 1 << 20, 0},
+    {"register_burst", offsetof(ServerConfig, burst[RATE_REGISTER]), 1, 1 << 20, 0},
+    {"direct_rate", offsetof(ServerConfig, rate[RATE_DIRECT]), 0, 1 << 20, 0},
+    {"direct_burst", offsetof(ServerConfig, burst[RATE_DIRECT]), 1, 1 << 20, 0},
+    {"broadcast_rate", offsetof(ServerConfig, rate[RATE_BROADCAST]), 0, 1 << 20, 0},
+    {"broadcast_burst", offsetof(ServerConfig, burst[RATE_BROADCAST]), 1, 1 << 20, 0},
+    {"status_rate", offsetof(ServerConfig, rate[RATE_STATUS]), 0, 1 << 20, 0},
+    {"status_burst", offsetof(ServerConfig, burst[RATE_STATUS]), 1, 1 << 20, 0},
+    {"users_rate", offsetof(ServerConfig, rate[RATE_USERS]), 0, 1 << 20, 0},
+    {"users_burst", offsetof(ServerConfig, burst[RATE_USERS]), 1, 1 << 20, 0},
+    {"download_rate", offsetof(ServerConfig, rate[RATE_DOWNLOAD]), 0, 1 << 20, 0},
+    {"download_burst", offsetof(ServerConfig, burst[RATE_DOWNLOAD]), 1, 1 << 20, 0},
+    {"read_quantum", offsetof(ServerConfig, read_quantum), 64, 1 << 24, 0},
+    {"zerocopy_threshold", offsetof(ServerConfig, zerocopy_threshold), 0, 1 << 30, 0},
+    {"stream_length", offsetof(ServerConfig, stream_length), 0, 1 << 30, 0},
+    {"attachment_length", offsetof(ServerConfig, attachment_length), 0, 1 << 30, 0},
+    {"spool_limit_mb", offsetof(ServerConfig, spool_limit_mb), 0, 1 << 24, 0},
+    {"attachment_ttl", offsetof(ServerConfig, attachment_ttl), 60, 30 * 86400, 0},
+    {"spool_dir", offsetof(ServerConfig, spool_dir), 0, SPOOL_DIR_LENGTH, 1},
+    {"retransmit_window", offsetof(ServerConfig, retransmit_window), 0, 1 << 20, 0},
+    {"resume_grace", offsetof(ServerConfig, resume_grace), 0, 86400, 0},
+    {"dedupe_window", offsetof(ServerConfig, dedupe_window), 0, 86400, 0},
+    {"max_recipients", offsetof(ServerConfig, max_recipients), 1, 256, 0},
+    {"lookup_limit", offsetof(ServerConfig, lookup_limit), 1, 1024, 0},
+    {"max_watches", offsetof(ServerConfig, max_watches), 0, 4096, 0},
+    {"ping_interval", offsetof(ServerConfig, ping_interval), 0, 3600, 0},
+    {"ping_timeout", offsetof(ServerConfig, ping_timeout), 1, 3600, 0},
+    {"keepalive_idle", offsetof(ServerConfig, keepalive_idle), 0, 86400, 0},
+    {"keepalive_interval", offsetof(ServerConfig, keepalive_interval), 1, 3600, 0},
+    {"keepalive_count", offsetof(ServerConfig, keepalive_count), 1, 127, 0},
+    {"user_timeout_ms", offsetof(ServerConfig, user_timeout_ms), 0, 3600000, 0},
+    {"accept_cpus", offsetof(ServerConfig, accept_cpus), 0, CPU_LIST_LENGTH, 1},
+    {"io_cpus", offsetof(ServerConfig, io_cpus), 0, CPU_LIST_LENGTH, 1},
+    {"worker_cpus", offsetof(ServerConfig, worker_cpus), 0, CPU_LIST_LENGTH, 1},
+};
+
+#define CONFIG_KEY_COUNT (int) (sizeof(config_keys) / sizeof(config_keys[0]))
+
+/*
+* Config defaults function
+* @param config: the server config
+* @return: void
+* This function will be used to fill the config with the values of env.h
+*/
+void config_defaults(ServerConfig *config) {
+    config->max_users = DEFAULT_MAX_USERS;
+    config->inactive_time = MAX_INACTIVE_TIME;
+    config->username_length = MAX_USERNAME_LENGTH - 1;
+    config->message_length = MAX_MESSAGE_LENGTH;
+    config->buffer_size = BUFFER_SIZE;
+    config->pool_cached = RECV_POOL_CACHED;
+    config->queue_limit = DEFAULT_QUEUE_LIMIT;
+    config->drain_timeout = DEFAULT_DRAIN_TIMEOUT;
+    config->io_threads = DEFAULT_IO_THREADS;
+    config->worker_threads = DEFAULT_WORKER_THREADS;
+    config->ring_size = DEFAULT_RING_SIZE;
+    config->memory_limit_mb = DEFAULT_MEMORY_LIMIT_MB;
+    config->max_per_ip = DEFAULT_MAX_PER_IP;
+    config->max_handshakes = DEFAULT_MAX_HANDSHAKES;
+    config->shed_depth = DEFAULT_SHED_DEPTH;
+    config->retry_after_ms = DEFAULT_RETRY_AFTER_MS;
+    config->rate[RATE_REGISTER] = DEFAULT_REGISTER_RATE;
+    config->burst[RATE_REGISTER] = DEFAULT_REGISTER_BURST;
+    config->rate[RATE_DIRECT] = DEFAULT_DIRECT_RATE;
+    config->burst[RATE_DIRECT] = DEFAULT_DIRECT_BURST;
+    config->rate[RATE_BROADCAST] = DEFAULT_BROADCAST_RATE;
+    config->burst[RATE_BROADCAST] = DEFAULT_BROADCAST_BURST;
+    config->rate[RATE_STATUS] = DEFAULT_STATUS_RATE;
+    config->burst[RATE_STATUS] = DEFAULT_STATUS_BURST;
+    config->rate[RATE_USERS] = DEFAULT_USERS_RATE;
+    config->burst[RATE_USERS] = DEFAULT_USERS_BURST;
+    config->rate[RATE_DOWNLOAD] = DEFAULT_DOWNLOAD_RATE;
+    config->burst[RATE_DOWNLOAD] = DEFAULT_DOWNLOAD_BURST;
+    config->read_quantum = DEFAULT_READ_QUANTUM;
+    config->zerocopy_threshold = DEFAULT_ZEROCOPY_THRESHOLD;
+    config->stream_length = DEFAULT_STREAM_LENGTH;
+    config->attachment_length = DEFAULT_ATTACHMENT_LENGTH;
+    config->spool_limit_mb = DEFAULT_SPOOL_LIMIT_MB;
+    config->attachment_ttl = DEFAULT_ATTACHMENT_TTL;
+    strcpy(config->spool_dir, DEFAULT_SPOOL_DIR);
+    config->retransmit_window = DEFAULT_RETRANSMIT_WINDOW;
+    config->resume_grace = DEFAULT_RESUME_GRACE;
+    config->dedupe_window = DEFAULT_DEDUPE_WINDOW;
+    config->max_recipients = DEFAULT_MAX_RECIPIENTS;
+    config->lookup_limit = DEFAULT_LOOKUP_LIMIT;
+    config->max_watches = DEFAULT_MAX_WATCHES;
+    config->ping_interval = DEFAULT_PING_INTERVAL;
+    config->ping_timeout = DEFAULT_PING_TIMEOUT;
+    config->keepalive_idle = DEFAULT_KEEPALIVE_IDLE;
+    config->keepalive_interval = DEFAULT_KEEPALIVE_INTERVAL;
+    config->keepalive_count = DEFAULT_KEEPALIVE_COUNT;
+    config->user_timeout_ms = DEFAULT_USER_TIMEOUT_MS;
+    config->accept_cpus[0] = '\0';
+    config->io_cpus[0] = '\0';
+    config->worker_cpus[0] = '\0';
+}
+
+/*
+* Config set function
+* @param config: the server config
+* @param key: the name of the knob
+* @param value: the new value as text
+* @return: 0 if successful, -1 if the key is unknown or the value out of range
+*/
+int config_set(ServerConfig *config, const char *key, const char *value) {
+    for (int i = 0; i < CONFIG_KEY_COUNT; i++) {
+        if (strcmp(config_keys[i].name, key) == 0) {
+            if (config_keys[i].text) {
+                if (strlen(value) >= (size_t) config_keys[i].max) {
+                    printf("Invalid value for %s, expected at most %d characters!\n", key, config_keys[i].max - 1);
+                    return -1;
+                }
+                strcpy((char *) config + config_keys[i].offset, value);
+                return 0;
+            }
+            char *end;
+            long number = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || number < config_keys[i].min || number > config_keys[i].max) {
+                printf("Invalid value for %s, expected %d to %d!\n", key, config_keys[i].min, config_keys[i].max);
+                return -1;
+            }
+            *(int *) ((char *) config + config_keys[i].offset) = (int) number;
+            return 0;
+        }
+    }
+    printf("Unknown config key %s!\n", key);
+    return -1;
+}
+
+/*
+* Config assign function
+* @param config: the server config
+* @param assignment: a "key=value" text, it is trimmed in place
+* @return: 0 if successful, -1 if failed
+* This function will be used for the config file lines and the -o overrides
+*/
+int config_assign(ServerConfig *config, char *assignment) {
+    char *equals = strchr(assignment, '=');
+    if (equals == NULL) {
+        printf("Expected key=value, got %s!\n", assignment);
+        return -1;
+    }
+    *equals = '\0';
+    char *key = assignment, *value = equals + 1;
+    // Trim the spaces around the key and the value
+    while (*key == ' ' || *key == '\t') key++;
+    while (*value == ' ' || *value == '\t') value++;
+    for (char *end = equals - 1; end >= key && (*end == ' ' || *end == '\t'); end--) *end = '\0';
+    for (char *end = value + strlen(value) - 1; end >= value && strchr(" \t\r\n", *end); end--) *end = '\0';
+    return config_set(config, key, value);
+}
+
+/*
+* Config load function
+* @param config: the server config
+* @param path: the config file, one key=value per line and # for comments
+* @return: 0 if successful, -1 if the file could not be read or has invalid lines
+*/
+int config_load(ServerConfig *config, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    char line[256];
+    int line_number = 0, result = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        char *start = line;
+        while (*start == ' ' || *start == '\t') start++;
+        if (*start == '#' || *start == '\n' || *start == '\r' || *start == '\0') {
+            continue;
+        }
+        if (config_assign(config, start) == -1) {
+            printf("Invalid line %d in %s!\n", line_number, path);
+            result = -1;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+/*
+* Config get function
+* @param config: the server config
+* @param index: the index of the key in config_keys
+* @return: the value of the key
+*/
+int config_get(const ServerConfig *config, int index) {
+    return *(const int *) ((const char *) config + config_keys[index].offset);
+}
+
+/*
+* Config get text function
+* @param config: the server config
+* @param index: the index of a text key in config_keys
+* @return: the value of the key
+*/
+const char *config_get_text(const ServerConfig *config, int index) {
+    return (const char *) config + config_keys[index].offset;
+}
+
+/*
+* Config print function
+* @param config: the server config
+* @return: void
+*/
+void config_print(const ServerConfig *config) {
+    for (int i = 0; i < CONFIG_KEY_COUNT; i++) {
+        if (config_keys[i].text) {
+            printf("  %s = %s\n", config_keys[i].name, config_get_text(config, i));
+        } else {
+            printf("  %s = %d\n", config_keys[i].name, config_get(config, i));
+        }
+    }
+}
+
+/*
+* Config print changes function
+* @param old_config: the config in use
+* @param new_config: the config about to be used
+* @return: the number of changed keys
+*/
+int config_print_changes(const ServerConfig *old_config, const ServerConfig *new_config) {
+    int changes = 0;
+    for (int i = 0; i < CONFIG_KEY_COUNT; i++) {
+        if (config_keys[i].text) {
+            if (strcmp(config_get_text(old_config, i), config_get_text(new_config, i)) != 0) {
+                printf("  %s: \"%s\" -> \"%s\"\n", config_keys[i].name, config_get_text(old_config, i), config_get_text(new_config, i));
+                changes++;
+            }
+        } else if (config_get(old_config, i) != config_get(new_config, i)) {
+            printf("  %s: %d -> %d\n", config_keys[i].name, config_get(old_config, i), config_get(new_config, i));
+            changes++;
+        }
+    }
+    return changes;
+}
+
+/*
+* Config request size function
+* @param config: the server config
+* @return: the bytes of the largest request a client may send, with its frame header
+* This function will be used to check that buffer_size fits a message of message_length bytes sent
+* to max_recipients users, and a chunk of a stream when streams or uploads are allowed
+*/
+long config_request_size(const ServerConfig *config) {
+    long name = config->username_length + NAME_OVERHEAD;
+    long message = config->message_length + (config->max_recipients + 1) * name;
+    long chunk = STREAM_CHUNK_SIZE + name;
+    if ((config->stream_length > 0 || config->attachment_length > 0) && chunk > message) {
+        message = chunk;
+    }
+    return FRAME_HEADER_SIZE + REQUEST_OVERHEAD + message;
+}
+
+/*
+* Config publish function
+* @param config: the config the threads read
+* @param next: the config to use from now on
+* @return: void
+* This function will be used by a reload, the I/O threads and the workers keep reading the config
+* without a lock, so every number is stored on its own with an atomic store and a reader sees the
+* old or the new value, never half of one. The text keys are only read at startup and a reload
+* keeps them as they are
+*/
+void config_publish(ServerConfig *config, const ServerConfig *next) {
+    for (int i = 0; i < CONFIG_KEY_COUNT; i++) {
+        if (!config_keys[i].text) {
+            __atomic_store_n((int *) ((char *) config + config_keys[i].offset), config_get(next, i), __ATOMIC_RELAXED);
+        }
+    }
+}
+
+#endif
@@ -1,718 +1,4487 @@
+// accept4 is a GNU extension
+#define _GNU_SOURCE
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <signal.h>
 #include <stdio.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <errno.h>
+#include <linux/errqueue.h>
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
+#include <sys/random.h>
 #include "client-node.h"
+#include "presence-table.h"
+#include "buffer-pool.h"
+#include "server-config.h"
+#include "hot-restart.h"
+#include "spsc-ring.h"
+#include "mpsc-queue.h"
+#include "cpu-affinity.h"
+#include "ip-table.h"
+#include "retransmit-window.h"
+#include "dedupe-set.h"
+#include "timer-wheel.h"
+#include "name-index.h"
+#include "watch-table.h"
 #include "chat.pb-c.h"
 #include "env.h"
 #include <time.h>
 
+// MSG_ZEROCOPY (Linux 4.14) may be missing from older headers
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
 pthread_mutex_t status_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t client_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Readers walk the list and the presence table, writers link, unlink and register clients.
+// Nothing is sent while it is held, a full ring must never wait on a thread that wants the lock
+pthread_rwlock_t client_lock = PTHREAD_RWLOCK_INITIALIZER;
 
 int srv_socket_descript = 0;
+int epoll_descript = 0;
+int connected_users = 0;
+// Knobs read from the config file and the command line, reloaded on SIGHUP
+ServerConfig config;
+char *config_path = DEFAULT_CONFIG_PATH;
+char **config_overrides = NULL;
+int config_override_count = 0;
+int config_reloads = 0;
+time_t config_loaded_at = 0;
 CNode *root_usr = NULL, *current_usr = NULL;
+PresenceTable presence;
+// Registered users by name, under client_lock like the list
+NameIndex names;
+// Followers of every watched username, the status changes pushed and the frames it took
+WatchTable watches;
+unsigned long presence_events = 0;
+unsigned long presence_pushes = 0;
+// Bytes waiting in outbound queues and number of queue entries
+size_t queued_bytes = 0;
+int queued_items = 0;
+// Admission control: open connections per source address, connections that have not registered
+// yet, and what was turned away by each check
+IpTable ip_table;
+int handshakes = 0;
+unsigned long refused_per_ip = 0;
+unsigned long refused_handshakes = 0;
+unsigned long shed_registrations = 0;
+// Requests refused by the rate limits of each kind
+unsigned long throttled_requests[RATE_KINDS] = {0};
+// Messages streamed in chunks that were completed and aborted, and the bytes of content relayed for them
+unsigned long streamed_messages = 0;
+unsigned long aborted_streams = 0;
+unsigned long streamed_bytes = 0;
+// Attachment bytes downloaded when the stats were printed last, and when that was
+size_t stats_downloaded = 0;
+struct timespec stats_taken;
+// Windows of the clients that went away, acknowledgments received, resumes, the frames they got
+// again and the ones that were no longer kept, and windows nobody came back for
+ParkedTable parked = {.lock = PTHREAD_MUTEX_INITIALIZER};
+// Sequencer of the broadcast channel, the number of the last broadcast
+uint64_t broadcast_sequence = 0;
+unsigned long acks_received = 0;
+unsigned long resumed_sessions = 0;
+unsigned long replayed_frames = 0;
+unsigned long lost_frames = 0;
+unsigned long expired_windows = 0;
+// Ids of the messages sent in the last dedupe_window seconds, the messages that had one and the
+// ones that were retries
+DedupeSet dedupe;
+unsigned long dedupe_checked = 0;
+unsigned long dedupe_hits = 0;
+// Heartbeat timers of every connection, pings sent and pongs received, and the sessions closed
+// because the client stopped answering or TCP gave up on it
+TimerWheel heartbeats;
+unsigned long pings_sent = 0;
+unsigned long pongs_received = 0;
+unsigned long reaped_heartbeat = 0;
+unsigned long reaped_tcp = 0;
+
+/*
+* Threads
+* The main thread accepts and runs the timers and signals. Each I/O thread owns the sockets given
+* to it, it unframes requests into its job rings and writes the frames posted to its clients.
+* Each worker runs the requests of its connections, one job ring per I/O thread, so the requests of
+* a connection (always the same I/O thread and worker) are handled in order.
+*   job_rings[io * worker_count + worker]: I/O thread -> worker, owner is the client, item the request
+*   client->mailbox: any thread -> I/O thread of the client, the frames in the order they were posted
+*   io->ready: clients with frames in their mailbox, a client is only in it once
+*/
+// A closed socket with zerocopy sends the kernel may still read, it stays open until their completions come
+typedef struct lingering {
+    int descript;
+    OutItem *sent;
+    time_t deadline;
+    struct lingering *next;
+} Lingering;
+
+typedef struct io_thread {
+    int id;
+    pthread_t thread;
+    int epoll_descript;
+    Waker waker;
+    // Clients closed in this event batch, released once the batch is handled
+    CNode *closed;
+    Lingering *lingering;
+    // Clients waiting for room in a worker ring, and clients with requests left after their quantum
+    CNode *stalled;
+    CNode *backlog;
+    MpscQueue ready;
+    // Receive buffers of the clients of the thread, allocated by the thread on its own NUMA node
+    BufferPool pool;
+    // Nodes the thread allocated and touched first so they are on its NUMA node, the accept thread takes
+    // them for the new clients of the thread, and how many clients got one or a node of the accept thread
+    pthread_mutex_t stash_lock;
+    CNode *stash;
+    int stashed;
+    unsigned long nodes_placed;
+    unsigned long nodes_missed;
+    // CPU the thread is pinned to (-1 if not) and where it runs
+    int pinned;
+    int cpu;
+    int node;
+    unsigned long requests;
+    unsigned long delivered;
+    // Frames written before waiting frames of later lanes, and frames let through by the starvation guard
+    unsigned long ahead;
+    unsigned long guarded;
+    // Sends done with MSG_ZEROCOPY, the ones the kernel copied anyway and the ones that fell back to a copy
+    unsigned long zerocopy_sends;
+    unsigned long zerocopy_copied;
+    unsigned long zerocopy_fallbacks;
+    unsigned long zerocopy_lingered;
+} IOThread;
+
+typedef struct worker {
+    int id;
+    pthread_t thread;
+    Waker waker;
+    int pinned;
+    int cpu;
+    int node;
+    unsigned long jobs;
+} Worker;
+
+IOThread *io_threads = NULL;
+Worker *workers = NULL;
+int io_count = 0, worker_count = 0;
+SpscRing *job_rings = NULL;
+int threads_started = 0;
+int next_io = 0, next_worker = 0;
+// CPUs of accept_cpus, io_cpus and worker_cpus, empty when the threads are not pinned
+cpu_set_t accept_cpu_set, io_cpu_set, worker_cpu_set;
+
+// Hot restart stops every thread: I/O threads stop reading (1), workers finish their jobs (2), I/O threads write what is left (3)
+pthread_mutex_t pause_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t pause_cond = PTHREAD_COND_INITIALIZER;
+int pause_phase = 0;
+int paused_threads = 0;
+// UNIX socket a new server connects to in order to take the connections over (-r)
+char *restart_path = NULL;
+int restart_descript = -1;
+CNode *restart_usr = NULL;
+volatile sig_atomic_t stats_requested = 0;
+volatile sig_atomic_t reload_requested = 0;
+// Drain state, the number of SIGINT/SIGTERM received: the first drains, the second exits right away
+volatile sig_atomic_t drain_requested = 0;
+int draining = 0;
+struct timespec drain_start;
+char *drain_redirect = "";
 
 /*
 * UTILS AREA
 */
 
 /*
-* Reset status function
-* @param client: the client node
+* Raise fd limit function
 * @return: void
-* This function will be used to reset the status of the client when it does an action
+* This function will be used to lift the soft limit of open files to the hard limit, every client is a socket
 */
-void reset_status(CNode *client) {
-    // Block the mutex while changing the status
-    Chat__UserStatus old_status = client->status;
-    pthread_mutex_lock(&status_mutex);
-    client->status = CHAT__USER_STATUS__ONLINE;
-    client->last_seen = clock();
-    pthread_mutex_unlock(&status_mutex);
-
-    if (old_status == CHAT__USER_STATUS__ONLINE) {
+void raise_fd_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+        perror("getrlimit failed");
         return;
     }
-    Chat__Response response = CHAT__RESPONSE__INIT;
-    response.status_code = CHAT__STATUS_CODE__OK;
-    response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
-    response.operation = CHAT__OPERATION__UPDATE_STATUS;
-    response.message ="\033[0;33mWARNING!\033[0m Status changed to \033[0;32mACTIVE\033[0m!";
-
-    // Serialize the response
-    size_t res_len = chat__response__get_packed_size(&response);
-    void *res_buffer = malloc(res_len);
-    if (res_buffer == NULL) {
-        printf("Memory allocation failed!\n");
-        exit(EXIT_FAILURE);
+    limit.rlim_cur = limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &limit) == -1) {
+        perror("setrlimit failed");
+        return;
+    }
+    printf("File descriptor limit set to %lu\n", (unsigned long) limit.rlim_cur);
+    if (limit.rlim_cur < (rlim_t) config.max_users + 16) {
+        printf("\033[0;33mWARNING!\033[0m The file descriptor limit is lower than the maximum number of users (%d)\n", config.max_users);
     }
+}
+
+/*
+* Elapsed ms function
+* @param start: the starting time, from CLOCK_MONOTONIC
+* @return: the milliseconds since start
+*/
+double elapsed_ms(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
 
-    chat__response__pack(&response, res_buffer);
+/*
+* Count queued function
+* @param bytes: the bytes added to (or removed from) the outbound queues
+* @param items: the frames added or removed
+* @return: void
+*/
+void count_queued(long bytes, int items) {
+    __atomic_add_fetch(&queued_bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&queued_items, items, __ATOMIC_RELAXED);
+}
 
-    // Send the response
-    int bytes_sent = send(client->data, res_buffer, res_len, 0);
-    if (bytes_sent < 0) {
-        printf("Send failed!\n");
-        exit(EXIT_FAILURE);
+/*
+* Watch client function
+* @param client: the client node
+* @return: void
+* This function will be used to update the events the I/O thread waits for on the client socket,
+* a stalled client is not read and a client with a queue waits until the socket can be written
+*/
+void watch_client(CNode *client) {
+    struct epoll_event event;
+    event.events = (client->stalled ? 0 : EPOLLIN) | (out_empty(client) ? 0 : EPOLLOUT);
+    if (event.events == client->events) {
+        return;
     }
+    client->events = event.events;
+    event.data.ptr = client;
+    epoll_ctl(io_threads[client->io].epoll_descript, EPOLL_CTL_MOD, client->data, &event);
 }
 
 /*
-* User exists function
-* @param username: the username to check
-* @return: 1 if the user exists, 0 if not
-* This function will be used to check if the user exists in the list
+* Stall client function
+* @param io: the I/O thread of the client
+* @param client: the client node
+* @param reason: why its requests wait
+* @return: void
+* This function will be used to put a client in the list of the I/O thread for the reason, the list holds a reference
 */
-int user_exists(char *username) {
-    CNode *current = root_usr;
-    while(current) {
-        if(strcmp(current->name, username) == 0) {
-            return 1;
+void stall_client(IOThread *io, CNode *client, Stall reason) {
+    CNode **list = reason == STALL_RING ? &io->stalled : &io->backlog;
+    // The worker of the client reads it to know if the I/O thread waits for it
+    __atomic_store_n(&client->stalled, reason, __ATOMIC_SEQ_CST);
+    client->next_stalled = *list;
+    *list = node_retain(client);
+    watch_client(client);
+}
+
+/*
+* Drop queue function
+* @param client: the client node
+* @return: void
+* This function will be used to release every frame still waiting in the outbound queues and the downloads
+*/
+void drop_queue(CNode *client) {
+    for (int lane = 0; lane < LANES; lane++) {
+        while (client->out_head[lane]) {
+            OutItem *item = client->out_head[lane];
+            client->out_head[lane] = item->next;
+            count_queued(-(long) (item->frame->len - item->offset), -1);
+            out_item_free(item);
         }
-        current = current->linked_to;
+        client->out_tail[lane] = NULL;
     }
-    return 0;
+    client->out_lane = -1;
+    client->out_bytes = 0;
+    while (client->downloads) {
+        Download *download = client->downloads;
+        client->downloads = download->next_download;
+        download_free(download);
+    }
+    client->downloads_tail = NULL;
 }
 
 /*
-* Get user count function
-* @return: the number of users
-* This function will be used to get the number of users in the list
+* Next lane function
+* @param client: the client node
+* @return: the lane whose head frame is written next, -1 if every lane is empty
+* This function will be used to write control frames before bulk ones and bulk frames before file
+* ones. A frame that was started is finished first, and a lane that waited while CONTROL_BURST
+* frames of earlier lanes were written in a row gets one frame through
 */
-int get_user_count() {
-    CNode *current = root_usr;
-    int count = 0;
-    while(current) {
-        count++;
-        current = current->linked_to;
+int next_lane(CNode *client) {
+    if (client->out_lane >= 0) {
+        return client->out_lane;
     }
-    printf("User count: %d\n", count);
-    return count;
+    int first = -1;
+    for (int lane = 0; lane < LANES; lane++) {
+        if (client->out_head[lane] == NULL) {
+            continue;
+        }
+        if (first >= 0 && client->skipped[lane] >= CONTROL_BURST) {
+            return lane;
+        }
+        if (first < 0) {
+            first = lane;
+        }
+    }
+    return first;
 }
 
 /*
-* SERVICES AREA
+* Zerocopy enable function
+* @param client: the client node
+* @return: 0 if the socket takes MSG_ZEROCOPY sends, -1 if not
+* This function will be used before the first large send of a client, the option is only set once
 */
+int zerocopy_enable(CNode *client) {
+    if (client->zerocopy == 0) {
+        int enable = 1;
+        client->zerocopy = setsockopt(client->data, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) == 0 ? 1 : -1;
+    }
+    return client->zerocopy == 1 ? 0 : -1;
+}
 
 /*
-* Exit service function
-* @param signal: the signal
-* @return: void
-* This function will be used to close the server and free the memory
+* Send bytes function
+* @param client: the client node
+* @param frame: the frame
+* @param offset: the bytes of the frame that were already sent
+* @return: the bytes sent, -1 if failed with errno set like send
+* This function will be used to write the rest of a frame. From zerocopy_threshold bytes the kernel
+* reads the frame itself instead of copying it, the frame is kept until it reports it is done with it.
+* The content of a file frame is written with sendfile, the two parts of a split frame with one call
 */
-void exit_service(int signal) {
-    // Temporary node to free the memory after closing the connection
-    CNode *to_free;
-    // While there are users in the list, close the connection and free the memory
-    while (root_usr) {
-        // Close the connection
-        close(root_usr->data);
-        printf("Connection closed for %s\n", root_usr->ip);
-        // Save the node to free
-        to_free = root_usr;
-        // Move to the next node
-        root_usr = root_usr->linked_to;
-        // Free the memory of saved node
-        free(to_free);
+ssize_t send_bytes(CNode *client, Frame *frame, size_t offset) {
+    if (frame->file) {
+        // The head is corked so it leaves with the content, which the kernel takes from the page cache
+        ssize_t head_sent = 0;
+        if (offset < frame->head) {
+            head_sent = send(client->data, frame->data + offset, frame->head - offset, MSG_NOSIGNAL | MSG_DONTWAIT | MSG_MORE);
+            if (head_sent < 0 || offset + head_sent < frame->head) {
+                return head_sent;
+            }
+        }
+        off_t position = frame->file_offset + (offset + head_sent - frame->head);
+        ssize_t file_sent = sendfile(client->data, frame->file->fd, &position, frame->len - offset - head_sent);
+        if (file_sent == 0 && head_sent == 0) {
+            // The file is shorter than it claims, the frame can never be finished
+            errno = EIO;
+            return -1;
+        }
+        return file_sent < 0 ? (head_sent > 0 ? head_sent : -1) : head_sent + file_sent;
     }
-    // Close the server socket
-    close(srv_socket_descript);
-    pthread_mutex_destroy(&status_mutex);
-    pthread_mutex_destroy(&client_mutex);
-    printf("\nShutting down...\n");
-    exit(EXIT_SUCCESS);
+    struct iovec parts[2];
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = parts;
+    message.msg_iovlen = frame_parts(frame, offset, parts);
+    size_t len = frame->len - offset;
+    size_t threshold = (size_t) config.zerocopy_threshold;
+    if (threshold > 0 && len >= threshold && zerocopy_enable(client) == 0) {
+        ssize_t bytes_sent = sendmsg(client->data, &message, MSG_NOSIGNAL | MSG_DONTWAIT | MSG_ZEROCOPY);
+        if (bytes_sent >= 0) {
+            // Every zerocopy send that took bytes gets the next id, the completions name ranges of them
+            OutItem *item = out_item_create(frame, client->zerocopy_next++);
+            if (item == NULL) {
+                printf("Memory allocation failed!\n");
+                exit(EXIT_FAILURE);
+            }
+            item->next = client->zerocopy_sent;
+            client->zerocopy_sent = item;
+            io_threads[client->io].zerocopy_sends++;
+            return bytes_sent;
+        }
+        // ENOBUFS means the socket has pinned as many pages as it may, this part is copied
+        if (errno != ENOBUFS) {
+            return bytes_sent;
+        }
+        io_threads[client->io].zerocopy_fallbacks++;
+    }
+    return sendmsg(client->data, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
 }
 
 /*
-* Status service function
-* @param client_node: the client node
+* Reap completions function
+* @param io: the I/O thread of the socket
+* @param descript: the socket
+* @param sent: the zerocopy sends of the socket the kernel may still read
 * @return: void
-* This function will be used to check the status of the client
+* This function will be used when the socket reports an error, the completions of the zerocopy
+* sends wait in its error queue and release the frames of the sends they name
 */
-void* status_service(void *client_node) {
-    CNode *client = (CNode *) client_node;
-    while(client->active) {
-        if(client->status == CHAT__USER_STATUS__ONLINE) {
-            if((clock()-client->last_seen)/CLOCKS_PER_SEC > MAX_INACTIVE_TIME) {
-                // Block the mutex while changing the status
-                pthread_mutex_lock(&status_mutex);
-                client->status = CHAT__USER_STATUS__BUSY;
-                pthread_mutex_unlock(&status_mutex);
-                
-                Chat__Response response = CHAT__RESPONSE__INIT;
-                response.status_code = CHAT__STATUS_CODE__OK;
-                response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
-                response.operation = CHAT__OPERATION__UPDATE_STATUS;
-                response.message = "\033[0;33mWARNING!\033[0m Status changed to \033[0;36mBUSY\033[0m due to inactivity!";
-
-                // Serialize the response
-                size_t res_len = chat__response__get_packed_size(&response);
-                void *res_buffer = malloc(res_len);
-                if (res_buffer == NULL) {
-                    printf("Memory allocation failed!\n");
-                    exit(EXIT_FAILURE);
-                }
-
-                chat__response__pack(&response, res_buffer);
-
-                // Send the response
-                int bytes_sent = send(client->data, res_buffer, res_len, 0);
-                if (bytes_sent < 0) {
-                    printf("Send failed!\n");
-                    exit(EXIT_FAILURE);
+void reap_completions(IOThread *io, int descript, OutItem **sent) {
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+    while (*sent) {
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if (recvmsg(descript, &message, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+            return;
+        }
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR) {
+                continue;
+            }
+            struct sock_extended_err error;
+            memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+            if (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY || error.ee_errno != 0) {
+                continue;
+            }
+            // Sends ee_info to ee_data are done, ids wrap around and the ranges may come out of order
+            uint32_t first = error.ee_info, count = error.ee_data - error.ee_info + 1;
+            if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                io->zerocopy_copied += count;
+            }
+            OutItem **link = sent;
+            while (*link) {
+                OutItem *item = *link;
+                if ((uint32_t) item->offset - first < count) {
+                    *link = item->next;
+                    out_item_free(item);
+                } else {
+                    link = &item->next;
                 }
             }
         }
     }
-    return NULL;
 }
 
 /*
-* Register user service function
+* Reap zerocopy function
 * @param client: the client node
-* @param username: the username to register
 * @return: void
-* This function will be used to register the user in the list
 */
-void set_username_service(CNode *client, char *username) {
-    if (user_exists(username)) {
-        Chat__Response response = CHAT__RESPONSE__INIT;
-        response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
-        response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
-        response.message = "User already exists!";
+void reap_zerocopy(CNode *client) {
+    reap_completions(&io_threads[client->io], client->data, &client->zerocopy_sent);
+}
+
+/*
+* Free sent function
+* @param sent: zerocopy sends the kernel is done with
+* @return: void
+*/
+void free_sent(OutItem *sent) {
+    while (sent) {
+        OutItem *item = sent;
+        sent = item->next;
+        out_item_free(item);
+    }
+}
 
-        // Serialize the response
-        size_t res_len = chat__response__get_packed_size(&response);
-        void *res_buffer = malloc(res_len);
-        if (res_buffer == NULL) {
+/*
+* Close socket function
+* @param io: the I/O thread of the client
+* @param client: the client node
+* @return: void
+* This function will be used to close the socket of a client. The kernel only pins the pages of a
+* zerocopy send, and TCP goes on sending what is queued after the close, so a frame freed now could
+* be reused and put new bytes on the wire. While the socket has unsent or unacked bytes it is shut down
+* instead and lingers on the I/O thread with its frames until the completions come
+*/
+void close_socket(IOThread *io, CNode *client) {
+    int queued = 0;
+    if (client->zerocopy_sent) {
+        reap_completions(io, client->data, &client->zerocopy_sent);
+    }
+    if (client->zerocopy_sent && ioctl(client->data, SIOCOUTQ, &queued) == 0 && queued > 0) {
+        Lingering *lingering = (Lingering *) malloc(sizeof(Lingering));
+        if (lingering == NULL) {
             printf("Memory allocation failed!\n");
             exit(EXIT_FAILURE);
         }
+        // The FIN goes after the queued bytes like on a close, only the completions are read from now on
+        epoll_ctl(io->epoll_descript, EPOLL_CTL_DEL, client->data, NULL);
+        shutdown(client->data, SHUT_RDWR);
+        lingering->descript = client->data;
+        lingering->sent = client->zerocopy_sent;
+        lingering->deadline = time(NULL) + ZEROCOPY_LINGER;
+        lingering->next = io->lingering;
+        io->lingering = lingering;
+        io->zerocopy_lingered++;
+    } else {
+        // Nothing is left in the socket, the kernel let go of every page
+        close(client->data);
+        free_sent(client->zerocopy_sent);
+    }
+    client->zerocopy_sent = NULL;
+}
 
-        chat__response__pack(&response, res_buffer);
-
-        // Send the response
-        int bytes_sent = send(client->data, res_buffer, res_len, 0);
-        if (bytes_sent < 0) {
-            printf("Send failed!\n");
-            exit(EXIT_FAILURE);
+/*
+* Reap lingering function
+* @param io: the I/O thread
+* @return: void
+* This function will be used by the I/O thread to close the lingering sockets the kernel is done with.
+* One that is still not done after ZEROCOPY_LINGER seconds is reset, which throws its queued bytes away
+*/
+void reap_lingering(IOThread *io) {
+    time_t now = time(NULL);
+    Lingering **link = &io->lingering;
+    while (*link) {
+        Lingering *lingering = *link;
+        reap_completions(io, lingering->descript, &lingering->sent);
+        int queued = 0;
+        int done = lingering->sent == NULL || (ioctl(lingering->descript, SIOCOUTQ, &queued) == 0 && queued == 0);
+        if (!done && now < lingering->deadline) {
+            link = &lingering->next;
+            continue;
         }
-    } else {
-        // Check if the maximum number of users is reached (+2 because the server is also a user and the new user is already added to the list)
-        if (get_user_count() >= MAX_USERS+2) {
-            Chat__Response response = CHAT__RESPONSE__INIT;
-            response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
-            response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
-            response.message = "Maximum number of users reached!";
+        if (!done) {
+            struct linger reset = {1, 0};
+            setsockopt(lingering->descript, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        }
+        close(lingering->descript);
+        free_sent(lingering->sent);
+        *link = lingering->next;
+        free(lingering);
+    }
+}
 
-            // Serialize the response
-            size_t res_len = chat__response__get_packed_size(&response);
-            void *res_buffer = malloc(res_len);
-            if (res_buffer == NULL) {
-                printf("Memory allocation failed!\n");
-                exit(EXIT_FAILURE);
-            }
+/*
+* Record frame function
+* @param client: the client node
+* @param frame: a frame that was written
+* @return: void
+* This function will be used by the I/O thread of the client every time a frame left, it gets the
+* next number and stays in the window until the client acknowledges it. A file frame only gets a
+* number, a download is not sent again
+*/
+void record_frame(CNode *client, Frame *frame) {
+    if (!frame->numbered) {
+        return;
+    }
+    window_trim(&client->window, __atomic_load_n(&client->acked, __ATOMIC_ACQUIRE));
+    window_push(&client->window, frame->lane == LANE_FILE ? NULL : frame, (uint32_t) config.retransmit_window);
+}
 
-            chat__response__pack(&response, res_buffer);
+/*
+* Window queue function
+* @param client: the client node
+* @return: void
+* This function will be used when the connection is lost, the frames still queued are numbered
+* as if they were written (a started one first) so a resume sends them
+*/
+void window_queue(CNode *client) {
+    int first = client->out_lane >= 0 ? client->out_lane : LANE_CONTROL;
+    for (int k = 0; k < LANES; k++) {
+        for (OutItem *item = client->out_head[(first + k) % LANES]; item; item = item->next) {
+            record_frame(client, item->frame);
+        }
+    }
+}
 
-            // Send the response
-            int bytes_sent = send(client->data, res_buffer, res_len, 0);
-            if (bytes_sent < 0) {
-                printf("Send failed!\n");
-                exit(EXIT_FAILURE);
-            }
-        } else {
+/*
+* Queue item function
+* @param client: the client node
+* @param item: the rest of a frame, the queue of its lane keeps the item and its frame reference
+* @return: void
+* This function will be used to keep the rest of a frame until the socket can be written
+*/
+void queue_item(CNode *client, OutItem *item) {
+    size_t len = item->frame->len - item->offset;
+    // A client that does not read its socket cannot make the server hold unbounded memory
+    if (client->out_bytes + len > (size_t) config.queue_limit) {
+        printf("Outbound queue of %s is full, dropping the client!\n", client->name);
+        drop_queue(client);
+        shutdown(client->data, SHUT_RDWR);
+        out_item_free(item);
+        return;
+    }
+    int lane = item->frame->lane;
+    int was_empty = out_empty(client);
+    item->next = NULL;
+    if (client->out_tail[lane]) {
+        client->out_tail[lane]->next = item;
+    } else {
+        client->out_head[lane] = item;
+    }
+    client->out_tail[lane] = item;
+    // Only the first frame can be partly written, the socket was not full before it
+    if (item->offset > 0) {
+        client->out_lane = lane;
+    }
+    if (was_empty) {
+        watch_client(client);
+    }
+    count_queued(len, 1);
+    client->out_bytes += len;
+}
 
-            strncpy(client->name, username, MAX_USERNAME_LENGTH);
-            printf("User %s joined the server!\n", client->name);
+/*
+* Queue frame function
+* @param client: the client node
+* @param frame: the packed response
+* @param offset: the bytes of the frame that were already sent
+* @return: void
+* This function will be used to queue a frame that was not posted, like the bytes adopted on a hot restart
+*/
+void queue_frame(CNode *client, Frame *frame, size_t offset) {
+    OutItem *item = out_item_create(frame, offset);
+    if (item == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    queue_item(client, item);
+}
 
-            Chat__Response response = CHAT__RESPONSE__INIT;
-            response.status_code = CHAT__STATUS_CODE__OK;
-            response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
-            response.message = "User registered successfully!";
+/*
+* Write item function
+* @param client: the client node
+* @param item: an item taken from the mailbox of the client
+* @return: void
+* This function will be used by the I/O thread of the client to write a frame right away or queue what the socket did not take
+*/
+void write_item(CNode *client, OutItem *item) {
+    if (client->data >= 0 && out_empty(client)) {
+        ssize_t bytes_sent = send_bytes(client, item->frame, 0);
+        if (bytes_sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            printf("Send failed for %s!\n", client->name);
+            shutdown(client->data, SHUT_RDWR);
+            bytes_sent = item->frame->len;
+        }
+        item->offset = bytes_sent > 0 ? bytes_sent : 0;
+        if (item->offset == item->frame->len) {
+            record_frame(client, item->frame);
+        }
+    }
+    // The mailbox item itself becomes the queue entry
+    if (client->data >= 0 && item->offset < item->frame->len) {
+        queue_item(client, item);
+        return;
+    }
+    out_item_free(item);
+}
 
-            // Serialize the response
-            size_t res_len = chat__response__get_packed_size(&response);
-            void *res_buffer = malloc(res_len);
-            if (res_buffer == NULL) {
-                printf("Memory allocation failed!\n");
-                exit(EXIT_FAILURE);
-            }
+/*
+* Post item function
+* @param client: the client node
+* @param item: the item, the mailbox takes it
+* @return: void
+* This function will be used by any thread to hand an item to the I/O thread of the client, it never waits
+*/
+void post_item(CNode *client, OutItem *item) {
+    mpsc_push(&client->mailbox, &item->link);
+    // The first post since the I/O thread last looked at the mailbox schedules the client, the ready queue holds a reference
+    if (__atomic_exchange_n(&client->scheduled, 1, __ATOMIC_ACQ_REL) == 0) {
+        mpsc_push(&io_threads[client->io].ready, &node_retain(client)->ready_link);
+        waker_wake(&io_threads[client->io].waker);
+    }
+}
 
-            chat__response__pack(&response, res_buffer);
+/*
+* Post frame function
+* @param client: the client node
+* @param frame: the frame, the mailbox takes a reference, NULL asks the I/O thread to close the client
+* @return: void
+* This function will be used by any thread to hand a frame to the I/O thread of the client, it never waits
+*/
+void post_frame(CNode *client, Frame *frame) {
+    OutItem *item = out_item_create(frame, 0);
+    if (item == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    post_item(client, item);
+}
 
-            // Send the response
-            int bytes_sent = send(client->data, res_buffer, res_len, 0);
-            if (bytes_sent < 0) {
-                printf("Send failed!\n");
-                exit(EXIT_FAILURE);
-            }
-        }
+/*
+* Post download function
+* @param client: the client node
+* @param download: the download, the mailbox takes it
+* @return: void
+* This function will be used by the worker of the client to have its I/O thread write an attachment
+*/
+void post_download(CNode *client, Download *download) {
+    OutItem *item = out_item_create(NULL, 0);
+    if (item == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    item->download = download;
+    if (client->active) {
+        post_item(client, item);
+    } else {
+        out_item_free(item);
     }
 }
 
 /*
-* Get all users service function
+* Send frame function
+* @param client: the client node
+* @param frame: the packed response
 * @return: void
-* This function will be used to get all the users in the list
+* This function will be used to send a frame to a client from any thread
 */
-void get_all_users_service(CNode *client, char* username) {
-    if (strlen(username) > 0) {
-        printf("Get user %s\n", username);
-        CNode *current = root_usr;
-        int found = 0;
-        printf("Searching in users...\n");
-        while(current) {
-            if(strcmp(current->name, username) == 0) {
-                found = 1;
-                printf("User %s found\n", username);
-                Chat__UserListResponse user_list = CHAT__USER_LIST_RESPONSE__INIT;
-                Chat__User **users = malloc(sizeof(Chat__User *) * 1);
-                Chat__User *user = malloc(sizeof(Chat__User));
-                chat__user__init(user);
-                // Concat the user ip before the name
-                char user_ip[MAX_USERNAME_LENGTH+16+4];
-                snprintf(user_ip, sizeof(user_ip), "%s (%s)", current->name, current->ip);
-                user->username = user_ip;
-                user->status = current->status;
-                users[0] = user;
-                user_list.n_users = 1;
-                user_list.users = users;
-                user_list.type = CHAT__USER_LIST_TYPE__SINGLE;
+void send_frame(CNode *client, Frame *frame) {
+    if (client->active) {
+        post_frame(client, frame);
+    }
+}
 
-                Chat__Response response = CHAT__RESPONSE__INIT;
-                response.status_code = CHAT__STATUS_CODE__OK;
-                response.result_case = CHAT__RESPONSE__RESULT_USER_LIST;
-                response.operation = CHAT__OPERATION__GET_USERS;
-                response.message = "User retrieved successfully!";
-                response.user_list = &user_list;
-
-                // Serialize the response
-                size_t res_len = chat__response__get_packed_size(&response);
-                void *res_buffer = malloc(res_len);
-                if (res_buffer == NULL) {
-                    printf("Memory allocation failed!\n");
-                    exit(EXIT_FAILURE);
-                }
-                printf("User %s retrieved successfully!\n", username);
+/*
+* Close client function
+* @param client: the client node
+* @return: void
+* This function will be used to ask the I/O thread of the client to close it after the frames sent before
+*/
+void close_client(CNode *client) {
+    post_frame(client, NULL);
+}
 
-                chat__response__pack(&response, res_buffer);
+/*
+* Pack response function
+* @param response: the response
+* @return: a frame holding the length of the response and the serialized response
+*/
+Frame *pack_response(Chat__Response *response) {
+    // Serialize the response after its length
+    size_t res_len = chat__response__get_packed_size(response);
+    Frame *frame = frame_create(FRAME_HEADER_SIZE + res_len);
+    if (frame == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t header = htonl((uint32_t) res_len);
+    memcpy(frame->data, &header, FRAME_HEADER_SIZE);
+    chat__response__pack(response, frame->data + FRAME_HEADER_SIZE);
+    // Chat messages are the bulk of the traffic, every answer and notice overtakes them
+    int bulk = response->operation == CHAT__OPERATION__INCOMING_MESSAGE || response->operation == CHAT__OPERATION__INCOMING_CHUNK
+        || response->operation == CHAT__OPERATION__INCOMING_ATTACHMENT;
+    frame->lane = bulk ? LANE_BULK : LANE_CONTROL;
+    return frame;
+}
 
-                // Send the response
-                int bytes_sent = send(client->data, res_buffer, res_len, 0);
-                if (bytes_sent < 0) {
-                    printf("Send failed!\n");
-                    exit(EXIT_FAILURE);
+/*
+* Send response function
+* @param client: the client node
+* @param response: the response
+* @return: void
+* This function will be used to serialize a response and send it to one client
+*/
+void send_response(CNode *client, Chat__Response *response) {
+    Frame *frame = pack_response(response);
+    send_frame(client, frame);
+    frame_release(frame);
+}
+
+/*
+* Varint size function
+* @param value: the value
+* @return: the bytes of the value as a protobuf varint
+*/
+size_t varint_size(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+/*
+* Varint put function
+* @param out: where to write the varint
+* @param value: the value
+* @return: the bytes written
+*/
+size_t varint_put(unsigned char *out, uint64_t value) {
+    size_t size = 0;
+    while (value >= 0x80) {
+        out[size++] = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    out[size++] = (unsigned char) value;
+    return size;
+}
+
+/*
+* Describe attachment function
+* @param file: the attachment
+* @param description: where to describe it, its strings point into the attachment
+* @return: void
+*/
+void describe_attachment(Attachment *file, Chat__Attachment *description) {
+    chat__attachment__init(description);
+    description->id = file->id;
+    description->name = file->header.name;
+    description->size = file->header.size;
+    description->sender = file->header.sender;
+    description->type = file->header.broadcast ? CHAT__MESSAGE_TYPE__BROADCAST : CHAT__MESSAGE_TYPE__DIRECT;
+}
+
+/*
+* Pack download chunk function
+* @param download: the download
+* @param type: BEGIN, which describes the attachment, or END
+* @return: a frame of the file lane holding the chunk
+*/
+Frame *pack_download_chunk(Download *download, Chat__ChunkType type) {
+    Chat__Attachment description;
+    describe_attachment(download->file, &description);
+    Chat__MessageChunk chunk = CHAT__MESSAGE_CHUNK__INIT;
+    chunk.message_id = download->message_id;
+    chunk.type = type;
+    chunk.attachment = type == CHAT__CHUNK_TYPE__BEGIN ? &description : NULL;
+
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__OK;
+    response.operation = CHAT__OPERATION__DOWNLOAD_ATTACHMENT;
+    response.result_case = CHAT__RESPONSE__RESULT_CHUNK;
+    response.message = "";
+    response.chunk = &chunk;
+
+    Frame *frame = pack_response(&response);
+    frame->lane = LANE_FILE;
+    return frame;
+}
+
+/*
+* Pack file chunk function
+* @param download: the download
+* @param len: the bytes of content the chunk carries, starting at the next byte of the download
+* @return: a frame of the file lane, only the response up to the content is in memory
+* This function will be used to frame the content of an attachment without reading it. The response
+* is packed without the chunk and the chunk without its data, then both fields are written by hand
+* as the last ones, so the content is the end of the frame and is sent from the file
+*/
+Frame *pack_file_chunk(Download *download, size_t len) {
+    Chat__MessageChunk chunk = CHAT__MESSAGE_CHUNK__INIT;
+    chunk.message_id = download->message_id;
+    chunk.type = CHAT__CHUNK_TYPE__DATA;
+    size_t chunk_head = chat__message_chunk__get_packed_size(&chunk) + 1 + varint_size(len);
+
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__OK;
+    response.operation = CHAT__OPERATION__DOWNLOAD_ATTACHMENT;
+    response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+    response.message = "";
+    size_t res_head = chat__response__get_packed_size(&response) + 1 + varint_size(chunk_head + len) + chunk_head;
+
+    Frame *frame = frame_create(FRAME_HEADER_SIZE + res_head);
+    if (frame == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t header = htonl((uint32_t) (res_head + len));
+    memcpy(frame->data, &header, FRAME_HEADER_SIZE);
+    unsigned char *out = frame->data + FRAME_HEADER_SIZE;
+    out += chat__response__pack(&response, out);
+    // Field 8 of the response (chunk) and field 4 of the chunk (data), both length delimited
+    *out++ = (8 << 3) | 2;
+    out += varint_put(out, chunk_head + len);
+    out += chat__message_chunk__pack(&chunk, out);
+    *out++ = (4 << 3) | 2;
+    varint_put(out, len);
+    frame->lane = LANE_FILE;
+    frame->len = frame->head + len;
+    frame->file = attachment_retain(download->file);
+    frame->file_offset = sizeof(AttachmentHeader) + download->next;
+    return frame;
+}
+
+/*
+* Feed download function
+* @param client: the client node
+* @return: void
+* This function will be used by the I/O thread before it writes the queues, the first download gets
+* its next frame once the file lane is empty, so a download never holds more than one frame
+*/
+void feed_download(CNode *client) {
+    Download *download = client->downloads;
+    if (download == NULL || client->out_head[LANE_FILE]) {
+        return;
+    }
+    Frame *frame;
+    uint64_t size = download->file->header.size;
+    if (!download->begun) {
+        download->begun = 1;
+        clock_gettime(CLOCK_MONOTONIC, &download->start);
+        frame = pack_download_chunk(download, CHAT__CHUNK_TYPE__BEGIN);
+    } else if (download->next < size) {
+        // A frame stays well under the queue limit, it is only reached by a client that does not read
+        size_t len = size - download->next;
+        size_t most = (size_t) config.queue_limit / 4 < ATTACHMENT_FRAME ? (size_t) config.queue_limit / 4 : ATTACHMENT_FRAME;
+        len = len < most ? len : most;
+        frame = pack_file_chunk(download, len);
+        download->next += len;
+        __atomic_add_fetch(&spool.downloaded, len, __ATOMIC_RELAXED);
+    } else {
+        frame = pack_download_chunk(download, CHAT__CHUNK_TYPE__END);
+        client->downloads = download->next_download;
+        if (client->downloads == NULL) {
+            client->downloads_tail = NULL;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        __atomic_add_fetch(&client->file_ns, (now.tv_sec - download->start.tv_sec) * 1000000000L + (now.tv_nsec - download->start.tv_nsec), __ATOMIC_RELAXED);
+        __atomic_add_fetch(&client->file_bytes, size, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&spool.downloads, 1, __ATOMIC_RELAXED);
+        download_free(download);
+    }
+    queue_frame(client, frame, 0);
+    frame_release(frame);
+}
+
+/*
+* Flush client function
+* @param client: the client node
+* @return: void
+* This function will be used to write the outbound queues until they are empty or the socket is full,
+* the downloads of the client are fed to the file lane as it goes
+*/
+void flush_client(CNode *client) {
+    int lane;
+    while (1) {
+        feed_download(client);
+        if ((lane = next_lane(client)) < 0) {
+            break;
+        }
+        OutItem *item = client->out_head[lane];
+        ssize_t bytes_sent = send_bytes(client, item->frame, item->offset);
+        if (bytes_sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            // The peer is gone, the event loop will see the hang up and remove the client
+            printf("Send failed for %s!\n", client->name);
+            window_queue(client);
+            drop_queue(client);
+            shutdown(client->data, SHUT_RDWR);
+            return;
+        }
+        item->offset += bytes_sent;
+        count_queued(-bytes_sent, 0);
+        client->out_bytes -= bytes_sent;
+        if (item->offset < item->frame->len) {
+            // Frames never interleave on the wire, this one is finished before any other
+            client->out_lane = lane;
+            return;
+        }
+        // The frame is out, the queue shrinks back to nothing when drained
+        record_frame(client, item->frame);
+        client->out_lane = -1;
+        client->out_head[lane] = item->next;
+        if (client->out_head[lane] == NULL) {
+            client->out_tail[lane] = NULL;
+        }
+        io_threads[client->io].guarded += client->skipped[lane] >= CONTROL_BURST;
+        client->skipped[lane] = 0;
+        int waiting = 0;
+        for (int later = lane + 1; later < LANES; later++) {
+            if (client->out_head[later]) {
+                client->skipped[later]++;
+                waiting = 1;
+            }
+        }
+        io_threads[client->io].ahead += waiting;
+        count_queued(0, -1);
+        out_item_free(item);
+    }
+    watch_client(client);
+}
+
+/*
+* Start download function
+* @param client: the client node
+* @param download: a download taken from the mailbox of the client
+* @return: void
+* This function will be used by the I/O thread of the client, the downloads are written one after the other
+*/
+void start_download(CNode *client, Download *download) {
+    if (client->data < 0) {
+        download_free(download);
+        return;
+    }
+    if (client->downloads_tail) {
+        client->downloads_tail->next_download = download;
+    } else {
+        client->downloads = download;
+    }
+    client->downloads_tail = download;
+    flush_client(client);
+}
+
+/*
+* Broadcast frame function
+* @param client: the sender, it is left out
+* @param frame: the packed response
+* @return: void
+* This function will be used to send a frame to every user that receives broadcasts. The eligibility
+* bitmap is scanned, the sender is masked out and the server never has a slot. The recipients are
+* taken in batches under the lock and sent to after unlocking
+*/
+void broadcast_frame(CNode *client, Frame *frame) {
+    CNode *recipients[SEND_BATCH];
+    int slot = 0;
+    while (slot >= 0) {
+        int count = 0;
+        pthread_rwlock_rdlock(&client_lock);
+        for (slot = presence_next(&presence, slot, client->slot); slot >= 0 && count < SEND_BATCH; slot = presence_next(&presence, slot + 1, client->slot)) {
+            recipients[count++] = node_retain((CNode *) presence.owners[slot]);
+        }
+        pthread_rwlock_unlock(&client_lock);
+        for (int i = 0; i < count; i++) {
+            // Send the response
+            send_frame(recipients[i], frame);
+            node_release(recipients[i]);
+        }
+    }
+}
+
+/*
+* Worker backlog function
+* @param worker: the index of the worker
+* @return: the requests waiting in the rings of the worker, only a snapshot
+*/
+size_t worker_backlog(int worker) {
+    size_t waiting = 0;
+    for (int i = 0; i < io_count; i++) {
+        waiting += spsc_size(&job_rings[i * worker_count + worker]);
+    }
+    return waiting;
+}
+
+/*
+* Rate limit function
+* @param client: the client node
+* @param payload: the request
+* @return: 0 if the request may run, otherwise the milliseconds until it may
+* This function will be used by the worker of the client before it handles a request, a refused one does not take a token
+*/
+uint32_t rate_limit(CNode *client, Chat__Request *payload) {
+    int kind;
+    switch (payload->operation) {
+        case CHAT__OPERATION__REGISTER_USER:
+            kind = RATE_REGISTER;
+            break;
+        case CHAT__OPERATION__SEND_MESSAGE:
+            kind = payload->send_message && strlen(payload->send_message->recipient) == 0 && payload->send_message->n_recipients == 0 ? RATE_BROADCAST : RATE_DIRECT;
+            break;
+        case CHAT__OPERATION__SEND_CHUNK:
+            // A streamed message (or an uploaded attachment) counts once, when it begins
+            if (payload->send_chunk == NULL || payload->send_chunk->type != CHAT__CHUNK_TYPE__BEGIN) {
+                return 0;
+            }
+            kind = strlen(payload->send_chunk->recipient) == 0 ? RATE_BROADCAST : RATE_DIRECT;
+            break;
+        case CHAT__OPERATION__UPDATE_STATUS:
+            kind = RATE_STATUS;
+            break;
+        case CHAT__OPERATION__GET_USERS:
+        case CHAT__OPERATION__SUBSCRIBE_PRESENCE:
+            kind = RATE_USERS;
+            break;
+        case CHAT__OPERATION__DOWNLOAD_ATTACHMENT:
+            kind = RATE_DOWNLOAD;
+            break;
+        default:
+            return 0;
+    }
+    uint32_t wait = bucket_take(&client->buckets[kind], __atomic_load_n(&config.rate[kind], __ATOMIC_RELAXED), __atomic_load_n(&config.burst[kind], __ATOMIC_RELAXED), monotonic_ms());
+    if (wait > 0) {
+        __atomic_add_fetch(&throttled_requests[kind], 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&client->throttled, 1, __ATOMIC_RELAXED);
+    }
+    return wait;
+}
+
+/*
+* Account service function
+* @param client: the client node
+* @param start: when the worker started on the request
+* @return: void
+* This function will be used by the worker of the client once a request is handled
+*/
+void account_service(CNode *client, struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    unsigned long ns = (now.tv_sec - start->tv_sec) * 1000000000L + (now.tv_nsec - start->tv_nsec);
+    __atomic_add_fetch(&client->service_ns, ns, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&client->served, 1, __ATOMIC_RELAXED);
+}
+
+/*
+* Top clients function
+* @param metric: the value to rank the clients by
+* @param top: where to store the clients with the highest values, highest first, a value of 0 is left out
+* @param values: where to store their values
+* @param max: the size of top
+* @return: the number of clients stored
+* This function will be used by the stats, the caller holds the read lock
+*/
+int top_clients(unsigned long (*metric)(CNode *), CNode **top, unsigned long *values, int max) {
+    int count = 0;
+    for (CNode *current = root_usr->linked_to; current; current = current->linked_to) {
+        unsigned long value = metric(current);
+        if (value == 0 || (count == max && value <= values[count - 1])) {
+            continue;
+        }
+        int position = count < max ? count++ : count - 1;
+        while (position > 0 && values[position - 1] < value) {
+            top[position] = top[position - 1];
+            values[position] = values[position - 1];
+            position--;
+        }
+        top[position] = current;
+        values[position] = value;
+    }
+    return count;
+}
+
+/*
+* Throttled metric function
+* @param client: the client node
+* @return: the requests of the client refused by its rate limits
+*/
+unsigned long throttled_metric(CNode *client) {
+    return __atomic_load_n(&client->throttled, __ATOMIC_RELAXED);
+}
+
+/*
+* Memory metric function
+* @param client: the client node
+* @return: the bytes the client holds, what it owns and what waits in its queue and its retransmit window
+*/
+unsigned long memory_metric(CNode *client) {
+    return __atomic_load_n(&client->memory, __ATOMIC_RELAXED) + __atomic_load_n(&client->out_bytes, __ATOMIC_RELAXED)
+        + (size_t) __atomic_load_n(&client->window.capacity, __ATOMIC_RELAXED) * sizeof(Frame *);
+}
+
+/*
+* Service metric function
+* @param client: the client node
+* @return: the nanoseconds the worker of the client spent on its requests
+*/
+unsigned long service_metric(CNode *client) {
+    return __atomic_load_n(&client->service_ns, __ATOMIC_RELAXED);
+}
+
+/*
+* Download metric function
+* @param client: the client node
+* @return: the attachment bytes of the downloads the client finished
+*/
+unsigned long download_metric(CNode *client) {
+    return __atomic_load_n(&client->file_bytes, __ATOMIC_RELAXED);
+}
+
+/*
+* Retry after function
+* @return: the milliseconds a refused client should wait, spread over up to twice retry_after_ms
+* This function will be used so the clients turned away together do not all come back together
+*/
+uint32_t retry_after() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return config.retry_after_ms + now.tv_nsec % config.retry_after_ms;
+}
+
+/*
+* Refuse connection function
+* @param descript: the socket of a connection that was just accepted
+* @param message: why it is refused
+* @return: void
+* This function will be used to answer a connection the server has no room for and close it, before any state is created for it
+*/
+void refuse_connection(int descript, char *message) {
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__SERVICE_UNAVAILABLE;
+    response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+    response.operation = CHAT__OPERATION__REGISTER_USER;
+    response.message = message;
+    response.retry_after_ms = retry_after();
+    Frame *frame = pack_response(&response);
+    // A new socket has room for one small frame, if not the client only sees the close
+    if (send(descript, frame->data, frame->len, MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+        printf("Send failed for a refused connection!\n");
+    }
+    frame_release(frame);
+    close(descript);
+}
+
+/*
+* Handshake done function
+* @param client: the client node
+* @return: void
+* This function will be used when a client registers or closes, whichever comes first takes it out of handshakes
+*/
+void handshake_done(CNode *client) {
+    if (__atomic_exchange_n(&client->handshaking, 0, __ATOMIC_ACQ_REL)) {
+        __atomic_sub_fetch(&handshakes, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+* Print stats function
+* @return: void
+* This function will be used to report the memory the connections are using (kill -USR1 <pid>)
+*/
+void print_stats() {
+    // An idle client only owns its node and its presence slot, buffers and queues are taken on demand
+    size_t slot_bytes = sizeof(unsigned char) + sizeof(void *) + 2 * sizeof(uint64_t) / PRESENCE_WORD_BITS;
+    size_t idle_bytes = sizeof(CNode) + slot_bytes;
+    printf("\n--- Server stats ---\n");
+    printf("Connected users: %d (registered %d, limit %d)\n", connected_users, presence.count, config.max_users);
+    printf("Bytes per idle connection: %zu (node %zu + presence slot %zu)\n", idle_bytes, sizeof(CNode), slot_bytes);
+    printf("Presence table: %d slots, %zu bytes\n", presence.capacity, presence.capacity * slot_bytes);
+    int buffers_in_use = 0, buffers_cached = 0;
+    for (int i = 0; i < io_count; i++) {
+        buffers_in_use += io_threads[i].pool.in_use;
+        buffers_cached += io_threads[i].pool.cached;
+    }
+    printf("Receive buffers: %d in use, %d cached, %d bytes each\n", buffers_in_use, buffers_cached, config.buffer_size);
+    printf("Outbound queues: %d frames, %zu bytes\n", queued_items, queued_bytes);
+    // Every allocation that grows with the load is charged to the memory budget
+    printf("Memory budget: %zu bytes used, peak %zu, limit %zu%s\n", memory.total, memory.peak, memory.limit, memory.limit ? "" : " (none)");
+    for (int kind = 0; kind < MEM_KINDS; kind++) {
+        printf("  %s: %zu bytes\n", mem_kind_names[kind], memory.used[kind]);
+    }
+    printf("  refused %lu connections, shed %lu broadcasts\n", memory.refused, memory.shed);
+    printf("Streamed messages: %lu completed, %lu aborted, %lu bytes relayed (up to %d bytes each)\n", streamed_messages, aborted_streams, streamed_bytes, config.stream_length);
+    // The download rate is taken over the time since the stats were printed last
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = (now.tv_sec - stats_taken.tv_sec) + (now.tv_nsec - stats_taken.tv_nsec) / 1e9;
+    size_t downloaded = __atomic_load_n(&spool.downloaded, __ATOMIC_RELAXED);
+    printf("Attachments: %zu bytes in %s (limit %d MB, kept %d s), %lu uploaded with %zu bytes, %lu expired\n", spool.bytes, spool.dir, config.spool_limit_mb, config.attachment_ttl, spool.uploads, spool.uploaded, spool.expired);
+    printf("  %lu downloads finished, %zu bytes sent with sendfile, %.2f MB/s over the last %.1f s\n", spool.downloads, downloaded, seconds > 0 ? (downloaded - stats_downloaded) / 1e6 / seconds : 0.0, seconds);
+    stats_downloaded = downloaded;
+    stats_taken = now;
+    printf("Delivery: %lu acks, up to %d frames kept per client, %d windows parked for %d s (%lu expired)\n", acks_received, config.retransmit_window, parked.count, config.resume_grace, expired_windows);
+    printf("  %lu resumes, %lu frames sent again, %lu lost\n", resumed_sessions, replayed_frames, lost_frames);
+    size_t dedupe_bytes;
+    unsigned long remembered = dedupe_count(&dedupe, &dedupe_bytes);
+    printf("Heartbeat: ping after %d s quiet, closed after %d s more, %d timers, %lu pings, %lu pongs\n", config.ping_interval, config.ping_timeout, heartbeats.count, pings_sent, pongs_received);
+    printf("  %lu sessions reaped by the heartbeat, %lu by TCP keepalive or user timeout\n", reaped_heartbeat, reaped_tcp);
+    pthread_rwlock_rdlock(&watches.lock);
+    printf("Presence: %d usernames followed by %d subscriptions, %lu changes pushed in %lu frames\n", watches.names, watches.links, presence_events, presence_pushes);
+    pthread_rwlock_unlock(&watches.lock);
+    printf("Dedupe: %lu messages with an id, %lu retries not sent again (%.1f%%), %lu ids kept for %d s in %zu bytes\n", dedupe_checked, dedupe_hits, dedupe_checked ? 100.0 * dedupe_hits / dedupe_checked : 0.0, remembered, config.dedupe_window, dedupe_bytes);
+    pthread_mutex_lock(&ip_table.lock);
+    printf("Admission: %d handshakes (limit %d), %u source addresses (limit %d connections each)\n", handshakes, config.max_handshakes, ip_table.used, config.max_per_ip);
+    pthread_mutex_unlock(&ip_table.lock);
+    printf("  refused %lu over the address limit, %lu over the handshake limit, shed %lu registrations\n", refused_per_ip, refused_handshakes, shed_registrations);
+    printf("Rate limits (per second/burst, throttled):\n");
+    for (int kind = 0; kind < RATE_KINDS; kind++) {
+        printf("  %s: %d/%d, %lu\n", rate_kind_names[kind], config.rate[kind], config.burst[kind], throttled_requests[kind]);
+    }
+    // The clients throttled the most and the clients the workers spent the most time on
+    CNode *top[TOP_CLIENTS_SHOWN];
+    unsigned long values[TOP_CLIENTS_SHOWN];
+    pthread_rwlock_rdlock(&client_lock);
+    int shown = top_clients(throttled_metric, top, values, TOP_CLIENTS_SHOWN);
+    for (int i = 0; i < shown; i++) {
+        printf("  throttled %s (%s): %lu requests\n", top[i]->name, top[i]->ip, values[i]);
+    }
+    shown = top_clients(service_metric, top, values, TOP_CLIENTS_SHOWN);
+    printf("Service time (read quantum %d bytes):\n", config.read_quantum);
+    for (int i = 0; i < shown; i++) {
+        unsigned long served = __atomic_load_n(&top[i]->served, __ATOMIC_RELAXED);
+        printf("  %s (%s): %.3f ms for %lu requests, %.1f us each\n", top[i]->name, top[i]->ip, values[i] / 1e6, served, served ? values[i] / 1e3 / served : 0.0);
+    }
+    shown = top_clients(download_metric, top, values, TOP_CLIENTS_SHOWN);
+    printf("Downloads (file lane frames of up to %d bytes):\n", ATTACHMENT_FRAME);
+    for (int i = 0; i < shown; i++) {
+        unsigned long ns = __atomic_load_n(&top[i]->file_ns, __ATOMIC_RELAXED);
+        printf("  %s (%s): %lu bytes at %.2f MB/s\n", top[i]->name, top[i]->ip, values[i], ns ? values[i] * 1e3 / ns : 0.0);
+    }
+    pthread_rwlock_unlock(&client_lock);
+    // The connections holding the most and what all of them hold
+    size_t connection_bytes = 0;
+    pthread_rwlock_rdlock(&client_lock);
+    for (CNode *current = root_usr->linked_to; current; current = current->linked_to) {
+        connection_bytes += memory_metric(current);
+    }
+    shown = top_clients(memory_metric, top, values, TOP_CLIENTS_SHOWN);
+    printf("Connection memory: %zu bytes held by %d connections\n", connection_bytes, connected_users);
+    for (int i = 0; i < shown; i++) {
+        printf("  %s (%s): %lu bytes, %zu queued\n", top[i]->name[0] ? top[i]->name : "unregistered", top[i]->ip, values[i], __atomic_load_n(&top[i]->out_bytes, __ATOMIC_RELAXED));
+    }
+    pthread_rwlock_unlock(&client_lock);
+    printf("Threads: %d I/O, %d workers, rings of %zu entries\n", io_count, worker_count, job_rings ? job_rings[0].mask + 1 : 0);
+    for (int i = 0; i < io_count; i++) {
+        printf("  I/O %d: %lu requests read, %lu frames delivered, %lu frames ahead of later lanes, %lu let through by the starvation guard\n", i, io_threads[i].requests, io_threads[i].delivered, io_threads[i].ahead, io_threads[i].guarded);
+        printf("    zerocopy (from %d bytes): %lu sends, %lu copied by the kernel, %lu fell back to a copy, %lu closed sockets waited for the kernel\n", config.zerocopy_threshold, io_threads[i].zerocopy_sends, io_threads[i].zerocopy_copied, io_threads[i].zerocopy_fallbacks, io_threads[i].zerocopy_lingered);
+    }
+    for (int w = 0; w < worker_count; w++) {
+        printf("  Worker %d: %lu jobs done, %zu waiting\n", w, workers[w].jobs, worker_backlog(w));
+    }
+    // Where every thread runs, the I/O and worker threads report it when they start
+    int cpu, node;
+    current_placement(&cpu, &node);
+    printf("Placement (cpu/node):\n");
+    printf("  Accept: cpus %s, on %d/%d\n", config.accept_cpus[0] ? config.accept_cpus : "any", cpu, node);
+    for (int i = 0; i < io_count; i++) {
+        printf("  I/O %d: pinned to %d, on %d/%d, %lu client nodes allocated there, %lu by the accept thread\n", i, io_threads[i].pinned, io_threads[i].cpu, io_threads[i].node, io_threads[i].nodes_placed, io_threads[i].nodes_missed);
+    }
+    for (int w = 0; w < worker_count; w++) {
+        printf("  Worker %d: pinned to %d, on %d/%d\n", w, workers[w].pinned, workers[w].cpu, workers[w].node);
+    }
+    printf("Config %s, reloaded %d times, last loaded %s", config_path, config_reloads, ctime(&config_loaded_at));
+    config_print(&config);
+    printf("--------------------\n");
+}
+
+/*
+* Stats signal function
+* @param signal: the signal
+* @return: void
+* This function will be used to ask the event loop for the stats
+*/
+void stats_signal(int signal) {
+    stats_requested = 1;
+}
+
+/*
+* Reload signal function
+* @param signal: the signal
+* @return: void
+* This function will be used to ask the event loop to read the config again
+*/
+void reload_signal(int signal) {
+    reload_requested = 1;
+}
+
+/*
+* Read config function
+* @param target: the config to fill
+* @param required: 1 if a missing config file is an error
+* @return: 0 if successful, -1 if failed
+* This function will be used to build the config from the defaults, the config file and the command line, in that order
+*/
+int read_config(ServerConfig *target, int required) {
+    config_defaults(target);
+    // Without -c the default config file is optional
+    if (required || access(config_path, F_OK) == 0) {
+        if (config_load(target, config_path) == -1) {
+            printf("Could not read the config file %s!\n", config_path);
+            return -1;
+        }
+    }
+    // The command line always wins over the file
+    for (int i = 0; i < config_override_count; i++) {
+        char assignment[256];
+        strncpy(assignment, config_overrides[i], sizeof(assignment) - 1);
+        assignment[sizeof(assignment) - 1] = '\0';
+        if (config_assign(target, assignment) == -1) {
+            return -1;
+        }
+    }
+    // A request that does not fit in a receive buffer closes the connection
+    if (target->buffer_size < config_request_size(target)) {
+        printf("buffer_size %d is too small for message_length %d and max_recipients %d, it needs at least %ld bytes!\n",
+            target->buffer_size, target->message_length, target->max_recipients, config_request_size(target));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+* Reload config function
+* @return: void
+* This function will be used by the event loop on SIGHUP, a bad config keeps the current one
+*/
+void reload_config() {
+    ServerConfig next;
+    if (read_config(&next, 0) == -1) {
+        printf("Config reload failed, keeping the current config!\n");
+        return;
+    }
+    // The threads and rings are created and pinned at startup
+    if (next.io_threads != config.io_threads || next.worker_threads != config.worker_threads || next.ring_size != config.ring_size
+        || strcmp(next.accept_cpus, config.accept_cpus) != 0 || strcmp(next.io_cpus, config.io_cpus) != 0 || strcmp(next.worker_cpus, config.worker_cpus) != 0
+        || strcmp(next.spool_dir, config.spool_dir) != 0) {
+        printf("\033[0;33mWARNING!\033[0m io_threads, worker_threads, ring_size, the CPU lists and spool_dir only change on restart\n");
+        next.io_threads = config.io_threads;
+        next.worker_threads = config.worker_threads;
+        next.ring_size = config.ring_size;
+        strcpy(next.accept_cpus, config.accept_cpus);
+        strcpy(next.io_cpus, config.io_cpus);
+        strcpy(next.worker_cpus, config.worker_cpus);
+        strcpy(next.spool_dir, config.spool_dir);
+    }
+    printf("Config reloaded from %s\n", config_path);
+    if (config_print_changes(&config, &next) == 0) {
+        printf("  no changes\n");
+    }
+    pthread_rwlock_wrlock(&client_lock);
+    config_publish(&config, &next);
+    pthread_rwlock_unlock(&client_lock);
+    __atomic_store_n(&memory.limit, (size_t) config.memory_limit_mb << 20, __ATOMIC_RELAXED);
+    // New buffers take the new size, borrowed ones are freed when given back
+    for (int i = 0; i < io_count; i++) {
+        pool_resize(&io_threads[i].pool, config.buffer_size, config.pool_cached);
+    }
+    config_reloads++;
+    config_loaded_at = time(NULL);
+    if (presence.count > config.max_users) {
+        printf("\033[0;33mWARNING!\033[0m %d users are registered, new ones wait until it is below %d\n", presence.count, config.max_users);
+    }
+}
+
+/*
+* Push presence function
+* @param client: the client whose status changed
+* @param status: its new status, OFFLINE when it left
+* @return: void
+* This function will be used on every status change, it costs a lookup when nobody follows the client
+* and one shared frame for all its followers. Followers that are OFFLINE are not in a chat and get nothing,
+* they subscribe again to get the statuses when they come back
+*/
+void push_presence(CNode *client, Chat__UserStatus status) {
+    if (__atomic_load_n(&watches.links, __ATOMIC_RELAXED) == 0) {
+        return;
+    }
+    Chat__User user = CHAT__USER__INIT;
+    user.username = client->name;
+    user.status = status;
+
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__OK;
+    response.operation = CHAT__OPERATION__PRESENCE_EVENT;
+    response.result_case = CHAT__RESPONSE__RESULT_PRESENCE;
+    response.message = "";
+    response.presence = &user;
+
+    Frame *frame = NULL;
+    unsigned long pushed = 0;
+    pthread_rwlock_rdlock(&watches.lock);
+    WatchEntry *entry = watch_find(&watches, client->name);
+    for (WatchLink *link = entry ? entry->watchers.next : NULL; link && link != &entry->watchers; link = link->next) {
+        CNode *watcher = (CNode *) link->watcher;
+        if (watcher == client || watcher->status == CHAT__USER_STATUS__OFFLINE) {
+            continue;
+        }
+        if (frame == NULL) {
+            frame = pack_response(&response);
+        }
+        send_frame(watcher, frame);
+        pushed++;
+    }
+    pthread_rwlock_unlock(&watches.lock);
+    if (frame) {
+        frame_release(frame);
+        __atomic_add_fetch(&presence_events, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&presence_pushes, pushed, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+* Broadcasts sent function
+* @return: the number of the last broadcast
+* This function will be used when a client starts to get the broadcasts again. It is read after the
+* client became eligible, so every broadcast with a higher number reaches it
+*/
+uint64_t broadcasts_sent() {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_load_n(&broadcast_sequence, __ATOMIC_SEQ_CST);
+}
+
+/*
+* Set client status function
+* @param client: the client node
+* @param status: the new status
+* @return: void
+* This function will be used to change the status of the client and its presence slot together
+*/
+void set_client_status(CNode *client, Chat__UserStatus status) {
+    pthread_mutex_lock(&status_mutex);
+    int changed = client->status != status;
+    client->status = status;
+    presence_set_status(&presence, client->slot, status);
+    pthread_mutex_unlock(&status_mutex);
+    if (changed && client->slot >= 0) {
+        push_presence(client, status);
+    }
+}
+
+/*
+* Reset status function
+* @param client: the client node
+* @return: void
+* This function will be used to reset the status of the client when it does an action
+*/
+void reset_status(CNode *client) {
+    // Block the mutex while changing the status
+    Chat__UserStatus old_status = client->status;
+    set_client_status(client, CHAT__USER_STATUS__ONLINE);
+    client->last_seen = time(NULL);
+
+    if (old_status == CHAT__USER_STATUS__ONLINE) {
+        return;
+    }
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__OK;
+    response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+    response.operation = CHAT__OPERATION__UPDATE_STATUS;
+    response.message ="\033[0;33mWARNING!\033[0m Status changed to \033[0;32mACTIVE\033[0m!";
+    if (old_status == CHAT__USER_STATUS__OFFLINE) {
+        response.broadcast_sequence = broadcasts_sent();
+    }
+
+    // Send the response
+    send_response(client, &response);
+}
+
+/*
+* User exists function
+* @param username: the username to check
+* @return: 1 if the user exists, 0 if not
+* This function will be used to check if the user exists in the list, the caller holds client_lock
+*/
+int user_exists(char *username) {
+    return name_index_find(&names, username) != NULL;
+}
+
+/*
+* Find client function
+* @param username: the username to look for
+* @return: the client with a reference the caller releases, NULL if not found
+*/
+CNode *find_client(char *username) {
+    pthread_rwlock_rdlock(&client_lock);
+    CNode *current = (CNode *) name_index_find(&names, username);
+    // The server keeps its name but is not a user
+    if (current == root_usr) {
+        current = NULL;
+    }
+    if (current) {
+        node_retain(current);
+    }
+    pthread_rwlock_unlock(&client_lock);
+    return current;
+}
+
+/*
+* Reserve presence slot function
+* @param client: the client node
+* @return: the slot of the client, -1 if the maximum number of users is reached
+* This function will be used to give a registered client its place in the presence table, the caller holds client_lock for writing
+*/
+int reserve_presence_slot(CNode *client) {
+    if (client->slot < 0 && presence.count < config.max_users) {
+        client->slot = presence_acquire(&presence, client);
+        if (client->slot < 0) {
+            // The table is full, double it (up to the limit) and try again
+            int capacity = presence.capacity * 2 < config.max_users ? presence.capacity * 2 : config.max_users;
+            pthread_mutex_lock(&status_mutex);
+            int grown = presence_grow(&presence, capacity);
+            pthread_mutex_unlock(&status_mutex);
+            if (grown == 0) {
+                client->slot = presence_acquire(&presence, client);
+            }
+        }
+    }
+    if (client->slot >= 0) {
+        set_client_status(client, client->status);
+    }
+    return client->slot;
+}
+
+/*
+* Find stream function
+* @param client: the client node
+* @param id: the message id the client gave the stream
+* @return: the open stream, NULL if there is none with that id
+*/
+Stream *find_stream(CNode *client, uint32_t id) {
+    for (int i = 0; client->streams && i < MAX_STREAMS; i++) {
+        if (client->streams[i].open && client->streams[i].id == id) {
+            return &client->streams[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+* Open stream function
+* @param client: the client node
+* @param id: the message id the client gave the stream
+* @return: a free stream for the id, NULL if the client has MAX_STREAMS open
+* This function will be used by the worker of the client, the streams are allocated by the first one
+*/
+Stream *open_stream(CNode *client, uint32_t id) {
+    if (client->streams == NULL) {
+        client->streams = (Stream *) calloc(MAX_STREAMS, sizeof(Stream));
+        if (client->streams == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        mem_charge(MEM_CONNECTIONS, sizeof(Stream) * MAX_STREAMS);
+        __atomic_add_fetch(&client->memory, sizeof(Stream) * MAX_STREAMS, __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        if (!client->streams[i].open) {
+            memset(&client->streams[i], 0, sizeof(Stream));
+            client->streams[i].id = id;
+            client->streams[i].slot = -1;
+            return &client->streams[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+* Stream recipient function
+* @param stream: a direct stream
+* @return: the recipient with a reference the caller releases, NULL if it left
+* This function will be used for every chunk, the slot of the recipient is checked first so only
+* a recipient that moved (like after a hot restart) is looked up by name
+*/
+CNode *stream_recipient(Stream *stream) {
+    CNode *recipient = NULL;
+    pthread_rwlock_rdlock(&client_lock);
+    if (stream->slot >= 0 && stream->slot < presence.capacity) {
+        recipient = (CNode *) presence.owners[stream->slot];
+        if (recipient && strcmp(recipient->name, stream->recipient) == 0) {
+            node_retain(recipient);
+        } else {
+            recipient = NULL;
+        }
+    }
+    pthread_rwlock_unlock(&client_lock);
+    if (recipient == NULL) {
+        recipient = find_client(stream->recipient);
+        stream->slot = recipient ? recipient->slot : -1;
+    }
+    return recipient;
+}
+
+/*
+* Relay chunk function
+* @param client: the sender
+* @param stream: the stream of the chunk
+* @param type: what the chunk does
+* @param data: the content of a DATA chunk, NULL for none
+* @param len: the size of the content
+* @return: 0 if successful, -1 if the recipient of a direct stream left
+* This function will be used to pass a chunk on as it comes, one frame for every recipient of a broadcast
+*/
+int relay_chunk(CNode *client, Stream *stream, Chat__ChunkType type, uint8_t *data, size_t len) {
+    CNode *recipient = NULL;
+    if (!stream->broadcast && (recipient = stream_recipient(stream)) == NULL) {
+        return -1;
+    }
+    Chat__MessageChunk chunk = CHAT__MESSAGE_CHUNK__INIT;
+    chunk.message_id = stream->id;
+    chunk.type = type;
+    chunk.data.data = data;
+    chunk.data.len = len;
+    chunk.sender = client->name;
+    chunk.message_type = stream->broadcast ? CHAT__MESSAGE_TYPE__BROADCAST : CHAT__MESSAGE_TYPE__DIRECT;
+
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__OK;
+    response.operation = CHAT__OPERATION__INCOMING_CHUNK;
+    response.result_case = CHAT__RESPONSE__RESULT_CHUNK;
+    response.message = "";
+    response.chunk = &chunk;
+
+    Frame *frame = pack_response(&response);
+    if (stream->broadcast) {
+        broadcast_frame(client, frame);
+    } else {
+        send_frame(recipient, frame);
+        node_release(recipient);
+    }
+    frame_release(frame);
+    __atomic_add_fetch(&streamed_bytes, len, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/*
+* Answer chunk function
+* @param client: the sender
+* @param id: the message id of the stream
+* @param type: END if the message was sent, ABORT if the stream was refused or stopped
+* @param code: the status code
+* @param message: the message for the sender
+* @return: void
+*/
+void answer_chunk(CNode *client, uint32_t id, Chat__ChunkType type, Chat__StatusCode code, char *message) {
+    Chat__MessageChunk chunk = CHAT__MESSAGE_CHUNK__INIT;
+    chunk.message_id = id;
+    chunk.type = type;
+
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = code;
+    response.operation = CHAT__OPERATION__SEND_CHUNK;
+    response.result_case = CHAT__RESPONSE__RESULT_CHUNK;
+    response.message = message;
+    response.chunk = &chunk;
+    if (code == CHAT__STATUS_CODE__SERVICE_UNAVAILABLE) {
+        response.retry_after_ms = retry_after();
+    }
+
+    // Send the response
+    send_response(client, &response);
+}
+
+/*
+* Close upload function
+* @param stream: the stream of an upload, its file is open
+* @param keep: 1 if the attachment was shared, 0 to remove its file
+* @return: void
+*/
+void close_upload(Stream *stream, int keep) {
+    if (!keep) {
+        attachment_remove(stream->file);
+    }
+    attachment_release(stream->file);
+    stream->file = NULL;
+    stream->attachment = 0;
+    stream->open = 0;
+}
+
+/*
+* Park window function
+* @param client: a registered client whose connection is lost
+* @return: void
+* This function will be used by the I/O thread of the client before it is removed, its window waits
+* resume_grace seconds for the user to register again, the frames still queued included
+*/
+void park_window(CNode *client) {
+    if (config.resume_grace == 0 || config.retransmit_window == 0) {
+        return;
+    }
+    window_queue(client);
+    window_trim(&client->window, __atomic_load_n(&client->acked, __ATOMIC_ACQUIRE));
+    // Even an empty window is kept, a resume learns nothing was lost
+    parked_put(&parked, client->name, client->session_token, client->status, &client->window, __atomic_load_n(&client->direct_sequence, __ATOMIC_RELAXED), time(NULL));
+}
+
+/*
+* Handoff frame function
+* @param channel: the handoff socket
+* @param frame: a queued frame
+* @param offset: the bytes of the frame that were already sent
+* @return: 0 if successful, -1 if failed
+* This function will be used on a hot restart to pass the rest of a frame on in chunks, the content of a file frame is read from its file
+* and the body of a split frame is passed on with it
+*/
+int handoff_frame(int channel, Frame *frame, size_t offset) {
+    unsigned char content[HANDOFF_CHUNK];
+    int result = 0;
+    while (offset < frame->len && result == 0) {
+        if (offset < frame->head) {
+            size_t len = frame->head - offset < HANDOFF_CHUNK ? frame->head - offset : HANDOFF_CHUNK;
+            result = handoff_send(channel, frame->data + offset, len, NULL, 0);
+            offset += len;
+        } else if (frame->body) {
+            size_t len = frame->len - offset < HANDOFF_CHUNK ? frame->len - offset : HANDOFF_CHUNK;
+            result = handoff_send(channel, frame->body->data + (offset - frame->head), len, NULL, 0);
+            offset += len;
+        } else {
+            size_t len = frame->len - offset < HANDOFF_CHUNK ? frame->len - offset : HANDOFF_CHUNK;
+            ssize_t bytes = pread(frame->file->fd, content, len, frame->file_offset + (offset - frame->head));
+            result = bytes == (ssize_t) len ? handoff_send(channel, content, len, NULL, 0) : -1;
+            offset += len;
+        }
+    }
+    return result;
+}
+
+/*
+* Handoff kept frame function
+* @param channel: the handoff socket
+* @param frame: a frame kept for a resume, NULL if its content is not kept
+* @return: 0 if successful, -1 if failed
+* This function will be used on a hot restart to pass a retransmit window on, frame by frame
+*/
+int handoff_kept_frame(int channel, Frame *frame) {
+    HandoffKept kept = {0, LANE_CONTROL};
+    // A file frame still queued is numbered but a resume does not send it again
+    if (frame && frame->lane != LANE_FILE) {
+        kept.len = frame->len;
+        kept.lane = frame->lane;
+    }
+    int result = handoff_send(channel, &kept, sizeof(kept), NULL, 0);
+    return result == 0 && kept.len > 0 ? handoff_frame(channel, frame, 0) : result;
+}
+
+/*
+* Takeover window function
+* @param channel: the handoff socket
+* @param window: an empty window
+* @param sent: the frames numbered so far
+* @param kept: how many of the last ones follow
+* @return: 0 if successful, -1 if failed
+* This function will be used by a new server to rebuild a retransmit window the old one kept
+*/
+int takeover_window(int channel, RetransmitWindow *window, uint64_t sent, uint32_t kept) {
+    window->sent = sent - kept;
+    for (uint32_t k = 0; k < kept; k++) {
+        HandoffKept header;
+        if (handoff_recv_all(channel, &header, sizeof(header)) == -1) {
+            return -1;
+        }
+        Frame *frame = NULL;
+        if (header.len > 0) {
+            frame = frame_create(header.len);
+            if (frame == NULL || handoff_recv_all(channel, frame->data, frame->len) == -1) {
+                if (frame) {
+                    frame_release(frame);
+                }
+                return -1;
+            }
+            frame->lane = header.lane >= 0 && header.lane < LANES ? header.lane : LANE_CONTROL;
+        }
+        window_push(window, frame, (uint32_t) config.retransmit_window);
+        if (frame) {
+            frame_release(frame);
+        }
+    }
+    return 0;
+}
+
+/*
+* Collect clients function
+* @param count: where to store the number of clients
+* @return: the connected clients with a reference each, the caller releases them and frees the array
+* This function will be used by the main thread to send to every client without holding the list lock
+*/
+CNode **collect_clients(int *count) {
+    pthread_rwlock_rdlock(&client_lock);
+    CNode **clients = (CNode **) malloc(sizeof(CNode *) * (connected_users + 1));
+    if (clients == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    *count = 0;
+    for (CNode *client = root_usr->linked_to; client; client = client->linked_to) {
+        clients[(*count)++] = node_retain(client);
+    }
+    pthread_rwlock_unlock(&client_lock);
+    return clients;
+}
+
+/*
+* Assign threads function
+* @param client: a new client node
+* @return: void
+* This function will be used to give a connection its I/O thread and worker, they do not change while it is open
+*/
+void assign_threads(CNode *client) {
+    client->io = next_io;
+    client->worker = next_worker;
+    next_io = (next_io + 1) % io_count;
+    next_worker = (next_worker + 1) % worker_count;
+    // One reference for the list and one for the I/O thread
+    client->refs = 2;
+}
+
+/*
+* Create threads function
+* @return: void
+* This function will be used to create the I/O threads, the workers and the rings between them
+*/
+void create_threads() {
+    io_count = config.io_threads;
+    worker_count = config.worker_threads;
+    io_threads = (IOThread *) calloc(io_count, sizeof(IOThread));
+    workers = (Worker *) calloc(worker_count, sizeof(Worker));
+    job_rings = (SpscRing *) aligned_alloc(CACHE_LINE, sizeof(SpscRing) * io_count * worker_count);
+    if (!io_threads || !workers || !job_rings) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < io_count * worker_count; i++) {
+        if (spsc_init(&job_rings[i], config.ring_size) == -1) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < io_count; i++) {
+        io_threads[i].id = i;
+        mpsc_init(&io_threads[i].ready);
+        // Only the bookkeeping is allocated here, the buffers are allocated by the I/O thread
+        pool_init(&io_threads[i].pool, config.buffer_size, config.pool_cached);
+        pthread_mutex_init(&io_threads[i].stash_lock, NULL);
+        io_threads[i].pinned = cpu_list_nth(&io_cpu_set, i);
+        io_threads[i].epoll_descript = epoll_create1(0);
+        if (io_threads[i].epoll_descript == -1 || waker_init(&io_threads[i].waker, 1) == -1) {
+            printf("Event loop creation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        // The waker is the only event without a client
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+        epoll_ctl(io_threads[i].epoll_descript, EPOLL_CTL_ADD, io_threads[i].waker.descript, &event);
+    }
+    for (int w = 0; w < worker_count; w++) {
+        workers[w].id = w;
+        workers[w].pinned = cpu_list_nth(&worker_cpu_set, w);
+        if (waker_init(&workers[w].waker, 0) == -1) {
+            printf("Worker creation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/*
+* Pause ack function
+* @param park: 1 to wait until the threads are resumed
+* @return: void
+* This function will be used by a thread that reached the point asked by the current pause phase
+*/
+void pause_ack(int park) {
+    pthread_mutex_lock(&pause_mutex);
+    paused_threads++;
+    pthread_cond_broadcast(&pause_cond);
+    while (park && pause_phase != 0) {
+        pthread_cond_wait(&pause_cond, &pause_mutex);
+    }
+    pthread_mutex_unlock(&pause_mutex);
+}
+
+/*
+* Pause phase function
+* @param phase: the next pause phase
+* @param threads: the number of threads that have to acknowledge it
+* @return: void
+*/
+void pause_phase_wait(int phase, int threads) {
+    pthread_mutex_lock(&pause_mutex);
+    paused_threads = 0;
+    __atomic_store_n(&pause_phase, phase, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&pause_mutex);
+    for (int i = 0; i < io_count; i++) {
+        waker_wake(&io_threads[i].waker);
+    }
+    for (int w = 0; w < worker_count; w++) {
+        waker_wake(&workers[w].waker);
+    }
+    pthread_mutex_lock(&pause_mutex);
+    while (paused_threads < threads) {
+        pthread_cond_wait(&pause_cond, &pause_mutex);
+    }
+    pthread_mutex_unlock(&pause_mutex);
+}
+
+/*
+* Pause threads function
+* @return: void
+* This function will be used before a hand over, once it returns every request read was handled,
+* every response was written or queued on its client and no other thread touches the clients
+*/
+void pause_threads() {
+    if (!threads_started) {
+        return;
+    }
+    pause_phase_wait(1, io_count);
+    pause_phase_wait(2, worker_count);
+    pause_phase_wait(3, io_count);
+}
+
+/*
+* Resume threads function
+* @return: void
+*/
+void resume_threads() {
+    if (!threads_started) {
+        return;
+    }
+    pthread_mutex_lock(&pause_mutex);
+    __atomic_store_n(&pause_phase, 0, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pause_cond);
+    pthread_mutex_unlock(&pause_mutex);
+}
+
+/*
+* SERVICES AREA
+*/
+
+/*
+* Exit service function
+* @param signal: the signal
+* @return: void
+* This function will be used by the event loop to close the server, the nodes are left to the system since other threads may still hold them
+*/
+void exit_service(int signal) {
+    // While there are users in the list, close the connection
+    pthread_rwlock_rdlock(&client_lock);
+    for (CNode *client = root_usr ? root_usr->linked_to : NULL; client; client = client->linked_to) {
+        // Close the connection
+        close(client->data);
+        printf("Connection closed for %s\n", client->ip);
+    }
+    pthread_rwlock_unlock(&client_lock);
+    // Close the server socket
+    close(srv_socket_descript);
+    if (restart_descript != -1) {
+        close(restart_descript);
+        unlink(restart_path);
+    }
+    printf("\nShutting down...\n");
+    exit(EXIT_SUCCESS);
+}
+
+/*
+* Drain signal function
+* @param signal: the signal
+* @return: void
+* This function will be used to ask the event loop for a graceful shutdown, a second signal asks it to exit
+* right away. The signals are only counted here, the event loop wakes up and closes the sockets
+*/
+void drain_signal(int signal) {
+    if (drain_requested < 2) {
+        drain_requested++;
+    }
+}
+
+/*
+* Drain service function
+* @return: void
+* This function will be used by the event loop to stop accepting clients and tell the connected ones
+* to reconnect elsewhere, the server keeps delivering messages until they leave or the deadline passes
+*/
+void drain_service() {
+    draining = 1;
+    clock_gettime(CLOCK_MONOTONIC, &drain_start);
+    printf("Draining %d clients, closing in at most %d seconds\n", connected_users, config.drain_timeout);
+
+    // Stop accepting, the load balancer sees the port closed and sends new clients elsewhere
+    close(srv_socket_descript);
+    srv_socket_descript = -1;
+    root_usr->data = -1;
+    if (restart_descript != -1) {
+        close(restart_descript);
+        unlink(restart_path);
+        restart_descript = -1;
+    }
+
+    Chat__ServerNoticeResponse notice = CHAT__SERVER_NOTICE_RESPONSE__INIT;
+    notice.type = CHAT__NOTICE_TYPE__DRAINING;
+    notice.redirect = drain_redirect;
+    notice.deadline_seconds = config.drain_timeout;
+
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__OK;
+    response.result_case = CHAT__RESPONSE__RESULT_SERVER_NOTICE;
+    response.operation = CHAT__OPERATION__SERVER_NOTICE;
+    response.message = "The server is shutting down, please reconnect!";
+    response.server_notice = &notice;
+
+    // Every client gets the same frame, nothing is sent while the list is locked
+    Frame *frame = pack_response(&response);
+    int count = 0;
+    CNode **clients = collect_clients(&count);
+    for (int i = 0; i < count; i++) {
+        send_frame(clients[i], frame);
+        node_release(clients[i]);
+    }
+    free(clients);
+    frame_release(frame);
+}
+
+/*
+* Client delivered function
+* @param client: the client node
+* @return: 1 if nothing waits to be written to the client and it acknowledged every frame written
+* This function will be used by the event loop while draining, the fields of the I/O thread and the
+* worker are only read so the answer is a snapshot
+*/
+int client_delivered(CNode *client) {
+    if (!mpsc_empty(&client->mailbox) || __atomic_load_n(&client->out_bytes, __ATOMIC_RELAXED) > 0
+        || __atomic_load_n(&client->downloads, __ATOMIC_RELAXED) != NULL) {
+        return 0;
+    }
+    // A client that never registered does not acknowledge, a written queue is all it gets
+    return client->slot < 0 || __atomic_load_n(&client->acked, __ATOMIC_ACQUIRE) >= __atomic_load_n(&client->window.sent, __ATOMIC_RELAXED);
+}
+
+/*
+* Drain done function
+* @return: 1 if the server can exit
+* This function will be used by the event loop to close every client that got all its frames, the
+* notice included, and to end the drain once they are all closed or the deadline passed
+*/
+int drain_done() {
+    int count = 0, waiting = 0;
+    CNode **clients = collect_clients(&count);
+    for (int i = 0; i < count; i++) {
+        if (!client_delivered(clients[i])) {
+            waiting++;
+        } else if (!clients[i]->drained) {
+            // Closed after the frames already posted, the client reconnects with its session
+            clients[i]->drained = 1;
+            close_client(clients[i]);
+        }
+        node_release(clients[i]);
+    }
+    free(clients);
+    // The I/O threads write what was posted before the closes, the server exits once the last one is closed
+    if (connected_users > 0 && elapsed_ms(&drain_start) < config.drain_timeout * 1000.0) {
+        return 0;
+    }
+    printf("Drained in %.3f ms, %d clients still connected, %d waiting for their frames, %zu bytes undelivered\n", elapsed_ms(&drain_start), connected_users, waiting, queued_bytes);
+    return 1;
+}
+
+/*
+* Arm heartbeat function
+* @param client: a client that is not watched yet
+* @return: void
+* This function will be used to start the heartbeat of a connection before its socket is watched
+*/
+void arm_heartbeat(CNode *client) {
+    time_t now = time(NULL);
+    client->last_heard = now;
+    pthread_mutex_lock(&heartbeats.lock);
+    timer_arm(&heartbeats, &client->heartbeat, now + (config.ping_interval > 0 ? config.ping_interval : TIMER_SLOTS));
+    pthread_mutex_unlock(&heartbeats.lock);
+}
+
+/*
+* Tune keepalive function
+* @param descript: a client socket
+* @return: void
+* This function will be used to let TCP notice a peer that is gone without the heartbeat, even
+* while the server has data queued for it that is never acknowledged
+*/
+void tune_keepalive(int descript) {
+    int on = config.keepalive_idle > 0;
+    setsockopt(descript, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+    if (on) {
+        setsockopt(descript, IPPROTO_TCP, TCP_KEEPIDLE, &config.keepalive_idle, sizeof(int));
+        setsockopt(descript, IPPROTO_TCP, TCP_KEEPINTVL, &config.keepalive_interval, sizeof(int));
+        setsockopt(descript, IPPROTO_TCP, TCP_KEEPCNT, &config.keepalive_count, sizeof(int));
+    }
+    unsigned int user_timeout = (unsigned int) config.user_timeout_ms;
+    setsockopt(descript, IPPROTO_TCP, TCP_USER_TIMEOUT, &user_timeout, sizeof(user_timeout));
+}
+
+/*
+* Heartbeat service function
+* @return: void
+* This function will be used by the main thread once per second. Only the timers that are due are
+* looked at: a client heard from since its timer was armed gets a new one, a quiet one is pinged,
+* and one that stayed quiet ping_timeout seconds after the ping is closed
+*/
+void heartbeat_service() {
+    time_t now = time(NULL);
+    // Closing takes the timer out with the lock held, so the clients stay valid while it is
+    pthread_mutex_lock(&heartbeats.lock);
+    TimerLink *due = timer_turn(&heartbeats, now);
+    while (due) {
+        CNode *client = timer_entry(due, CNode, heartbeat);
+        due = due->next;
+        if (config.ping_interval == 0) {
+            timer_arm(&heartbeats, &client->heartbeat, now + TIMER_SLOTS);
+            continue;
+        }
+        time_t quiet = now - __atomic_load_n(&client->last_heard, __ATOMIC_RELAXED);
+        if (quiet >= config.ping_interval + config.ping_timeout) {
+            printf("No answer from %s for %ld s, closing the connection\n", client->name, (long) quiet);
+            reaped_heartbeat++;
+            close_client(client);
+        } else if (quiet >= config.ping_interval) {
+            Chat__Response response = CHAT__RESPONSE__INIT;
+            response.status_code = CHAT__STATUS_CODE__OK;
+            response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+            response.operation = CHAT__OPERATION__PING;
+            response.message = "";
+
+            // Send the response
+            send_response(client, &response);
+            pings_sent++;
+            timer_arm(&heartbeats, &client->heartbeat, now - quiet + config.ping_interval + config.ping_timeout);
+        } else {
+            timer_arm(&heartbeats, &client->heartbeat, now - quiet + config.ping_interval);
+        }
+    }
+    pthread_mutex_unlock(&heartbeats.lock);
+}
+
+/*
+* Inactivity service function
+* @return: void
+* This function will be used by the main thread to mark inactive clients as busy, it replaces a thread per client
+*/
+void inactivity_service() {
+    time_t now = time(NULL);
+    int count = 0;
+    CNode **clients = collect_clients(&count);
+    for (int i = 0; i < count; i++) {
+        CNode *client = clients[i];
+        if(client->status == CHAT__USER_STATUS__ONLINE && now - client->last_seen > config.inactive_time) {
+            set_client_status(client, CHAT__USER_STATUS__BUSY);
+
+            Chat__Response response = CHAT__RESPONSE__INIT;
+            response.status_code = CHAT__STATUS_CODE__OK;
+            response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+            response.operation = CHAT__OPERATION__UPDATE_STATUS;
+            response.message = "\033[0;33mWARNING!\033[0m Status changed to \033[0;36mBUSY\033[0m due to inactivity!";
+
+            // Send the response
+            send_response(client, &response);
+        }
+        node_release(client);
+    }
+    free(clients);
+}
+
+/*
+* Register user service function
+* @param client: the client node
+* @param request: the username, and the token and the frames received of a session to resume
+* @return: void
+* This function will be used to register the user in the list. A client with the token of the last
+* registration of the name takes its session back: its status, its direct message numbers and the
+* frames it did not receive, sent right after the answer. Without the token a parked name is refused
+*/
+void set_username_service(CNode *client, Chat__NewUserRequest *request) {
+    char *username = request->username;
+    if (strlen(username) < 1 || strlen(username) > (size_t) config.username_length) {
+        Chat__Response response = CHAT__RESPONSE__INIT;
+        response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
+        response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+        response.message = "Invalid username length!";
+
+        // Send the response
+        send_response(client, &response);
+        return;
+    }
+    unsigned char *token = request->session_token.len == SESSION_TOKEN_LENGTH ? request->session_token.data : NULL;
+    unsigned char issued[SESSION_TOKEN_LENGTH];
+    if (getrandom(issued, SESSION_TOKEN_LENGTH, 0) != SESSION_TOKEN_LENGTH) {
+        Chat__Response response = CHAT__RESPONSE__INIT;
+        response.status_code = CHAT__STATUS_CODE__INTERNAL_SERVER_ERROR;
+        response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+        response.message = "Could not create a session!";
+
+        // Send the response
+        send_response(client, &response);
+        return;
+    }
+
+    // The check and the registration happen under the same lock, two workers cannot take the same name
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+    char *error = NULL;
+    ParkedWindow session;
+    int claim = -1;
+    pthread_rwlock_wrlock(&client_lock);
+    CNode *holder = (CNode *) name_index_find(&names, username);
+    if (holder && holder != client && holder->slot >= 0 && token && token_equal(holder->session_token, token)) {
+        // The connection the client lost is still open here, it goes and parks the session
+        close_client(holder);
+        error = "Your earlier connection is being closed, try again!";
+        response.status_code = CHAT__STATUS_CODE__SERVICE_UNAVAILABLE;
+        response.retry_after_ms = SESSION_TAKEOVER_MS;
+    } else if (holder) {
+        error = "User already exists!";
+    } else if ((claim = parked_claim(&parked, username, token, &session)) == -2) {
+        time_t left = session.parked_at + config.resume_grace - time(NULL);
+        error = "Username is kept for a session that may resume!";
+        response.retry_after_ms = (left > 0 ? left : 1) * 1000;
+    } else {
+        // The session goes on with the status it had
+        if (claim == 0 && request->resume) {
+            client->status = session.status;
+        }
+        if (reserve_presence_slot(client) < 0) {
+            // Check if the maximum number of users is reached, the presence table keeps the count
+            error = "Maximum number of users reached!";
+        } else {
+            // A client that registers again leaves its old name
+            name_index_remove(&names, client);
+            snprintf(client->name, sizeof(client->name), "%s", username);
+            if (name_index_insert(&names, client) < 0) {
+                printf("Memory allocation failed!\n");
+                exit(EXIT_FAILURE);
+            }
+            memcpy(client->session_token, issued, SESSION_TOKEN_LENGTH);
+        }
+    }
+    pthread_rwlock_unlock(&client_lock);
+
+    uint64_t from = 0;
+    if (error) {
+        if (response.status_code == 0) {
+            response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
+        }
+        response.message = error;
+    } else {
+        handshake_done(client);
+        printf("User %s joined the server!\n", client->name);
+        response.status_code = CHAT__STATUS_CODE__OK;
+        response.message = "User registered successfully!";
+        response.session_token.data = client->session_token;
+        response.session_token.len = SESSION_TOKEN_LENGTH;
+    }
+    int resumed = error == NULL && claim == 0 && request->resume;
+    if (resumed) {
+        // Frames after the ones received, those older than the window are lost
+        uint64_t received = request->received;
+        from = received + 1 > window_first(&session.window) ? received + 1 : window_first(&session.window);
+        response.lost = from - (received + 1);
+        for (uint64_t seq = from; seq <= session.window.sent; seq++) {
+            if (window_at(&session.window, seq)) {
+                response.replayed++;
+            } else {
+                response.lost++;
+            }
+        }
+        response.message = "User resumed successfully!";
+        response.resumed = 1;
+        response.status = client->status;
+        // Parked it got no broadcast, the ones sent meanwhile are not lost
+        response.broadcast_sequence = broadcasts_sent();
+        // No direct message was sent to the new connection yet, its numbers go on
+        __atomic_store_n(&client->direct_sequence, session.direct_sequence, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&resumed_sessions, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&replayed_frames, response.replayed, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&lost_frames, response.lost, __ATOMIC_RELAXED);
+    } else if (error == NULL && request->resume) {
+        response.message = "User registered successfully, nothing was kept to resume!";
+    }
+
+    // Send the response, then the frames the client missed in the order they were written
+    send_response(client, &response);
+    if (claim == 0) {
+        for (uint64_t seq = from; resumed && seq <= session.window.sent; seq++) {
+            Frame *frame = window_at(&session.window, seq);
+            if (frame) {
+                send_frame(client, frame);
+            }
+        }
+        window_free(&session.window);
+    }
+    // Its followers saw it leave, the session is back with its status
+    if (resumed && client->status != CHAT__USER_STATUS__OFFLINE) {
+        push_presence(client, client->status);
+    }
+}
+
+/*
+* Shed registration service function
+* @param client: the client node
+* @return: void
+* This function will be used to refuse a registration while the worker of the client is behind, the client is told when to come back
+*/
+void shed_registration_service(CNode *client) {
+    __atomic_add_fetch(&shed_registrations, 1, __ATOMIC_RELAXED);
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__SERVICE_UNAVAILABLE;
+    response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+    response.operation = CHAT__OPERATION__REGISTER_USER;
+    response.message = "Server is busy, try again later!";
+    response.retry_after_ms = retry_after();
+
+    // Send the response
+    send_response(client, &response);
+}
+
+/*
+* Throttle service function
+* @param client: the client node
+* @param operation: the operation of the refused request
+* @param wait: the milliseconds until the client may send it again
+* @return: void
+* This function will be used to answer a request over the rate limit of the client, it is not handled
+*/
+void throttle_service(CNode *client, Chat__Operation operation, uint32_t wait) {
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__TOO_MANY_REQUESTS;
+    response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+    response.operation = operation;
+    response.message = "Too many requests, slow down!";
+    response.retry_after_ms = wait;
+
+    // Send the response
+    send_response(client, &response);
+}
+
+/*
+* Lookup users service function
+* @param client: the client that asked
+* @param request: the names to look up, or the prefix of the names
+* @return: void
+* This function will be used to find several users in one request or complete a name, every name costs
+* one walk of the name index, never a pass over all the users
+*/
+void lookup_users_service(CNode *client, Chat__UserListRequest *request) {
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
+    response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+    response.operation = CHAT__OPERATION__GET_USERS;
+    if (request->n_usernames > (size_t) config.lookup_limit) {
+        response.message = "Too many usernames!";
+        send_response(client, &response);
+        return;
+    }
+    int prefix = request->n_usernames == 0;
+    int limit = prefix ? config.lookup_limit : (int) request->n_usernames;
+    if (prefix && request->limit > 0 && request->limit < (uint32_t) limit) {
+        limit = request->limit;
+    }
+
+    // One more, the server has a name but is not a user. lookup_limit may be large, not on the stack
+    void **found = (void **) malloc(sizeof(void *) * (limit + 1));
+    Chat__User *user_data = (Chat__User *) malloc(sizeof(Chat__User) * (limit + 1));
+    Chat__User **users = (Chat__User **) malloc(sizeof(Chat__User *) * (limit + 1));
+    if (found == NULL || user_data == NULL || users == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    int count = 0;
+    int n = 0;
+    pthread_rwlock_rdlock(&client_lock);
+    if (prefix) {
+        n = name_index_prefix(&names, request->prefix, found, limit + 1);
+    } else {
+        for (size_t i = 0; i < request->n_usernames; i++) {
+            found[n++] = name_index_find(&names, request->usernames[i]);
+        }
+    }
+    for (int i = 0; i < n && count < limit; i++) {
+        CNode *current = (CNode *) found[i];
+        if (current == NULL || current == root_usr) {
+            continue;
+        }
+        chat__user__init(&user_data[count]);
+        user_data[count].username = current->name;
+        user_data[count].status = current->status;
+        users[count] = &user_data[count];
+        count++;
+    }
+
+    Chat__UserListResponse user_list = CHAT__USER_LIST_RESPONSE__INIT;
+    user_list.n_users = count;
+    user_list.users = users;
+    user_list.type = prefix ? CHAT__USER_LIST_TYPE__PREFIX : CHAT__USER_LIST_TYPE__BATCH;
+
+    char summary[64];
+    if (prefix) {
+        snprintf(summary, sizeof(summary), "Users starting with the prefix: %d", count);
+    } else {
+        snprintf(summary, sizeof(summary), "Users found: %d of %d", count, n);
+    }
+    response.status_code = CHAT__STATUS_CODE__OK;
+    response.result_case = CHAT__RESPONSE__RESULT_USER_LIST;
+    response.message = summary;
+    response.user_list = &user_list;
+
+    // The names are read from the nodes, the response is packed before unlocking
+    Frame *frame = pack_response(&response);
+    pthread_rwlock_unlock(&client_lock);
+
+    // Send the response
+    send_frame(client, frame);
+    frame_release(frame);
+    free(found);
+    free(user_data);
+    free(users);
+}
+
+/*
+* Subscribe presence service function
+* @param client: the follower
+* @param request: the usernames to follow or stop following
+* @return: void
+* This function will be used so a client learns the status changes of some users without asking for
+* the user list, the answer has the statuses of the ones connected now and the changes are pushed
+*/
+void subscribe_presence_service(CNode *client, Chat__PresenceRequest *request) {
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
+    response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+    response.operation = CHAT__OPERATION__SUBSCRIBE_PRESENCE;
+    if (config.max_watches == 0) {
+        response.message = "Presence subscriptions are turned off!";
+        send_response(client, &response);
+        return;
+    }
+    if (request->n_usernames > (size_t) config.max_watches) {
+        response.message = "Too many usernames!";
+        send_response(client, &response);
+        return;
+    }
+
+    // The names the client follows after the request, only their statuses are answered
+    size_t asked = request->unsubscribe ? 0 : request->n_usernames;
+    char **followed = (char **) malloc(sizeof(char *) * (asked + 1));
+    Chat__User *user_data = (Chat__User *) malloc(sizeof(Chat__User) * (asked + 1));
+    Chat__User **users = (Chat__User **) malloc(sizeof(Chat__User *) * (asked + 1));
+    if (followed == NULL || user_data == NULL || users == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t accepted = 0;
+    int full = 0;
+    pthread_rwlock_wrlock(&watches.lock);
+    for (size_t i = 0; i < request->n_usernames; i++) {
+        char *name = request->usernames[i];
+        if (strlen(name) < 1 || strlen(name) > (size_t) config.username_length) {
+            continue;
+        }
+        if (request->unsubscribe) {
+            watch_remove(&watches, &client->watching, name);
+            continue;
+        }
+        if (!watch_follows(&watches, &client->watching, name)) {
+            if (client->watching.count >= config.max_watches) {
+                full = 1;
+                continue;
+            }
+            if (watch_add(&watches, &client->watching, client, name) < 0) {
+                printf("Memory allocation failed!\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        followed[accepted++] = name;
+    }
+    int count = client->watching.count;
+    pthread_rwlock_unlock(&watches.lock);
+
+    // The statuses now, the changes after them are pushed
+    int found = 0;
+    pthread_rwlock_rdlock(&client_lock);
+    for (size_t i = 0; i < accepted; i++) {
+        CNode *current = (CNode *) name_index_find(&names, followed[i]);
+        if (current == NULL || current == root_usr) {
+            continue;
+        }
+        chat__user__init(&user_data[found]);
+        user_data[found].username = current->name;
+        user_data[found].status = current->status;
+        users[found] = &user_data[found];
+        found++;
+    }
+
+    Chat__UserListResponse user_list = CHAT__USER_LIST_RESPONSE__INIT;
+    user_list.n_users = found;
+    user_list.users = users;
+    user_list.type = CHAT__USER_LIST_TYPE__BATCH;
+
+    char summary[80];
+    snprintf(summary, sizeof(summary), full ? "Following %d users, no more can be followed!" : "Following %d users", count);
+    response.status_code = CHAT__STATUS_CODE__OK;
+    response.result_case = CHAT__RESPONSE__RESULT_USER_LIST;
+    response.message = summary;
+    response.user_list = &user_list;
+
+    // The names are read from the nodes, the response is packed before unlocking
+    Frame *frame = pack_response(&response);
+    pthread_rwlock_unlock(&client_lock);
+    free(followed);
+    free(user_data);
+    free(users);
+
+    // Send the response
+    send_frame(client, frame);
+    frame_release(frame);
+}
+
+/*
+* Get all users service function
+* @return: void
+* This function will be used to get all the users in the list
+*/
+void get_all_users_service(CNode *client, char* username) {
+    if (strlen(username) > 0) {
+        printf("Get user %s\n", username);
+        printf("Searching in users...\n");
+        CNode *current = find_client(username);
+        if (current) {
+            printf("User %s found\n", username);
+            Chat__UserListResponse user_list = CHAT__USER_LIST_RESPONSE__INIT;
+            Chat__User *users[1];
+            Chat__User user;
+            chat__user__init(&user);
+            // Concat the user ip before the name
+            char user_ip[MAX_USERNAME_LENGTH+16+4];
+            snprintf(user_ip, sizeof(user_ip), "%s (%s)", current->name, current->ip);
+            user.username = user_ip;
+            user.status = current->status;
+            users[0] = &user;
+            user_list.n_users = 1;
+            user_list.users = users;
+            user_list.type = CHAT__USER_LIST_TYPE__SINGLE;
+
+            Chat__Response response = CHAT__RESPONSE__INIT;
+            response.status_code = CHAT__STATUS_CODE__OK;
+            response.result_case = CHAT__RESPONSE__RESULT_USER_LIST;
+            response.operation = CHAT__OPERATION__GET_USERS;
+            response.message = "User retrieved successfully!";
+            response.user_list = &user_list;
+
+            printf("User %s retrieved successfully!\n", username);
+            // Send the response
+            send_response(client, &response);
+            printf("User %s sent successfully!\n", username);
+            node_release(current);
+        } else {
+            printf("User %s not found\n", username);
+            Chat__Response response = CHAT__RESPONSE__INIT;
+            response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
+            response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+            response.message = "User not found!";
+
+            // Send the response
+            send_response(client, &response);
+        }
+    } else {
+        printf("Get all users\n");
+        // Lock the list while it is copied, the pages are packed before unlocking and sent after
+        pthread_rwlock_rdlock(&client_lock);
+        CNode *current = root_usr;
+        // Size the list from the connected users counter, one allocation for all the users
+        Chat__User **users = malloc(sizeof(Chat__User *) * (connected_users + 1));
+        Chat__User *user_data = malloc(sizeof(Chat__User) * (connected_users + 1));
+        if (users == NULL || user_data == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        int i = 0;
+        printf("Searching in users...\n");
+        while(current) {
+            if (strcmp(current->name, "Server") == 0) {
+                current = current->linked_to;
+                continue;
+            }
+            Chat__User *user = &user_data[i];
+            chat__user__init(user);
+            user->username = current->name;
+            user->status = current->status;
+            users[i] = user;
+            i++;
+            current = current->linked_to;
+        }
+        printf("Users retrieved successfully!\n");
+
+        // One frame of at most lookup_limit users per page, a roster of any size fits the buffers of the clients
+        int limit = config.lookup_limit;
+        int page_count = i > 0 ? (i + limit - 1) / limit : 1;
+        Frame **pages = malloc(sizeof(Frame *) * page_count);
+        if (pages == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int page = 0; page < page_count; page++) {
+            Chat__UserListResponse user_list = CHAT__USER_LIST_RESPONSE__INIT;
+            user_list.users = users + page * limit;
+            user_list.n_users = i - page * limit < limit ? i - page * limit : limit;
+            user_list.type = CHAT__USER_LIST_TYPE__ALL;
+            user_list.more = page < page_count - 1;
+
+            Chat__Response response = CHAT__RESPONSE__INIT;
+            response.status_code = CHAT__STATUS_CODE__OK;
+            response.operation = CHAT__OPERATION__GET_USERS;
+            response.result_case = CHAT__RESPONSE__RESULT_USER_LIST;
+            response.message = "User list retrieved successfully!";
+            response.user_list = &user_list;
+            pages[page] = pack_response(&response);
+        }
+        pthread_rwlock_unlock(&client_lock);
+        free(users);
+        free(user_data);
+
+        // Send the pages in order
+        for (int page = 0; page < page_count; page++) {
+            send_frame(client, pages[page]);
+            frame_release(pages[page]);
+        }
+        free(pages);
+    }
+    printf("User list sent successfully!\n");
+
+}
+
+/*
+* Remove client service function
+* @param to_remove: the client node to remove
+* @return: void
+* This function will be used to remove the client from the list, the socket is closed by its I/O thread
+*/
+void remove_client_service(CNode *to_remove) {
+    // Lock the list while removing the client
+    pthread_rwlock_wrlock(&client_lock);
+    if (!to_remove->active) {
+        pthread_rwlock_unlock(&client_lock);
+        return;
+    }
+    if (to_remove->linked_from) {
+        to_remove->linked_from->linked_to = to_remove->linked_to;
+        if(to_remove == current_usr) {
+            current_usr = to_remove->linked_from;
+        }
+    }
+    if (to_remove->linked_to) {
+        to_remove->linked_to->linked_from = to_remove->linked_from;
+    }
+    to_remove->linked_to = NULL;
+    to_remove->linked_from = NULL;
+    name_index_remove(&names, to_remove);
+    // Its followers see it leave, it follows nobody anymore
+    pthread_rwlock_wrlock(&watches.lock);
+    watch_clear(&watches, &to_remove->watching);
+    pthread_rwlock_unlock(&watches.lock);
+    if (to_remove->slot >= 0 && to_remove->status != CHAT__USER_STATUS__OFFLINE) {
+        push_presence(to_remove, CHAT__USER_STATUS__OFFLINE);
+    }
+    // Give the presence slot back, status changes write the same bitmap words under status_mutex
+    pthread_mutex_lock(&status_mutex);
+    presence_release(&presence, to_remove->slot);
+    to_remove->slot = -1;
+    pthread_mutex_unlock(&status_mutex);
+    connected_users--;
+    // Change the status to inactive so no more requests or frames are handled for it
+    to_remove->active = 0;
+    printf("User removed %s\n", to_remove->name);
+    pthread_rwlock_unlock(&client_lock);
+    // Drop the reference of the list, the memory is freed once no thread holds the node
+    node_release(to_remove);
+}
+
+/*
+* Answer duplicate function
+* @param client: the sender
+* @param result: what the message with the same id did
+* @return: void
+* This function will be used to answer a message that was already sent, with what it got the first time
+*/
+void answer_duplicate(CNode *client, uint64_t result) {
+    Chat__IncomingMessageResponse sent = CHAT__INCOMING_MESSAGE_RESPONSE__INIT;
+    sent.sender = client->name;
+    sent.content = "";
+    sent.type = (result & 3) == DEDUPE_BROADCAST ? CHAT__MESSAGE_TYPE__BROADCAST : CHAT__MESSAGE_TYPE__DIRECT;
+    sent.sequence = result >> 2;
+
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__OK;
+    response.result_case = CHAT__RESPONSE__RESULT_INCOMING_MESSAGE;
+    response.operation = CHAT__OPERATION__SEND_MESSAGE;
+    response.message = (result & 3) == DEDUPE_BUSY ? "\033[0;33mWARNING!\033[0m Recipient is \033[0;36mBUSY\033[0m! Message will be delivered but probably not read!" : "";
+    if ((result & 3) == DEDUPE_MULTI) {
+        response.message = "Message was already sent to its recipients!";
+    }
+    response.incoming_message = &sent;
+    response.duplicate = 1;
+    if (result == DEDUPE_PENDING) {
+        // The first one is still going out, its own answer has the number
+        response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+        response.incoming_message = NULL;
+        response.message = "Message is already being sent!";
+    }
+
+    // Send the response
+    send_response(client, &response);
+}
+
+/*
+* Already sent function
+* @param client: the sender
+* @param message_id: the id it gave the message, 0 for none
+* @param check: set if the message is now pending and has to be settled with settle_sent
+* @return: 1 if the message was sent before and the client was answered, 0 if not
+* This function will be used before a message goes out, a retry is answered from the first one and costs no fan-out
+*/
+int already_sent(CNode *client, uint64_t message_id, int *check) {
+    uint64_t result;
+    // Ids are per username, a client that did not register has none of its own
+    *check = message_id != 0 && config.dedupe_window > 0 && client->slot >= 0;
+    if (*check) {
+        __atomic_add_fetch(&dedupe_checked, 1, __ATOMIC_RELAXED);
+        if (dedupe_claim(&dedupe, client->name, message_id, config.dedupe_window, &result)) {
+            __atomic_add_fetch(&dedupe_hits, 1, __ATOMIC_RELAXED);
+            answer_duplicate(client, result);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+* Settle sent function
+* @param client: the sender
+* @param message_id: the id it gave the message
+* @param result: what the message did, DEDUPE_PENDING if it was refused
+* @return: void
+* This function will be used once a message checked by already_sent went out, or not, a refused one is
+* forgotten so its retry is handled again
+*/
+void settle_sent(CNode *client, uint64_t message_id, uint64_t result) {
+    if (result == DEDUPE_PENDING) {
+        dedupe_forget(&dedupe, client->name, message_id);
+    } else {
+        dedupe_add(&dedupe, client->name, message_id, config.dedupe_window, result);
+    }
+}
+
+void send_message_service(CNode *client, char *recipient, char *content, uint64_t message_id) {
+    int check;
+    if (already_sent(client, message_id, &check)) {
+        return;
+    }
+    uint64_t result = DEDUPE_PENDING;
+
+    if (strlen(content) > (size_t) config.message_length) {
+        Chat__Response response = CHAT__RESPONSE__INIT;
+        response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
+        response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+        response.operation = CHAT__OPERATION__SEND_MESSAGE;
+        response.message = "Message is too long!";
+
+        // Send the response
+        send_response(client, &response);
+    } else if (strlen(recipient) == 0 && mem_over()) {
+        // A broadcast makes a queue entry for every user, it is the first traffic shed when memory runs out
+        __atomic_add_fetch(&memory.shed, 1, __ATOMIC_RELAXED);
+        Chat__Response response = CHAT__RESPONSE__INIT;
+        response.status_code = CHAT__STATUS_CODE__SERVICE_UNAVAILABLE;
+        response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+        response.operation = CHAT__OPERATION__SEND_MESSAGE;
+        response.message = "Server is low on memory, broadcast dropped! Try again later";
+        response.retry_after_ms = retry_after();
+
+        // Send the response
+        send_response(client, &response);
+    } else if (strlen(recipient) == 0 ) {
+        // Send the message to all users
+        Chat__IncomingMessageResponse message = CHAT__INCOMING_MESSAGE_RESPONSE__INIT;
+        message.sender = client->name;
+        message.content = content;
+        message.type = CHAT__MESSAGE_TYPE__BROADCAST;
+        // One atomic orders the broadcasts, the workers fan them out at the same time and the
+        // recipients put them back in this order
+        message.sequence = __atomic_add_fetch(&broadcast_sequence, 1, __ATOMIC_SEQ_CST);
+
+        Chat__Response response = CHAT__RESPONSE__INIT;
+        response.status_code = CHAT__STATUS_CODE__OK;
+        response.result_case = CHAT__RESPONSE__RESULT_INCOMING_MESSAGE;
+        response.operation = CHAT__OPERATION__INCOMING_MESSAGE;
+        response.message = "Message sent successfully!";
+        response.incoming_message = &message;
+
+        // Serialize the response once, every recipient queues the same frame
+        Frame *frame = pack_response(&response);
+        broadcast_frame(client, frame);
+        frame_release(frame);
+        result = message.sequence << 2 | DEDUPE_BROADCAST;
+
+        // The sender does not get its own broadcast, only its number so it has no gap
+        Chat__IncomingMessageResponse sent = CHAT__INCOMING_MESSAGE_RESPONSE__INIT;
+        sent.sender = client->name;
+        sent.content = "";
+        sent.type = CHAT__MESSAGE_TYPE__BROADCAST;
+        sent.sequence = message.sequence;
+
+        Chat__Response answer = CHAT__RESPONSE__INIT;
+        answer.status_code = CHAT__STATUS_CODE__OK;
+        answer.result_case = CHAT__RESPONSE__RESULT_INCOMING_MESSAGE;
+        answer.operation = CHAT__OPERATION__SEND_MESSAGE;
+        answer.message = "";
+        answer.incoming_message = &sent;
+
+        // Send the response
+        send_response(client, &answer);
+    } else {
+        // Send the message to the recipient
+
+        // Check if the recipient exists
+        CNode *current = find_client(recipient);
+        if (current) {
+            if (current->status == CHAT__USER_STATUS__OFFLINE) {
+                Chat__Response response = CHAT__RESPONSE__INIT;
+                response.status_code = CHAT__STATUS_CODE__OK;
+                response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+                response.operation = CHAT__OPERATION__SEND_MESSAGE;
+                response.message = "\033[0;33mWARNING!\033[0m Recipient is \033[0;31mOFFLINE\033[0m! Message will not be delivered!";
+
+                // Send the response
+                send_response(client, &response);
+            } else {
+                Chat__IncomingMessageResponse message = CHAT__INCOMING_MESSAGE_RESPONSE__INIT;
+                message.sender = client->name;
+                message.content = content;
+                message.type = CHAT__MESSAGE_TYPE__DIRECT;
+                message.sequence = __atomic_add_fetch(&current->direct_sequence, 1, __ATOMIC_RELAXED);
+
+                Chat__Response response = CHAT__RESPONSE__INIT;
+                response.status_code = CHAT__STATUS_CODE__OK;
+                response.result_case = CHAT__RESPONSE__RESULT_INCOMING_MESSAGE;
+                response.operation = CHAT__OPERATION__INCOMING_MESSAGE;
+                response.message = "";
+                response.incoming_message = &message;
+
+                // Send the response
+                send_response(current, &response);
+                int busy = current->status == CHAT__USER_STATUS__BUSY;
+                result = message.sequence << 2 | (busy ? DEDUPE_BUSY : DEDUPE_DIRECT);
+
+                if (busy) {
+                    Chat__Response response = CHAT__RESPONSE__INIT;
+                    response.status_code = CHAT__STATUS_CODE__OK;
+                    response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+                    response.operation = CHAT__OPERATION__SEND_MESSAGE;
+                    response.message = "\033[0;33mWARNING!\033[0m Recipient is \033[0;36mBUSY\033[0m! Message will be delivered but probably not read!";
+
+                    // Send the response
+                    send_response(client, &response);
+                }
+            }
+            node_release(current);
+            printf("Message sent to %s\n", recipient);
+        } else {
+            Chat__Response response = CHAT__RESPONSE__INIT;
+            response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
+            response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+            response.message = "Recipient not found!";
+
+            // Send the response
+            send_response(client, &response);
+        }
+    }
+    if (check) {
+        settle_sent(client, message_id, result);
+    }
+}
+
+/*
+* Pack numbered function
+* @param head: a response without a result, packed
+* @param head_len: its bytes
+* @param body: a frame with an incoming message without its sequence, packed
+* @param sequence: the number of the message for its recipient
+* @return: a split frame, the response and the number of the message followed by the shared body
+* This function will be used to give every recipient of a message its own number without packing or
+* copying the message again. Protobuf takes the fields in any order, the number goes first
+*/
+Frame *pack_numbered(unsigned char *head, size_t head_len, Frame *body, uint64_t sequence) {
+    size_t message_len = 1 + varint_size(sequence) + body->len;
+    size_t res_len = head_len + 1 + varint_size(message_len) + message_len;
+    Frame *frame = frame_create_split(FRAME_HEADER_SIZE + res_len - body->len, body);
+    if (frame == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t header = htonl((uint32_t) res_len);
+    memcpy(frame->data, &header, FRAME_HEADER_SIZE);
+    unsigned char *out = frame->data + FRAME_HEADER_SIZE;
+    memcpy(out, head, head_len);
+    out += head_len;
+    // Field 5 of the response (incoming_message) and field 4 of the message (sequence)
+    *out++ = (5 << 3) | 2;
+    out += varint_put(out, message_len);
+    *out++ = 4 << 3;
+    varint_put(out, sequence);
+    frame->lane = LANE_BULK;
+    return frame;
+}
+
+/*
+* Send multi service function
+* @param client: the sender
+* @param request: a direct message with recipients
+* @return: void
+* This function will be used to send a direct message to several users at once. The recipients are
+* found in the name index under one lock and the message is packed once, every recipient only gets its
+* number written before it. The sender gets one answer with what happened for each recipient
+*/
+void send_multi_service(CNode *client, Chat__SendMessageRequest *request) {
+    Chat__Response response = CHAT__RESPONSE__INIT;
+    response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
+    response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+    response.operation = CHAT__OPERATION__SEND_MESSAGE;
+    size_t given = request->n_recipients + (strlen(request->recipient) > 0);
+    if (strlen(request->content) > (size_t) config.message_length) {
+        response.message = "Message is too long!";
+        send_response(client, &response);
+        return;
+    }
+    if (given > (size_t) config.max_recipients) {
+        response.message = "Too many recipients!";
+        send_response(client, &response);
+        return;
+    }
+    // Checked once the request is known to be valid, only a message that goes out is pending
+    int check;
+    if (already_sent(client, request->message_id, &check)) {
+        return;
+    }
+
+    // Every name once, in the order given. The lists are as long as max_recipients allows, not on the stack
+    char **recipients = (char **) malloc(sizeof(char *) * (given + 1));
+    CNode **found = (CNode **) malloc(sizeof(CNode *) * (given + 1));
+    if (recipients == NULL || found == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    int count = 0;
+    for (size_t i = 0; i < given; i++) {
+        char *name = i < request->n_recipients ? request->recipients[i] : request->recipient;
+        int seen = strlen(name) == 0;
+        for (int j = 0; j < count && !seen; j++) {
+            seen = strcmp(recipients[j], name) == 0;
+        }
+        if (!seen) {
+            found[count] = NULL;
+            recipients[count++] = name;
+        }
+    }
+    pthread_rwlock_rdlock(&client_lock);
+    for (int i = 0; i < count; i++) {
+        found[i] = (CNode *) name_index_find(&names, recipients[i]);
+        if (found[i] == root_usr) {
+            found[i] = NULL;
+        }
+        if (found[i]) {
+            node_retain(found[i]);
+        }
+    }
+    pthread_rwlock_unlock(&client_lock);
+
+    // Packed once, the number of each recipient goes before it
+    Chat__IncomingMessageResponse message = CHAT__INCOMING_MESSAGE_RESPONSE__INIT;
+    message.sender = client->name;
+    message.content = request->content;
+    message.type = CHAT__MESSAGE_TYPE__DIRECT;
+
+    Chat__Response incoming = CHAT__RESPONSE__INIT;
+    incoming.status_code = CHAT__STATUS_CODE__OK;
+    incoming.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+    incoming.operation = CHAT__OPERATION__INCOMING_MESSAGE;
+    incoming.message = "";
+    size_t head_len = chat__response__get_packed_size(&incoming);
+    unsigned char *head = (unsigned char *) malloc(head_len + 1);
+    Frame *body = frame_create(chat__incoming_message_response__get_packed_size(&message));
+    Chat__Delivery *deliveries = (Chat__Delivery *) malloc(sizeof(Chat__Delivery) * (count + 1));
+    Chat__Delivery **results = (Chat__Delivery **) malloc(sizeof(Chat__Delivery *) * (count + 1));
+    if (head == NULL || body == NULL || deliveries == NULL || results == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    chat__response__pack(&incoming, head);
+    chat__incoming_message_response__pack(&message, body->data);
+
+    int delivered = 0;
+    for (int i = 0; i < count; i++) {
+        chat__delivery__init(&deliveries[i]);
+        deliveries[i].username = recipients[i];
+        results[i] = &deliveries[i];
+        CNode *current = found[i];
+        if (current == NULL) {
+            deliveries[i].status = CHAT__DELIVERY_STATUS__RECIPIENT_NOT_FOUND;
+        } else if (current->status == CHAT__USER_STATUS__OFFLINE) {
+            deliveries[i].status = CHAT__DELIVERY_STATUS__RECIPIENT_OFFLINE;
+        } else {
+            Frame *frame = pack_numbered(head, head_len, body, __atomic_add_fetch(&current->direct_sequence, 1, __ATOMIC_RELAXED));
+            send_frame(current, frame);
+            frame_release(frame);
+            deliveries[i].status = current->status == CHAT__USER_STATUS__BUSY ? CHAT__DELIVERY_STATUS__DELIVERED_BUSY : CHAT__DELIVERY_STATUS__DELIVERED;
+            delivered++;
+        }
+        if (current) {
+            node_release(current);
+        }
+    }
+    if (check) {
+        settle_sent(client, request->message_id, delivered > 0 ? DEDUPE_MULTI : DEDUPE_PENDING);
+    }
+    printf("Message sent to %d of %d recipients\n", delivered, count);
+
+    char summary[64];
+    snprintf(summary, sizeof(summary), "Message delivered to %d of %d recipients", delivered, count);
+    response.status_code = count > 0 ? CHAT__STATUS_CODE__OK : CHAT__STATUS_CODE__BAD_REQUEST;
+    response.message = count > 0 ? summary : "No recipients!";
+    response.n_deliveries = count;
+    response.deliveries = results;
+
+    // Send the response
+    send_response(client, &response);
+    frame_release(body);
+    free(head);
+    free(recipients);
+    free(found);
+    free(deliveries);
+    free(results);
+}
+
+/*
+* Upload service function
+* @param client: the sender
+* @param stream: the stream of an upload
+* @param chunk: a chunk after BEGIN
+* @return: void
+* This function will be used to write an attachment to the spool as it is streamed. Nothing is
+* relayed, at END the recipients are told about it and the sender gets its id, the content is only
+* read when someone downloads it
+*/
+void upload_service(CNode *client, Stream *stream, Chat__MessageChunk *chunk) {
+    uint32_t id = stream->id;
+    // After a hot restart the file is opened again by its id
+    if (stream->file == NULL && (stream->file = attachment_find(stream->attachment)) == NULL) {
+        stream->attachment = 0;
+        stream->open = 0;
+        __atomic_add_fetch(&aborted_streams, 1, __ATOMIC_RELAXED);
+        answer_chunk(client, id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__INTERNAL_SERVER_ERROR, "Attachment was lost!");
+        return;
+    }
+    char *reason = NULL;
+    Chat__StatusCode code = CHAT__STATUS_CODE__BAD_REQUEST;
+    if (chunk->type == CHAT__CHUNK_TYPE__DATA) {
+        size_t limit = (size_t) config.spool_limit_mb << 20;
+        if (stream->bytes + chunk->data.len > (size_t) config.attachment_length) {
+            reason = "Attachment is too long!";
+        } else if (limit > 0 && __atomic_load_n(&spool.bytes, __ATOMIC_RELAXED) + chunk->data.len > limit) {
+            code = CHAT__STATUS_CODE__SERVICE_UNAVAILABLE;
+            reason = "The server has no room for attachments! Try again later";
+        } else if (attachment_append(stream->file, chunk->data.data, chunk->data.len) == -1) {
+            code = CHAT__STATUS_CODE__INTERNAL_SERVER_ERROR;
+            reason = "Could not store the attachment!";
+        }
+        stream->bytes += chunk->data.len;
+    } else if (chunk->type == CHAT__CHUNK_TYPE__END) {
+        CNode *recipient = NULL;
+        if (!stream->broadcast && (recipient = stream_recipient(stream)) == NULL) {
+            reason = "Recipient left, attachment not delivered!";
+        } else if (attachment_finish(stream->file) == -1) {
+            code = CHAT__STATUS_CODE__INTERNAL_SERVER_ERROR;
+            reason = "Could not store the attachment!";
+        } else {
+            Chat__Attachment description;
+            describe_attachment(stream->file, &description);
+            Chat__Response response = CHAT__RESPONSE__INIT;
+            response.status_code = CHAT__STATUS_CODE__OK;
+            response.operation = CHAT__OPERATION__INCOMING_ATTACHMENT;
+            response.result_case = CHAT__RESPONSE__RESULT_ATTACHMENT;
+            response.message = "";
+            response.attachment = &description;
+
+            // Every recipient gets the same notice
+            Frame *frame = pack_response(&response);
+            if (recipient) {
+                send_frame(recipient, frame);
+            } else {
+                broadcast_frame(client, frame);
+            }
+            frame_release(frame);
+
+            // And the sender the id, with the confirmation
+            Chat__MessageChunk answer = CHAT__MESSAGE_CHUNK__INIT;
+            answer.message_id = id;
+            answer.type = CHAT__CHUNK_TYPE__END;
+            answer.attachment = &description;
+            response.operation = CHAT__OPERATION__SEND_CHUNK;
+            response.result_case = CHAT__RESPONSE__RESULT_CHUNK;
+            response.message = "Attachment sent successfully!";
+            response.chunk = &answer;
+            send_response(client, &response);
+            close_upload(stream, 1);
+        }
+        if (recipient) {
+            node_release(recipient);
+        }
+    } else if (chunk->type == CHAT__CHUNK_TYPE__ABORT) {
+        // The sender gave up, nothing to answer
+        close_upload(stream, 0);
+        __atomic_add_fetch(&aborted_streams, 1, __ATOMIC_RELAXED);
+    }
+    if (reason) {
+        close_upload(stream, 0);
+        __atomic_add_fetch(&aborted_streams, 1, __ATOMIC_RELAXED);
+        answer_chunk(client, id, CHAT__CHUNK_TYPE__ABORT, code, reason);
+    }
+}
+
+/*
+* Send chunk service function
+* @param client: the sender
+* @param chunk: a chunk of a streamed message
+* @return: void
+* This function will be used to relay a message longer than message_length as it is streamed. The
+* recipient is checked at BEGIN, every DATA chunk is passed on right away and END confirms the
+* message to the sender. A stream that is refused or stopped is answered once with ABORT, the
+* chunks the sender already had on the way for it are dropped
+*/
+void send_chunk_service(CNode *client, Chat__MessageChunk *chunk) {
+    Stream *stream = find_stream(client, chunk->message_id);
+    if (chunk->type == CHAT__CHUNK_TYPE__BEGIN) {
+        // A file name makes the stream an upload, its content goes to the spool instead of the recipients
+        int upload = chunk->filename && chunk->filename[0] != '\0';
+        if (stream) {
+            answer_chunk(client, chunk->message_id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__BAD_REQUEST, "Stream is already open!");
+            return;
+        }
+        if (upload && config.attachment_length == 0) {
+            answer_chunk(client, chunk->message_id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__BAD_REQUEST, "Attachments are disabled!");
+            return;
+        }
+        if (upload && (strlen(chunk->filename) >= ATTACHMENT_NAME_LENGTH || strchr(chunk->filename, '/'))) {
+            answer_chunk(client, chunk->message_id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__BAD_REQUEST, "Invalid file name!");
+            return;
+        }
+        if (!upload && config.stream_length == 0) {
+            answer_chunk(client, chunk->message_id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__BAD_REQUEST, "Message is too long!");
+            return;
+        }
+        int broadcast = strlen(chunk->recipient) == 0;
+        if (!upload && broadcast && mem_over()) {
+            __atomic_add_fetch(&memory.shed, 1, __ATOMIC_RELAXED);
+            answer_chunk(client, chunk->message_id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__SERVICE_UNAVAILABLE, "Server is low on memory, broadcast dropped! Try again later");
+            return;
+        }
+        CNode *recipient = NULL;
+        if (!broadcast) {
+            recipient = find_client(chunk->recipient);
+            if (recipient == NULL) {
+                answer_chunk(client, chunk->message_id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__BAD_REQUEST, "Recipient not found!");
+                return;
+            }
+            if (recipient->status == CHAT__USER_STATUS__OFFLINE) {
+                node_release(recipient);
+                answer_chunk(client, chunk->message_id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__OK, "\033[0;33mWARNING!\033[0m Recipient is \033[0;31mOFFLINE\033[0m! Message will not be delivered!");
+                return;
+            }
+        }
+        stream = open_stream(client, chunk->message_id);
+        if (stream == NULL) {
+            if (recipient) {
+                node_release(recipient);
+            }
+            answer_chunk(client, chunk->message_id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__BAD_REQUEST, "Too many open streams!");
+            return;
+        }
+        stream->open = 1;
+        stream->broadcast = broadcast;
+        if (recipient) {
+            snprintf(stream->recipient, sizeof(stream->recipient), "%s", recipient->name);
+            stream->slot = recipient->slot;
+            if (recipient->status == CHAT__USER_STATUS__BUSY) {
+                Chat__Response response = CHAT__RESPONSE__INIT;
+                response.status_code = CHAT__STATUS_CODE__OK;
+                response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+                response.operation = CHAT__OPERATION__SEND_MESSAGE;
+                response.message = "\033[0;33mWARNING!\033[0m Recipient is \033[0;36mBUSY\033[0m! Message will be delivered but probably not read!";
+
+                // Send the response
+                send_response(client, &response);
+            }
+            node_release(recipient);
+        }
+        if (upload) {
+            stream->file = attachment_create(chunk->filename, client->name, stream->recipient);
+            if (stream->file == NULL) {
+                stream->open = 0;
+                answer_chunk(client, chunk->message_id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__INTERNAL_SERVER_ERROR, "Could not store the attachment!");
+            } else {
+                stream->attachment = stream->file->id;
+            }
+            return;
+        }
+        if (relay_chunk(client, stream, CHAT__CHUNK_TYPE__BEGIN, NULL, 0) == -1) {
+            stream->open = 0;
+            answer_chunk(client, chunk->message_id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__BAD_REQUEST, "Recipient not found!");
+        }
+        return;
+    }
+    // The stream was refused or stopped, the sender got the reason already
+    if (stream == NULL) {
+        return;
+    }
+    if (stream->attachment) {
+        upload_service(client, stream, chunk);
+        return;
+    }
+    if (chunk->type == CHAT__CHUNK_TYPE__DATA) {
+        stream->bytes += chunk->data.len;
+        char *reason = NULL;
+        Chat__StatusCode code = CHAT__STATUS_CODE__BAD_REQUEST;
+        if (stream->bytes > (size_t) config.stream_length) {
+            reason = "Message is too long!";
+        } else if (stream->broadcast && mem_over()) {
+            // Like a broadcast, a streamed one is the first traffic shed when memory runs out
+            __atomic_add_fetch(&memory.shed, 1, __ATOMIC_RELAXED);
+            code = CHAT__STATUS_CODE__SERVICE_UNAVAILABLE;
+            reason = "Server is low on memory, broadcast dropped! Try again later";
+        } else if (relay_chunk(client, stream, CHAT__CHUNK_TYPE__DATA, chunk->data.data, chunk->data.len) == -1) {
+            reason = "Recipient left, message not delivered!";
+        }
+        if (reason) {
+            // The recipients drop what they received so far
+            relay_chunk(client, stream, CHAT__CHUNK_TYPE__ABORT, NULL, 0);
+            stream->open = 0;
+            __atomic_add_fetch(&aborted_streams, 1, __ATOMIC_RELAXED);
+            answer_chunk(client, stream->id, CHAT__CHUNK_TYPE__ABORT, code, reason);
+        }
+    } else if (chunk->type == CHAT__CHUNK_TYPE__END) {
+        stream->open = 0;
+        if (relay_chunk(client, stream, CHAT__CHUNK_TYPE__END, NULL, 0) == -1) {
+            __atomic_add_fetch(&aborted_streams, 1, __ATOMIC_RELAXED);
+            answer_chunk(client, stream->id, CHAT__CHUNK_TYPE__ABORT, CHAT__STATUS_CODE__BAD_REQUEST, "Recipient left, message not delivered!");
+        } else {
+            __atomic_add_fetch(&streamed_messages, 1, __ATOMIC_RELAXED);
+            answer_chunk(client, stream->id, CHAT__CHUNK_TYPE__END, CHAT__STATUS_CODE__OK, "Message sent successfully!");
+        }
+    } else if (chunk->type == CHAT__CHUNK_TYPE__ABORT) {
+        // The sender gave up, nothing to answer
+        relay_chunk(client, stream, CHAT__CHUNK_TYPE__ABORT, NULL, 0);
+        stream->open = 0;
+        __atomic_add_fetch(&aborted_streams, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+* Download service function
+* @param client: the client node
+* @param request: the attachment and the id the client gave the download
+* @return: void
+* This function will be used to check the client may have the attachment, its I/O thread then writes
+* it straight from the spool file and the worker is done with it
+*/
+void download_service(CNode *client, Chat__DownloadRequest *request) {
+    Attachment *file = attachment_find(request->attachment_id);
+    // Only the users an attachment was shared with learn that it exists
+    if (file && !(file->header.complete && (file->header.broadcast || strcmp(file->header.sender, client->name) == 0
+        || strcmp(file->header.recipient, client->name) == 0))) {
+        attachment_release(file);
+        file = NULL;
+    }
+    if (file == NULL) {
+        Chat__MessageChunk chunk = CHAT__MESSAGE_CHUNK__INIT;
+        chunk.message_id = request->message_id;
+        chunk.type = CHAT__CHUNK_TYPE__ABORT;
+
+        Chat__Response response = CHAT__RESPONSE__INIT;
+        response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
+        response.operation = CHAT__OPERATION__DOWNLOAD_ATTACHMENT;
+        response.result_case = CHAT__RESPONSE__RESULT_CHUNK;
+        response.message = "Attachment not found!";
+        response.chunk = &chunk;
+
+        // Send the response
+        send_response(client, &response);
+        return;
+    }
+    Download *download = download_create(file, request->message_id);
+    if (download == NULL) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    post_download(client, download);
+}
+
+/*
+* Ack service function
+* @param client: the client node
+* @param received: the frames the client received on this connection
+* @return: void
+* This function will be used by the worker of the client, its I/O thread releases the frames up to
+* that one the next time it writes. Only the worker of the client writes the number
+*/
+void ack_service(CNode *client, uint64_t received) {
+    __atomic_add_fetch(&acks_received, 1, __ATOMIC_RELAXED);
+    if (received > client->acked) {
+        __atomic_store_n(&client->acked, received, __ATOMIC_RELEASE);
+    }
+}
+
+char* parse_user_status(int status){
+    switch (status){
+        case CHAT__USER_STATUS__ONLINE:
+            return "Active";
+        case CHAT__USER_STATUS__BUSY:
+            return "Inactive";
+        case CHAT__USER_STATUS__OFFLINE:
+            return "Away";
+        default:
+            return "Unknown";
+    }
+}
+
+void change_status_service(Chat__UserStatus status, char *username) {
+    CNode *current = find_client(username);
+    if (current) {
+        Chat__UserStatus old_status = current->status;
+        set_client_status(current, status);
+        current->last_seen = time(NULL);
+        printf("User %s status changed to %s\n", username, parse_user_status(status));
+        Chat__Response response = CHAT__RESPONSE__INIT;
+        response.status_code = CHAT__STATUS_CODE__OK;
+        response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
+        response.message = "Status changed successfully!";
+        // The broadcasts skipped it while it was OFFLINE, the client starts counting after this one
+        if (old_status == CHAT__USER_STATUS__OFFLINE && status != CHAT__USER_STATUS__OFFLINE) {
+            response.broadcast_sequence = broadcasts_sent();
+        }
+
+        // Send the response
+        send_response(current, &response);
+        node_release(current);
+    }
+}
+
+void unregister_user_service(char *username) {
+    CNode *current = find_client(username);
+    if (current) {
+        remove_client_service(current);
+        close_client(current);
+        node_release(current);
+    }
+}
+
+/*
+* Handoff state function
+* @param channel: the handoff socket
+* @return: 0 if successful, -1 if failed
+* This function will be used on a hot restart after the last batch of clients, the sessions parked for
+* a resume and the messages the dedupe set remembers go on in the new server
+*/
+int handoff_state(int channel) {
+    HandoffTail tail = {0, 0};
+    time_t now = time(NULL);
+    pthread_mutex_lock(&parked.lock);
+    tail.parked = parked.count;
+    for (int shard = 0; shard < DEDUPE_SHARDS; shard++) {
+        for (int g = 0; g < DEDUPE_GENERATIONS; g++) {
+            tail.dedupe_tables += dedupe.shards[shard].tables[g].used > 0;
+        }
+    }
+    int result = handoff_send(channel, &tail, sizeof(tail), NULL, 0);
+    for (int bucket = 0; bucket < PARKED_BUCKETS && result == 0; bucket++) {
+        for (ParkedWindow *session = parked.buckets[bucket]; session && result == 0; session = session->next) {
+            HandoffParked state;
+            memset(&state, 0, sizeof(state));
+            snprintf(state.name, sizeof(state.name), "%s", session->name);
+            memcpy(state.token, session->token, SESSION_TOKEN_LENGTH);
+            state.status = session->status;
+            state.kept = session->window.count;
+            state.sent = session->window.sent;
+            state.direct_sequence = session->direct_sequence;
+            state.parked_at = session->parked_at;
+            result = handoff_send(channel, &state, sizeof(state), NULL, 0);
+            for (uint64_t seq = window_first(&session->window); seq <= session->window.sent && result == 0; seq++) {
+                result = handoff_kept_frame(channel, window_at(&session->window, seq));
+            }
+        }
+    }
+    pthread_mutex_unlock(&parked.lock);
+
+    // The tables from the newest one back, only the slots in use are sent
+    DedupeEntry entries[HANDOFF_CHUNK / sizeof(DedupeEntry)];
+    for (int shard = 0; shard < DEDUPE_SHARDS && result == 0; shard++) {
+        DedupeShard *current = &dedupe.shards[shard];
+        pthread_mutex_lock(&current->lock);
+        for (int g = 0; g < DEDUPE_GENERATIONS && result == 0; g++) {
+            DedupeTable *table = &current->tables[(current->current + DEDUPE_GENERATIONS - g) % DEDUPE_GENERATIONS];
+            if (table->used == 0) {
+                continue;
+            }
+            HandoffDedupe state = {(uint32_t) shard, (uint32_t) g, table->used, (int64_t) (now - current->started)};
+            result = handoff_send(channel, &state, sizeof(state), NULL, 0);
+            size_t filled = 0;
+            for (uint32_t slot = 0; slot <= table->mask && result == 0; slot++) {
+                if (table->slots[slot].key == 0) {
+                    continue;
+                }
+                entries[filled++] = table->slots[slot];
+                if (filled == sizeof(entries) / sizeof(DedupeEntry)) {
+                    result = handoff_send(channel, entries, sizeof(entries), NULL, 0);
+                    filled = 0;
+                }
+            }
+            if (filled > 0 && result == 0) {
+                result = handoff_send(channel, entries, sizeof(DedupeEntry) * filled, NULL, 0);
+            }
+        }
+        pthread_mutex_unlock(&current->lock);
+    }
+    return result;
+}
+
+/*
+* Takeover state function
+* @param channel: the handoff socket, the last batch of clients was received
+* @return: 0 if successful, -1 if failed
+* This function will be used by a new server to take the parked sessions and the remembered messages
+* of the running one, a client can still resume and a retry is still answered once
+*/
+int takeover_state(int channel) {
+    HandoffTail tail;
+    if (handoff_recv_all(channel, &tail, sizeof(tail)) == -1) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < tail.parked; i++) {
+        HandoffParked state;
+        if (handoff_recv_all(channel, &state, sizeof(state)) == -1) {
+            return -1;
+        }
+        state.name[MAX_USERNAME_LENGTH - 1] = '\0';
+        RetransmitWindow window;
+        window_init(&window);
+        if (takeover_window(channel, &window, state.sent, state.kept) == -1) {
+            window_free(&window);
+            return -1;
+        }
+        if (parked_put(&parked, state.name, state.token, state.status, &window, state.direct_sequence, (time_t) state.parked_at) < 0) {
+            printf("\033[0;33mWARNING!\033[0m No memory for the session of %s, it cannot resume\n", state.name);
+        }
+    }
+    DedupeEntry entries[HANDOFF_CHUNK / sizeof(DedupeEntry)];
+    for (uint32_t i = 0; i < tail.dedupe_tables; i++) {
+        HandoffDedupe state;
+        if (handoff_recv_all(channel, &state, sizeof(state)) == -1) {
+            return -1;
+        }
+        // The entries come in the chunks they were sent in
+        for (uint32_t received = 0; received < state.count; ) {
+            uint32_t count = state.count - received;
+            count = count < sizeof(entries) / sizeof(DedupeEntry) ? count : sizeof(entries) / sizeof(DedupeEntry);
+            if (handoff_recv_all(channel, entries, sizeof(DedupeEntry) * count) == -1) {
+                return -1;
+            }
+            if (dedupe_restore(&dedupe, state.shard, state.generation, entries, count, (time_t) state.age) < 0) {
+                printf("\033[0;33mWARNING!\033[0m No memory for the dedupe set, some retries may be sent again\n");
+            }
+            received += count;
+        }
+    }
+    return 0;
+}
+
+/*
+* Handoff service function
+* @return: void
+* This function will be used by the event loop when a new server asks for the connections (hot restart).
+* The sockets stay open in the new server, so the clients never see a disconnect. If anything fails
+* this server keeps serving.
+*/
+void handoff_service() {
+    int channel = accept(restart_descript, NULL, NULL);
+    if (channel == -1) {
+        return;
+    }
+    handoff_timeout(channel);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    printf("Handing the connections over to a new server...\n");
+
+    // Nothing may be read, run or written while the clients are copied
+    pause_threads();
+    pthread_rwlock_rdlock(&client_lock);
+    // The listening socket goes first
+    HandoffHeader header = {HANDOFF_MAGIC, (uint32_t) connected_users, broadcast_sequence};
+    int result = handoff_send(channel, &header, sizeof(header), &srv_socket_descript, 1);
+
+    // Then the clients in batches, each batch followed by what is still queued for them
+    HandoffRecord records[HANDOFF_BATCH];
+    CNode *batch[HANDOFF_BATCH];
+    int fds[HANDOFF_BATCH];
+    CNode *current = root_usr->linked_to;
+    while (result == 0 && current) {
+        int count = 0;
+        while (current && count < HANDOFF_BATCH) {
+            memset(&records[count], 0, sizeof(HandoffRecord));
+            snprintf(records[count].name, sizeof(records[count].name), "%s", current->name);
+            snprintf(records[count].ip, sizeof(records[count].ip), "%s", current->ip);
+            records[count].status = current->status;
+            records[count].registered = current->slot >= 0;
+            records[count].last_seen = current->last_seen;
+            records[count].pending = current->out_bytes;
+            records[count].partial = current->rx_len;
+            records[count].zerocopy = current->zerocopy;
+            records[count].zerocopy_next = current->zerocopy_next;
+            records[count].streams = 0;
+            for (int k = 0; current->streams && k < MAX_STREAMS; k++) {
+                records[count].streams += current->streams[k].open;
+            }
+            records[count].downloads = 0;
+            for (Download *download = current->downloads; download; download = download->next_download) {
+                records[count].downloads++;
+            }
+            records[count].sent = current->window.sent;
+            for (int lane = 0; lane < LANES; lane++) {
+                for (OutItem *item = current->out_head[lane]; item; item = item->next) {
+                    records[count].sent += item->frame->numbered;
+                    records[count].kept += item->frame->numbered;
                 }
-                printf("User %s sent successfully!\n", username);
-                break;
             }
+            records[count].kept += current->window.count;
+            records[count].watches = current->watching.count;
+            records[count].acked = current->acked;
+            records[count].direct_sequence = current->direct_sequence;
+            memcpy(records[count].session_token, current->session_token, SESSION_TOKEN_LENGTH);
+            fds[count] = current->data;
+            batch[count] = current;
+            count++;
             current = current->linked_to;
         }
-        if (!found) {
-            printf("User %s not found\n", username);
-            Chat__Response response = CHAT__RESPONSE__INIT;
-            response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
-            response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
-            response.message = "User not found!";
+        result = handoff_send(channel, records, sizeof(HandoffRecord) * count, fds, count);
+        for (int i = 0; i < count && result == 0; i++) {
+            // The lane of a frame that was started goes first, so the new server starts with its rest
+            int first = batch[i]->out_lane >= 0 ? batch[i]->out_lane : LANE_CONTROL;
+            for (int k = 0; k < LANES; k++) {
+                for (OutItem *item = batch[i]->out_head[(first + k) % LANES]; item && result == 0; item = item->next) {
+                    result = handoff_frame(channel, item->frame, item->offset);
+                }
+            }
+            // Then the start of a request that was not complete yet
+            for (size_t offset = 0; offset < batch[i]->rx_len && result == 0; offset += HANDOFF_CHUNK) {
+                size_t len = batch[i]->rx_len - offset < HANDOFF_CHUNK ? batch[i]->rx_len - offset : HANDOFF_CHUNK;
+                result = handoff_send(channel, batch[i]->rx + offset, len, NULL, 0);
+            }
+            // And the messages it is streaming, the chunks still to come go on in the new server
+            for (int k = 0; batch[i]->streams && k < MAX_STREAMS && result == 0; k++) {
+                if (batch[i]->streams[k].open) {
+                    result = handoff_send(channel, &batch[i]->streams[k], sizeof(Stream), NULL, 0);
+                }
+            }
+            // And the attachments it is downloading, from the next byte that was not queued
+            for (Download *download = batch[i]->downloads; download && result == 0; download = download->next_download) {
+                HandoffDownload state = {download->file->id, download->next, download->message_id, download->begun};
+                result = handoff_send(channel, &state, sizeof(state), NULL, 0);
+            }
+            // And the frames kept for a resume, the numbered ones still queued after the window as if
+            // they were written
+            for (uint64_t seq = window_first(&batch[i]->window); seq <= batch[i]->window.sent && result == 0; seq++) {
+                result = handoff_kept_frame(channel, window_at(&batch[i]->window, seq));
+            }
+            for (int k = 0; k < LANES; k++) {
+                for (OutItem *item = batch[i]->out_head[(first + k) % LANES]; item && result == 0; item = item->next) {
+                    if (item->frame->numbered) {
+                        result = handoff_kept_frame(channel, item->frame);
+                    }
+                }
+            }
+            // And the names it follows
+            for (WatchLink *link = batch[i]->watching.head; link && result == 0; link = link->next_watched) {
+                result = handoff_send(channel, link->entry->name, MAX_USERNAME_LENGTH, NULL, 0);
+            }
+        }
+    }
+    if (result == 0) {
+        result = handoff_state(channel);
+    }
+
+    // Wait until the new server owns the sockets
+    char ack = 0;
+    if (result == 0 && recv(channel, &ack, 1, 0) == 1) {
+        printf("Handed %u clients over in %.3f ms, exiting\n", header.clients, elapsed_ms(&start));
+        exit(EXIT_SUCCESS);
+    }
+    pthread_rwlock_unlock(&client_lock);
+    resume_threads();
+    close(channel);
+    printf("Hand over failed, still serving!\n");
+}
+
+/*
+* Takeover service function
+* @param channel: the handoff socket, the header was already received
+* @param clients: the number of clients announced in the header
+* @return: 0 if successful, -1 if failed
+* This function will be used by a new server to adopt the connections of the running one
+*/
+int takeover_service(int channel, uint32_t clients) {
+    HandoffRecord records[HANDOFF_BATCH];
+    int fds[HANDOFF_BATCH];
+    uint32_t adopted = 0;
+    while (adopted < clients) {
+        int count = 0;
+        ssize_t len = handoff_recv(channel, records, sizeof(records), fds, HANDOFF_BATCH, &count);
+        if (len == -1 || count == 0 || len != (ssize_t) (sizeof(HandoffRecord) * count)) {
+            for (int i = 0; i < count; i++) {
+                close(fds[i]);
+            }
+            return -1;
+        }
+        for (int i = 0; i < count; i++) {
+            records[i].name[MAX_USERNAME_LENGTH - 1] = '\0';
+            records[i].ip[15] = '\0';
+            CNode *client = create_node(fds[i], records[i].ip, NULL);
+            snprintf(client->name, sizeof(client->name), "%s", records[i].name);
+            client->status = records[i].status;
+            client->last_seen = records[i].last_seen;
+            // Completions of the sends of the old server may still come, no frame waits for them here
+            client->zerocopy = records[i].zerocopy;
+            client->zerocopy_next = records[i].zerocopy_next;
+            client->acked = records[i].acked;
+            client->direct_sequence = records[i].direct_sequence;
+            memcpy(client->session_token, records[i].session_token, SESSION_TOKEN_LENGTH);
+            assign_threads(client);
 
-            // Serialize the response
-            size_t res_len = chat__response__get_packed_size(&response);
-            void *res_buffer = malloc(res_len);
-            if (res_buffer == NULL) {
+            // Add the node to the list
+            pthread_rwlock_wrlock(&client_lock);
+            client->linked_from = current_usr;
+            current_usr->linked_to = client;
+            current_usr = client;
+            connected_users++;
+            if (records[i].registered && name_index_insert(&names, client) < 0) {
                 printf("Memory allocation failed!\n");
                 exit(EXIT_FAILURE);
             }
+            if (records[i].registered && reserve_presence_slot(client) < 0) {
+                printf("\033[0;33mWARNING!\033[0m No presence slot for %s, the maximum number of users is reached\n", client->name);
+            }
+            pthread_rwlock_unlock(&client_lock);
+            // Adopted connections count against the limits but are never refused
+            ip_table_add(&ip_table, inet_addr(client->ip), 0);
+            if (!records[i].registered) {
+                client->handshaking = 1;
+                handshakes++;
+            }
 
-            chat__response__pack(&response, res_buffer);
+            // The heartbeat starts again, the new config applies to the adopted sockets too
+            tune_keepalive(client->data);
+            arm_heartbeat(client);
 
-            // Send the response
-            int bytes_sent = send(client->data, res_buffer, res_len, 0);
-            if (bytes_sent < 0) {
-                printf("Send failed!\n");
-                exit(EXIT_FAILURE);
+            // Watch the client socket
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = client;
+            if (epoll_ctl(io_threads[client->io].epoll_descript, EPOLL_CTL_ADD, client->data, &event) == -1) {
+                return -1;
+            }
+
+            // Receive what the old server could not send yet, it is written once the handoff is confirmed
+            if (records[i].pending > 0) {
+                Frame *frame = frame_create(records[i].pending);
+                if (frame == NULL) {
+                    return -1;
+                }
+                if (handoff_recv_all(channel, frame->data, frame->len) == -1) {
+                    frame_release(frame);
+                    return -1;
+                }
+                // The frames in it were numbered by the old server
+                frame->numbered = 0;
+                queue_frame(client, frame, 0);
+                // The bytes may end a frame the old server started, nothing goes before them
+                client->out_lane = frame->lane;
+                frame_release(frame);
+            }
+            // And the incomplete request it read
+            if (records[i].partial > 0) {
+                char *partial = (char *) malloc(records[i].partial);
+                if (partial == NULL || handoff_recv_all(channel, partial, records[i].partial) == -1) {
+                    free(partial);
+                    return -1;
+                }
+                client->rx = pool_take(&io_threads[client->io].pool);
+                if (client->rx) {
+                    client->memory += pool_buffer_size(client->rx);
+                }
+                if (client->rx == NULL || pool_buffer_size(client->rx) < records[i].partial) {
+                    printf("\033[0;33mWARNING!\033[0m The request of %s does not fit in buffer_size, dropping the client\n", client->name);
+                    shutdown(client->data, SHUT_RDWR);
+                } else {
+                    memcpy(client->rx, partial, records[i].partial);
+                    client->rx_len = records[i].partial;
+                    // It may hold complete requests, they are handed over before new bytes are read
+                    stall_client(&io_threads[client->io], client, STALL_BUDGET);
+                }
+                free(partial);
+            }
+            // And its open streams, the recipients have other slots here
+            for (uint32_t k = 0; k < records[i].streams; k++) {
+                Stream adopted;
+                if (handoff_recv_all(channel, &adopted, sizeof(Stream)) == -1) {
+                    return -1;
+                }
+                Stream *stream = k < MAX_STREAMS ? open_stream(client, adopted.id) : NULL;
+                if (stream) {
+                    *stream = adopted;
+                    stream->recipient[MAX_USERNAME_LENGTH - 1] = '\0';
+                    stream->slot = -1;
+                    stream->file = NULL;
+                }
+            }
+            // And its downloads, they go on once the handoff is confirmed
+            for (uint32_t k = 0; k < records[i].downloads; k++) {
+                HandoffDownload state;
+                if (handoff_recv_all(channel, &state, sizeof(state)) == -1) {
+                    return -1;
+                }
+                Attachment *file = attachment_find(state.attachment);
+                if (file == NULL) {
+                    printf("\033[0;33mWARNING!\033[0m Attachment %llx is gone, a download of %s stops\n", (unsigned long long) state.attachment, client->name);
+                    continue;
+                }
+                Download *download = download_create(file, state.message_id);
+                if (download == NULL) {
+                    return -1;
+                }
+                download->next = state.next;
+                download->begun = state.begun;
+                clock_gettime(CLOCK_MONOTONIC, &download->start);
+                if (client->downloads_tail) {
+                    client->downloads_tail->next_download = download;
+                } else {
+                    client->downloads = download;
+                }
+                client->downloads_tail = download;
+            }
+            // Only queued, the socket is watched for writing once it has a frame
+            feed_download(client);
+            // And the frames kept for a resume, the bytes queued above among them
+            if (takeover_window(channel, &client->window, records[i].sent, records[i].kept) == -1) {
+                return -1;
+            }
+            // And the names it follows, their changes are pushed from here on
+            for (uint32_t k = 0; k < records[i].watches; k++) {
+                char name[MAX_USERNAME_LENGTH];
+                if (handoff_recv_all(channel, name, sizeof(name)) == -1) {
+                    return -1;
+                }
+                name[MAX_USERNAME_LENGTH - 1] = '\0';
+                pthread_rwlock_wrlock(&watches.lock);
+                int added = watch_follows(&watches, &client->watching, name) ? 0 : watch_add(&watches, &client->watching, client, name);
+                pthread_rwlock_unlock(&watches.lock);
+                if (added < 0) {
+                    printf("Memory allocation failed!\n");
+                    exit(EXIT_FAILURE);
+                }
             }
         }
-    } else {
-        printf("Get all users\n");
-        CNode *current = root_usr;
-        Chat__UserListResponse user_list = CHAT__USER_LIST_RESPONSE__INIT;
-        Chat__User **users = malloc(sizeof(Chat__User *) * MAX_USERS);
-        int i = 0;
-        printf("Searching in users...\n");
-        while(current) {
-            if (strcmp(current->name, "Server") == 0) {
-                current = current->linked_to;
-                continue;
+        adopted += count;
+    }
+    return takeover_state(channel);
+}
+
+/*
+* Client service function
+* @param client: the client node
+* @param request: the request without its length
+* @return: void
+* This function will be used by a worker to handle a request, the job reference of the client and the request are released
+*/
+void client_service(CNode *client, Frame *request) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // The budget of the client is given back before the work, the I/O thread can read ahead meanwhile.
+    // If it waits for room it is woken once its next request fits, it does not poll for it
+    size_t inflight = __atomic_sub_fetch(&client->inflight, FRAME_HEADER_SIZE + request->len, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&client->stalled, __ATOMIC_SEQ_CST) == STALL_BUDGET && inflight <= client->budget_room) {
+        waker_wake(&io_threads[client->io].waker);
+    }
+    // Requests read before the client left are not handled
+    Chat__Request *payload = NULL;
+    if (client->active) {
+        payload = chat__request__unpack(NULL, request->len, request->data);
+        if(payload == NULL) {
+            printf("Error unpacking message!\n");
+        }
+    }
+    frame_release(request);
+    if (payload == NULL) {
+        node_release(client);
+        return;
+    }
+    // A client over its rate limit only gets the answer, a spammed broadcast never reaches the users
+    uint32_t wait = rate_limit(client, payload);
+    if (wait > 0) {
+        throttle_service(client, payload->operation, wait);
+        chat__request__free_unpacked(payload, NULL);
+        account_service(client, &start);
+        node_release(client);
+        return;
+    }
+
+    switch (payload->operation)
+    {
+        case CHAT__OPERATION__REGISTER_USER:
+            // New users wait while the worker is behind, the latency of the users already in comes first.
+            // A resume is not shed, it is cheaper than the requests the client would make instead
+            if (!payload->register_user->resume && worker_backlog(client->worker) > (size_t) config.shed_depth) {
+                shed_registration_service(client);
+            } else {
+                set_username_service(client, payload->register_user);
             }
-            Chat__User *user = malloc(sizeof(Chat__User));
-            chat__user__init(user);
-            user->username = current->name;
-            user->status = current->status;
-            users[i] = user;
-            i++;
-            current = current->linked_to;
+            break;
+        case CHAT__OPERATION__SEND_MESSAGE:    
+            reset_status(client);
+            if (payload->send_message->n_recipients > 0) {
+                send_multi_service(client, payload->send_message);
+            } else {
+                send_message_service(client, payload->send_message->recipient, payload->send_message->content, payload->send_message->message_id);
+            }
+            break;
+        case CHAT__OPERATION__SEND_CHUNK:
+            if (payload->send_chunk) {
+                reset_status(client);
+                send_chunk_service(client, payload->send_chunk);
+            }
+            break;
+        case CHAT__OPERATION__DOWNLOAD_ATTACHMENT:
+            if (payload->download_attachment) {
+                reset_status(client);
+                download_service(client, payload->download_attachment);
+            }
+            break;
+        case CHAT__OPERATION__GET_USERS:
+            
+            if(payload && payload->get_users && (payload->get_users->n_usernames > 0 || strlen(payload->get_users->prefix) > 0)){
+                lookup_users_service(client, payload->get_users);
+            } else if(payload && payload->get_users && payload->get_users->username){
+                printf("Get user %s\n", payload->get_users->username);
+                get_all_users_service(client, payload->get_users->username);
+            } else {
+                printf("Get all users\n");
+                get_all_users_service(client, "");
+            }
+            break;
+        case CHAT__OPERATION__UPDATE_STATUS:
+            change_status_service(payload->update_status->new_status, payload->update_status->username);
+            break;
+        case CHAT__OPERATION__UNREGISTER_USER:
+            unregister_user_service(payload->unregister_user->username);
+            break;
+        case CHAT__OPERATION__ACK:
+            if (payload->ack) {
+                ack_service(client, payload->ack->received);
+            }
+            break;
+        case CHAT__OPERATION__PONG:
+            // Reading it was enough, the client is there
+            __atomic_add_fetch(&pongs_received, 1, __ATOMIC_RELAXED);
+            break;
+        case CHAT__OPERATION__SUBSCRIBE_PRESENCE:
+            if (payload->subscribe_presence) {
+                subscribe_presence_service(client, payload->subscribe_presence);
+            }
+            break;
+        default:
+            break;
+    }
+    chat__request__free_unpacked(payload, NULL);
+    account_service(client, &start);
+    node_release(client);
+}
+
+/*
+* Close connection function
+* @param io: the I/O thread of the client
+* @param client: the client node
+* @return: void
+* This function will be used by the I/O thread to remove the client and close its socket, the node
+* is released once the current events are handled so pending events never see freed memory
+*/
+void close_connection(IOThread *io, CNode *client) {
+    if (client->data < 0) {
+        return;
+    }
+    // The main thread does not look at the client once its timer is gone
+    pthread_mutex_lock(&heartbeats.lock);
+    timer_cancel(&heartbeats, &client->heartbeat);
+    pthread_mutex_unlock(&heartbeats.lock);
+    // Parked before the name is given back, a resume that finds the name free also finds the window
+    if (client->slot >= 0) {
+        park_window(client);
+    }
+    remove_client_service(client);
+    handshake_done(client);
+    ip_table_remove(&ip_table, inet_addr(client->ip));
+    // Closing the socket also takes it out of the event loop
+    close_socket(io, client);
+    client->data = -1;
+    drop_queue(client);
+    if (client->rx) {
+        __atomic_sub_fetch(&client->memory, pool_buffer_size(client->rx), __ATOMIC_RELAXED);
+        pool_give(&io->pool, client->rx);
+        client->rx = NULL;
+        client->rx_len = 0;
+    }
+    client->linked_to = io->closed;
+    io->closed = client;
+}
+
+/*
+* Parse client function
+* @param io: the I/O thread of the client
+* @param client: the client node
+* @return: 0 if successful, -1 if the client sent a request that does not fit in a buffer
+* This function will be used to cut the received bytes into requests and hand them to the worker of
+* the client. A client whose worker ring is full is stalled until there is room, and a client has at
+* most read_quantum bytes waiting at its worker, so a pipelining client cannot fill the ring and a
+* request of another client waits behind at most a quantum of every busy client
+*/
+int parse_client(IOThread *io, CNode *client) {
+    SpscRing *ring = &job_rings[io->id * worker_count + client->worker];
+    size_t used = 0;
+    while (client->rx_len - used >= FRAME_HEADER_SIZE) {
+        uint32_t header;
+        memcpy(&header, client->rx + used, FRAME_HEADER_SIZE);
+        size_t len = ntohl(header);
+        if (len > pool_buffer_size(client->rx) - FRAME_HEADER_SIZE) {
+            printf("Request of %s is larger than buffer_size!\n", client->name);
+            return -1;
+        }
+        if (client->rx_len - used < FRAME_HEADER_SIZE + len) {
+            break;
+        }
+        // A request larger than the quantum goes alone
+        size_t inflight = __atomic_load_n(&client->inflight, __ATOMIC_RELAXED);
+        size_t quantum = (size_t) __atomic_load_n(&config.read_quantum, __ATOMIC_RELAXED);
+        if (inflight > 0 && inflight + FRAME_HEADER_SIZE + len > quantum) {
+            client->budget_room = quantum > FRAME_HEADER_SIZE + len ? quantum - FRAME_HEADER_SIZE - len : 0;
+            stall_client(io, client, STALL_BUDGET);
+            break;
+        }
+        Frame *request = frame_create(len);
+        if (request == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(request->data, client->rx + used + FRAME_HEADER_SIZE, len);
+        if (spsc_push(ring, node_retain(client), request) == -1) {
+            frame_release(request);
+            node_release(client);
+            stall_client(io, client, STALL_RING);
+            break;
+        }
+        io->requests++;
+        __atomic_add_fetch(&client->inflight, FRAME_HEADER_SIZE + len, __ATOMIC_RELAXED);
+        used += FRAME_HEADER_SIZE + len;
+    }
+    if (used > 0) {
+        waker_wake(&workers[client->worker].waker);
+        memmove(client->rx, client->rx + used, client->rx_len - used);
+        client->rx_len -= used;
+    }
+    // An idle connection does not keep a buffer
+    if (client->rx_len == 0) {
+        __atomic_sub_fetch(&client->memory, pool_buffer_size(client->rx), __ATOMIC_RELAXED);
+        pool_give(&io->pool, client->rx);
+        client->rx = NULL;
+    }
+    return 0;
+}
+
+/*
+* Read client function
+* @param io: the I/O thread of the client
+* @param client: the client node
+* @return: void
+* This function will be used by the I/O thread when a client is readable
+*/
+void read_client(IOThread *io, CNode *client) {
+    if (client->stalled) {
+        return;
+    }
+    // Borrow a receive buffer only while there is data to read
+    if (client->rx == NULL) {
+        client->rx = pool_take(&io->pool);
+        if (client->rx == NULL) {
+            printf("Memory allocation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        __atomic_add_fetch(&client->memory, pool_buffer_size(client->rx), __ATOMIC_RELAXED);
+        client->rx_len = 0;
+    }
+
+    // Read the incoming bytes after the incomplete request
+    ssize_t raw_payload = recv(client->data, client->rx + client->rx_len, pool_buffer_size(client->rx) - client->rx_len, 0);
+    // Check if the bytes are received successfully
+    if (raw_payload == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            parse_client(io, client);
+            return;
+        }
+        // The keepalive probes or the user timeout found the peer gone
+        if (errno == ETIMEDOUT) {
+            __atomic_add_fetch(&reaped_tcp, 1, __ATOMIC_RELAXED);
+        }
+        printf("Connection lost for %s\n", client->name);
+        close_connection(io, client);
+        return;
+    } else if (raw_payload == 0) { // Check if the client disconnected
+        close_connection(io, client);
+        return;
+    }
+    client->rx_len += raw_payload;
+    // Any request tells the client is there, the heartbeat only pings the quiet ones
+    __atomic_store_n(&client->last_heard, time(NULL), __ATOMIC_RELAXED);
+    if (parse_client(io, client) == -1) {
+        close_connection(io, client);
+    }
+}
+
+/*
+* Drain mailbox function
+* @param io: the I/O thread of the client
+* @param client: a client taken from the ready queue
+* @return: void
+* This function will be used by the I/O thread to write the frames posted to a client, in the order they were posted
+*/
+void drain_mailbox(IOThread *io, CNode *client) {
+    // Clear the flag before looking, a post that is missed here schedules the client again
+    __atomic_store_n(&client->scheduled, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    MpscNode *node;
+    while ((node = mpsc_pop(&client->mailbox)) != NULL) {
+        OutItem *item = mpsc_entry(node, OutItem, link);
+        if (item->download) {
+            start_download(client, item->download);
+            item->download = NULL;
+            out_item_free(item);
+        } else if (item->frame == NULL) {
+            out_item_free(item);
+            close_connection(io, client);
+        } else {
+            write_item(client, item);
+            io->delivered++;
         }
-        printf("Users retrieved successfully!\n");
-        user_list.n_users = i;
-        user_list.users = users;
-        user_list.type = CHAT__USER_LIST_TYPE__ALL;
+    }
+}
 
-        Chat__Response response = CHAT__RESPONSE__INIT;
-        response.status_code = CHAT__STATUS_CODE__OK;
-        response.operation = CHAT__OPERATION__GET_USERS;
-        response.result_case = CHAT__RESPONSE__RESULT_USER_LIST;
-        response.message = "User list retrieved successfully!";
-        response.user_list = &user_list;
-
-        // Serialize the response
-        size_t res_len = chat__response__get_packed_size(&response);
-        void *res_buffer = malloc(res_len);
-        if (res_buffer == NULL) {
-            printf("Memory allocation failed!\n");
-            exit(EXIT_FAILURE);
+/*
+* Drain ready function
+* @param io: the I/O thread
+* @return: the number of clients handled
+* This function will be used by the I/O thread to write what the other threads posted to its clients
+*/
+int drain_ready(IOThread *io) {
+    int handled = 0;
+    MpscNode *node;
+    while ((node = mpsc_pop(&io->ready)) != NULL) {
+        CNode *client = mpsc_entry(node, CNode, ready_link);
+        drain_mailbox(io, client);
+        // Drop the reference of the ready queue
+        node_release(client);
+        handled++;
+    }
+    return handled;
+}
+
+/*
+* Retry stalled function
+* @param io: the I/O thread
+* @return: void
+* This function will be used by the I/O thread to hand the requests of stalled clients to their worker again
+*/
+void retry_stalled(IOThread *io) {
+    CNode *client = io->stalled;
+    io->stalled = NULL;
+    while (client) {
+        CNode *next = client->next_stalled;
+        client->next_stalled = NULL;
+        __atomic_store_n(&client->stalled, STALL_NONE, __ATOMIC_RELAXED);
+        if (client->data >= 0) {
+            if (parse_client(io, client) == -1) {
+                close_connection(io, client);
+            } else {
+                watch_client(client);
+            }
         }
-        chat__response__pack(&response, res_buffer);
+        node_release(client);
+        client = next;
+    }
+}
 
-        // Send the response
-        int bytes_sent = send(client->data, res_buffer, res_len, 0);
-        if (bytes_sent < 0) {
-            printf("Send failed!\n");
-            exit(EXIT_FAILURE);
+/*
+* Backlog ready function
+* @param io: the I/O thread
+* @return: 1 if the worker of a client held back already made room for its next request, 0 if not
+* This function will be used before the I/O thread sleeps, a worker that made room before then did not wake it
+*/
+int backlog_ready(IOThread *io) {
+    for (CNode *client = io->backlog; client; client = client->next_stalled) {
+        if (__atomic_load_n(&client->inflight, __ATOMIC_SEQ_CST) <= client->budget_room) {
+            return 1;
         }
     }
-    printf("User list sent successfully!\n");
+    return 0;
+}
 
+/*
+* Serve backlog function
+* @param io: the I/O thread
+* @return: void
+* This function will be used by the I/O thread after the ready sockets were served, the clients
+* that had a quantum waiting hand over what their worker made room for, so they take turns in the rings
+*/
+void serve_backlog(IOThread *io) {
+    CNode *client = io->backlog;
+    io->backlog = NULL;
+    while (client) {
+        CNode *next = client->next_stalled;
+        client->next_stalled = NULL;
+        __atomic_store_n(&client->stalled, STALL_NONE, __ATOMIC_RELAXED);
+        if (client->data >= 0) {
+            if (parse_client(io, client) == -1) {
+                close_connection(io, client);
+            } else {
+                watch_client(client);
+            }
+        }
+        node_release(client);
+        client = next;
+    }
 }
 
 /*
-* Remove client service function
-* @param to_remove: the client node to remove
+* Stash nodes function
+* @param io: the I/O thread
 * @return: void
-* This function will be used to remove the client from the list
+* This function will be used by the I/O thread to keep NODE_STASH nodes ready for its next clients. The
+* thread writes every byte of them, so their pages are given on the NUMA node it runs on
 */
-void remove_client_service(CNode *to_remove) {
-    // Block the mutex while removing the client
-    pthread_mutex_lock(&client_mutex);
-    if (to_remove->linked_from) {
-        to_remove->linked_from->linked_to = to_remove->linked_to;
-        if(to_remove == current_usr) {
-            current_usr = to_remove->linked_from;
+void stash_nodes(IOThread *io) {
+    if (__atomic_load_n(&io->stashed, __ATOMIC_RELAXED) > NODE_STASH / 2) {
+        return;
+    }
+    pthread_mutex_lock(&io->stash_lock);
+    while (io->stashed < NODE_STASH) {
+        CNode *node = (CNode *) malloc(sizeof(CNode));
+        if (node == NULL) {
+            break;
         }
+        memset(node, 0, sizeof(CNode));
+        node->linked_to = io->stash;
+        io->stash = node;
+        io->stashed++;
     }
-    if (to_remove->linked_to) {
-        to_remove->linked_to->linked_from = to_remove->linked_from;
+    pthread_mutex_unlock(&io->stash_lock);
+}
+
+/*
+* Take node function
+* @param io: the I/O thread of the new client
+* @return: a node of its stash, NULL if it is empty
+*/
+CNode *take_node(IOThread *io) {
+    pthread_mutex_lock(&io->stash_lock);
+    CNode *node = io->stash;
+    if (node) {
+        io->stash = node->linked_to;
+        io->stashed--;
+        io->nodes_placed++;
+    } else {
+        io->nodes_missed++;
     }
-    // Close the connection
-    close(to_remove->data);
-    // Change the status to inactive to stop the status service 
-    to_remove->active = 0; 
-    printf("User removed %s\n", to_remove->name);
-    // Free the memory
-    free(to_remove); 
-    // Unlock the mutex
-    pthread_mutex_unlock(&client_mutex);
+    pthread_mutex_unlock(&io->stash_lock);
+    return node;
 }
 
-void send_message_service(CNode *client, char *recipient, char *content) {
-    if (strlen(recipient) == 0 ) {
-        // Send the message to all users
-        CNode *current = root_usr;
-        while(current) {
-            if (strcmp(current->name, "Server") == 0 || strcmp(current->name, client->name) == 0 || current->status == CHAT__USER_STATUS__OFFLINE){
-                current = current->linked_to;
+/*
+* I/O thread function
+* @param arg: the I/O thread
+* @return: NULL
+* This function will be used to read the requests of the clients of the thread and write their responses
+*/
+void *io_thread(void *arg) {
+    IOThread *io = (IOThread *) arg;
+    // Pin before the first buffer is allocated so it lands on the local node
+    if (pin_thread(io->pinned) == -1) {
+        printf("\033[0;33mWARNING!\033[0m Could not pin I/O thread %d to CPU %d\n", io->id, io->pinned);
+        io->pinned = -1;
+    }
+    current_placement(&io->cpu, &io->node);
+    stash_nodes(io);
+    struct epoll_event events[MAX_EVENTS];
+    int acked = 0;
+    while (1) {
+        int phase = __atomic_load_n(&pause_phase, __ATOMIC_ACQUIRE);
+        if (phase == 0) {
+            acked = 0;
+        } else if (phase == 1 && acked == 0) {
+            // Stop reading, the workers can finish what was read
+            pause_ack(0);
+            acked = 1;
+        } else if (phase == 3) {
+            // Every worker is parked, write what they sent and wait
+            while (drain_ready(io) > 0 || !mpsc_empty(&io->ready));
+            pause_ack(1);
+            acked = 0;
+            continue;
+        }
+
+        // Sleep only when nothing is waiting, a full ring or a pause is checked again soon. The workers
+        // wake the thread when a client held back has room again
+        waker_sleep(&io->waker);
+        int timeout = !mpsc_empty(&io->ready) || (phase == 0 && backlog_ready(io)) ? 0 : (io->stalled || phase ? 1 : (io->lingering ? LINGER_CHECK_MS : 1000));
+        int ready = epoll_wait(io->epoll_descript, events, MAX_EVENTS, timeout);
+        waker_cancel(&io->waker);
+        if (ready == -1 && errno != EINTR) {
+            printf("Event loop failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < ready; i++) {
+            CNode *client = (CNode *) events[i].data.ptr;
+            if (client == NULL) {
+                waker_clear(&io->waker);
                 continue;
             }
-            
-            Chat__IncomingMessageResponse message = CHAT__INCOMING_MESSAGE_RESPONSE__INIT;
-            message.sender = client->name;
-            message.content = content;
-            message.type = CHAT__MESSAGE_TYPE__BROADCAST;
-
-            Chat__Response response = CHAT__RESPONSE__INIT;
-            response.status_code = CHAT__STATUS_CODE__OK;
-            response.result_case = CHAT__RESPONSE__RESULT_INCOMING_MESSAGE;
-            response.operation = CHAT__OPERATION__INCOMING_MESSAGE;
-            response.message = "Message sent successfully!";
-            response.incoming_message = &message;
-
-            // Serialize the response
-            size_t res_len = chat__response__get_packed_size(&response);
-            void *res_buffer = malloc(res_len);
-            if (res_buffer == NULL) {
-                printf("Memory allocation failed!\n");
-                exit(EXIT_FAILURE);
+            // Closed in this batch
+            if (client->data < 0) {
+                continue;
             }
-
-            chat__response__pack(&response, res_buffer);
-
-            // Send the response
-            int bytes_sent = send(current->data, res_buffer, res_len, 0);
-            if (bytes_sent < 0) {
-                printf("Send failed!\n");
-                exit(EXIT_FAILURE);
+            // Zerocopy completions wake the socket with EPOLLERR until they are taken
+            if ((events[i].events & EPOLLERR) && client->zerocopy == 1) {
+                reap_zerocopy(client);
             }
-            
-            current = current->linked_to;
-        }
-    } else {
-        // Send the message to the recipient
-
-        // Check if the recipient exists
-        if (user_exists(recipient)) {
-            CNode *current = root_usr;
-            while(current) {
-                if(strcmp(current->name, recipient) == 0) {
-                    if (current->status == CHAT__USER_STATUS__OFFLINE) {
-                        Chat__Response response = CHAT__RESPONSE__INIT;
-                        response.status_code = CHAT__STATUS_CODE__OK;
-                        response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
-                        response.operation = CHAT__OPERATION__SEND_MESSAGE;
-                        response.message = "\033[0;33mWARNING!\033[0m Recipient is \033[0;31mOFFLINE\033[0m! Message will not be delivered!";
-
-                        // Serialize the response
-                        size_t res_len = chat__response__get_packed_size(&response);
-                        void *res_buffer = malloc(res_len);
-                        if (res_buffer == NULL) {
-                            printf("Memory allocation failed!\n");
-                            exit(EXIT_FAILURE);
-                        }
-
-                        chat__response__pack(&response, res_buffer);
-
-                        // Send the response
-                        int bytes_sent = send(client->data, res_buffer, res_len, 0);
-                        if (bytes_sent < 0) {
-                            printf("Send failed!\n");
-                            exit(EXIT_FAILURE);
-                        }
-                        break;
-                    }else {
-                        Chat__IncomingMessageResponse message = CHAT__INCOMING_MESSAGE_RESPONSE__INIT;
-                        message.sender = client->name;
-                        message.content = content;
-                        message.type = CHAT__MESSAGE_TYPE__DIRECT;
-
-                        Chat__Response response = CHAT__RESPONSE__INIT;
-                        response.status_code = CHAT__STATUS_CODE__OK;
-                        response.result_case = CHAT__RESPONSE__RESULT_INCOMING_MESSAGE;
-                        response.operation = CHAT__OPERATION__INCOMING_MESSAGE;
-                        response.message = "";
-                        response.incoming_message = &message;
-
-                        // Serialize the response
-                        size_t res_len = chat__response__get_packed_size(&response);
-                        void *res_buffer = malloc(res_len);
-                        if (res_buffer == NULL) {
-                            printf("Memory allocation failed!\n");
-                            exit(EXIT_FAILURE);
-                        }
-
-                        chat__response__pack(&response, res_buffer);
-
-                        // Send the response
-                        int bytes_sent = send(current->data, res_buffer, res_len, 0);
-                        if (bytes_sent < 0) {
-                            printf("Send failed!\n");
-                            exit(EXIT_FAILURE);
-                        }
-
-                        if (current->status == CHAT__USER_STATUS__BUSY) {
-                            Chat__Response response = CHAT__RESPONSE__INIT;
-                            response.status_code = CHAT__STATUS_CODE__OK;
-                            response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
-                            response.operation = CHAT__OPERATION__SEND_MESSAGE;
-                            response.message = "\033[0;33mWARNING!\033[0m Recipient is \033[0;36mBUSY\033[0m! Message will be delivered but probably not read!";
-
-                            // Serialize the response
-                            size_t res_len = chat__response__get_packed_size(&response);
-                            void *res_buffer = malloc(res_len);
-                            if (res_buffer == NULL) {
-                                printf("Memory allocation failed!\n");
-                                exit(EXIT_FAILURE);
-                            }
-
-                            chat__response__pack(&response, res_buffer);
-
-                            // Send the response
-                            int bytes_sent = send(client->data, res_buffer, res_len, 0);
-                            if (bytes_sent < 0) {
-                                printf("Send failed!\n");
-                                exit(EXIT_FAILURE);
-                            }
-                        }
-                        break;
-                    }
-                }
-                current = current->linked_to;
+            if (events[i].events & EPOLLOUT) {
+                flush_client(client);
             }
-            printf("Message sent to %s\n", recipient);
-        } else {
-            Chat__Response response = CHAT__RESPONSE__INIT;
-            response.status_code = CHAT__STATUS_CODE__BAD_REQUEST;
-            response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
-            response.message = "Recipient not found!";
-
-            // Serialize the response
-            size_t res_len = chat__response__get_packed_size(&response);
-            void *res_buffer = malloc(res_len);
-            if (res_buffer == NULL) {
-                printf("Memory allocation failed!\n");
-                exit(EXIT_FAILURE);
+            if (phase == 0 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                read_client(io, client);
             }
+        }
+        drain_ready(io);
+        if (phase == 0 && io->stalled) {
+            retry_stalled(io);
+        }
+        if (phase == 0 && io->backlog) {
+            serve_backlog(io);
+        }
+        if (io->lingering) {
+            reap_lingering(io);
+        }
 
-            chat__response__pack(&response, res_buffer);
-
-            // Send the response
-            int bytes_sent = send(client->data, res_buffer, res_len, 0);
-            if (bytes_sent < 0) {
-                printf("Send failed!\n");
-                exit(EXIT_FAILURE);
-            }
+        // Drop the reference of the thread to the clients closed in this iteration
+        while (io->closed) {
+            CNode *closed = io->closed;
+            io->closed = closed->linked_to;
+            node_release(closed);
         }
+        stash_nodes(io);
     }
+    return NULL;
 }
 
-char* parse_user_status(int status){
-    switch (status){
-        case CHAT__USER_STATUS__ONLINE:
-            return "Active";
-        case CHAT__USER_STATUS__BUSY:
-            return "Inactive";
-        case CHAT__USER_STATUS__OFFLINE:
-            return "Away";
-        default:
-            return "Unknown";
+/*
+* Worker thread function
+* @param arg: the worker
+* @return: NULL
+* This function will be used to run the requests of the clients of the worker, every I/O thread has its own ring to it
+*/
+void *worker_thread(void *arg) {
+    Worker *worker = (Worker *) arg;
+    if (pin_thread(worker->pinned) == -1) {
+        printf("\033[0;33mWARNING!\033[0m Could not pin worker %d to CPU %d\n", worker->id, worker->pinned);
+        worker->pinned = -1;
     }
-}
-
-void change_status_service(Chat__UserStatus status, char *username) {
-    CNode *current = root_usr;
-    while(current) {
-        if(strcmp(current->name, username) == 0) {
-            pthread_mutex_lock(&status_mutex);
-            current->status = status;
-            current->last_seen = clock();
-            pthread_mutex_unlock(&status_mutex);
-            printf("User %s status changed to %s\n", username, parse_user_status(status));
-            Chat__Response response = CHAT__RESPONSE__INIT;
-            response.status_code = CHAT__STATUS_CODE__OK;
-            response.result_case = CHAT__RESPONSE__RESULT__NOT_SET;
-            response.message = "Status changed successfully!";
-
-            // Serialize the response
-            size_t res_len = chat__response__get_packed_size(&response);
-            void *res_buffer = malloc(res_len);
-            if (res_buffer == NULL) {
-                printf("Memory allocation failed!\n");
-                exit(EXIT_FAILURE);
+    current_placement(&worker->cpu, &worker->node);
+    RingEntry entry;
+    while (1) {
+        int handled = 0;
+        for (int i = 0; i < io_count; i++) {
+            SpscRing *ring = &job_rings[i * worker_count + worker->id];
+            // A bounded batch per ring so one busy I/O thread cannot starve the others
+            for (int n = 0; n < WORKER_BATCH && spsc_pop(ring, &entry) == 0; n++) {
+                client_service((CNode *) entry.owner, (Frame *) entry.item);
+                handled++;
             }
+        }
+        worker->jobs += handled;
+        if (handled > 0) {
+            continue;
+        }
 
-            chat__response__pack(&response, res_buffer);
-
-            // Send the response
-            int bytes_sent = send(current->data, res_buffer, res_len, 0);
-            if (bytes_sent < 0) {
-                printf("Send failed!\n");
-                exit(EXIT_FAILURE);
-            }
-            
-            break;
+        int phase = __atomic_load_n(&pause_phase, __ATOMIC_ACQUIRE);
+        if (phase == 2) {
+            // The rings are empty and the I/O threads stopped reading, park until resumed
+            pause_ack(1);
+            continue;
         }
-        current = current->linked_to;
-    }
-}
 
-void unregister_user_service(char *username) {
-    CNode *current = root_usr;
-    while(current) {
-        if(strcmp(current->name, username) == 0) {
-            remove_client_service(current);
-            break;
+        // Look at the rings once more after announcing the sleep, a push in between wakes us
+        waker_sleep(&worker->waker);
+        int waiting = __atomic_load_n(&pause_phase, __ATOMIC_ACQUIRE) == 2;
+        for (int i = 0; i < io_count && !waiting; i++) {
+            waiting = spsc_size(&job_rings[i * worker_count + worker->id]) > 0;
+        }
+        if (waiting) {
+            waker_cancel(&worker->waker);
+        } else {
+            waker_clear(&worker->waker);
         }
-        current = current->linked_to;
     }
+    return NULL;
 }
 
 /*
-* Client service function
-* @param client_node: the client node
+* Accept service function
 * @return: void
-* This function will be used to handle the client service and actions
+* This function will be used by the main thread to accept every pending connection and give it to an I/O thread
 */
-void* client_service(void *client_node) {
-    // initialize the status mutex
-    pthread_mutex_init(&status_mutex, NULL);
-    // Cast the client node
-    CNode *client = (CNode *) client_node;
-    // Create a new thread for the status service
-    pthread_t thread;
-    pthread_create(&thread, NULL, status_service, client_node);
-    if (pthread_detach(thread) != 0) {
-        printf("Status thread creation failed!\n");
-        exit(EXIT_FAILURE);
-    }
-    
-    // Create a buffer for the username and payload
-    char username[MAX_USERNAME_LENGTH];
-    char payload_buffer[MAX_MESSAGE_LENGTH];
-
-    while(1){
-        // Await for any incoming messages
-        int raw_payload = recv(client->data, payload_buffer, MAX_MESSAGE_LENGTH, 0);
-        // Check if the message is received successfully
-        if (raw_payload == -1) {
-            printf("Connection lost for %s\n", client->name);
-            return NULL;
-        } else if (raw_payload == 0) { // Check if the client disconnected
-            remove_client_service(client);
-            return NULL;
-        } 
-
-        // Parse the received message
-        Chat__Request *payload = chat__request__unpack(NULL, raw_payload, payload_buffer);
-        if(payload == NULL) {
-            printf("Error unpacking message!\n");
+void accept_service() {
+    struct sockaddr_in client_address;
+    socklen_t cli_addr_len = sizeof(client_address);
+    while(1) {
+        // Accept the incoming connection
+        int cli_socket_descript = accept4(srv_socket_descript, (struct sockaddr *) &client_address, &cli_addr_len, SOCK_NONBLOCK);
+        if (cli_socket_descript == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED) {
+                printf("Accepting connection failed!\n");
+            }
+            return;
+        }
+        // Over the memory budget the connections the server has go first
+        if (mem_over()) {
+            printf("\033[0;33mWARNING!\033[0m Memory budget exceeded, refusing %s:%d\n", inet_ntoa(client_address.sin_addr), ntohs(client_address.sin_port));
+            __atomic_add_fetch(&memory.refused, 1, __ATOMIC_RELAXED);
+            refuse_connection(cli_socket_descript, "Server is low on memory, try again later!");
+            continue;
+        }
+        // A reconnect storm is let in at the pace the workers register it
+        if (__atomic_load_n(&handshakes, __ATOMIC_RELAXED) >= config.max_handshakes) {
+            refused_handshakes++;
+            refuse_connection(cli_socket_descript, "Too many connections are registering, try again later!");
+            continue;
+        }
+        if (ip_table_add(&ip_table, client_address.sin_addr.s_addr, config.max_per_ip) == -1) {
+            printf("\033[0;33mWARNING!\033[0m %s has too many connections, refusing it\n", inet_ntoa(client_address.sin_addr));
+            refused_per_ip++;
+            refuse_connection(cli_socket_descript, "Too many connections from your address, try again later!");
             continue;
         }
+        printf("Accepted connection from %s:%d\n", inet_ntoa(client_address.sin_addr), ntohs(client_address.sin_port));
 
-        switch (payload->operation)
-        {
-            case CHAT__OPERATION__REGISTER_USER:
-                set_username_service(client, payload->register_user->username);
-                break;
-            case CHAT__OPERATION__SEND_MESSAGE:    
-                reset_status(client);
-                send_message_service(client, payload->send_message->recipient, payload->send_message->content);
-                break;
-            case CHAT__OPERATION__GET_USERS:
-                
-                if(payload && payload->get_users && payload->get_users->username){
-                    printf("Get user %s\n", payload->get_users->username);
-                    get_all_users_service(client, payload->get_users->username);
-                } else {
-                    printf("Get all users\n");
-                    get_all_users_service(client, "");
-                }
-                break;
-            case CHAT__OPERATION__UPDATE_STATUS:
-                change_status_service(payload->update_status->new_status, payload->update_status->username);
-                break;
-            case CHAT__OPERATION__UNREGISTER_USER:
-                unregister_user_service(payload->unregister_user->username);
-                break;
-            default:
-                break;
+        // Create a new node for the client, on the NUMA node of its I/O thread when it has one ready
+        CNode *new_usr = take_node(&io_threads[next_io]);
+        if (new_usr) {
+            init_node(new_usr, cli_socket_descript, inet_ntoa(client_address.sin_addr), NULL);
+        } else {
+            new_usr = create_node(cli_socket_descript, inet_ntoa(client_address.sin_addr), NULL);
+        }
+        new_usr->handshaking = 1;
+        __atomic_add_fetch(&handshakes, 1, __ATOMIC_RELAXED);
+        assign_threads(new_usr);
+        tune_keepalive(cli_socket_descript);
+        arm_heartbeat(new_usr);
+
+        // Add the new node to the list before a request of it can be read
+        pthread_rwlock_wrlock(&client_lock);
+        new_usr->linked_from = current_usr;
+        current_usr->linked_to = new_usr;
+        current_usr = new_usr;
+        connected_users++;
+        pthread_rwlock_unlock(&client_lock);
+
+        // Watch the client socket
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = new_usr;
+        if (epoll_ctl(io_threads[new_usr->io].epoll_descript, EPOLL_CTL_ADD, cli_socket_descript, &event) == -1) {
+            printf("Watching connection failed!\n");
+            pthread_mutex_lock(&heartbeats.lock);
+            timer_cancel(&heartbeats, &new_usr->heartbeat);
+            pthread_mutex_unlock(&heartbeats.lock);
+            remove_client_service(new_usr);
+            close(cli_socket_descript);
+            node_release(new_usr);
         }
     }
-    return NULL;
 }
 
 /*
@@ -723,101 +4492,288 @@ void* client_service(void *client_node) {
 * Based of https://www.geeksforgeeks.org/tcp-server-client-implementation-in-c/
 */
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
+    if (argc < 2) {
         printf("Provide a port number!\n");
-        printf("Usage: %s <port>\n", argv[0]);
+        printf("Usage: %s <port> [max_users] [-c <config file>] [-o <key>=<value>]... [-r <restart socket> [-t]] [-d <drain redirect>]\n", argv[0]);
         return 1;
     }
 
     // Save the port number
     int port = atoi(argv[1]);
 
-    signal(SIGINT, exit_service);
-
-    // Socket creation
-    srv_socket_descript = socket(AF_INET, SOCK_STREAM, 0);
-    // Check if the socket is created successfully
-    if (srv_socket_descript == -1) {
-        printf("Socket creation failed!\n");
-        exit(EXIT_FAILURE);
-    } else{
-        printf("Socket created successfully!\n");
+    // Save the config file and the overrides, they are applied again on every reload
+    config_overrides = (char **) malloc(sizeof(char *) * argc);
+    int config_required = 0;
+    int takeover = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            config_path = argv[++i];
+            config_required = 1;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            config_overrides[config_override_count++] = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            restart_path = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0) {
+            takeover = 1;
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            drain_redirect = argv[++i];
+        } else if (i == 2 && argv[i][0] != '-') {
+            // The maximum number of users can still be given after the port
+            char *assignment = (char *) malloc(strlen(argv[i]) + 11);
+            sprintf(assignment, "max_users=%s", argv[i]);
+            config_overrides[config_override_count++] = assignment;
+        } else {
+            printf("Unknown argument %s!\n", argv[i]);
+            return 1;
+        }
     }
+    if (read_config(&config, config_required) == -1) {
+        printf("Invalid configuration!\n");
+        return 1;
+    }
+    if (cpu_list_parse(config.accept_cpus, &accept_cpu_set) == -1 || cpu_list_parse(config.io_cpus, &io_cpu_set) == -1
+        || cpu_list_parse(config.worker_cpus, &worker_cpu_set) == -1) {
+        printf("Invalid CPU list, expected something like 0-3,8!\n");
+        return 1;
+    }
+    memory.limit = (size_t) config.memory_limit_mb << 20;
+    if (takeover && restart_path == NULL) {
+        printf("Taking over needs the restart socket of the running server (-r)!\n");
+        return 1;
+    }
+    config_loaded_at = time(NULL);
+    clock_gettime(CLOCK_MONOTONIC, &stats_taken);
 
-    int yes = 1;
-    // Set the socket options for reusing the port and avoiding the "Address already in use" error
-    if (setsockopt(srv_socket_descript, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) == -1) {
-        perror("setsockopt SO_REUSEADDR failed");
-        exit(EXIT_FAILURE);
+    // Attachments are kept in the spool, the ones of an earlier server stay available
+    if (spool_init(config.spool_dir) == -1) {
+        printf("Could not use the spool directory %s!\n", config.spool_dir);
+        return 1;
     }
 
-    // Save the server address and client address
-    struct sockaddr_in srv_address, client_address;
+    // Every client is a socket, so allow as many open files as the system lets us
+    raise_fd_limit();
+
+    signal(SIGINT, drain_signal);
+    signal(SIGTERM, drain_signal);
+    signal(SIGUSR1, stats_signal);
+    signal(SIGHUP, reload_signal);
+    // sendfile has no MSG_NOSIGNAL, a peer that left is seen as EPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    // Save the server address
+    struct sockaddr_in srv_address;
     int srv_addr_len = sizeof(srv_address);
-    int cli_addr_len = sizeof(client_address);
 
-    // Initialize the server and client address
+    // Initialize the server address
     memset(&srv_address, 0, srv_addr_len);
-    memset(&client_address, 0, cli_addr_len);
 
-    // Set the server address and port
-    srv_address.sin_family = AF_INET;
-    srv_address.sin_addr.s_addr = INADDR_ANY;
-    srv_address.sin_port = htons(port);
-
-    // Bind the socket to the server address
-    if (bind(srv_socket_descript, (struct sockaddr *) &srv_address, srv_addr_len) == -1) {
-        printf("Binding failed!\n");
-        exit(EXIT_FAILURE);
+    // Hot restart, the running server hands over its listening socket instead of binding a new one
+    int handoff_channel = -1;
+    HandoffHeader handoff_header;
+    struct timespec takeover_start;
+    clock_gettime(CLOCK_MONOTONIC, &takeover_start);
+    if (takeover) {
+        int count = 0;
+        handoff_channel = handoff_connect(restart_path);
+        if (handoff_channel == -1) {
+            printf("Could not reach the running server at %s!\n", restart_path);
+            exit(EXIT_FAILURE);
+        }
+        handoff_timeout(handoff_channel);
+        if (handoff_recv(handoff_channel, &handoff_header, sizeof(handoff_header), &srv_socket_descript, 1, &count) != sizeof(handoff_header)
+            || count != 1 || handoff_header.magic != HANDOFF_MAGIC) {
+            printf("Invalid handoff from the running server!\n");
+            exit(EXIT_FAILURE);
+        }
+        printf("Listening socket received from the running server\n");
     } else {
-        printf("Binding successful!\n");
-    }
+        // Socket creation
+        srv_socket_descript = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        // Check if the socket is created successfully
+        if (srv_socket_descript == -1) {
+            printf("Socket creation failed!\n");
+            exit(EXIT_FAILURE);
+        } else{
+            printf("Socket created successfully!\n");
+        }
 
-    // Listen for incoming connections
-    if (listen(srv_socket_descript, 5) == -1) {
-        printf("Listening failed!\n");
-        exit(EXIT_FAILURE);
-    } else {
-        printf("Socket is listening...\n");
+        int yes = 1;
+        // Set the socket options for reusing the port and avoiding the "Address already in use" error
+        if (setsockopt(srv_socket_descript, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) == -1) {
+            perror("setsockopt SO_REUSEADDR failed");
+            exit(EXIT_FAILURE);
+        }
+
+        // Set the server address and port
+        srv_address.sin_family = AF_INET;
+        srv_address.sin_addr.s_addr = INADDR_ANY;
+        srv_address.sin_port = htons(port);
+
+        // Bind the socket to the server address
+        if (bind(srv_socket_descript, (struct sockaddr *) &srv_address, srv_addr_len) == -1) {
+            printf("Binding failed!\n");
+            exit(EXIT_FAILURE);
+        } else {
+            printf("Binding successful!\n");
+        }
+
+        // Listen for incoming connections
+        if (listen(srv_socket_descript, SOMAXCONN) == -1) {
+            printf("Listening failed!\n");
+            exit(EXIT_FAILURE);
+        } else {
+            printf("Socket is listening...\n");
+        }
     }
 
     // Configure the client ip and port
     getsockname(srv_socket_descript, (struct sockaddr *) &srv_address, &srv_addr_len);
     printf("Server started on %s:%d\n", inet_ntoa(srv_address.sin_addr), ntohs(srv_address.sin_port));
 
+    // Allocate the presence table, registered users take a slot in it and it grows up to max_users
+    if (presence_init(&presence, config.max_users < INITIAL_USER_SLOTS ? config.max_users : INITIAL_USER_SLOTS) == -1) {
+        printf("Presence table allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    if (ip_table_init(&ip_table, INITIAL_IP_SLOTS) == -1) {
+        printf("IP table allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    dedupe_init(&dedupe);
+    timer_init(&heartbeats, time(NULL));
+
     // Create the root node of the tree, this will be the server
     root_usr = create_node(srv_socket_descript, inet_ntoa(srv_address.sin_addr), "Server");
+    // Its name is taken, no user registers as the server
+    name_index_init(&names, offsetof(CNode, name));
+    name_index_insert(&names, root_usr);
+    if (watch_init(&watches) < 0) {
+        printf("Memory allocation failed!\n");
+        exit(EXIT_FAILURE);
+    }
 
     // Set the current user to the root user
     current_usr = root_usr;
 
-    // Accept the incoming connections
-    while(1){
-        // Accept the incoming connection
-        int cli_socket_descript = accept(srv_socket_descript, (struct sockaddr *) &client_address, (socklen_t *) &cli_addr_len);
-        if (cli_socket_descript == -1) {
-            printf("Accepting connection failed!\n");
+    // The sockets are watched by the I/O threads, they start once the clients of a previous server are adopted
+    create_threads();
+
+    // Create the event loop and watch the listening socket
+    epoll_descript = epoll_create1(0);
+    if (epoll_descript == -1) {
+        printf("Event loop creation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = root_usr;
+    if (epoll_ctl(epoll_descript, EPOLL_CTL_ADD, srv_socket_descript, &event) == -1) {
+        printf("Event loop creation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Adopt the clients of the running server, it exits once we confirm
+    if (takeover) {
+        broadcast_sequence = handoff_header.broadcast_sequence;
+        if (takeover_service(handoff_channel, handoff_header.clients) == -1) {
+            printf("Takeover failed, the running server keeps the connections!\n");
             exit(EXIT_FAILURE);
-        } else {
-            printf("Accepted connection from %s:%d\n", inet_ntoa(client_address.sin_addr), ntohs(client_address.sin_port));
         }
+        char ack = 1;
+        send(handoff_channel, &ack, 1, MSG_NOSIGNAL);
+        close(handoff_channel);
+        printf("Took %u clients over in %.3f ms\n", handoff_header.clients, elapsed_ms(&takeover_start));
+    }
 
-        // Create a new node for the client
-        CNode *new_usr = create_node(cli_socket_descript, inet_ntoa(client_address.sin_addr), NULL);
+    // Wait for the next server on the restart socket
+    if (restart_path) {
+        restart_descript = handoff_listen(restart_path);
+        if (restart_descript == -1) {
+            printf("Restart socket creation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+        restart_usr = create_node(restart_descript, "", "Restart");
+        event.events = EPOLLIN;
+        event.data.ptr = restart_usr;
+        epoll_ctl(epoll_descript, EPOLL_CTL_ADD, restart_descript, &event);
+        printf("Hot restart available on %s\n", restart_path);
+    }
 
-        // Add the new node to the list
-        new_usr->linked_from = current_usr;
-        current_usr->linked_to = new_usr;
-        current_usr = new_usr;
+    threads_started = 1;
+    for (int i = 0; i < io_count; i++) {
+        if (pthread_create(&io_threads[i].thread, NULL, io_thread, &io_threads[i]) != 0) {
+            printf("I/O thread creation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int w = 0; w < worker_count; w++) {
+        if (pthread_create(&workers[w].thread, NULL, worker_thread, &workers[w]) != 0) {
+            printf("Worker creation failed!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("Serving with %d I/O threads and %d workers\n", io_count, worker_count);
+    // The main thread is pinned last, the other threads would inherit its CPUs
+    if (CPU_COUNT(&accept_cpu_set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(accept_cpu_set), &accept_cpu_set) != 0) {
+        printf("\033[0;33mWARNING!\033[0m Could not pin the accept thread to %s\n", config.accept_cpus);
+    }
 
-        // Create a new thread for the client
-        pthread_mutex_init(&client_mutex, NULL);
-        pthread_t thread;
-        pthread_create(&thread, NULL, client_service, (void *) new_usr);
-        if (pthread_detach(thread) != 0) {
-            printf("Thread creation failed!\n");
+    // Accept the connections and run the timers, the I/O threads and the workers serve the clients
+    struct epoll_event events[MAX_EVENTS];
+    time_t last_check = time(NULL);
+    time_t last_sweep = last_check;
+    while(1){
+        // The clients are served by other threads, a drain is checked often enough to exit soon after the last one leaves
+        int ready = epoll_wait(epoll_descript, events, MAX_EVENTS, draining ? 50 : 1000);
+        if (ready == -1 && errno != EINTR) {
+            printf("Event loop failed!\n");
             exit(EXIT_FAILURE);
         }
+        for (int i = 0; i < ready; i++) {
+            CNode *client = (CNode *) events[i].data.ptr;
+            if (client == root_usr) {
+                accept_service();
+                continue;
+            }
+            if (client == restart_usr) {
+                handoff_service();
+            }
+        }
+
+        // Check the inactive clients once per second
+        time_t now = time(NULL);
+        if (now != last_check) {
+            last_check = now;
+            inactivity_service();
+            expired_windows += parked_expire(&parked, config.resume_grace);
+            dedupe_sweep(&dedupe, config.dedupe_window);
+            heartbeat_service();
+        }
+        // And remove the expired attachments once a minute
+        if (now - last_sweep >= SPOOL_SWEEP_INTERVAL) {
+            last_sweep = now;
+            int expired = spool_expire(config.attachment_ttl);
+            if (expired > 0) {
+                printf("Removed %d expired attachments\n", expired);
+            }
+        }
+
+        if (drain_requested > 1 || (draining && drain_done())) {
+            exit_service(0);
+        }
+        if (drain_requested && !draining) {
+            drain_service();
+        }
+
+        if (reload_requested) {
+            reload_requested = 0;
+            reload_config();
+        }
+
+        if (stats_requested) {
+            stats_requested = 0;
+            print_stats();
+        }
     }
 
     return 0;
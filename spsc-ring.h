@@ -0,0 +1,176 @@
+#ifndef SPSCRING
+#define SPSCRING
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define CACHE_LINE 64
+
+/*
+* SPSC ring
+* Bounded lock-free queue with exactly one producer thread and one consumer thread. Every entry
+* carries the connection it belongs to (owner) and the frame (item), the consumer sees the entries
+* in the order they were pushed. Each index has its own cache line so the two threads do not
+* bounce the same line, and each side keeps a cached copy of the other index.
+*/
+typedef struct ring_entry {
+    void *owner;
+    void *item;
+} RingEntry;
+
+typedef struct spsc_ring {
+    // Written by the consumer
+    _Alignas(CACHE_LINE) size_t head;
+    size_t cached_tail;
+    // Written by the producer
+    _Alignas(CACHE_LINE) size_t tail;
+    size_t cached_head;
+    _Alignas(CACHE_LINE) size_t mask;
+    RingEntry *entries;
+} SpscRing;
+
+/*
+* Waker
+* Lets a producer wake a consumer that went to sleep on an eventfd, the write is only done
+* when the consumer said it is about to sleep.
+*/
+typedef struct waker {
+    int descript;
+    int sleeping;
+} Waker;
+
+/*
+* SPSC init function
+* @param ring: the ring
+* @param capacity: the number of entries, rounded up to a power of two
+* @return: 0 if successful, -1 if failed
+*/
+int spsc_init(SpscRing *ring, size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    ring->head = ring->tail = 0;
+    ring->cached_head = ring->cached_tail = 0;
+    ring->mask = size - 1;
+    ring->entries = (RingEntry *) calloc(size, sizeof(RingEntry));
+    return ring->entries ? 0 : -1;
+}
+
+/*
+* SPSC push function
+* @param ring: the ring
+* @param owner: the connection of the entry
+* @param item: the payload of the entry
+* @return: 0 if successful, -1 if the ring is full
+* This function must only be called by the producer thread of the ring
+*/
+int spsc_push(SpscRing *ring, void *owner, void *item) {
+    size_t tail = ring->tail;
+    if (tail - ring->cached_head > ring->mask) {
+        ring->cached_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail - ring->cached_head > ring->mask) {
+            return -1;
+        }
+    }
+    ring->entries[tail & ring->mask].owner = owner;
+    ring->entries[tail & ring->mask].item = item;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+* SPSC pop function
+* @param ring: the ring
+* @param entry: where to store the oldest entry
+* @return: 0 if successful, -1 if the ring is empty
+* This function must only be called by the consumer thread of the ring
+*/
+int spsc_pop(SpscRing *ring, RingEntry *entry) {
+    size_t head = ring->head;
+    if (head == ring->cached_tail) {
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head == ring->cached_tail) {
+            return -1;
+        }
+    }
+    *entry = ring->entries[head & ring->mask];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+* SPSC size function
+* @param ring: the ring
+* @return: the number of entries waiting, only a snapshot when called from a third thread
+*/
+size_t spsc_size(SpscRing *ring) {
+    return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+}
+
+/*
+* Waker init function
+* @param waker: the waker
+* @param nonblocking: 1 if the consumer waits on it through epoll
+* @return: 0 if successful, -1 if failed
+*/
+int waker_init(Waker *waker, int nonblocking) {
+    waker->sleeping = 0;
+    waker->descript = eventfd(0, nonblocking ? EFD_NONBLOCK : 0);
+    return waker->descript == -1 ? -1 : 0;
+}
+
+/*
+* Waker wake function
+* @param waker: the waker of the consumer
+* @return: void
+* This function will be used by a producer after a push, the fence pairs with the one in waker_sleep
+*/
+void waker_wake(Waker *waker) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&waker->sleeping, __ATOMIC_RELAXED)) {
+        uint64_t one = 1;
+        if (write(waker->descript, &one, sizeof(one)) < 0) {
+            return;
+        }
+    }
+}
+
+/*
+* Waker sleep function
+* @param waker: the waker of the consumer
+* @return: void
+* This function will be used by the consumer before it checks its rings one last time and waits
+*/
+void waker_sleep(Waker *waker) {
+    __atomic_store_n(&waker->sleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/*
+* Waker cancel function
+* @param waker: the waker of the consumer
+* @return: void
+* This function will be used by the consumer when it found work after waker_sleep or woke up for another reason
+*/
+void waker_cancel(Waker *waker) {
+    __atomic_store_n(&waker->sleeping, 0, __ATOMIC_RELAXED);
+}
+
+/*
+* Waker clear function
+* @param waker: the waker of the consumer
+* @return: void
+* This function will be used by the consumer once it is awake, a blocking waker waits here
+*/
+void waker_clear(Waker *waker) {
+    uint64_t count;
+    if (read(waker->descript, &count, sizeof(count)) < 0) {
+        count = 0;
+    }
+    __atomic_store_n(&waker->sleeping, 0, __ATOMIC_RELAXED);
+}
+
+#endif
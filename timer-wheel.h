@@ -0,0 +1,120 @@
+#ifndef TWHEEL
+#define TWHEEL
+
+#include <pthread.h>
+#include <stddef.h>
+#include <time.h>
+#include "env.h"
+
+/*
+* Timer wheel
+* Hashed wheel of TIMER_SLOTS one-second slots shared by every connection, so a timer costs two
+* pointers in the node it belongs to and nothing per second: a timer is linked into the slot of its
+* deadline and the main thread only looks at the slots of the seconds that went by. A deadline more
+* than TIMER_SLOTS seconds away stays in its slot until its round comes. The element embeds a
+* TimerLink, armed and canceled by any thread with the lock of the wheel held.
+*/
+typedef struct timer_link {
+    struct timer_link *next;
+    struct timer_link *prev;
+    time_t deadline;
+    int armed;
+} TimerLink;
+
+typedef struct timer_wheel {
+    pthread_mutex_t lock;
+    // Circular list heads, a slot is empty when its head points to itself
+    TimerLink slots[TIMER_SLOTS];
+    // Last second the wheel was turned to and the armed timers
+    time_t turned;
+    int count;
+} TimerWheel;
+
+// Element that embeds the link
+#define timer_entry(link, type, member) ((type *) ((char *) (link) - offsetof(type, member)))
+
+/*
+* Timer init function
+* @param wheel: the wheel
+* @param now: the current time
+* @return: void
+*/
+void timer_init(TimerWheel *wheel, time_t now) {
+    pthread_mutex_init(&wheel->lock, NULL);
+    for (int i = 0; i < TIMER_SLOTS; i++) {
+        wheel->slots[i].next = &wheel->slots[i];
+        wheel->slots[i].prev = &wheel->slots[i];
+    }
+    wheel->turned = now;
+    wheel->count = 0;
+}
+
+/*
+* Timer cancel function
+* @param wheel: the wheel, the caller holds its lock
+* @param link: the timer, nothing happens if it is not armed
+* @return: void
+*/
+void timer_cancel(TimerWheel *wheel, TimerLink *link) {
+    if (!link->armed) {
+        return;
+    }
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->armed = 0;
+    wheel->count--;
+}
+
+/*
+* Timer arm function
+* @param wheel: the wheel, the caller holds its lock
+* @param link: the timer, moved if it is armed
+* @param deadline: when it fires, a deadline that passed fires at the next turn
+* @return: void
+*/
+void timer_arm(TimerWheel *wheel, TimerLink *link, time_t deadline) {
+    timer_cancel(wheel, link);
+    if (deadline <= wheel->turned) {
+        deadline = wheel->turned + 1;
+    }
+    TimerLink *head = &wheel->slots[deadline % TIMER_SLOTS];
+    link->deadline = deadline;
+    link->next = head;
+    link->prev = head->prev;
+    head->prev->next = link;
+    head->prev = link;
+    link->armed = 1;
+    wheel->count++;
+}
+
+/*
+* Timer turn function
+* @param wheel: the wheel, the caller holds its lock
+* @param now: the current time
+* @return: the timers whose deadline came, disarmed and chained by next
+* This function will be used by the main thread once per second, the caller arms again the timers it keeps
+*/
+TimerLink *timer_turn(TimerWheel *wheel, time_t now) {
+    TimerLink *due = NULL;
+    // After a long stop every slot is looked at once
+    time_t from = now - wheel->turned > TIMER_SLOTS ? now - TIMER_SLOTS + 1 : wheel->turned + 1;
+    for (time_t second = from; second <= now; second++) {
+        TimerLink *head = &wheel->slots[second % TIMER_SLOTS];
+        TimerLink *link = head->next;
+        while (link != head) {
+            TimerLink *next = link->next;
+            if (link->deadline <= now) {
+                timer_cancel(wheel, link);
+                link->next = due;
+                due = link;
+            }
+            link = next;
+        }
+    }
+    if (now > wheel->turned) {
+        wheel->turned = now;
+    }
+    return due;
+}
+
+#endif
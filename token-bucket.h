@@ -0,0 +1,78 @@
+#ifndef TBUCKET
+#define TBUCKET
+
+#include <stdint.h>
+#include <time.h>
+
+// Requests with a bucket of their own, a broadcast costs a send per user so it is limited apart
+typedef enum rate_kind {
+    RATE_REGISTER,
+    RATE_DIRECT,
+    RATE_BROADCAST,
+    RATE_STATUS,
+    RATE_USERS,
+    RATE_DOWNLOAD,
+    RATE_KINDS
+} RateKind;
+
+const char *rate_kind_names[RATE_KINDS] = {"register", "direct", "broadcast", "status", "users", "download"};
+
+/*
+* Token bucket
+* Holds up to burst tokens and gains rate tokens per second, a request takes one. The tokens are
+* kept in thousandths so the refill is integer math on the milliseconds since the last request,
+* nothing runs between requests. A bucket belongs to one connection and is only touched by its worker.
+*/
+typedef struct token_bucket {
+    int64_t tokens;
+    int64_t last_ms;
+} TokenBucket;
+
+/*
+* Monotonic ms function
+* @return: milliseconds of the monotonic clock, with the resolution of the scheduler tick
+*/
+int64_t monotonic_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+* Bucket fill function
+* @param bucket: the bucket
+* @param now_ms: the current monotonic time
+* @return: void
+* This function will be used for a new connection, the first take brings the bucket down to its burst
+*/
+void bucket_fill(TokenBucket *bucket, int64_t now_ms) {
+    bucket->tokens = INT64_MAX / 2;
+    bucket->last_ms = now_ms;
+}
+
+/*
+* Bucket take function
+* @param bucket: the bucket
+* @param rate: the tokens gained per second, 0 for no limit
+* @param burst: the most tokens it holds
+* @param now_ms: the current monotonic time
+* @return: 0 if a token was taken, otherwise the milliseconds until there is one
+*/
+uint32_t bucket_take(TokenBucket *bucket, int rate, int burst, int64_t now_ms) {
+    if (rate <= 0) {
+        return 0;
+    }
+    // rate tokens per second are rate thousandths per millisecond
+    bucket->tokens += (now_ms - bucket->last_ms) * rate;
+    bucket->last_ms = now_ms;
+    if (bucket->tokens > (int64_t) burst * 1000) {
+        bucket->tokens = (int64_t) burst * 1000;
+    }
+    if (bucket->tokens >= 1000) {
+        bucket->tokens -= 1000;
+        return 0;
+    }
+    return (uint32_t) ((1000 - bucket->tokens + rate - 1) / rate);
+}
+
+#endif
@@ -0,0 +1,334 @@
+#!/usr/bin/env python3
+# Writes chat.pb-c.h and chat.pb-c.c from chat.proto the way protoc-c 1.3.3 does, for the proto3
+# subset chat.proto uses (scalars, strings, bytes, enums, repeated fields, nested messages and
+# oneofs), so the protocol can be changed where protoc-c is not installed. On the chat.proto of the
+# first version it gives the files protoc-c wrote byte for byte.
+#   python3 tools/gen-pbc.py chat.proto .
+import re, sys, os
+
+def camel_to_lower(n):
+    r = n[0].lower()
+    for c in n[1:]:
+        if c.isupper():
+            r += '_' + c.lower()
+        else:
+            r += c
+    return r
+
+def camel_to_upper(n):
+    return camel_to_lower(n).upper()
+
+def to_camel(n):
+    # foo_bar -> FooBar
+    return ''.join(p[:1].upper() + p[1:] for p in n.split('_'))
+
+SCALARS = {
+    'string': ('STRING', 'char *', '(char *)protobuf_c_empty_string'),
+    'bytes': ('BYTES', 'ProtobufCBinaryData ', '{0,NULL}'),
+    'uint32': ('UINT32', 'uint32_t ', '0'),
+    'int32': ('INT32', 'int32_t ', '0'),
+    'uint64': ('UINT64', 'uint64_t ', '0'),
+    'int64': ('INT64', 'int64_t ', '0'),
+    'bool': ('BOOL', 'protobuf_c_boolean ', '0'),
+}
+
+class Enum:
+    def __init__(s, name, comment):
+        s.name = name; s.comment = comment; s.values = []
+
+class Field:
+    pass
+
+class Message:
+    def __init__(s, name, comment):
+        s.name = name; s.comment = comment; s.fields = []; s.oneofs = []
+
+def parse(text):
+    lines = text.split('\n')
+    pkg = None
+    enums = []; msgs = []
+    pending = []  # leading comment lines
+    stack = []
+    oneof = None
+    for raw in lines:
+        line = raw
+        stripped = line.strip()
+        if stripped == '':
+            pending = []
+            continue
+        if stripped.startswith('//'):
+            pending.append(stripped[2:])
+            continue
+        # split trailing comment
+        code, trailing = line, None
+        idx = line.find('//')
+        if idx >= 0:
+            code = line[:idx]; trailing = line[idx+2:]
+        code = code.strip()
+        leading = pending; pending = []
+        def cm():
+            if leading:
+                return leading
+            if trailing is not None:
+                return [trailing]
+            return []
+        m = re.match(r'syntax\s*=', code)
+        if m: continue
+        m = re.match(r'package\s+(\w+)\s*;', code)
+        if m: pkg = m.group(1); continue
+        m = re.match(r'enum\s+(\w+)\s*\{', code)
+        if m:
+            e = Enum(m.group(1), leading)
+            enums.append(e); stack.append(e); continue
+        m = re.match(r'message\s+(\w+)\s*\{', code)
+        if m:
+            msg = Message(m.group(1), leading)
+            msgs.append(msg); stack.append(msg); continue
+        m = re.match(r'oneof\s+(\w+)\s*\{', code)
+        if m:
+            oneof = m.group(1); stack[-1].oneofs.append(oneof); continue
+        if code == '}':
+            if oneof is not None:
+                oneof = None
+            else:
+                stack.pop()
+            continue
+        cur = stack[-1]
+        if isinstance(cur, Enum):
+            m = re.match(r'(\w+)\s*=\s*(-?\d+)\s*;', code)
+            assert m, code
+            cur.values.append((m.group(1), int(m.group(2)), cm()))
+            continue
+        m = re.match(r'(repeated\s+)?(\w+)\s+(\w+)\s*=\s*(\d+)\s*;', code)
+        assert m, code
+        f = Field()
+        f.repeated = bool(m.group(1)); f.type = m.group(2); f.name = m.group(3)
+        f.number = int(m.group(4)); f.comment = cm(); f.oneof = oneof
+        cur.fields.append(f)
+    return pkg, enums, msgs
+
+def comment(lines, indent):
+    out = ''
+    if not lines:
+        return out
+    out += indent + '/*\n'
+    for l in lines:
+        if l == '':
+            continue
+        if l[0] == '/':
+            l = ' ' + l
+        l = l.replace('/*', ' *').replace('*/', '* ')
+        out += indent + ' *' + l + '\n'
+    out += indent + ' */\n'
+    return out
+
+def gen(protofile, outdir):
+    text = open(protofile).read()
+    pkg, enums, msgs = parse(text)
+    P = pkg.capitalize()
+    enum_names = {e.name for e in enums}
+    msg_names = {m.name for m in msgs}
+    enum_by = {e.name: e for e in enums}
+    def ctype(n): return '%s__%s' % (P, n)
+    def lower(n): return '%s__%s' % (pkg, camel_to_lower(n))
+    def upper(n): return '%s__%s' % (pkg.upper(), camel_to_upper(n))
+    base = os.path.basename(protofile)
+    stem = base[:-len('.proto')]
+    guard = 'PROTOBUF_C_' + base.replace('.', '_2e').replace('-', '_2d') + '__INCLUDED'
+
+    h = ''
+    h += '/* Generated by the protocol buffer compiler.  DO NOT EDIT! */\n'
+    h += '/* Generated from: %s */\n\n' % base
+    h += '#ifndef %s\n#define %s\n\n' % (guard, guard)
+    h += '#include <protobuf-c/protobuf-c.h>\n\nPROTOBUF_C__BEGIN_DECLS\n\n'
+    h += '#if PROTOBUF_C_VERSION_NUMBER < 1003000\n'
+    h += '# error This file was generated by a newer version of protoc-c which is incompatible with your libprotobuf-c headers. Please update your headers.\n'
+    h += '#elif 1003003 < PROTOBUF_C_MIN_COMPILER_VERSION\n'
+    h += '# error This file was generated by an older version of protoc-c which is incompatible with your libprotobuf-c headers. Please regenerate this file with a newer version of protoc-c.\n'
+    h += '#endif\n\n\n'
+    for m in msgs:
+        h += 'typedef struct _%s %s;\n' % (ctype(m.name), ctype(m.name))
+    h += '\n\n/* --- enums --- */\n\n'
+    for e in enums:
+        h += comment(e.comment, '')
+        h += 'typedef enum _%s {\n' % ctype(e.name)
+        for i, (vn, vv, vc) in enumerate(e.values):
+            h += comment(vc, '  ')
+            h += '  %s__%s = %d%s\n' % (upper(e.name), vn, vv, ',' if i < len(e.values) - 1 else '')
+        h += '    PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(%s)\n' % upper(e.name)
+        h += '} %s;\n' % ctype(e.name)
+    h += '\n/* --- messages --- */\n\n'
+
+    def member(f, indent):
+        out = comment(f.comment, indent)
+        if f.type in SCALARS:
+            t = SCALARS[f.type][1]
+        elif f.type in enum_names:
+            t = ctype(f.type) + ' '
+        else:
+            t = ctype(f.type) + ' *'
+        if f.repeated:
+            out += indent + 'size_t n_%s;\n' % f.name
+            out += indent + '%s*%s;\n' % (t, f.name)
+        else:
+            out += indent + '%s%s;\n' % (t, f.name)
+        return out
+
+    def init_value(f):
+        if f.repeated:
+            return '0,NULL'
+        if f.type in SCALARS:
+            return SCALARS[f.type][2]
+        if f.type in enum_names:
+            e = enum_by[f.type]
+            return '%s__%s' % (upper(e.name), e.values[0][0])
+        return 'NULL'
+
+    for m in msgs:
+        for o in m.oneofs:
+            oup = '%s__%s' % (upper(m.name), o.upper())
+            h += 'typedef enum {\n'
+            h += '  %s__NOT_SET = 0,\n' % oup
+            fs = [f for f in m.fields if f.oneof == o]
+            for i, f in enumerate(fs):
+                h += '  %s_%s = %d%s\n' % (oup, f.name.upper(), f.number, ',' if i < len(fs) - 1 else '')
+            h += '    PROTOBUF_C__FORCE_ENUM_TO_BE_INT_SIZE(%s)\n' % oup
+            h += '} %s__%sCase;\n\n' % (ctype(m.name), to_camel(o))
+        h += comment(m.comment, '')
+        h += 'struct  _%s\n{\n  ProtobufCMessage base;\n' % ctype(m.name)
+        for f in m.fields:
+            if f.oneof is None:
+                h += member(f, '  ')
+        for o in m.oneofs:
+            h += '  %s__%sCase %s_case;\n' % (ctype(m.name), to_camel(o), o)
+            h += '  union {\n'
+            for f in m.fields:
+                if f.oneof == o:
+                    h += member(f, '    ')
+            h += '  };\n'
+        h += '};\n'
+        h += '#define %s__INIT \\\n { PROTOBUF_C_MESSAGE_INIT (&%s__descriptor) \\\n    ' % (upper(m.name), lower(m.name))
+        for f in m.fields:
+            if f.oneof is None:
+                h += ', ' + init_value(f)
+        for o in m.oneofs:
+            h += ', %s__%s__NOT_SET' % (upper(m.name), o.upper())
+            h += ', {0}'
+        h += ' }\n\n\n'
+
+    for m in msgs:
+        C = ctype(m.name); L = lower(m.name)
+        h += '/* %s methods */\n' % C
+        h += 'void   %s__init\n                     (%s         *message);\n' % (L, C)
+        h += 'size_t %s__get_packed_size\n                     (const %s   *message);\n' % (L, C)
+        h += 'size_t %s__pack\n                     (const %s   *message,\n                      uint8_t             *out);\n' % (L, C)
+        h += 'size_t %s__pack_to_buffer\n                     (const %s   *message,\n                      ProtobufCBuffer     *buffer);\n' % (L, C)
+        h += '%s *\n       %s__unpack\n                     (ProtobufCAllocator  *allocator,\n                      size_t               len,\n                      const uint8_t       *data);\n' % (C, L)
+        h += 'void   %s__free_unpacked\n                     (%s *message,\n                      ProtobufCAllocator *allocator);\n' % (L, C)
+    h += '/* --- per-message closures --- */\n\n'
+    for m in msgs:
+        C = ctype(m.name)
+        h += 'typedef void (*%s_Closure)\n                 (const %s *message,\n                  void *closure_data);\n' % (C, C)
+    h += '\n/* --- services --- */\n\n\n/* --- descriptors --- */\n\n'
+    for e in enums:
+        h += 'extern const ProtobufCEnumDescriptor    %s__descriptor;\n' % lower(e.name)
+    for m in msgs:
+        h += 'extern const ProtobufCMessageDescriptor %s__descriptor;\n' % lower(m.name)
+    h += '\nPROTOBUF_C__END_DECLS\n\n\n#endif  /* %s */\n' % guard
+
+    c = ''
+    c += '/* Generated by the protocol buffer compiler.  DO NOT EDIT! */\n'
+    c += '/* Generated from: %s */\n\n' % base
+    c += '/* Do not generate deprecated warnings for self */\n#ifndef PROTOBUF_C__NO_DEPRECATED\n#define PROTOBUF_C__NO_DEPRECATED\n#endif\n\n'
+    c += '#include "%s.pb-c.h"\n' % stem
+    for m in msgs:
+        C = ctype(m.name); L = lower(m.name); U = upper(m.name)
+        c += 'void   %s__init\n                     (%s         *message)\n{\n  static const %s init_value = %s__INIT;\n  *message = init_value;\n}\n' % (L, C, C, U)
+        c += 'size_t %s__get_packed_size\n                     (const %s *message)\n{\n  assert(message->base.descriptor == &%s__descriptor);\n  return protobuf_c_message_get_packed_size ((const ProtobufCMessage*)(message));\n}\n' % (L, C, L)
+        c += 'size_t %s__pack\n                     (const %s *message,\n                      uint8_t       *out)\n{\n  assert(message->base.descriptor == &%s__descriptor);\n  return protobuf_c_message_pack ((const ProtobufCMessage*)message, out);\n}\n' % (L, C, L)
+        c += 'size_t %s__pack_to_buffer\n                     (const %s *message,\n                      ProtobufCBuffer *buffer)\n{\n  assert(message->base.descriptor == &%s__descriptor);\n  return protobuf_c_message_pack_to_buffer ((const ProtobufCMessage*)message, buffer);\n}\n' % (L, C, L)
+        c += '%s *\n       %s__unpack\n                     (ProtobufCAllocator  *allocator,\n                      size_t               len,\n                      const uint8_t       *data)\n{\n  return (%s *)\n     protobuf_c_message_unpack (&%s__descriptor,\n                                allocator, len, data);\n}\n' % (C, L, C, L)
+        c += 'void   %s__free_unpacked\n                     (%s *message,\n                      ProtobufCAllocator *allocator)\n{\n  if(!message)\n    return;\n  assert(message->base.descriptor == &%s__descriptor);\n  protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);\n}\n' % (L, C, L)
+    for m in msgs:
+        C = ctype(m.name); L = lower(m.name)
+        fs = sorted(m.fields, key=lambda f: f.number)
+        c += 'static const ProtobufCFieldDescriptor %s__field_descriptors[%d] =\n{\n' % (L, len(fs))
+        for f in fs:
+            c += '  {\n    "%s",\n    %d,\n' % (f.name, f.number)
+            c += '    PROTOBUF_C_LABEL_%s,\n' % ('REPEATED' if f.repeated else 'NONE')
+            if f.type in SCALARS:
+                tn = SCALARS[f.type][0]; d = 'NULL'
+            elif f.type in enum_names:
+                tn = 'ENUM'; d = '&%s__descriptor' % lower(f.type)
+            else:
+                tn = 'MESSAGE'; d = '&%s__descriptor' % lower(f.type)
+            c += '    PROTOBUF_C_TYPE_%s,\n' % tn
+            if f.repeated:
+                c += '    offsetof(%s, n_%s),\n' % (C, f.name)
+            elif f.oneof:
+                c += '    offsetof(%s, %s_case),\n' % (C, f.oneof)
+            else:
+                c += '    0,   /* quantifier_offset */\n'
+            c += '    offsetof(%s, %s),\n' % (C, f.name)
+            c += '    %s,\n' % d
+            c += '    %s,\n' % ('&protobuf_c_empty_string' if f.type == 'string' else 'NULL')
+            flags = '0'
+            if f.repeated and f.type not in ('string', 'bytes') and f.type not in msg_names:
+                flags += ' | PROTOBUF_C_FIELD_FLAG_PACKED'
+            if f.oneof:
+                flags += ' | PROTOBUF_C_FIELD_FLAG_ONEOF'
+            c += '    %s,             /* flags */\n' % flags
+            c += '    0,NULL,NULL    /* reserved1,reserved2, etc */\n  },\n'
+        c += '};\n'
+        c += 'static const unsigned %s__field_indices_by_name[] = {\n' % L
+        for i, f in sorted(enumerate(fs), key=lambda x: x[1].name):
+            c += '  %d,   /* field[%d] = %s */\n' % (i, i, f.name)
+        c += '};\n'
+        ranges = []
+        for i, f in enumerate(fs):
+            if i == 0 or f.number != fs[i-1].number + 1:
+                ranges.append((f.number, i))
+        c += 'static const ProtobufCIntRange %s__number_ranges[%d + 1] =\n{\n' % (L, len(ranges))
+        for r in ranges:
+            c += '  { %d, %d },\n' % r
+        c += '  { 0, %d }\n};\n' % len(fs)
+        c += 'const ProtobufCMessageDescriptor %s__descriptor =\n{\n' % L
+        c += '  PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,\n'
+        c += '  "%s.%s",\n  "%s",\n  "%s",\n  "%s",\n' % (pkg, m.name, m.name, C, pkg)
+        c += '  sizeof(%s),\n  %d,\n' % (C, len(fs))
+        c += '  %s__field_descriptors,\n  %s__field_indices_by_name,\n' % (L, L)
+        c += '  %d,  %s__number_ranges,\n' % (len(ranges), L)
+        c += '  (ProtobufCMessageInit) %s__init,\n' % L
+        c += '  NULL,NULL,NULL    /* reserved[123] */\n};\n'
+    for e in enums:
+        L = lower(e.name); U = upper(e.name)
+        vals = sorted(e.values, key=lambda v: v[1])
+        c += 'static const ProtobufCEnumValue %s__enum_values_by_number[%d] =\n{\n' % (L, len(vals))
+        for vn, vv, _ in vals:
+            c += '  { "%s", "%s__%s", %d },\n' % (vn, U, vn, vv)
+        c += '};\n'
+        ranges = []
+        for i, v in enumerate(vals):
+            if i == 0 or v[1] != vals[i-1][1] + 1:
+                ranges.append((v[1], i))
+        c += 'static const ProtobufCIntRange %s__value_ranges[] = {\n' % L
+        c += ','.join('{%d, %d}' % r for r in ranges) + ',{0, %d}\n};\n' % len(vals)
+        c += 'static const ProtobufCEnumValueIndex %s__enum_values_by_name[%d] =\n{\n' % (L, len(vals))
+        for i, v in sorted(enumerate(vals), key=lambda x: x[1][0]):
+            c += '  { "%s", %d },\n' % (v[0], i)
+        c += '};\n'
+        c += 'const ProtobufCEnumDescriptor %s__descriptor =\n{\n' % L
+        c += '  PROTOBUF_C__ENUM_DESCRIPTOR_MAGIC,\n'
+        c += '  "%s.%s",\n  "%s",\n  "%s",\n  "%s",\n' % (pkg, e.name, e.name, ctype(e.name), pkg)
+        c += '  %d,\n  %s__enum_values_by_number,\n  %d,\n  %s__enum_values_by_name,\n' % (len(vals), L, len(vals), L)
+        c += '  %d,\n  %s__value_ranges,\n' % (len(ranges), L)
+        c += '  NULL,NULL,NULL,NULL   /* reserved[1234] */\n};\n'
+
+    open(os.path.join(outdir, stem + '.pb-c.h'), 'w').write(h)
+    open(os.path.join(outdir, stem + '.pb-c.c'), 'w').write(c)
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('Usage: %s <file.proto> [output dir]' % sys.argv[0])
+        sys.exit(1)
+    gen(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else '.')
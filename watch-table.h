@@ -0,0 +1,249 @@
+#ifndef WTABLE
+#define WTABLE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "env.h"
+
+/*
+* Watch table
+* Reverse index of the presence subscriptions: for every watched username, the connections that
+* watch it, so a status change is pushed to its watchers without looking at anyone else. A name
+* is watched before its user registers and after it leaves, so the entries are keyed by the name,
+* in a hash table with chaining that doubles when it has more names than buckets. A subscription
+* is one link, in the circular list of the watchers of its name and in the list of the names its
+* watcher follows, so a connection that goes drops all its subscriptions without a search. The
+* caller holds the lock of the table, for reading to push and for writing to change it.
+*/
+typedef struct watch_link {
+    // Other watchers of the same name
+    struct watch_link *next;
+    struct watch_link *prev;
+    // Other names followed by the same watcher
+    struct watch_link *next_watched;
+    struct watch_entry *entry;
+    void *watcher;
+} WatchLink;
+
+typedef struct watch_entry {
+    // Next entry of the bucket
+    struct watch_entry *next;
+    // Circular list head, the name is watched by nobody when it points to itself
+    WatchLink watchers;
+    char name[MAX_USERNAME_LENGTH];
+} WatchEntry;
+
+typedef struct watch_list {
+    WatchLink *head;
+    int count;
+} WatchList;
+
+typedef struct watch_table {
+    pthread_rwlock_t lock;
+    WatchEntry **buckets;
+    uint32_t mask;
+    // Watched names and subscriptions
+    int names;
+    int links;
+} WatchTable;
+
+/*
+* Watch init function
+* @param table: the table
+* @return: 0 if successful, -1 if failed
+*/
+int watch_init(WatchTable *table) {
+    pthread_rwlock_init(&table->lock, NULL);
+    table->buckets = (WatchEntry **) calloc(WATCH_INITIAL_BUCKETS, sizeof(WatchEntry *));
+    table->mask = WATCH_INITIAL_BUCKETS - 1;
+    table->names = 0;
+    table->links = 0;
+    return table->buckets ? 0 : -1;
+}
+
+/*
+* Watch hash function
+* @param name: the username
+* @return: the 32-bit hash of the name
+*/
+uint32_t watch_hash(const char *name) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash = (hash ^ (unsigned char) *name++) * 16777619u;
+    }
+    return hash;
+}
+
+/*
+* Watch find function
+* @param table: the table
+* @param name: the username
+* @return: the entry of the name, NULL if nobody watches it
+*/
+WatchEntry *watch_find(WatchTable *table, const char *name) {
+    WatchEntry *entry = table->buckets[watch_hash(name) & table->mask];
+    while (entry && strcmp(entry->name, name) != 0) {
+        entry = entry->next;
+    }
+    return entry;
+}
+
+/*
+* Watch grow function
+* @param table: the table
+* @return: void
+* This function will be used when the table has more names than buckets, it stays as it is if the memory is not there
+*/
+void watch_grow(WatchTable *table) {
+    uint32_t size = (table->mask + 1) * 2;
+    WatchEntry **buckets = (WatchEntry **) calloc(size, sizeof(WatchEntry *));
+    if (buckets == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i <= table->mask; i++) {
+        WatchEntry *entry = table->buckets[i];
+        while (entry) {
+            WatchEntry *next = entry->next;
+            WatchEntry **bucket = &buckets[watch_hash(entry->name) & (size - 1)];
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->mask = size - 1;
+}
+
+/*
+* Watch follows function
+* @param table: the table
+* @param list: the names the watcher follows
+* @param name: the username
+* @return: 1 if the watcher follows the name, 0 if not
+*/
+int watch_follows(WatchTable *table, WatchList *list, const char *name) {
+    WatchEntry *entry = watch_find(table, name);
+    for (WatchLink *link = list->head; entry && link; link = link->next_watched) {
+        if (link->entry == entry) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+* Watch add function
+* @param table: the table
+* @param list: the names the watcher follows
+* @param watcher: the connection that watches
+* @param name: the username to watch
+* @return: 0 if successful, 1 if it was already watched, -1 if failed
+*/
+int watch_add(WatchTable *table, WatchList *list, void *watcher, const char *name) {
+    WatchEntry *entry = watch_find(table, name);
+    for (WatchLink *link = list->head; entry && link; link = link->next_watched) {
+        if (link->entry == entry) {
+            return 1;
+        }
+    }
+    WatchLink *link = (WatchLink *) malloc(sizeof(WatchLink));
+    if (link == NULL) {
+        return -1;
+    }
+    if (entry == NULL) {
+        entry = (WatchEntry *) malloc(sizeof(WatchEntry));
+        if (entry == NULL) {
+            free(link);
+            return -1;
+        }
+        strncpy(entry->name, name, MAX_USERNAME_LENGTH - 1);
+        entry->name[MAX_USERNAME_LENGTH - 1] = '\0';
+        entry->watchers.next = &entry->watchers;
+        entry->watchers.prev = &entry->watchers;
+        WatchEntry **bucket = &table->buckets[watch_hash(entry->name) & table->mask];
+        entry->next = *bucket;
+        *bucket = entry;
+        if (++table->names > (int) table->mask + 1) {
+            watch_grow(table);
+        }
+    }
+    link->entry = entry;
+    link->watcher = watcher;
+    link->next = &entry->watchers;
+    link->prev = entry->watchers.prev;
+    entry->watchers.prev->next = link;
+    entry->watchers.prev = link;
+    link->next_watched = list->head;
+    list->head = link;
+    list->count++;
+    table->links++;
+    return 0;
+}
+
+/*
+* Watch unlink function
+* @param table: the table
+* @param link: a subscription, already out of the list of its watcher
+* @return: void
+* This function will be used to drop a subscription, the entry of a name nobody watches anymore goes with it
+*/
+void watch_unlink(WatchTable *table, WatchLink *link) {
+    WatchEntry *entry = link->entry;
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    free(link);
+    table->links--;
+    if (entry->watchers.next != &entry->watchers) {
+        return;
+    }
+    WatchEntry **where = &table->buckets[watch_hash(entry->name) & table->mask];
+    while (*where != entry) {
+        where = &(*where)->next;
+    }
+    *where = entry->next;
+    free(entry);
+    table->names--;
+}
+
+/*
+* Watch remove function
+* @param table: the table
+* @param list: the names the watcher follows
+* @param name: the username to stop watching
+* @return: 1 if it was watched, 0 if not
+*/
+int watch_remove(WatchTable *table, WatchList *list, const char *name) {
+    WatchEntry *entry = watch_find(table, name);
+    for (WatchLink **where = &list->head; entry && *where; where = &(*where)->next_watched) {
+        if ((*where)->entry == entry) {
+            WatchLink *link = *where;
+            *where = link->next_watched;
+            list->count--;
+            watch_unlink(table, link);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+* Watch clear function
+* @param table: the table
+* @param list: the names the watcher follows
+* @return: void
+* This function will be used when a connection goes, before its node can be freed
+*/
+void watch_clear(WatchTable *table, WatchList *list) {
+    while (list->head) {
+        WatchLink *link = list->head;
+        list->head = link->next_watched;
+        watch_unlink(table, link);
+    }
+    list->count = 0;
+}
+
+#endif